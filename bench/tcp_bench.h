@@ -0,0 +1,79 @@
+#ifndef TCP_BENCH_H
+#define TCP_BENCH_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Settings of one benchmark run
+struct BenchConfig {
+    double min_seconds = 0.5;           // Repeat each microbenchmark at least this long
+    uint64_t trace_rows = 200000;       // Rows of the generated collector trace
+    int cells = 2000;                   // Cells of the generated results store
+    int trials = 3;                     // Trials per cell
+    int loopback_seconds = 5;           // Length of each loopback transfer
+    int sample_rate_hz = 10000;         // TCP_INFO rate of the sampled transfer
+    std::string filter;                 // Run only benchmarks whose name contains this
+    std::string directory;              // Scratch directory for generated inputs
+};
+
+// One measured value
+struct BenchValue {
+    std::string benchmark;
+    std::string metric;
+    double value;
+    std::string unit;
+};
+
+// Values of every benchmark that ran, in order
+class BenchReport {
+public:
+    void add(const std::string& benchmark, const std::string& metric, double value, const std::string& unit) {
+        values_.push_back({benchmark, metric, value, unit});
+    }
+
+    const std::vector<BenchValue>& values() const { return values_; }
+
+    // Benchmark,Metric,Value,Unit
+    bool write_csv(const std::string& path) const;
+
+    // Aligned table on stdout
+    void print() const;
+
+private:
+    std::vector<BenchValue> values_;
+};
+
+// Whether the benchmark is selected by config.filter
+bool bench_selected(const BenchConfig& config, const std::string& benchmark);
+
+// Make value look used, so the compiler cannot drop the work computing it
+inline void keep_result(double value) {
+    __asm__ __volatile__("" : : "g"(value) : "memory");
+}
+
+// Call op until config.min_seconds have passed (at least once) and return
+// the mean seconds per call; calls is set to how many ran
+template <typename Op>
+double time_per_call(const BenchConfig& config, Op op, uint64_t& calls) {
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    double elapsed = 0.0;
+    calls = 0;
+    do {
+        op();
+        ++calls;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < config.min_seconds);
+    return elapsed / static_cast<double>(calls);
+}
+
+// Parsers, aggregation and CSV writers over generated inputs
+void run_processing_benchmarks(const BenchConfig& config, BenchReport& report);
+
+// Bulk transfer over loopback without emulation, with and without the
+// TCP_INFO sampler
+void run_loopback_benchmarks(const BenchConfig& config, BenchReport& report);
+
+#endif // TCP_BENCH_H
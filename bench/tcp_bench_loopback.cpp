@@ -0,0 +1,172 @@
+#include "tcp_bench.h"
+
+#include "tcp_cpu_counters.h"
+#include "tcp_info_sampler.h"
+#include "tcp_transfer_engine.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+namespace {
+
+// Getsockopt(TCP_INFO) calls per timed batch
+const int kTcpInfoBatch = 1000;
+
+// Both ends of one loopback connection
+struct LoopbackPair {
+    int sender = -1;
+    int receiver = -1;
+
+    ~LoopbackPair() {
+        if (sender >= 0) {
+            close(sender);
+        }
+        if (receiver >= 0) {
+            close(receiver);
+        }
+    }
+};
+
+// Connect to a listener on an ephemeral 127.0.0.1 port and accept it
+bool open_loopback(LoopbackPair& pair) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0) {
+        std::cerr << "Failed to create listener socket\n";
+        return false;
+    }
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (bind(listener, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0 ||
+        listen(listener, 1) < 0 ||
+        getsockname(listener, reinterpret_cast<struct sockaddr*>(&address), &length) < 0) {
+        std::cerr << "Failed to listen on loopback\n";
+        close(listener);
+        return false;
+    }
+    pair.sender = socket(AF_INET, SOCK_STREAM, 0);
+    if (pair.sender < 0 ||
+        connect(pair.sender, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0) {
+        std::cerr << "Failed to connect on loopback\n";
+        close(listener);
+        return false;
+    }
+    pair.receiver = accept(listener, nullptr, nullptr);
+    close(listener);
+    if (pair.receiver < 0) {
+        std::cerr << "Failed to accept on loopback\n";
+        return false;
+    }
+    return true;
+}
+
+// What one loopback transfer achieved
+struct LoopbackRun {
+    bool ok = false;
+    double throughput_mbps = 0.0;
+    double cpu_percent = 0.0;
+    uint64_t samples = 0;
+    uint64_t missed_ticks = 0;
+};
+
+// Bulk transfer for config.loopback_seconds, polling TCP_INFO on the
+// sender at sample_rate_hz (0 = no sampler)
+LoopbackRun run_transfer(const BenchConfig& config, int sample_rate_hz) {
+    LoopbackRun run;
+    LoopbackPair pair;
+    if (!open_loopback(pair)) {
+        return run;
+    }
+
+    // Counters first: they follow the threads created after them
+    CpuCounters counters;
+    counters.start();
+    TcpInfoSampler sampler(sample_rate_hz > 0 ? sample_rate_hz : 1);
+    if (sample_rate_hz > 0) {
+        sampler.add_socket(pair.sender, TcpInfoSampler::capacity_for(sample_rate_hz, config.loopback_seconds));
+        if (!sampler.start()) {
+            return run;
+        }
+    }
+    TransferEngine engine(pair.sender, pair.receiver, TransferConfig());
+    if (!engine.start()) {
+        sampler.stop();
+        return run;
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(config.loopback_seconds));
+    TransferStats stats = engine.stop();
+    sampler.stop();
+    CpuCost cpu = counters.stop();
+
+    run.ok = true;
+    run.throughput_mbps = stats.throughput_mbps;
+    run.cpu_percent = cpu.cpu_percent;
+    if (sample_rate_hz > 0) {
+        run.samples = sampler.size(0);
+        run.missed_ticks = sampler.missed_ticks();
+    }
+    return run;
+}
+
+void bench_tcp_info(const BenchConfig& config, BenchReport& report) {
+    LoopbackPair pair;
+    if (!open_loopback(pair)) {
+        return;
+    }
+    struct tcp_info info;
+    uint64_t calls = 0;
+    double seconds = time_per_call(config, [&] {
+        for (int i = 0; i < kTcpInfoBatch; ++i) {
+            socklen_t length = sizeof(info);
+            getsockopt(pair.sender, IPPROTO_TCP, TCP_INFO, &info, &length);
+        }
+    }, calls);
+    report.add("tcp_info_read", "time", seconds / kTcpInfoBatch * 1e9, "ns/call");
+}
+
+} // namespace
+
+void run_loopback_benchmarks(const BenchConfig& config, BenchReport& report) {
+    if (bench_selected(config, "tcp_info_read")) {
+        bench_tcp_info(config, report);
+    }
+
+    bool plain = bench_selected(config, "loopback_transfer");
+    bool sampled = bench_selected(config, "loopback_sampled");
+    if (!plain && !sampled) {
+        return;
+    }
+    // The sampled run's overhead is relative to the plain one
+    LoopbackRun baseline = run_transfer(config, 0);
+    if (!baseline.ok) {
+        return;
+    }
+    if (plain) {
+        report.add("loopback_transfer", "throughput", baseline.throughput_mbps, "Mbps");
+        report.add("loopback_transfer", "cpu", baseline.cpu_percent, "%");
+    }
+    if (!sampled) {
+        return;
+    }
+    LoopbackRun run = run_transfer(config, config.sample_rate_hz);
+    if (!run.ok) {
+        return;
+    }
+    double expected = static_cast<double>(config.sample_rate_hz) * config.loopback_seconds;
+    report.add("loopback_sampled", "throughput", run.throughput_mbps, "Mbps");
+    report.add("loopback_sampled", "cpu", run.cpu_percent, "%");
+    report.add("loopback_sampled", "sample_rate", run.samples / static_cast<double>(config.loopback_seconds), "Hz");
+    report.add("loopback_sampled", "missed_ticks", expected > 0 ? 100.0 * run.missed_ticks / expected : 0.0, "%");
+    report.add("loopback_sampled", "throughput_overhead",
+               baseline.throughput_mbps > 0 ? 100.0 * (1.0 - run.throughput_mbps / baseline.throughput_mbps) : 0.0,
+               "%");
+    report.add("loopback_sampled", "cpu_overhead", run.cpu_percent - baseline.cpu_percent, "%");
+}
@@ -0,0 +1,139 @@
+#include "tcp_bench.h"
+
+#include "tcp_info_sampler.h"
+
+#include <getopt.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+bool BenchReport::write_csv(const std::string& path) const {
+    std::ofstream csv_file(path);
+    if (!csv_file) {
+        std::cerr << "Failed to create " << path << std::endl;
+        return false;
+    }
+    csv_file << "Benchmark,Metric,Value,Unit\n";
+    for (const auto& value : values_) {
+        csv_file << value.benchmark << "," << value.metric << "," << value.value << "," << value.unit << "\n";
+    }
+    csv_file.close();
+    std::cout << "Benchmark results saved to " << path << std::endl;
+    return static_cast<bool>(csv_file);
+}
+
+void BenchReport::print() const {
+    for (const auto& value : values_) {
+        std::cout << std::left << std::setw(24) << value.benchmark << std::setw(22) << value.metric
+                  << std::right << std::setw(14) << std::fixed << std::setprecision(2) << value.value
+                  << " " << value.unit << std::defaultfloat << "\n";
+    }
+}
+
+bool bench_selected(const BenchConfig& config, const std::string& benchmark) {
+    return config.filter.empty() || benchmark.find(config.filter) != std::string::npos;
+}
+
+static void print_usage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "Benchmarks the harness's own hot paths: the collector trace parser, the results\n"
+              << "store, the CSV export and comparison, the latency sketch, TCP_INFO reads and a\n"
+              << "loopback transfer with and without the TCP_INFO sampler.\n\n"
+              << "Options:\n"
+              << "  --min-time=SECONDS      Repeat each microbenchmark at least this long\n"
+              << "                          (default: 0.5)\n"
+              << "  --trace-rows=N          Rows of the generated collector trace (default: 200000)\n"
+              << "  --cells=N               Cells of the generated results store (default: 2000)\n"
+              << "  --trials=N              Trials per generated cell (default: 3)\n"
+              << "  --duration=SECONDS      Length of each loopback transfer (default: 5)\n"
+              << "  --sample-rate=HZ        TCP_INFO rate of the sampled transfer (default: 10000)\n"
+              << "  --filter=TEXT           Run only benchmarks whose name contains TEXT\n"
+              << "  --output=FILE           Machine-readable results (default: bench_results.csv)\n"
+              << "  --help                  Show this message\n";
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig config;
+    std::string output = "bench_results.csv";
+
+    static const struct option long_options[] = {
+        {"min-time",    required_argument, nullptr, 'm'},
+        {"trace-rows",  required_argument, nullptr, 'r'},
+        {"cells",       required_argument, nullptr, 'c'},
+        {"trials",      required_argument, nullptr, 'T'},
+        {"duration",    required_argument, nullptr, 'd'},
+        {"sample-rate", required_argument, nullptr, 'R'},
+        {"filter",      required_argument, nullptr, 'f'},
+        {"output",      required_argument, nullptr, 'o'},
+        {"help",        no_argument,       nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "h", long_options, nullptr)) != -1) {
+        switch (opt) {
+            case 'm':
+                config.min_seconds = std::atof(optarg);
+                break;
+            case 'r':
+                config.trace_rows = std::strtoull(optarg, nullptr, 10);
+                break;
+            case 'c':
+                config.cells = std::atoi(optarg);
+                break;
+            case 'T':
+                config.trials = std::atoi(optarg);
+                break;
+            case 'd':
+                config.loopback_seconds = std::atoi(optarg);
+                break;
+            case 'R':
+                config.sample_rate_hz = std::atoi(optarg);
+                break;
+            case 'f':
+                config.filter = optarg;
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    if (config.trace_rows == 0 || config.cells <= 0 || config.trials <= 0 || config.loopback_seconds <= 0) {
+        std::cerr << "Trace rows, cells, trials and duration must be positive\n";
+        return 1;
+    }
+    if (config.sample_rate_hz <= 0 || config.sample_rate_hz > kMaxTcpInfoSampleRate) {
+        std::cerr << "Sample rate must be between 1 and " << kMaxTcpInfoSampleRate << " Hz\n";
+        return 1;
+    }
+
+    // Generated inputs and the export's files go to a scratch directory
+    const char* tmp = std::getenv("TMPDIR");
+    std::string pattern = std::string(tmp != nullptr && *tmp != '\0' ? tmp : "/tmp") + "/tcp_bench.XXXXXX";
+    if (mkdtemp(&pattern[0]) == nullptr) {
+        std::cerr << "Failed to create a scratch directory\n";
+        return 1;
+    }
+    config.directory = pattern;
+
+    BenchReport report;
+    run_processing_benchmarks(config, report);
+    run_loopback_benchmarks(config, report);
+    rmdir(config.directory.c_str());
+
+    report.print();
+    if (report.values().empty()) {
+        std::cerr << "No benchmark ran\n";
+        return 1;
+    }
+    return report.write_csv(output) ? 0 : 1;
+}
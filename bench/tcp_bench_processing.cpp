@@ -0,0 +1,226 @@
+#include "tcp_bench.h"
+
+#include "tcp_collector_trace.h"
+#include "tcp_latency_sketch.h"
+#include "tcp_results_compare.h"
+#include "tcp_results_export.h"
+#include "tcp_results_store.h"
+
+#include <sys/stat.h>
+
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+const char* const kAlgorithms[] = {"cubic", "bbr", "reno", "htcp", "vegas"};
+
+// Values recorded per call of the sketch benchmark
+const size_t kSketchBatch = 4096;
+
+// Sends the exporters' progress lines nowhere while they are timed
+class QuietStdout {
+public:
+    QuietStdout() : saved_(std::cout.rdbuf(sink_.rdbuf())) {}
+    ~QuietStdout() { std::cout.rdbuf(saved_); }
+
+private:
+    std::ostringstream sink_;
+    std::streambuf* saved_;
+};
+
+off_t file_size(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 ? info.st_size : 0;
+}
+
+// A collector trace in the layout tcp_ebpf_collector.py writes: samples of
+// a few flows per algorithm, one row each
+bool write_collector_trace(const std::string& path, uint64_t rows) {
+    std::FILE* file = std::fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        std::cerr << "Failed to create " << path << std::endl;
+        return false;
+    }
+    std::fprintf(file, "timestamp,src_port,dst_port,cc_algo,rtt_us,rttvar_us,cwnd,lost_packets,"
+                       "retrans_packets,bytes_acked\n");
+    std::mt19937_64 rng(1);
+    std::uniform_int_distribution<uint32_t> jitter(0, 2000);
+    uint64_t acked[40] = {};
+    for (uint64_t row = 0; row < rows; ++row) {
+        size_t flow = row % 40;
+        acked[flow] += 1448 * (1 + jitter(rng) % 16);
+        std::fprintf(file, "%llu,%zu,5201,%s,%u,%u,%u,%u,%u,%llu\n",
+                     static_cast<unsigned long long>(1000000000ULL + row * 10000), 40000 + flow,
+                     kAlgorithms[flow % 5], 10000 + jitter(rng), 500 + jitter(rng) / 4, 10 + jitter(rng) % 200,
+                     jitter(rng) % 3, jitter(rng) % 7, static_cast<unsigned long long>(acked[flow]));
+    }
+    return std::fclose(file) == 0;
+}
+
+// A results store of a sweep: cells across algorithms, bandwidths and
+// latencies, each trial with its summary values and an RTT sketch
+bool write_results_store(const std::string& path, int cells, int trials) {
+    ResultsStoreWriter writer;
+    if (!writer.open(path)) {
+        return false;
+    }
+    std::mt19937_64 rng(2);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    LatencySketch rtt_us;
+    for (int cell = 0; cell < cells; ++cell) {
+        const char* algorithm = kAlgorithms[cell % 5];
+        int bandwidth = 10 * (1 + cell / 5 / 6);
+        int latency = 1 + 10 * (cell / 5 % 6);
+        for (int trial = 0; trial < trials; ++trial) {
+            rtt_us.clear();
+            for (int i = 0; i < 1000; ++i) {
+                rtt_us.record(static_cast<uint64_t>(latency * 1000.0 * (1.0 + 0.1 * std::fabs(noise(rng)))));
+            }
+            std::vector<MetricValue> metrics = {
+                {kMetricThroughput, bandwidth * 0.9 + noise(rng)},
+                {kMetricGoodput, bandwidth * 0.9},
+                {kMetricLatency, latency * 1.1},
+                {kMetricJitter, 0.1},
+                {kMetricPacketLoss, 3.0},
+                {kMetricCyclesPerByte, 2.0 + 0.05 * noise(rng)},
+            };
+            if (!writer.append_cell(make_results_key(algorithm, bandwidth, latency, trial), metrics, 0, {},
+                                    {{kSketchRtt, &rtt_us}})) {
+                return false;
+            }
+        }
+    }
+    return writer.close();
+}
+
+void bench_sketch(const BenchConfig& config, BenchReport& report) {
+    std::vector<uint64_t> values(kSketchBatch);
+    std::mt19937_64 rng(3);
+    std::lognormal_distribution<double> rtt(9.0, 0.5);
+    for (uint64_t& value : values) {
+        value = static_cast<uint64_t>(rtt(rng));
+    }
+
+    LatencySketch sketch;
+    uint64_t calls = 0;
+    double seconds = time_per_call(config, [&] {
+        for (uint64_t value : values) {
+            sketch.record(value);
+        }
+    }, calls);
+    report.add("sketch_record", "time", seconds / kSketchBatch * 1e9, "ns/value");
+
+    LatencySketch merged;
+    seconds = time_per_call(config, [&] {
+        merged.clear();
+        merged.merge(sketch);
+        keep_result(merged.quantile(0.99));
+    }, calls);
+    report.add("sketch_merge_p99", "time", seconds * 1e9, "ns/op");
+}
+
+void bench_collector_trace(const BenchConfig& config, BenchReport& report) {
+    std::string path = config.directory + "/bench_" + kCollectorDefaultOutput;
+    if (!write_collector_trace(path, config.trace_rows)) {
+        return;
+    }
+    double megabytes = static_cast<double>(file_size(path)) / 1e6;
+    std::vector<CollectorTraceSummary> summaries;
+    uint64_t skipped = 0;
+    bool ok = true;
+    uint64_t calls = 0;
+    double seconds = time_per_call(config, [&] {
+        summaries.clear();
+        ok = summarize_collector_trace(path, summaries, skipped) && ok;
+    }, calls);
+    std::remove(path.c_str());
+    if (!ok) {
+        return;
+    }
+    report.add("collector_trace_parse", "rows", config.trace_rows / seconds, "rows/s");
+    report.add("collector_trace_parse", "bytes", megabytes / seconds, "MB/s");
+}
+
+void bench_results_store(const BenchConfig& config, BenchReport& report) {
+    std::string path = config.directory + "/bench_results.tcpr";
+    if (!write_results_store(path, config.cells, config.trials)) {
+        return;
+    }
+    double cells = static_cast<double>(config.cells) * config.trials;
+    uint64_t calls = 0;
+
+    if (bench_selected(config, "results_store_read")) {
+        LatencySketch rtt_us;
+        bool ok = true;
+        double seconds = time_per_call(config, [&] {
+            ResultsStoreReader reader;
+            ok = reader.open(path) && ok;
+            for (size_t i = 0; i < reader.size(); ++i) {
+                keep_result(reader.metric(i, kMetricThroughput));
+                reader.sketch(i, kSketchRtt, rtt_us);
+                keep_result(rtt_us.quantile(0.99));
+            }
+        }, calls);
+        if (ok) {
+            report.add("results_store_read", "cells", cells / seconds, "cells/s");
+        }
+    }
+
+    ResultsStoreReader reader;
+    if (!reader.open(path)) {
+        return;
+    }
+    if (bench_selected(config, "results_export_csv")) {
+        // The per-algorithm comparison and the gnuplot pivots are aggregated
+        // and written in this one pass
+        bool ok = true;
+        double seconds = time_per_call(config, [&] {
+            QuietStdout quiet;
+            ok = export_results_csv(reader, config.directory) && ok;
+        }, calls);
+        if (ok) {
+            report.add("results_export_csv", "cells", cells / seconds, "cells/s");
+            report.add("results_export_csv", "time", seconds * 1e3, "ms");
+        }
+        for (const char* name : {"detailed_metrics.csv", "algorithm_comparison.csv", "cell_confidence.csv",
+                                 "request_latency.csv", "throughput_vs_bandwidth.csv",
+                                 "latency_vs_bandwidth.csv"}) {
+            std::remove((config.directory + "/" + name).c_str());
+        }
+    }
+    if (bench_selected(config, "results_compare")) {
+        CompareOptions options;
+        CompareSummary summary;
+        bool ok = true;
+        double seconds = time_per_call(config, [&] {
+            QuietStdout quiet;
+            ok = compare_results(reader, reader, options, config.directory, summary) && ok;
+        }, calls);
+        if (ok) {
+            report.add("results_compare", "cells", 2.0 * cells / seconds, "cells/s");
+            report.add("results_compare", "time", seconds * 1e3, "ms");
+        }
+        std::remove((config.directory + "/regression_report.csv").c_str());
+    }
+    std::remove(path.c_str());
+}
+
+} // namespace
+
+void run_processing_benchmarks(const BenchConfig& config, BenchReport& report) {
+    if (bench_selected(config, "sketch_record") || bench_selected(config, "sketch_merge_p99")) {
+        bench_sketch(config, report);
+    }
+    if (bench_selected(config, "collector_trace_parse")) {
+        bench_collector_trace(config, report);
+    }
+    if (bench_selected(config, "results_store_read") || bench_selected(config, "results_export_csv") ||
+        bench_selected(config, "results_compare")) {
+        bench_results_store(config, report);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef TCP_BPF_CONGESTION_H
+#define TCP_BPF_CONGESTION_H
+
+#include <string>
+#include <vector>
+
+struct bpf_object;
+struct bpf_link;
+
+// A congestion control registered from a BPF object file
+struct BpfCongestion {
+    std::string name;           // As in tcp_available_congestion_control
+    std::string object_path;
+};
+
+// Congestion controls written as BPF struct_ops programs (struct
+// tcp_congestion_ops, such as the kernel's bpf_cubic and bpf_dctcp
+// examples), loaded from object files and registered with the kernel for
+// the length of the run. Every struct_ops map of every *.o file in the
+// directory is registered, one at a time; the name each one adds to
+// tcp_available_congestion_control is the algorithm. unload() or the
+// destructor unregisters them again.
+//
+// Without ENABLE_EBPF_METRICS at build time (libbpf) load() always fails.
+class BpfCongestionLoader {
+public:
+    BpfCongestionLoader() = default;
+    ~BpfCongestionLoader();
+
+    BpfCongestionLoader(const BpfCongestionLoader&) = delete;
+    BpfCongestionLoader& operator=(const BpfCongestionLoader&) = delete;
+
+    // Whether struct_ops loading was compiled in
+    static bool available();
+
+    // Register the algorithms of every object file in directory; objects
+    // that fail are reported and skipped. False when none registered.
+    bool load(const std::string& directory);
+
+    // Unregister every algorithm and close the objects
+    void unload();
+
+    const std::vector<BpfCongestion>& algorithms() const { return algorithms_; }
+
+    // Object file of a registered algorithm, empty for kernel ones
+    std::string object_of(const std::string& name) const;
+
+private:
+    std::vector<struct bpf_object*> objects_;
+    std::vector<struct bpf_link*> links_;
+    std::vector<BpfCongestion> algorithms_;
+
+    bool load_object(const std::string& path);
+};
+
+#endif // TCP_BPF_CONGESTION_H
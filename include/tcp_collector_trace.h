@@ -0,0 +1,48 @@
+#ifndef TCP_COLLECTOR_TRACE_H
+#define TCP_COLLECTOR_TRACE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Output name the standalone collector (src/tcp_ebpf_collector.py) uses
+// when it is not given --output
+const char* const kCollectorDefaultOutput = "ebpf_metrics.csv";
+
+// Parts of a collector file name, "{algorithm}_{YYYYmmdd_HHMMSS}_{output}"
+struct CollectorTraceName {
+    std::string algorithm;
+    std::string timestamp;      // YYYYmmdd_HHMMSS, sorts chronologically
+    std::string output;
+};
+
+// Split a collector file name (without directory); false if it does not
+// follow the collector's pattern
+bool parse_collector_trace_name(const std::string& filename, CollectorTraceName& name);
+
+// Newest trace per algorithm written into directory with the given output
+// name, as full paths sorted by algorithm
+std::vector<std::string> find_collector_traces(const std::string& directory, const std::string& output);
+
+// One congestion control algorithm's share of a collector trace
+struct CollectorTraceSummary {
+    std::string algorithm;      // cc_algo column, or the file name's algorithm
+    uint64_t samples = 0;
+    uint64_t flows = 0;         // Distinct (src_port, dst_port) pairs
+    double duration_s = 0.0;    // First to last timestamp
+    double mean_rtt_ms = 0.0;
+    double mean_rttvar_ms = 0.0;
+    double mean_cwnd = 0.0;     // Packets
+    uint64_t max_cwnd = 0;
+    uint64_t max_lost = 0;      // Peak lost_packets
+    uint64_t max_retrans = 0;   // Peak retrans_packets
+    double throughput_mbps = 0.0;  // Sum of per-flow bytes_acked deltas over the duration
+};
+
+// Stream a collector CSV once and aggregate it per algorithm. Columns are
+// matched by header name; rtt_us is required, the others are used when
+// present. skipped counts rows without a usable rtt_us.
+bool summarize_collector_trace(const std::string& path, std::vector<CollectorTraceSummary>& summaries,
+                               uint64_t& skipped);
+
+#endif // TCP_COLLECTOR_TRACE_H
@@ -0,0 +1,67 @@
+#ifndef TCP_CPU_COUNTERS_H
+#define TCP_CPU_COUNTERS_H
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// CPU spent during one measurement window
+struct CpuCost {
+    bool measured = false;          // Utilisation was read from /proc/stat
+    bool counted = false;           // Cycles and instructions were counted
+    bool system_wide = false;       // ... on every CPU, not only by the tester
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    uint64_t context_switches = 0;  // Of the tester's threads
+    double cpu_percent = 0.0;       // Busy share of all CPUs
+    double softirq_percent = 0.0;   // Share of all CPUs spent in softirq
+    double elapsed_seconds = 0.0;
+};
+
+// Cycle, instruction and context switch counters over a measurement window
+// via perf_event_open, next to CPU and softirq time from /proc/stat.
+//
+// The tester's counters are opened on the calling thread with inherit set,
+// so they also count every thread it creates afterwards (transfer engine,
+// sampler, probes): start() has to run before those threads exist. When
+// the caller may (root, CAP_PERFMON or perf_event_paranoid <= 0), cycles
+// and instructions are also counted on every CPU; those include softirq
+// work done outside the tester's threads, such as ksoftirqd, and are
+// preferred. Without a hardware PMU (most VMs) only the software counters
+// and /proc/stat are available.
+class CpuCounters {
+public:
+    CpuCounters() = default;
+    ~CpuCounters();
+
+    CpuCounters(const CpuCounters&) = delete;
+    CpuCounters& operator=(const CpuCounters&) = delete;
+
+    // Open and enable the counters. False when /proc/stat cannot be read;
+    // counters that cannot be opened are left out.
+    bool start();
+
+    // Disable the counters and return what they counted since start()
+    CpuCost stop();
+
+private:
+    // Jiffies of the aggregate "cpu" line of /proc/stat
+    struct ProcStat {
+        uint64_t total = 0;
+        uint64_t idle = 0;          // Idle and iowait
+        uint64_t softirq = 0;
+    };
+
+    int thread_cycles_ = -1;
+    int thread_instructions_ = -1;
+    int thread_switches_ = -1;
+    std::vector<int> system_cycles_;        // One per online CPU
+    std::vector<int> system_instructions_;
+    ProcStat start_stat_;
+    std::chrono::steady_clock::time_point start_time_;
+
+    static bool read_proc_stat(ProcStat& stat);
+    void close_all();
+};
+
+#endif // TCP_CPU_COUNTERS_H
@@ -0,0 +1,22 @@
+#ifndef TCP_CRASH_RESTORE_H
+#define TCP_CRASH_RESTORE_H
+
+#include <string>
+#include <vector>
+
+// Host-wide changes (qdiscs, sysctls, routes) must not outlive the process.
+// Every change in place owns a slot holding a prebuilt restore; on SIGINT,
+// SIGTERM, a crash or exit() the slots are replayed with async-signal-safe
+// calls only and the signal is re-raised with its default action.
+// Registration returns the slot index, or -1 when the restore cannot be held.
+
+// Replay message on the netlink socket fd, which the caller keeps open
+int register_netlink_restore(int fd, const std::vector<char>& message);
+
+// Write value to the sysctl name, a path below /proc/sys
+int register_sysctl_restore(const std::string& name, const std::string& value);
+
+// Drop the slot once the change has been undone (-1 is ignored)
+void unregister_crash_restore(int slot);
+
+#endif
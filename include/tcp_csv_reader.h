@@ -0,0 +1,56 @@
+#ifndef TCP_CSV_READER_H
+#define TCP_CSV_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "tcp_mapped_file.h"
+
+// Streaming reader for CSV files with a header line, over an mmap'd file.
+// Columns are looked up by header name once; next() then splits one row at
+// a time into views of the mapping, so reading does not allocate per row or
+// per field. Fields may be quoted; the quotes are stripped, doubled quotes
+// inside them are left as they are.
+class CsvReader {
+public:
+    CsvReader();
+
+    // Map the file and read its header
+    bool open(const std::string& path);
+
+    // Index of a header column, -1 if the file has none by that name
+    int column(std::string_view name) const;
+    size_t columns() const { return header_.size(); }
+
+    // Advance to the next non-empty row; false at the end of the file.
+    // Rows shorter than the header read the missing fields as empty.
+    bool next();
+
+    // 1-based line number of the current row, for error messages
+    uint64_t line() const { return line_; }
+
+    // Field of the current row; empty for index -1 or a missing field
+    std::string_view field(int index) const;
+
+    // Parse a numeric field with std::from_chars; false if it is empty or
+    // not entirely a number
+    bool number(int index, double& value) const;
+    bool number(int index, uint64_t& value) const;
+
+private:
+    MappedFile file_;
+    const char* cursor_;
+    const char* end_;
+    uint64_t line_;
+    std::vector<std::string> header_;
+    std::vector<std::pair<const char*, size_t>> fields_;
+
+    // Split the line starting at cursor_ into fields_ and step past it
+    size_t split_line();
+};
+
+#endif // TCP_CSV_READER_H
@@ -0,0 +1,129 @@
+#ifndef TCP_EBPF_COLLECTOR_H
+#define TCP_EBPF_COLLECTOR_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "tcp_ebpf_events.h"
+
+struct tcp_metrics_bpf;
+struct ring_buffer;
+
+const size_t kEbpfHistogramSlots = TCP_METRICS_HIST_SLOTS;
+
+// log2 histogram: slot i counts values in [2^i, 2^(i+1))
+using EbpfHistogram = std::array<uint64_t, kEbpfHistogramSlots>;
+
+// Estimate a quantile (0..1) from a log2 histogram, to within its bucket
+double ebpf_histogram_quantile(const EbpfHistogram& histogram, double quantile);
+
+// In-kernel aggregates of one flow, merged across CPUs
+struct EbpfFlowStats {
+    uint64_t samples = 0;
+    uint64_t srtt_sum_us = 0;
+    uint64_t mdev_sum_us = 0;
+    uint64_t lost_out_sum = 0;
+    uint64_t retrans_out_sum = 0;
+    uint64_t bytes_acked = 0;
+    uint64_t retransmits = 0;
+    uint64_t cwnd_samples = 0;
+    uint32_t snd_cwnd_max = 0;
+    uint32_t lost_out_max = 0;
+    uint32_t retrans_out_max = 0;
+    EbpfHistogram srtt_hist = {};      // Microseconds
+    EbpfHistogram mdev_hist = {};      // Microseconds
+    EbpfHistogram cwnd_hist = {};      // Packets
+};
+
+// Kernel-side view of the sender over one cell
+struct EbpfCellSummary {
+    uint64_t samples = 0;
+    uint64_t events = 0;            // Per-packet events received, if enabled
+    double mean_rtt_ms = 0.0;       // Mean smoothed RTT
+    double mean_rttvar_ms = 0.0;    // Mean RTT deviation
+    double p50_rtt_ms = 0.0;        // From the log2 histogram
+    double p99_rtt_ms = 0.0;
+    double peak_interval_mbps = 0.0;  // Best bytes_acked rate between two reads
+    uint32_t max_cwnd = 0;          // Packets
+    uint32_t max_lost_out = 0;      // Peak packets marked lost
+    uint32_t max_retrans_out = 0;   // Peak retransmissions in flight
+    uint64_t retransmits = 0;       // Retransmitted segments
+    EbpfFlowStats flow;
+};
+
+// In-process eBPF collector built on a libbpf skeleton of
+// src/bpf/tcp_metrics.bpf.c. The programs are loaded and attached once by
+// open() and stay attached for the whole sweep; begin_cell() registers the
+// test socket's cookie with the kernel. The kernel aggregates every sample
+// per flow and per CPU; sample() reads those aggregates and is meant to be
+// called at a coarse interval. Per-packet ring buffer events are off unless
+// set_event_sampling() asks for one in N; they are counted and can be
+// written to a trace per cell.
+//
+// Without ENABLE_EBPF_METRICS at build time open() always fails.
+class EbpfCollector {
+public:
+    EbpfCollector();
+    ~EbpfCollector();
+
+    EbpfCollector(const EbpfCollector&) = delete;
+    EbpfCollector& operator=(const EbpfCollector&) = delete;
+
+    // Whether the collector was compiled in
+    static bool available();
+
+    // Load and attach the BPF programs
+    bool open();
+
+    // Emit one per-packet event in every one_in_n samples (0 = none).
+    // Takes effect at the next begin_cell().
+    void set_event_sampling(uint32_t one_in_n) { event_sampling_ = one_in_n; }
+
+    // Report on the TCP socket fd from now on. With per-packet events on and
+    // a trace_path, the cell's events are written there as a CSV in the
+    // columns of tcp_ebpf_collector.py, algorithm going in cc_algo.
+    bool begin_cell(int socket_fd, const std::string& trace_path = std::string(),
+                    const std::string& algorithm = std::string());
+
+    // Read the current aggregates of the cell's flow
+    bool sample(EbpfFlowStats& stats);
+
+    // Consume pending per-packet events, waiting up to timeout_ms
+    void poll(int timeout_ms);
+
+    // Stop reporting, take a final sample, close the trace and summarise
+    // the cell
+    EbpfCellSummary end_cell();
+
+private:
+    struct tcp_metrics_bpf* skel_;
+    struct ring_buffer* ring_;
+    uint32_t cell_;
+    uint32_t event_sampling_;
+
+    // Socket cookie of the current cell's flow
+    uint64_t cookie_;
+    bool cong_control_hooked_;
+
+    // Per-CPU values of one lookup, allocated once in open()
+    std::vector<unsigned char> percpu_values_;
+
+    // State of the current cell
+    uint64_t events_;
+    uint64_t last_sample_ns_;
+    uint64_t last_bytes_acked_;
+    double peak_interval_mbps_;
+    std::FILE* trace_;
+    std::string trace_path_;
+    std::string trace_algorithm_;
+
+    static int handle_event(void* ctx, void* data, size_t size);
+    bool write_config();
+    void close_trace();
+};
+
+#endif // TCP_EBPF_COLLECTOR_H
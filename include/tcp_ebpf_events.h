@@ -0,0 +1,68 @@
+#ifndef TCP_EBPF_EVENTS_H
+#define TCP_EBPF_EVENTS_H
+
+// Records shared between src/bpf/tcp_metrics.bpf.c and the userspace
+// collector. The BPF side gets the __u* types from vmlinux.h.
+#ifndef __VMLINUX_H__
+#include <linux/types.h>
+#endif
+
+// log2 buckets per histogram; bucket i counts values in [2^i, 2^(i+1))
+#define TCP_METRICS_HIST_SLOTS 32
+
+// Hook that produced an event
+enum tcp_metrics_event_kind {
+    TCP_METRICS_PROBE = 1,          // tcp:tcp_probe, an incoming segment
+    TCP_METRICS_RETRANSMIT = 2,     // tcp:tcp_retransmit_skb
+    TCP_METRICS_CONG_CONTROL = 3,   // Return from tcp_cong_control()
+};
+
+// One sample of the sender's congestion state
+struct tcp_metrics_event {
+    __u64 ts_ns;                // bpf_ktime_get_ns()
+    __u64 cookie;               // Socket cookie (SO_COOKIE)
+    __u32 cell;                 // Cell the flow was registered for
+    __u32 kind;                 // tcp_metrics_event_kind
+    __u32 saddr;                // Network byte order
+    __u32 daddr;
+    __u16 sport;                // Host byte order
+    __u16 dport;
+    __u32 snd_cwnd;             // Packets
+    __u32 snd_ssthresh;
+    __u32 rcv_wnd;              // Bytes
+    __u32 srtt_us;
+    __u32 mdev_us;
+    __u32 lost_out;             // Packets currently considered lost
+    __u32 retrans_out;          // Retransmitted packets in flight
+    __u64 bytes_sent;
+    __u64 bytes_acked;
+};
+
+// Per-flow, per-CPU aggregates kept in the kernel, keyed by socket cookie.
+// Userspace sums the CPUs (maxima and bytes_acked are combined with max)
+// when it samples the map.
+struct tcp_flow_stats {
+    __u64 samples;
+    __u64 srtt_sum_us;
+    __u64 mdev_sum_us;
+    __u64 lost_out_sum;
+    __u64 retrans_out_sum;
+    __u64 bytes_acked;          // Cumulative, latest value seen
+    __u64 retransmits;          // tcp_retransmit_skb calls
+    __u64 cwnd_samples;         // Entries in cwnd_hist
+    __u32 snd_cwnd_max;
+    __u32 lost_out_max;
+    __u32 retrans_out_max;
+    __u32 pad;
+    __u64 srtt_hist[TCP_METRICS_HIST_SLOTS];     // Microseconds
+    __u64 mdev_hist[TCP_METRICS_HIST_SLOTS];     // Microseconds
+    __u64 cwnd_hist[TCP_METRICS_HIST_SLOTS];     // Packets
+};
+
+// Global settings, written by userspace
+struct tcp_metrics_config {
+    __u32 event_sampling;       // Per-packet events: 0 = off, N = one in N
+    __u32 cong_control_hooked;  // cwnd is sampled after tcp_cong_control()
+};
+
+#endif // TCP_EBPF_EVENTS_H
@@ -0,0 +1,125 @@
+#ifndef TCP_FLOW_CHURN_H
+#define TCP_FLOW_CHURN_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tcp_latency_sketch.h"
+
+// Flow size buckets of the completion-time report
+const size_t kChurnBuckets = 5;
+
+// Bucket of a flow size and its name, e.g. "10KB-100KB"
+size_t churn_bucket(uint64_t bytes);
+const char* churn_bucket_name(size_t bucket);
+
+// Empirical flow size CDF: (bytes, cumulative probability) points,
+// linearly interpolated
+class FlowSizeDistribution {
+public:
+    // "websearch" (DCTCP), "datamining" (VL2) or a file of "BYTES CDF"
+    // lines with non-decreasing values ending at probability 1
+    bool load(const std::string& name_or_path);
+
+    // Size at uniform draw u in [0, 1), at least one byte
+    uint64_t sample(double u) const;
+
+    double mean() const;
+    const std::string& name() const { return name_; }
+
+private:
+    std::string name_;
+    std::vector<std::pair<double, double>> points_;
+
+    bool set_points(const std::vector<std::pair<double, double>>& points);
+};
+
+// Settings of one churn run
+struct ChurnConfig {
+    double rate = 1000.0;               // New connections per second, Poisson arrivals
+    size_t max_active = 1000;           // Flows open at once; arrivals beyond are dropped
+    std::string algorithm;              // TCP_CONGESTION of the client (sending) sockets
+    uint16_t port = 5001;               // Loopback port of the generator's own listener
+    double drain_seconds = 5.0;         // Grace time for open flows once arrivals stop
+    uint64_t seed = 1;
+};
+
+// What a churn run measured
+struct ChurnStats {
+    uint64_t arrivals = 0;
+    uint64_t completed = 0;
+    uint64_t failed = 0;                // socket(), connect() or transfer errors
+    uint64_t port_exhausted = 0;        // Of the failures, EADDRNOTAVAIL from connect()
+    uint64_t dropped = 0;               // Arrivals while max_active flows were open
+    uint64_t unfinished = 0;            // Still open after the drain time
+    uint64_t bytes = 0;                 // Payload of completed flows
+    double elapsed_seconds = 0.0;       // Arrival window
+    double setup_cpu_us = 0.0;          // Mean time to open a flow: socket(), setsockopt(),
+                                        // connect() and epoll registration
+    uint32_t peak_time_wait = 0;        // Most TIME_WAIT sockets seen at once
+    uint32_t ephemeral_ports = 0;       // Size of ip_local_port_range
+    LatencySketch connect_us;           // connect() to established
+    std::array<LatencySketch, kChurnBuckets> fct_us;    // Per size bucket
+};
+
+// Open-loop short-flow generator. Each arrival connects a non-blocking
+// client to the generator's loopback listener, sends a size header and the
+// flow's bytes and waits for a one-byte reply; the flow completion time
+// runs from connect() to that reply, and the client then closes first, so
+// TIME_WAIT builds up on the client side as in a real load generator. Both
+// ends of every flow are driven by one edge-triggered epoll loop in the
+// calling thread; per-connection state lives in a table indexed by
+// descriptor and all flows share one send and one receive buffer, so the
+// loop does not allocate per connection.
+class FlowChurn {
+public:
+    FlowChurn(const ChurnConfig& config, const FlowSizeDistribution& sizes);
+    ~FlowChurn();
+
+    FlowChurn(const FlowChurn&) = delete;
+    FlowChurn& operator=(const FlowChurn&) = delete;
+
+    // Generate arrivals for `seconds`, then give open flows drain_seconds
+    // to finish. False when the listener or the algorithm cannot be set up.
+    bool run(double seconds, ChurnStats& stats);
+
+private:
+    enum Role : uint8_t { kUnused, kClient, kServer };
+    enum Phase : uint8_t { kConnecting, kSending, kAwaitingReply, kReceiving, kReplied };
+
+    struct Connection {
+        Role role = kUnused;
+        Phase phase = kConnecting;
+        uint32_t generation = 0;        // Tells events of a reused descriptor apart
+        uint64_t size = 0;              // Payload bytes
+        uint64_t done = 0;              // Header and payload bytes sent or received
+        uint64_t started_ns = 0;
+        uint64_t header = 0;            // Size as sent, or as it arrives
+    };
+
+    ChurnConfig config_;
+    const FlowSizeDistribution& sizes_;
+    int listen_fd_;
+    int epoll_fd_;
+    size_t active_;
+    std::vector<Connection> connections_;
+    std::vector<char> send_buffer_;
+    std::vector<char> recv_buffer_;
+
+    bool open_listener();
+    Connection& slot(int fd);
+    uint64_t tag(int fd);
+    void start_flow(uint64_t size, ChurnStats& stats);
+    void accept_flows();
+    void on_client(int fd, uint32_t events, ChurnStats& stats);
+    void on_server(int fd);
+    bool send_flow(int fd, Connection& conn);
+    void finish_client(int fd, bool completed, ChurnStats& stats);
+    void close_connection(int fd);
+};
+
+#endif // TCP_FLOW_CHURN_H
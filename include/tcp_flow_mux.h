@@ -0,0 +1,123 @@
+#ifndef TCP_FLOW_MUX_H
+#define TCP_FLOW_MUX_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Upper bound on automatically chosen FlowMux workers
+const int kMuxDefaultMaxWorkers = 4;
+
+// One flow of a contention run
+struct ContentionFlowSpec {
+    std::string algorithm;
+    double start_seconds = 0.0;         // Offset from the start of the run
+    double duration_seconds = 0.0;      // 0 = until the end of the run
+};
+
+// Parse comma-separated groups "ALG[:COUNT][@START][+DURATION]" (times in
+// seconds), e.g. "cubic:50,bbr:50@5+20"; returns false on malformed groups
+bool parse_contention_spec(const std::string& text, std::vector<ContentionFlowSpec>& flows);
+
+// Raise the soft open-file limit so `descriptors` more files fit
+bool reserve_descriptors(size_t descriptors);
+
+// What one flow did over its active span
+struct MuxFlowStats {
+    double started_seconds = 0.0;       // Since FlowMux::start()
+    double ended_seconds = 0.0;
+    uint64_t bytes_sent = 0;
+    uint64_t bytes_received = 0;        // Read by the receiver up to the end
+    uint64_t bytes_acked = 0;           // tcpi_bytes_acked at the end
+    double rtt_ms = 0.0;                // Sender srtt at the end
+    uint32_t retransmits = 0;           // tcpi_total_retrans at the end
+
+    double goodput_mbps() const;
+};
+
+// Drives many bulk flows from a few threads. Flows are spread over the
+// workers; each worker multiplexes the non-blocking sender and receiver
+// sockets of its flows with one edge-triggered epoll instance, starts each
+// flow at its offset and shuts its sending side down when its duration is
+// over. Sockets stay owned by the caller.
+class FlowMux {
+public:
+    // workers <= 0 picks one per CPU, at most kMuxDefaultMaxWorkers
+    FlowMux(size_t message_size, int workers);
+    ~FlowMux();
+
+    FlowMux(const FlowMux&) = delete;
+    FlowMux& operator=(const FlowMux&) = delete;
+
+    // Add a connected pair before start(); duration 0 runs until stop().
+    // Returns the flow's index.
+    size_t add_flow(int send_fd, int recv_fd, double start_seconds, double duration_seconds);
+
+    bool start();
+
+    // Stop every flow still sending, join the workers and settle the stats
+    void stop();
+
+    size_t flows() const { return flows_.size(); }
+    int workers() const { return static_cast<int>(workers_.size()); }
+
+    // Safe to call while running
+    uint64_t bytes_received(size_t flow) const {
+        return flows_[flow]->received.load(std::memory_order_relaxed);
+    }
+    bool sending(size_t flow) const {
+        return flows_[flow]->state.load(std::memory_order_relaxed) == kSending;
+    }
+
+    // After stop()
+    const MuxFlowStats& stats(size_t flow) const { return flows_[flow]->stats; }
+
+private:
+    enum FlowState : int { kPending, kSending, kDraining, kDone };
+
+    struct Flow {
+        int send_fd;
+        int recv_fd;
+        double start_seconds;
+        double end_seconds;             // 0 = open-ended
+        std::atomic<int> state;
+        std::atomic<uint64_t> received;
+        MuxFlowStats stats;             // Owned by the flow's worker until stop()
+
+        Flow(int send, int recv, double start, double end)
+            : send_fd(send), recv_fd(recv), start_seconds(start), end_seconds(end),
+              state(kPending), received(0) {}
+    };
+
+    struct Worker {
+        int epoll_fd = -1;
+        std::thread thread;
+        std::vector<size_t> starts;     // Flow indices by start time
+        std::vector<size_t> ends;       // Timed flow indices by end time
+        std::vector<char> recv_buffer;
+    };
+
+    size_t message_size_;
+    int requested_workers_;
+    std::vector<char> send_buffer_;
+    std::vector<std::unique_ptr<Flow>> flows_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    int wake_fd_;
+    std::atomic<bool> stop_requested_;
+    bool running_;
+    std::chrono::steady_clock::time_point start_time_;
+
+    double elapsed() const;
+    void worker_loop(Worker& worker);
+    void begin_flow(Worker& worker, size_t index);
+    void end_flow(Worker& worker, size_t index);
+    void send_more(size_t index);
+    void receive(Worker& worker, size_t index);
+};
+
+#endif // TCP_FLOW_MUX_H
@@ -0,0 +1,137 @@
+#ifndef TCP_INFO_SAMPLER_H
+#define TCP_INFO_SAMPLER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+class LiveFlow;
+
+// Highest sampling rate the sampler accepts
+const int kMaxTcpInfoSampleRate = 10000;
+
+// One TCP_INFO reading of a sender socket
+struct TcpInfoSample {
+    uint64_t t_ns = 0;              // Since TcpInfoSampler::start()
+    uint32_t rtt_us = 0;            // Smoothed RTT
+    uint32_t rttvar_us = 0;
+    uint32_t snd_cwnd = 0;          // Packets
+    uint32_t lost = 0;              // Packets currently considered lost
+    uint32_t total_retrans = 0;     // Cumulative retransmitted segments
+    uint32_t pad = 0;
+    uint64_t delivery_rate = 0;     // Bytes per second
+    uint64_t pacing_rate = 0;       // Bytes per second
+    uint64_t busy_time_us = 0;      // Cumulative time with data in flight
+    uint64_t rwnd_limited_us = 0;   // Cumulative time limited by the receive window
+    uint64_t sndbuf_limited_us = 0; // Cumulative time limited by the send buffer
+    uint64_t bytes_acked = 0;
+};
+
+// Samples of one socket as columns, oldest first
+struct TcpInfoSeries {
+    std::vector<uint64_t> t_ns;
+    std::vector<uint32_t> rtt_us;
+    std::vector<uint32_t> rttvar_us;
+    std::vector<uint32_t> snd_cwnd;
+    std::vector<uint32_t> lost;
+    std::vector<uint32_t> total_retrans;
+    std::vector<uint64_t> delivery_rate;
+    std::vector<uint64_t> pacing_rate;
+    std::vector<uint64_t> busy_time_us;
+    std::vector<uint64_t> rwnd_limited_us;
+    std::vector<uint64_t> sndbuf_limited_us;
+    std::vector<uint64_t> bytes_acked;
+
+    size_t rows() const { return t_ns.size(); }
+};
+
+// What the samples of one socket say about the measurement window
+struct TcpInfoSummary {
+    uint64_t samples = 0;           // Readings kept in the ring
+    uint64_t overwritten = 0;       // Older readings lost to a full ring
+    double mean_rtt_ms = 0.0;
+    double mean_rttvar_ms = 0.0;
+    double min_rtt_ms = 0.0;
+    double max_rtt_ms = 0.0;
+    uint32_t max_cwnd = 0;          // Packets
+    double mean_delivery_mbps = 0.0;
+    double max_delivery_mbps = 0.0;
+    double mean_pacing_mbps = 0.0;
+    uint32_t max_lost = 0;
+    uint32_t retransmits = 0;       // total_retrans delta over the kept window
+    double rwnd_limited = 0.0;      // Fractions of the busy time
+    double sndbuf_limited = 0.0;
+};
+
+// Polls TCP_INFO on a set of sockets from one thread at a fixed rate (up to
+// kMaxTcpInfoSampleRate Hz). Ticks are scheduled on absolute deadlines, so
+// the rate does not drift; ticks the thread could not keep up with are
+// skipped and counted. Each socket gets a ring of samples allocated by
+// add_socket(); the sampling loop itself does not allocate. When a ring
+// fills up the oldest samples are overwritten.
+//
+// Needs no privileges and no kernel support beyond TCP_INFO, which makes
+// it the metrics backend of builds without ENABLE_EBPF_METRICS.
+class TcpInfoSampler {
+public:
+    explicit TcpInfoSampler(int rate_hz);
+    ~TcpInfoSampler();
+
+    TcpInfoSampler(const TcpInfoSampler&) = delete;
+    TcpInfoSampler& operator=(const TcpInfoSampler&) = delete;
+
+    // Ring size that holds `seconds` of samples at rate_hz, plus slack
+    static size_t capacity_for(int rate_hz, int seconds);
+
+    // Sample fd into a ring of `capacity` samples; only before start().
+    // Every sample is also published to live, if given, which the sampler
+    // releases once it stops. Returns the socket's index.
+    size_t add_socket(int fd, size_t capacity, LiveFlow* live = nullptr);
+
+    // Spawn the sampling thread
+    bool start();
+
+    // Join the sampling thread; the rings stay readable
+    void stop();
+
+    int rate_hz() const { return rate_hz_; }
+    size_t sockets() const { return rings_.size(); }
+
+    // Ticks skipped because a round of getsockopt() calls overran
+    uint64_t missed_ticks() const { return missed_.load(std::memory_order_relaxed); }
+
+    // Samples of one socket currently held, oldest first
+    size_t size(size_t socket) const;
+    const TcpInfoSample& at(size_t socket, size_t index) const;
+
+    // Summarise one socket's samples
+    TcpInfoSummary summarize(size_t socket) const;
+
+    // Copy one socket's samples into columns
+    void export_series(size_t socket, TcpInfoSeries& series) const;
+
+private:
+    struct Ring {
+        int fd;
+        std::vector<TcpInfoSample> samples;
+        std::atomic<uint64_t> written;   // Total samples ever stored
+        LiveFlow* live;
+
+        Ring(int socket_fd, size_t capacity, LiveFlow* live_flow)
+            : fd(socket_fd), samples(capacity), written(0), live(live_flow) {}
+    };
+
+    int rate_hz_;
+    std::vector<std::unique_ptr<Ring>> rings_;
+    std::thread thread_;
+    std::atomic<bool> stop_requested_;
+    std::atomic<uint64_t> missed_;
+    bool running_;
+
+    void sample_loop();
+};
+
+#endif // TCP_INFO_SAMPLER_H
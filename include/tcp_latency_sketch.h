@@ -0,0 +1,55 @@
+#ifndef TCP_LATENCY_SKETCH_H
+#define TCP_LATENCY_SKETCH_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-memory, mergeable latency distribution in the style of
+// HdrHistogram: values are grouped by power of two and each power of two
+// is split into 64 linear slots, so any recorded value is known to within
+// 1/64 (about 1.6%) of itself. Values below 128 are exact. Recording is
+// a few shifts and an increment and never allocates; two sketches merge by
+// adding their slots, so trials and parallel workers combine without the
+// raw samples.
+class LatencySketch {
+public:
+    static const int kSubBucketBits = 7;                        // 128 slots per bucket, upper half used
+    static const int kMaxBucket = 33;                           // Values up to 2^40 - 1
+    static const size_t kSlots = (kMaxBucket + 2) << (kSubBucketBits - 1);
+
+    LatencySketch();
+
+    void record(uint64_t value, uint64_t count = 1);
+    void merge(const LatencySketch& other);
+    void clear();
+
+    uint64_t count() const { return total_; }
+    bool empty() const { return total_ == 0; }
+    uint64_t min() const { return total_ > 0 ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const { return total_ > 0 ? sum_ / static_cast<double>(total_) : 0.0; }
+
+    // Value at quantile q (0..1): the middle of the slot holding it,
+    // clamped to the recorded min and max. 0 for an empty sketch.
+    double quantile(double q) const;
+
+    // Raw slots for serialisation: [first_slot(), last_slot()] holds every
+    // non-zero slot
+    size_t first_slot() const;
+    size_t last_slot() const;
+    uint64_t slot(size_t index) const { return counts_[index]; }
+    double sum() const { return sum_; }
+
+    // Rebuild from serialised slots; false if they do not fit
+    bool restore(size_t first, size_t count, const uint64_t* slots, uint64_t min, uint64_t max, double sum);
+
+private:
+    std::array<uint64_t, kSlots> counts_;
+    uint64_t total_;
+    uint64_t min_;
+    uint64_t max_;
+    double sum_;
+};
+
+#endif // TCP_LATENCY_SKETCH_H
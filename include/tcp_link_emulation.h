@@ -0,0 +1,95 @@
+#ifndef TCP_LINK_EMULATION_H
+#define TCP_LINK_EMULATION_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "tcp_netlink.h"
+
+// Path properties to emulate on one interface. Delay is applied on egress,
+// so on an interface that carries both directions (loopback) the caller
+// passes half of the intended RTT.
+struct LinkConditions {
+    double rate_mbps = 0.0;        // Bottleneck rate, 0 = unlimited
+    double delay_ms = 0.0;         // Added one-way delay
+    double jitter_ms = 0.0;        // Uniform delay variation around delay_ms
+    double loss_percent = 0.0;     // Random loss probability
+    double reorder_percent = 0.0;  // Share of packets sent without delay (needs delay_ms > 0)
+    std::string queue;             // Qdisc holding the queue (fq, fq_codel, ...), empty = built-in FIFO
+
+    bool needs_rate() const { return rate_mbps > 0.0; }
+    bool needs_netem() const {
+        return delay_ms > 0.0 || jitter_ms > 0.0 || loss_percent > 0.0 || reorder_percent > 0.0;
+    }
+};
+
+// Where cell conditions are emulated: kernel qdiscs on the test interface,
+// the in-process relay (tcp_userspace_emulator.h), or not at all
+enum class EmulationMode {
+    None,
+    Qdisc,
+    Userspace
+};
+
+bool parse_emulation_mode(const std::string& name, EmulationMode& mode);
+const char* emulation_mode_name(EmulationMode mode);
+
+// Programs a tbf (rate) and netem (delay, jitter, loss, reorder) hierarchy on
+// one interface directly over rtnetlink:
+//
+//   root 1: tbf  ->  1:1  ->  10: netem      (rate and netem settings)
+//   root 1: tbf                              (rate only)
+//   root 1: netem                            (no rate limit)
+//
+// A queue qdisc, when asked for, hangs below the last of these (10:1 ->
+// 20:, or 1:1 -> 10:), or becomes the root on its own. Below the rate
+// limiter it is where the standing queue builds, so an AQM sees it.
+//
+// The interface's previous root qdisc is captured before the first change
+// and put back by restore(), by the destructor, and by a signal handler if
+// the process crashes while conditions are applied. Only the previous root
+// qdisc is restored, not children that hung below it.
+class QdiscEmulator {
+public:
+    explicit QdiscEmulator(const std::string& interface);
+    ~QdiscEmulator();
+
+    QdiscEmulator(const QdiscEmulator&) = delete;
+    QdiscEmulator& operator=(const QdiscEmulator&) = delete;
+
+    // Apply conditions. If the qdisc layout is unchanged the existing qdiscs
+    // are modified in place, so queued packets survive the update.
+    bool apply(const LinkConditions& conditions);
+
+    // Put the saved root qdisc back
+    bool restore();
+
+    const std::string& interface() const { return interface_; }
+
+private:
+    std::string interface_;
+    int ifindex_;
+    uint32_t mtu_;
+    NetlinkSocket nl_;
+
+    // State captured before the first change
+    bool saved_;
+    std::vector<char> restore_message_;
+    int crash_slot_;
+
+    // Layout currently installed by us
+    bool applied_;
+    bool applied_rate_;
+    bool applied_netem_;
+    std::string applied_queue_;
+
+    bool prepare();
+    bool save_previous_root();
+    bool delete_root();
+    bool put_tbf(const LinkConditions& conditions, uint16_t flags);
+    bool put_netem(const LinkConditions& conditions, uint32_t parent, uint32_t handle, uint16_t flags);
+    bool put_queue(const std::string& kind, uint32_t parent, uint32_t handle, uint16_t flags);
+};
+
+#endif // TCP_LINK_EMULATION_H
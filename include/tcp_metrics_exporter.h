@@ -0,0 +1,108 @@
+#ifndef TCP_METRICS_EXPORTER_H
+#define TCP_METRICS_EXPORTER_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "tcp_cpu_counters.h"
+#include "tcp_info_sampler.h"
+
+// Flows the exporter can show at once; more are measured but not shown
+const size_t kLiveFlowSlots = 64;
+
+// RTT samples of a flow the rolling percentiles are taken over
+const size_t kLiveRttWindow = 1024;
+
+// What a live flow is measuring, as the labels of its series
+struct LiveFlowLabels {
+    std::string algorithm;
+    int bandwidth_mbps = 0;
+    int latency_ms = 0;
+};
+
+// Latest TCP_INFO values of one sender socket, written by the sampler
+// thread that claimed it and read by the exporter without locks. The
+// labels are guarded by a sequence count, so a scrape that races with a
+// new claim skips the flow instead of mixing two cells.
+class LiveFlow {
+public:
+    // Sampler thread only
+    void publish(const TcpInfoSample& sample);
+
+    // Stop showing the flow and free its slot
+    void release();
+
+private:
+    friend class MetricsExporter;
+
+    std::atomic<bool> claimed_{false};
+    std::atomic<uint64_t> sequence_{0};    // Odd while the labels change
+    std::atomic<uint64_t> algorithm_[2] = {};   // Name, kCongestionNameMax bytes
+    std::atomic<int> bandwidth_mbps_{0};
+    std::atomic<int> latency_ms_{0};
+
+    std::atomic<uint64_t> samples_{0};
+    std::atomic<uint64_t> rtt_sum_us_{0};
+    std::atomic<uint32_t> snd_cwnd_{0};
+    std::atomic<uint32_t> total_retrans_{0};
+    std::atomic<uint64_t> delivery_rate_{0};
+    std::atomic<uint64_t> bytes_acked_{0};
+    std::array<std::atomic<uint32_t>, kLiveRttWindow> rtt_window_ = {};
+};
+
+// OpenMetrics (Prometheus) endpoint on 127.0.0.1 for watching a sweep while
+// it runs. A background thread answers GET /metrics with the sweep's
+// progress, the CPU use of the last measured cell and of the whole harness,
+// and per live flow its delivery rate, cwnd, acknowledged bytes,
+// retransmissions and RTT percentiles over its last kLiveRttWindow samples.
+// Flows come from the TCP_INFO sampler, so they need --sample-rate > 0.
+// Measurement threads only store to their own atomics; a scrape never
+// takes a lock they could wait on.
+class MetricsExporter {
+public:
+    explicit MetricsExporter(uint16_t port);
+    ~MetricsExporter();
+
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+    // Listen on 127.0.0.1:port and start serving
+    bool start();
+
+    // Stop serving and close the listener
+    void stop();
+
+    // A free slot for a flow, null when all are taken
+    LiveFlow* claim_flow(const LiveFlowLabels& labels);
+
+    // Progress: cells the sweep will run (0 = not known) and cells done
+    void set_cells_total(uint64_t cells) { cells_total_.store(cells, std::memory_order_relaxed); }
+    void cell_finished() { cells_finished_.fetch_add(1, std::memory_order_relaxed); }
+
+    // CPU use of the last measured cell
+    void set_cell_cpu(const CpuCost& cpu);
+
+    // Current exposition, as served
+    std::string render() const;
+
+private:
+    uint16_t port_;
+    int listen_fd_;
+    std::thread thread_;
+    std::atomic<bool> stop_requested_;
+
+    std::array<LiveFlow, kLiveFlowSlots> flows_;
+    std::atomic<uint64_t> cells_total_;
+    std::atomic<uint64_t> cells_finished_;
+    std::atomic<double> cell_cpu_percent_;
+    std::atomic<double> cell_softirq_percent_;
+
+    void serve_loop();
+    void answer(int fd) const;
+};
+
+#endif // TCP_METRICS_EXPORTER_H
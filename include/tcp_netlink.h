@@ -0,0 +1,104 @@
+#ifndef TCP_NETLINK_H
+#define TCP_NETLINK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <linux/netlink.h>
+
+// Builder for one rtnetlink request: nlmsghdr, a family header and
+// (possibly nested) attributes. Offsets are used instead of pointers
+// because the buffer grows while attributes are appended.
+class NetlinkMessage {
+public:
+    NetlinkMessage(uint16_t type, uint16_t flags);
+
+    // Append the family-specific header (ifinfomsg, ifaddrmsg, tcmsg, ...)
+    template <typename T>
+    T* put_header() {
+        size_t offset = append(nullptr, sizeof(T));
+        return reinterpret_cast<T*>(buffer_.data() + offset);
+    }
+
+    void add_attr(uint16_t type, const void* data, size_t len);
+    void add_attr_u32(uint16_t type, uint32_t value);
+    void add_attr_string(uint16_t type, const std::string& value);
+
+    // Open a nested attribute; close it with end_nested(returned offset)
+    size_t begin_nested(uint16_t type);
+    void end_nested(size_t offset);
+
+    // Raw bytes for nested payloads that start with a header (VETH_INFO_PEER)
+    size_t append(const void* data, size_t len);
+
+    struct nlmsghdr* header() {
+        return reinterpret_cast<struct nlmsghdr*>(buffer_.data());
+    }
+    const char* data() const { return buffer_.data(); }
+    size_t size() const { return buffer_.size(); }
+
+private:
+    std::vector<char> buffer_;
+};
+
+// NETLINK_ROUTE socket bound to the network namespace of the thread that
+// opened it
+class NetlinkSocket {
+public:
+    NetlinkSocket();
+    ~NetlinkSocket();
+
+    NetlinkSocket(const NetlinkSocket&) = delete;
+    NetlinkSocket& operator=(const NetlinkSocket&) = delete;
+
+    bool open();
+    void close();
+    bool is_open() const { return fd_ >= 0; }
+    int fd() const { return fd_; }
+
+    // Send a request and wait for the kernel's acknowledgement.
+    // Returns 0 on success or a negative errno.
+    int request(NetlinkMessage& message);
+
+    // Send a dump request and hand every reply message to the callback.
+    // Returns 0 on success or a negative errno.
+    int dump(NetlinkMessage& message,
+             const std::function<void(const struct nlmsghdr*)>& callback);
+
+private:
+    int fd_;
+    uint32_t sequence_;
+    std::vector<char> receive_buffer_;
+
+    int send_message(NetlinkMessage& message);
+    int receive_replies(uint32_t sequence,
+                        const std::function<void(const struct nlmsghdr*)>& callback);
+};
+
+// Interface management used by the isolated test paths
+bool netlink_create_veth(NetlinkSocket& nl, const std::string& name,
+                         const std::string& peer_name, int peer_netns_fd);
+bool netlink_set_link_up(NetlinkSocket& nl, int ifindex);
+bool netlink_add_ipv4_address(NetlinkSocket& nl, int ifindex,
+                              const std::string& address, int prefix_len);
+
+// Replace the kernel's local host route of address (as "ip route change
+// local ADDRESS dev IFACE table local ... initcwnd N" would); connections
+// to address then start with initcwnd packets. initcwnd 0 drops the metric
+// and restores the kernel's route.
+bool netlink_set_local_route_initcwnd(NetlinkSocket& nl, int ifindex,
+                                      const std::string& address, uint32_t initcwnd);
+
+// The request netlink_set_local_route_initcwnd sends, as bytes to replay
+// later (for a crash restore)
+bool netlink_local_route_message(int ifindex, const std::string& address, uint32_t initcwnd,
+                                 std::vector<char>& message);
+
+// initcwnd metric of that route, 0 when it has none; false if the route
+// is missing
+bool netlink_get_local_route_initcwnd(NetlinkSocket& nl, int ifindex,
+                                      const std::string& address, uint32_t& initcwnd);
+
+#endif // TCP_NETLINK_H
@@ -0,0 +1,56 @@
+#ifndef TCP_NETNS_H
+#define TCP_NETNS_H
+
+#include <string>
+
+// Create a new, empty network namespace without moving the calling thread.
+// Returns an fd that keeps the namespace alive, or -1 on failure.
+int create_network_namespace();
+
+// Moves the calling thread into another network namespace for the lifetime
+// of the object. Sockets created meanwhile stay bound to that namespace.
+class ScopedNetns {
+public:
+    explicit ScopedNetns(int target_netns_fd);
+    ~ScopedNetns();
+
+    ScopedNetns(const ScopedNetns&) = delete;
+    ScopedNetns& operator=(const ScopedNetns&) = delete;
+
+    bool ok() const { return entered_; }
+
+private:
+    int original_fd_;
+    bool entered_;
+};
+
+// A private sender/receiver path: two network namespaces joined by a veth
+// pair. Namespaces are anonymous, so they (and the veth pair) disappear when
+// the object is destroyed or the process exits, even after a crash.
+class IsolatedPath {
+public:
+    static const char* const kSenderAddress;
+    static const char* const kReceiverAddress;
+    static const char* const kSenderInterface;
+    static const char* const kReceiverInterface;
+
+    IsolatedPath();
+    ~IsolatedPath();
+
+    IsolatedPath(const IsolatedPath&) = delete;
+    IsolatedPath& operator=(const IsolatedPath&) = delete;
+
+    // Create both namespaces, the veth pair, addresses and routes
+    bool create();
+
+    int sender_netns() const { return sender_netns_; }
+    int receiver_netns() const { return receiver_netns_; }
+
+private:
+    int sender_netns_;
+    int receiver_netns_;
+
+    bool configure_side(int netns_fd, const char* interface, const char* address);
+};
+
+#endif // TCP_NETNS_H
@@ -0,0 +1,63 @@
+#ifndef TCP_RESULTS_CACHE_H
+#define TCP_RESULTS_CACHE_H
+
+#include <string>
+
+#include "tcp_results_store.h"
+
+// Version of what a cell measures; bump it when a change to the tool makes
+// earlier cached cells incomparable
+const char* const kToolVersion = "1.0";
+
+// Content-addressed cache of finished cells. A cell is described by every
+// input that decides its outcome, one "name=value" line each: tool and
+// kernel version, the TCP sysctls, the algorithm and its module parameters,
+// the emulated path and the test settings. Its entry is named after a hash
+// of that description and holds the cell's trials as a results store, with
+// the description next to it as a .key file. Entries are written under a
+// temporary name and renamed once the cell has finished, so an interrupted
+// cell is never picked up and a rerun measures it again.
+class ResultsCache {
+public:
+    explicit ResultsCache(const std::string& directory);
+
+    // Create the directory if needed
+    bool open();
+
+    // Lines every cell on this host shares: tool, kernel and TCP sysctls
+    static std::string host_description();
+
+    // Lines of one algorithm: its name and module parameters, so changing
+    // a parameter of one algorithm only invalidates that algorithm's cells
+    static std::string algorithm_description(const std::string& algorithm);
+
+    // Copy the trials of a cached cell into store under key, numbering them
+    // from key.trial, and leave the entry open in cached; false, with none
+    // of its trials in store, when the cell is not cached or could not be
+    // copied whole. Variants are numbered per run, so the cached keys are
+    // not reused.
+    bool load(const std::string& description, const ResultsCellKey& key, ResultsStoreWriter& store,
+              ResultsStoreReader& cached) const;
+
+    // Start an entry; the cell's trials are appended to writer
+    bool begin(const std::string& description, ResultsStoreWriter& writer) const;
+
+    // Close writer and publish the entry
+    bool commit(const std::string& description, ResultsStoreWriter& writer) const;
+
+    // Close writer and drop the entry, for cells that did not measure
+    void discard(const std::string& description, ResultsStoreWriter& writer) const;
+
+    const std::string& directory() const { return directory_; }
+
+private:
+    std::string directory_;
+
+    std::string entry_path(const std::string& description) const;
+};
+
+// FNV-1a of a file's contents as 16 hex digits, empty if it cannot be read;
+// lets descriptions cover input files such as traces
+std::string file_digest(const std::string& path);
+
+#endif // TCP_RESULTS_CACHE_H
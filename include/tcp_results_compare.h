@@ -0,0 +1,37 @@
+#ifndef TCP_RESULTS_COMPARE_H
+#define TCP_RESULTS_COMPARE_H
+
+#include <cstddef>
+#include <string>
+
+#include "tcp_results_store.h"
+
+// When a change between two result sets counts as a regression
+struct CompareOptions {
+    double threshold = 0.05;            // Relative change that matters
+    double alpha = 0.05;                // Significance level of the trial tests
+};
+
+// Outcome of a comparison
+struct CompareSummary {
+    size_t cells = 0;                   // Cells in both result sets
+    size_t regressions = 0;             // Metric rows flagged as regressions
+    size_t improvements = 0;
+    size_t baseline_only = 0;           // Cells only one side measured
+    size_t candidate_only = 0;
+};
+
+// Compare the cells two result stores share, matched by algorithm,
+// bandwidth, latency and tuning, and write regression_report.csv into
+// directory. Per cell it compares the median throughput, the p99 RTT of
+// the trials' merged RTT sketches and the median CPU cycles per byte.
+// A metric regresses when it moves the wrong way by more than the
+// threshold and the Mann-Whitney test on the per-trial values puts the
+// change below alpha; cells with too few trials for the test to ever
+// reach alpha are judged by the threshold alone. Each store is read in
+// one pass over its index and holds no sketch per cell, so thousands of
+// cells compare in milliseconds.
+bool compare_results(const ResultsStoreReader& baseline, const ResultsStoreReader& candidate,
+                     const CompareOptions& options, const std::string& directory, CompareSummary& summary);
+
+#endif // TCP_RESULTS_COMPARE_H
@@ -0,0 +1,51 @@
+#ifndef TCP_RESULTS_EXPORT_H
+#define TCP_RESULTS_EXPORT_H
+
+#include <string>
+
+#include "tcp_results_store.h"
+
+// Summary values every cell carries in the results store
+const char* const kMetricThroughput = "throughput";     // Mbps, from bytes acknowledged
+const char* const kMetricGoodput = "goodput";           // Mbps, from bytes read by the receiver
+const char* const kMetricLatency = "latency";           // ms
+const char* const kMetricJitter = "jitter";             // ms
+const char* const kMetricPacketLoss = "packet_loss";    // Retransmitted segments
+const char* const kMetricWarmup = "warmup";             // s at the start left out as warm-up
+
+// CPU cost of a cell, when it was measured
+const char* const kMetricCyclesPerByte = "cycles_per_byte";             // Per byte received
+const char* const kMetricInstructionsPerByte = "instructions_per_byte";
+const char* const kMetricCpuUtil = "cpu_util";                          // % of all CPUs busy
+const char* const kMetricSoftirqUtil = "softirq_util";                  // % of all CPUs in softirq
+const char* const kMetricContextSwitches = "context_switches";          // Of the tester's threads
+
+// Tuning of a cell: "tune_" + dimension name (tcp_socket_options.h) for
+// every dimension that is not at its default
+const char* const kMetricTuningPrefix = "tune_";
+
+// Latency distributions a cell may carry, in microseconds
+const char* const kSketchRtt = "rtt_us";                // Sender smoothed RTT samples
+const char* const kSketchOwd = "owd_us";                // Message one-way delay
+const char* const kSketchRpcRtt = "rpc_rtt_us";         // Requests on their own connection
+const char* const kSketchRpcOwd = "rpc_owd_us";
+const char* const kSketchInlineRtt = "inline_rtt_us";   // Requests interleaved with the bulk flow
+const char* const kSketchInlineOwd = "inline_owd_us";
+
+// Label of a cell's tuning from its tune_ metrics, "default" without any
+std::string results_tuning_label(const ResultsStoreReader& store, size_t index);
+
+// Write detailed_metrics.csv, algorithm_comparison.csv, cell_confidence.csv,
+// request_latency.csv, throughput_vs_bandwidth.csv and
+// latency_vs_bandwidth.csv into directory
+// from one pass over the store's index. Trials of a cell are averaged in
+// the bandwidth/latency tables, listed separately in the detailed file and
+// summarised as 95% confidence intervals in cell_confidence.csv. Tuning
+// variants of a cell are listed separately, and the bandwidth/latency
+// tables show the variant with the highest mean throughput.
+// RTT and one-way-delay percentiles come from the cells' sketches; the
+// comparison merges the sketches of every cell of an algorithm, and
+// request_latency.csv merges the probe sketches of every trial of a cell.
+bool export_results_csv(const ResultsStoreReader& store, const std::string& directory);
+
+#endif // TCP_RESULTS_EXPORT_H
@@ -0,0 +1,235 @@
+#ifndef TCP_RESULTS_STORE_H
+#define TCP_RESULTS_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "tcp_latency_sketch.h"
+#include "tcp_mapped_file.h"
+
+// Binary results store. The file is append-only: a header, then one block
+// per finished cell (its time series, if any, followed by its summary), and
+// on close an index block and a trailer pointing at it. Everything is
+// 8-byte aligned and in host byte order, so readers map the file and use
+// the records in place. A file without a trailer (an interrupted sweep) is
+// still readable; the reader rebuilds the index by walking the blocks.
+//
+//   file    := header block* [index trailer]
+//   block   := ResultsBlockHeader payload        (payload size % 8 == 0)
+//   cell    := ResultsCellRecord ResultsMetric[metric_count] sketch[sketch_count]
+//   sketch  := ResultsSketchHeader uint64[slot_count]
+//   series  := ResultsSeriesHeader ResultsColumnInfo[column_count] columns
+//   index   := uint64 count, ResultsIndexEntry[count], sorted by key
+
+const char kResultsMagic[8] = {'T', 'C', 'P', 'R', 'S', 'L', 'T', '1'};
+const char kResultsIndexMagic[8] = {'T', 'C', 'P', 'R', 'I', 'D', 'X', '1'};
+const uint32_t kResultsVersion = 1;
+const size_t kResultsNameLength = 32;
+const size_t kResultsMetricNameLength = 24;
+const size_t kResultsColumnNameLength = 20;
+
+enum ResultsBlockType : uint32_t {
+    kResultsCellBlock = 1,
+    kResultsSeriesBlock = 2,
+    kResultsIndexBlock = 3,
+};
+
+enum class ColumnType : uint32_t {
+    U32 = 1,
+    U64 = 2,
+    F64 = 3,
+};
+
+struct ResultsFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct ResultsBlockHeader {
+    uint32_t type;              // ResultsBlockType
+    uint32_t reserved;
+    uint64_t size;              // Payload bytes after this header
+};
+
+// Identifies one measured cell
+struct ResultsCellKey {
+    char algorithm[kResultsNameLength];     // NUL-padded
+    int32_t bandwidth_mbps;
+    int32_t latency_ms;
+    uint32_t trial;
+    uint32_t variant;           // Tuning of the cell, 0 without tuning dimensions
+};
+
+struct ResultsCellRecord {
+    ResultsCellKey key;
+    uint64_t series_offset;     // File offset of the series block, 0 = none
+    uint32_t metric_count;
+    uint32_t sketch_count;
+};
+
+// Named summary value of a cell
+struct ResultsMetric {
+    char name[kResultsMetricNameLength];    // NUL-padded
+    double value;
+};
+
+// Named latency distribution of a cell: the non-zero slot range of a
+// LatencySketch
+struct ResultsSketchHeader {
+    char name[kResultsMetricNameLength];    // NUL-padded
+    uint64_t min;
+    uint64_t max;
+    double sum;
+    uint32_t first_slot;
+    uint32_t slot_count;
+};
+
+struct ResultsSeriesHeader {
+    uint64_t rows;
+    uint32_t column_count;
+    uint32_t reserved;
+};
+
+struct ResultsColumnInfo {
+    char name[kResultsColumnNameLength];    // NUL-padded
+    uint32_t type;              // ColumnType
+    uint64_t offset;            // From the start of the series payload
+};
+
+struct ResultsIndexEntry {
+    ResultsCellKey key;
+    uint64_t cell_offset;       // File offset of the cell block
+    uint64_t series_offset;     // File offset of the series block, 0 = none
+};
+
+struct ResultsTrailer {
+    uint64_t index_offset;      // File offset of the index block
+    char magic[8];
+};
+
+// Order of the index: algorithm, bandwidth, latency, variant, trial
+bool results_key_less(const ResultsCellKey& a, const ResultsCellKey& b);
+ResultsCellKey make_results_key(const std::string& algorithm, int bandwidth_mbps, int latency_ms,
+                                uint32_t trial, uint32_t variant = 0);
+std::string_view results_key_algorithm(const ResultsCellKey& key);
+
+// A summary value to write
+struct MetricValue {
+    const char* name;
+    double value;
+};
+
+// A distribution to write, not owned
+struct SketchRef {
+    const char* name;
+    const LatencySketch* sketch;
+};
+
+// A column to write: `rows` values of `type` at `data`, not owned
+struct ColumnRef {
+    const char* name;
+    ColumnType type;
+    const void* data;
+};
+
+class ResultsStoreReader;
+
+// Appends cells to a results file. Not thread-safe; callers that finish
+// cells on several threads serialise append_cell().
+class ResultsStoreWriter {
+public:
+    ResultsStoreWriter();
+    ~ResultsStoreWriter();
+
+    ResultsStoreWriter(const ResultsStoreWriter&) = delete;
+    ResultsStoreWriter& operator=(const ResultsStoreWriter&) = delete;
+
+    // Create (or truncate) path and write the file header
+    bool open(const std::string& path);
+
+    // Write one cell and, if rows > 0, its time series
+    bool append_cell(const ResultsCellKey& key, const std::vector<MetricValue>& metrics,
+                     uint64_t rows, const std::vector<ColumnRef>& columns,
+                     const std::vector<SketchRef>& sketches = {});
+
+    // Copy a cell and its time series from another store under key
+    bool copy_cell(const ResultsStoreReader& from, size_t index, const ResultsCellKey& key);
+
+    // Unindex the cells appended after the first `cells`; their blocks stay
+    // in the file but no reader of the closed store sees them
+    void drop_cells(size_t cells);
+
+    // Write the index and trailer, then close the file
+    bool close();
+
+    bool is_open() const { return file_ != nullptr; }
+    const std::string& path() const { return path_; }
+    size_t cells() const { return index_.size(); }
+
+private:
+    std::FILE* file_;
+    std::string path_;
+    uint64_t offset_;
+    std::vector<ResultsIndexEntry> index_;
+
+    bool write_block(uint32_t type, const std::vector<std::pair<const void*, size_t>>& parts);
+};
+
+// Typed view of one series column
+struct ColumnView {
+    ColumnType type = ColumnType::U64;
+    const void* data = nullptr;
+
+    bool valid() const { return data != nullptr; }
+    double at(uint64_t row) const;
+};
+
+// Read-only, mmap'd view of a results file
+class ResultsStoreReader {
+public:
+    ResultsStoreReader();
+
+    bool open(const std::string& path);
+
+    // Cells in index order
+    size_t size() const { return count_; }
+    const ResultsIndexEntry& entry(size_t index) const { return entries_[index]; }
+
+    // Summary values of a cell
+    const ResultsCellRecord& cell(size_t index) const;
+    const ResultsMetric* metrics(size_t index) const;
+
+    // Named summary value, or fallback if the cell does not have it
+    double metric(size_t index, std::string_view name, double fallback = 0.0) const;
+
+    // Named distribution of a cell; false (and sketch cleared) without one
+    bool sketch(size_t index, std::string_view name, LatencySketch& sketch) const;
+
+    // Rows of a cell's time series (0 without one) and one of its columns
+    uint64_t series_rows(size_t index) const;
+    ColumnView series_column(size_t index, std::string_view name) const;
+
+    // Raw blocks of a cell, for copying it into another store; the series
+    // block is null without one
+    const ResultsBlockHeader* cell_block(size_t index) const;
+    const ResultsBlockHeader* series_block(size_t index) const;
+
+private:
+    MappedFile file_;
+    const ResultsIndexEntry* entries_;
+    size_t count_;
+
+    // Index rebuilt by walking the blocks when the file has no trailer
+    std::vector<ResultsIndexEntry> rebuilt_;
+
+    const ResultsSeriesHeader* series_header(size_t index) const;
+    bool rebuild_index();
+};
+
+#endif // TCP_RESULTS_STORE_H
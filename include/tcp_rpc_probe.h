@@ -0,0 +1,72 @@
+#ifndef TCP_RPC_PROBE_H
+#define TCP_RPC_PROBE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "tcp_latency_sketch.h"
+
+// Smallest request that holds the probe header (sequence number, send
+// time, server receive time)
+const size_t kMinRpcRequestSize = 3 * sizeof(uint64_t);
+
+// Request/response probe settings
+struct RpcProbeConfig {
+    int rate_hz = 0;                    // Requests per second, 0 = off
+    size_t request_size = 64;           // Bytes per request and per response
+};
+
+// What a probe measured between start() and stop()
+struct RpcProbeStats {
+    uint64_t requests = 0;              // Written by the client
+    uint64_t responses = 0;             // Read back before stop()
+    LatencySketch rtt_us;               // Request written to response read
+    LatencySketch owd_us;               // Request written to request read by the server
+};
+
+// Ping-pong RPCs over a dedicated connection next to a bulk flow: the
+// latency a small interactive request sees while the bulk flow fills the
+// bottleneck queue. The client thread writes one request per tick of
+// rate_hz and waits for its response, so at most one request is in flight
+// and ticks spent waiting are skipped. Requests carry their send time and
+// the server thread echoes it with its receive time; both ends are in this
+// process, so round trip and one-way delay come from one monotonic clock.
+// Both sockets get TCP_NODELAY and stay owned by the caller.
+class RpcProbe {
+public:
+    RpcProbe(int client_fd, int server_fd, const RpcProbeConfig& config);
+    ~RpcProbe();
+
+    RpcProbe(const RpcProbe&) = delete;
+    RpcProbe& operator=(const RpcProbe&) = delete;
+
+    // Spawn the client and server threads
+    bool start();
+
+    // Stop both threads and report the latencies seen
+    RpcProbeStats stop();
+
+    int client_fd() const { return client_fd_; }
+    int server_fd() const { return server_fd_; }
+
+private:
+    int client_fd_;
+    int server_fd_;
+    RpcProbeConfig config_;
+
+    std::thread client_;
+    std::thread server_;
+    std::atomic<bool> stop_requested_;
+    bool running_;
+
+    // Client thread only until stop()
+    RpcProbeStats stats_;
+
+    void client_loop();
+    void server_loop();
+};
+
+#endif // TCP_RPC_PROBE_H
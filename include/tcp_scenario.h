@@ -0,0 +1,63 @@
+#ifndef TCP_SCENARIO_H
+#define TCP_SCENARIO_H
+
+#include <string>
+#include <vector>
+
+#include "tcp_info_sampler.h"
+#include "tcp_link_emulation.h"
+
+// Time resolution of the convergence analysis
+const double kScenarioBinSeconds = 0.1;
+
+// Throughput counts as converged within this fraction of its steady value
+const double kConvergenceTolerance = 0.1;
+
+// Run time after the last change when the duration leaves less
+const double kScenarioSettleSeconds = 10.0;
+
+// Link conditions from one point of a run on; delay_ms is the RTT
+struct ScenarioStep {
+    double at_seconds = 0.0;
+    LinkConditions conditions;
+    std::string text;                   // The step as written, for reports
+};
+
+// Changes of the emulated path over one run, sorted by time, the first at 0
+struct Scenario {
+    std::string name;
+    std::vector<ScenarioStep> steps;
+
+    // Run length: the duration, stretched to settle after the last change
+    double length_seconds(double duration_seconds) const;
+};
+
+// Parse a built-in scenario ("step-down", "step-up", "rtt-spike",
+// "loss-burst"), a file with one step per line, or steps separated by ';'.
+// A step is "SECONDS:key=value,..." with keys rate (Mbps), delay (RTT ms),
+// jitter (ms), loss and reorder (percent); unnamed keys keep their previous
+// value, starting from base. Returns false on malformed steps.
+bool parse_scenario(const std::string& text, const LinkConditions& base, Scenario& scenario);
+
+// How the flow reacted to one change of the scenario
+struct ConvergenceResult {
+    double at_seconds = 0.0;
+    double convergence_seconds = -1.0;  // Until throughput stays within tolerance, -1 = never
+    double steady_mbps = 0.0;           // Mean over the last quarter before the next change
+    double steady_queue_ms = 0.0;       // RTT above the run's minimum and the step's added delay, same window
+    double peak_queue_ms = 0.0;         // Largest after the change
+    double overshoot_ms = 0.0;          // Peak above steady queueing delay
+    double overshoot_bytes = 0.0;       // The same at the steady throughput
+};
+
+// Convergence time and queue overshoot after every step of a sender's
+// TCP_INFO series whose t_ns starts with the scenario. Throughput comes
+// from bytes_acked and queueing delay from srtt in kScenarioBinSeconds bins.
+std::vector<ConvergenceResult> analyze_convergence(const TcpInfoSeries& series, const Scenario& scenario,
+                                                   double length_seconds);
+
+// Per-bin throughput (Mbps) and mean srtt (ms) of a series, for timelines
+void scenario_bins(const TcpInfoSeries& series, double length_seconds,
+                   std::vector<double>& mbps, std::vector<double>& rtt_ms);
+
+#endif // TCP_SCENARIO_H
@@ -0,0 +1,66 @@
+#ifndef TCP_SERIES_DOWNSAMPLE_H
+#define TCP_SERIES_DOWNSAMPLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// How a series is reduced to its point budget
+enum class DownsampleMethod {
+    Lttb,       // Largest-Triangle-Three-Buckets: one point per bucket, the most visible one
+    MinMax      // Lowest and highest point of every bucket
+};
+
+// Parse "lttb" or "minmax"; returns false on unknown names
+bool parse_downsample_method(const std::string& name, DownsampleMethod& method);
+const char* downsample_method_name(DownsampleMethod method);
+
+struct SeriesPoint {
+    double x;
+    double y;
+};
+
+// Reduces a series of a known number of points to at most `budget` points
+// that keep its shape: sawtooth peaks, probing dips and retransmission
+// bursts survive where averaging would flatten them. Points are fed once,
+// in order, and buckets are fixed by position, so memory is bounded by two
+// buckets (LTTB) or one (min/max) however long the series is. Series that
+// fit the budget are kept as they are.
+class SeriesDownsampler {
+public:
+    SeriesDownsampler(DownsampleMethod method, uint64_t points, size_t budget);
+
+    void add(double x, double y);
+
+    // Points kept, in order; valid once all `points` have been added
+    const std::vector<SeriesPoint>& points() const { return kept_; }
+
+private:
+    DownsampleMethod method_;
+    uint64_t total_;
+    uint64_t seen_;
+    size_t buckets_;
+    std::vector<SeriesPoint> kept_;
+
+    // LTTB: the bucket waiting for the next one's average, and the next one
+    std::vector<SeriesPoint> pending_;
+    std::vector<SeriesPoint> filling_;
+    uint64_t filling_bucket_;
+
+    // Min/max: extremes of the current bucket
+    SeriesPoint low_;
+    SeriesPoint high_;
+    uint64_t bucket_;
+    bool bucket_open_;
+
+    void add_lttb(double x, double y);
+    void add_minmax(double x, double y);
+
+    // Keep the point of bucket that spans the largest triangle with the
+    // last kept point and next
+    void select(const std::vector<SeriesPoint>& bucket, const SeriesPoint& next);
+    void flush_minmax();
+};
+
+#endif // TCP_SERIES_DOWNSAMPLE_H
@@ -0,0 +1,36 @@
+#ifndef TCP_SERIES_EXPORT_H
+#define TCP_SERIES_EXPORT_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "tcp_results_store.h"
+#include "tcp_series_downsample.h"
+
+// Where and how finely time series are written
+struct SeriesOptions {
+    size_t points = 0;                  // Budget per series, 0 = no series output
+    DownsampleMethod method = DownsampleMethod::Lttb;
+    std::string directory = "series";
+};
+
+// Write the TCP_INFO series of every sampled cell in the store as a gnuplot
+// data file, <alg>_<bw>mbps_<lat>ms_v<variant>_t<trial>.dat, holding one
+// data set (gnuplot "index") each for cwnd, smoothed RTT, delivery rate,
+// retransmissions and queueing delay (smoothed RTT above the cell's lowest),
+// each downsampled to options.points. series.gp next to them plots every
+// cell as one PNG. Series are read straight from the store's mapping in
+// two passes and never copied out of it.
+bool export_series_gnuplot(const ResultsStoreReader& store, const SeriesOptions& options);
+
+// Window the collector series' delivery rate is measured over
+const int kCollectorRateWindowMs = 10;
+
+// The same for tcp_ebpf_collector.py traces: one file per flow,
+// <trace>_<alg>_<sport>_<dport>.dat, with cwnd, smoothed RTT, the delivery
+// rate over kCollectorRateWindowMs of acknowledged bytes, retransmissions
+// and queueing delay, as far as the trace has the columns for them
+bool export_collector_series(const std::vector<std::string>& traces, const SeriesOptions& options);
+
+#endif // TCP_SERIES_EXPORT_H
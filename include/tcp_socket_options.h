@@ -0,0 +1,126 @@
+#ifndef TCP_SOCKET_OPTIONS_H
+#define TCP_SOCKET_OPTIONS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tcp_netlink.h"
+
+// Kernel limit for congestion control names (TCP_CA_NAME_MAX)
+const size_t kCongestionNameMax = 16;
+
+// Select the congestion control for one socket with setsockopt(TCP_CONGESTION)
+// and read it back with getsockopt to confirm the kernel accepted it
+bool set_socket_congestion(int fd, const std::string& algorithm);
+
+// Congestion control currently attached to a socket, empty on failure
+std::string get_socket_congestion(int fd);
+
+// Algorithms the kernel offers (net.ipv4.tcp_available_congestion_control)
+std::vector<std::string> available_congestion_controls();
+
+// Queueing disciplines the qdisc tuning dimension accepts
+const char* const kTuningQdiscs[] = {"fq", "fq_codel", "cake", "pfifo"};
+
+// One point of the sweep's tuning dimensions; 0 or empty keeps the default
+struct SocketTuning {
+    uint64_t sndbuf = 0;            // SO_SNDBUF of the sender, bytes
+    uint64_t rcvbuf = 0;            // SO_RCVBUF of the receiver, bytes
+    uint64_t notsent_lowat = 0;     // TCP_NOTSENT_LOWAT of the sender, bytes
+    double max_pacing_mbps = 0.0;   // SO_MAX_PACING_RATE of the sender
+    uint64_t tcp_rmem_max = 0;      // Autotuning ceilings (net.ipv4.tcp_rmem and
+    uint64_t tcp_wmem_max = 0;      // tcp_wmem, third field), bytes
+    uint32_t initcwnd = 0;          // Route initcwnd towards the receiver, packets
+    std::string qdisc;              // Queue at the bottleneck, one of kTuningQdiscs
+
+    // "sndbuf=1048576 qdisc=fq", or "default" when nothing is set
+    std::string label() const;
+};
+
+// A tuning dimension of the sweep and the values it takes, as written
+struct TuningDimension {
+    std::string name;
+    std::vector<std::string> values;
+};
+
+// Parse "NAME=VALUE,VALUE,..." with NAME one of sndbuf, rcvbuf,
+// notsent_lowat, max_pacing (Mbps), tcp_rmem, tcp_wmem (autotuning
+// ceilings), initcwnd (packets) or qdisc. Byte sizes take K, M and G
+// suffixes; "default" keeps the kernel's setting.
+bool parse_tuning_dimension(const std::string& text, TuningDimension& dimension);
+
+// Every combination of the dimensions' values, the last dimension varying
+// fastest; a single default tuning without dimensions
+std::vector<SocketTuning> tuning_grid(const std::vector<TuningDimension>& dimensions);
+
+// Set one dimension of a tuning from its text; false for a bad value
+bool set_tuning_value(SocketTuning& tuning, const std::string& name, const std::string& value);
+
+// The tuning as (dimension, number) pairs for the results store, the qdisc
+// as its position in kTuningQdiscs plus one; set_tuning_number reverses it
+std::vector<std::pair<std::string, double>> tuning_numbers(const SocketTuning& tuning);
+bool set_tuning_number(SocketTuning& tuning, const std::string& name, double value);
+
+// Apply the per-socket part of a tuning to the two ends of a connection
+bool apply_sender_tuning(int fd, const SocketTuning& tuning);
+bool apply_receiver_tuning(int fd, const SocketTuning& tuning);
+
+// Writes a sysctl and puts the original value back when restored or
+// destroyed, or when the process is killed or exits while it is changed.
+// The original is read once, by save() or the first set(), so values
+// written later do not replace it. Names are paths below /proc/sys, e.g.
+// "net/ipv4/tcp_rmem".
+class SysctlOverride {
+public:
+    SysctlOverride() = default;
+    ~SysctlOverride();
+
+    SysctlOverride(const SysctlOverride&) = delete;
+    SysctlOverride& operator=(const SysctlOverride&) = delete;
+
+    bool save(const std::string& name);
+    bool set(const std::string& name, const std::string& value);
+    void restore();
+
+    // Value read by save(), empty before
+    const std::string& original() const { return original_; }
+
+    // Current value of a sysctl, empty if it cannot be read
+    static std::string read(const std::string& name);
+
+private:
+    std::string name_;
+    std::string original_;
+    bool changed_ = false;
+    int crash_slot_ = -1;
+};
+
+// Sets the initcwnd of the local host route of an address and puts the
+// original route back like SysctlOverride does for a sysctl. The original
+// metric is read once, by save() or the first set().
+class InitcwndOverride {
+public:
+    InitcwndOverride() = default;
+    ~InitcwndOverride();
+
+    InitcwndOverride(const InitcwndOverride&) = delete;
+    InitcwndOverride& operator=(const InitcwndOverride&) = delete;
+
+    bool save(const std::string& interface, const std::string& address);
+    bool set(const std::string& interface, const std::string& address, uint32_t initcwnd);
+    void restore();
+
+private:
+    NetlinkSocket nl_;
+    int ifindex_ = 0;
+    std::string address_;
+    uint32_t original_ = 0;
+    std::vector<char> restore_message_;
+    bool changed_ = false;
+    int crash_slot_ = -1;
+};
+
+#endif // TCP_SOCKET_OPTIONS_H
@@ -0,0 +1,39 @@
+#ifndef TCP_SWEEP_SCHEDULER_H
+#define TCP_SWEEP_SCHEDULER_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// One independent point of the test matrix
+struct SweepCell {
+    std::string algorithm;
+    int bandwidth_mbps;
+    int latency_ms;
+};
+
+// Cores reserved for one worker; -1 means "do not pin"
+struct CpuPair {
+    int sender_cpu;
+    int receiver_cpu;
+};
+
+// Runs independent cells on a bounded pool of worker threads. Each worker
+// owns a disjoint pair of cores for its sender and receiver, so the number
+// of workers is capped at half the CPUs this process may run on.
+class SweepScheduler {
+public:
+    // max_jobs <= 0 selects as many workers as there are core pairs
+    explicit SweepScheduler(int max_jobs);
+
+    int jobs() const { return static_cast<int>(slots_.size()); }
+
+    // Run every cell exactly once; returns when all cells have finished
+    void run(const std::vector<SweepCell>& cells,
+             const std::function<void(const SweepCell&, const CpuPair&)>& run_cell);
+
+private:
+    std::vector<CpuPair> slots_;
+};
+
+#endif // TCP_SWEEP_SCHEDULER_H
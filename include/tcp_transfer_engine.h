@@ -0,0 +1,132 @@
+#ifndef TCP_TRANSFER_ENGINE_H
+#define TCP_TRANSFER_ENGINE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/types.h>
+
+#include "tcp_latency_sketch.h"
+
+// How the sender hands payload bytes to the kernel
+enum class SendMode {
+    Copy,       // Plain send(), payload copied into the socket buffer
+    ZeroCopy,   // send(MSG_ZEROCOPY), completions reaped from the error queue
+    Splice      // vmsplice() into a pipe, then splice() into the socket
+};
+
+// Parse "copy", "zerocopy" or "splice"; returns false on unknown names
+bool parse_send_mode(const std::string& name, SendMode& mode);
+const char* send_mode_name(SendMode mode);
+
+// Data plane configuration
+struct TransferConfig {
+    size_t message_size = 128 * 1024;   // Bytes per send call
+    SendMode send_mode = SendMode::Copy;
+    int sender_cpu = -1;                // Core for the sender thread, -1 = unpinned
+    int receiver_cpu = -1;              // Core for the receiver thread, -1 = unpinned
+    int inline_rpc_hz = 0;              // Messages per second turned into requests (copy mode only)
+};
+
+// Pin the calling thread to one CPU (no-op for cpu < 0)
+bool pin_current_thread(int cpu);
+
+// What the data plane observed between start() and stop()
+struct TransferStats {
+    uint64_t bytes_sent = 0;        // Handed to the kernel by the sender
+    uint64_t bytes_acked = 0;       // tcpi_bytes_acked delta on the sender socket
+    uint64_t bytes_received = 0;    // Read by the receiver application
+    double elapsed_seconds = 0.0;
+    double throughput_mbps = 0.0;   // From bytes_acked
+    double goodput_mbps = 0.0;      // From bytes_received
+    double rtt_ms = 0.0;            // Sender srtt at stop time
+    double rttvar_ms = 0.0;         // Sender rtt variance at stop time
+    uint32_t retransmits = 0;       // tcpi_total_retrans delta
+    LatencySketch owd_us;           // Message one-way delay (copy mode only)
+    LatencySketch inline_rtt_us;    // Request message written to its response read
+    LatencySketch inline_owd_us;    // Request message written to its head read
+};
+
+// Bulk sender/receiver pair driving one established TCP connection.
+// The sender thread writes on send_fd, the receiver thread drains recv_fd
+// (the accepted end of the same connection). Both sockets stay owned by
+// the caller; stop() shuts them down so blocked threads return.
+class TransferEngine {
+public:
+    TransferEngine(int send_fd, int recv_fd, const TransferConfig& config);
+    ~TransferEngine();
+
+    TransferEngine(const TransferEngine&) = delete;
+    TransferEngine& operator=(const TransferEngine&) = delete;
+
+    // Spawn the sender and receiver threads
+    bool start();
+
+    // Stop both threads and report what was transferred
+    TransferStats stop();
+
+    // Bytes read by the receiver so far (safe to call while running)
+    uint64_t bytes_received() const {
+        return received_.load(std::memory_order_relaxed);
+    }
+
+private:
+    int send_fd_;
+    int recv_fd_;
+    TransferConfig config_;
+
+    std::vector<char> send_buffer_;
+    std::vector<char> recv_buffer_;
+    int pipe_fds_[2];
+
+    std::thread sender_;
+    std::thread receiver_;
+    std::thread responses_;
+    std::atomic<bool> stop_requested_;
+    std::atomic<uint64_t> sent_;
+    std::atomic<uint64_t> received_;
+    bool running_;
+
+    // In copy mode every message starts with its send time, so the
+    // receiver can tell how long the head of each message took to arrive.
+    // Partial sends resume mid-message to keep the stream message-aligned.
+    bool stamp_messages_;
+    size_t send_offset_;            // Sender position within the current message
+    LatencySketch owd_us_;          // Receiver thread only until stop()
+
+    // Interleaved requests: at most inline_rpc_hz times per second and with
+    // one in flight, the sender flags a message's stamp as a request. The
+    // receiver answers it on the otherwise idle reverse direction, and a
+    // third thread reads the answers on send_fd, so a request waits behind
+    // the bulk data already queued on the same connection.
+    bool inline_requests_;
+    uint64_t request_interval_ns_;
+    uint64_t next_request_ns_;      // Sender thread only
+    std::atomic<bool> request_pending_;
+    LatencySketch inline_rtt_us_;   // Response thread only until stop()
+    LatencySketch inline_owd_us_;   // Receiver thread only until stop()
+
+    std::chrono::steady_clock::time_point start_time_;
+    uint64_t acked_at_start_;
+    uint32_t retrans_at_start_;
+
+    void sender_loop();
+    void receiver_loop();
+    void response_loop();
+
+    // One send call in the configured mode; returns bytes queued or -1
+    ssize_t send_copy();
+    ssize_t send_zerocopy();
+    ssize_t send_splice();
+
+    // Drain MSG_ZEROCOPY completion notifications from the error queue
+    void reap_zerocopy_completions();
+
+    bool setup_send_mode();
+};
+
+#endif // TCP_TRANSFER_ENGINE_H
@@ -0,0 +1,85 @@
+#ifndef TCP_TRIAL_STATS_H
+#define TCP_TRIAL_STATS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "tcp_info_sampler.h"
+
+// How often a cell is repeated. A cell runs at least min_trials and at most
+// max_trials times and stops early once the 95% confidence intervals of
+// its throughput and p99 RTT are within tolerance of their means, or when
+// starting another trial would exceed the time budget.
+struct TrialPolicy {
+    int min_trials = 3;                 // Capped at max_trials
+    int max_trials = 1;
+    double tolerance = 0.05;            // Relative CI half-width, 0 = always max_trials
+    double budget_seconds = 0.0;        // Per cell, 0 = unlimited
+};
+
+// Mean and 95% Student-t confidence interval half-width of n values
+struct ConfidenceInterval {
+    size_t n = 0;
+    double mean = 0.0;
+    double half_width = 0.0;            // 0 for fewer than two values
+
+    // Half-width relative to the mean; infinite when the mean is 0
+    double relative() const;
+};
+
+// Two-sided 95% Student-t quantile for the given degrees of freedom
+double student_t95(size_t degrees_of_freedom);
+
+ConfidenceInterval confidence_interval(const std::vector<double>& values);
+
+// Two-sided p-value of the Mann-Whitney U test that a and b come from the
+// same distribution: exact for small samples without ties, otherwise the
+// normal approximation with tie and continuity correction. 1 when either
+// sample is empty.
+double mann_whitney_p(const std::vector<double>& a, const std::vector<double>& b);
+
+// Smallest p-value the test can reach with samples of these sizes; with
+// three trials on each side it is 0.1, so no difference is significant
+double mann_whitney_min_p(size_t n1, size_t n2);
+
+// Stopping state of one cell's trials
+class TrialTracker {
+public:
+    explicit TrialTracker(const TrialPolicy& policy);
+
+    // Record a finished trial; p99_rtt_ms < 0 when it had no RTT samples
+    void add(double throughput_mbps, double p99_rtt_ms);
+
+    // Whether to stop before a trial of trial_seconds would start
+    bool done(double trial_seconds) const;
+
+    // Why done() is true: "converged", "max trials" or "time budget"
+    const char* stop_reason(double trial_seconds) const;
+
+    size_t trials() const { return throughput_.size(); }
+    ConfidenceInterval throughput() const { return confidence_interval(throughput_); }
+    ConfidenceInterval p99_rtt() const { return confidence_interval(p99_rtt_); }
+
+private:
+    TrialPolicy policy_;
+    std::chrono::steady_clock::time_point start_;
+    std::vector<double> throughput_;
+    std::vector<double> p99_rtt_;
+
+    bool converged() const;
+    bool over_budget(double trial_seconds) const;
+};
+
+// Truncation point of a series of batch means by the Marginal Standard
+// Error Rule: the d in [0, n/2] minimising the variance of the remaining
+// values over (n - d). Removes initial transients without a threshold.
+size_t mser_truncation(const std::vector<double>& batches);
+
+// First sample after the warm-up of a TCP_INFO series: the later of the
+// MSER points of its delivered-rate and RTT batch means. 0 when the
+// series is too short to tell.
+size_t warmup_end(const TcpInfoSeries& series);
+
+#endif // TCP_TRIAL_STATS_H
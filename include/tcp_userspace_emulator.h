@@ -0,0 +1,75 @@
+#ifndef TCP_USERSPACE_EMULATOR_H
+#define TCP_USERSPACE_EMULATOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Settings of the in-process link emulator
+struct UserspaceEmulatorConfig {
+    double rate_mbps = 0.0;         // Token-bucket rate, 0 = unlimited
+    double delay_ms = 0.0;          // RTT, split evenly between both directions
+    std::string trace_file;         // Mahimahi delivery trace (overrides rate_mbps)
+    size_t queue_bytes = 0;         // Bottleneck buffer, 0 = one BDP
+    uint16_t target_port = 5000;    // Listener the relay connects to on 127.0.0.1
+};
+
+// A Mahimahi packet-delivery trace: each line is a millisecond timestamp at
+// which one MTU-sized packet may leave the link. The trace repeats with a
+// period equal to its last timestamp.
+struct DeliveryTrace {
+    std::vector<uint64_t> opportunities_ns;
+    uint64_t period_ns = 0;
+
+    bool load(const std::string& path);
+    bool empty() const { return opportunities_ns.empty(); }
+    double mean_rate_mbps() const;
+};
+
+// In-process link emulator for hosts without CAP_NET_ADMIN. It listens on
+// an ephemeral loopback port; the test client connects there and the relay
+// connects on to the real listener. Bytes from the client go through a
+// bottleneck queue drained by a token bucket (or a delivery trace), then
+// through a timed delay line. The reverse direction only gets the delay.
+//
+// The relay terminates TCP: the client's congestion control sees the
+// emulator's receive window, not the emulated link, and the queue never
+// drops. All buffers are allocated up front; the relay loop itself does not
+// allocate.
+class UserspaceLinkEmulator {
+public:
+    explicit UserspaceLinkEmulator(const UserspaceEmulatorConfig& config);
+    ~UserspaceLinkEmulator();
+
+    UserspaceLinkEmulator(const UserspaceLinkEmulator&) = delete;
+    UserspaceLinkEmulator& operator=(const UserspaceLinkEmulator&) = delete;
+
+    // Bind the relay port and start the relay thread for one connection
+    bool start();
+
+    // Stop relaying and join the thread
+    void stop();
+
+    // Port the test client must connect to
+    uint16_t port() const { return port_; }
+
+    uint64_t bytes_forwarded() const { return forwarded_.load(std::memory_order_relaxed); }
+    uint64_t max_queue_bytes() const { return max_queue_.load(std::memory_order_relaxed); }
+
+private:
+    UserspaceEmulatorConfig config_;
+    DeliveryTrace trace_;
+    int listen_fd_;
+    int wake_fd_;
+    uint16_t port_;
+    std::thread relay_;
+    std::atomic<uint64_t> forwarded_;
+    std::atomic<uint64_t> max_queue_;
+
+    void relay_loop();
+};
+
+#endif // TCP_USERSPACE_EMULATOR_H
@@ -0,0 +1,230 @@
+// SPDX-License-Identifier: GPL-2.0
+//
+// CO-RE version of tcp_ebpf_metrics.c, built once at compile time and
+// loaded by the in-process collector (tcp_ebpf_collector.cpp) through its
+// libbpf skeleton.
+//
+// Flows are identified by socket cookie, never by the current task: the
+// hooks mostly run in softirq context on behalf of whatever task happens to
+// be on the CPU. Userspace registers the cookies it wants in `watched`.
+//
+// Every sample is folded into per-flow, per-CPU aggregates (log2
+// histograms and counters) that userspace reads at its own interval.
+// Per-packet events over the ring buffer are opt-in and sampled.
+
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+#include <bpf/bpf_core_read.h>
+#include <bpf/bpf_endian.h>
+
+#include "tcp_ebpf_events.h"
+
+char LICENSE[] SEC("license") = "GPL";
+
+struct {
+    __uint(type, BPF_MAP_TYPE_RINGBUF);
+    __uint(max_entries, 4 * 1024 * 1024);
+} events SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct tcp_metrics_config);
+} config SEC(".maps");
+
+// Socket cookies to report on, mapped to the cell that registered them
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, 4096);
+    __type(key, __u64);
+    __type(value, __u32);
+} watched SEC(".maps");
+
+// LRU so flows that userspace never cleans up cannot fill the map
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_PERCPU_HASH);
+    __uint(max_entries, 4096);
+    __type(key, __u64);
+    __type(value, struct tcp_flow_stats);
+} flow_stats SEC(".maps");
+
+// All-zero value used to create flow_stats entries; too large for the stack
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct tcp_flow_stats);
+} zero_stats SEC(".maps");
+
+// Per-CPU count of samples, used to pick one in N for per-packet events
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, __u64);
+} event_counter SEC(".maps");
+
+// Index of the highest set bit, clamped to the histogram size
+static __always_inline __u32 log2_slot(__u32 v)
+{
+    __u32 r, shift;
+
+    r = (v > 0xFFFF) << 4; v >>= r;
+    shift = (v > 0xFF) << 3; v >>= shift; r |= shift;
+    shift = (v > 0xF) << 2; v >>= shift; r |= shift;
+    shift = (v > 0x3) << 1; v >>= shift; r |= shift;
+    r |= (v >> 1);
+    return r < TCP_METRICS_HIST_SLOTS ? r : TCP_METRICS_HIST_SLOTS - 1;
+}
+
+static __always_inline struct tcp_flow_stats *flow_entry(__u64 *cookie)
+{
+    struct tcp_flow_stats *stats = bpf_map_lookup_elem(&flow_stats, cookie);
+    if (stats)
+        return stats;
+
+    __u32 zero = 0;
+    struct tcp_flow_stats *empty = bpf_map_lookup_elem(&zero_stats, &zero);
+    if (!empty)
+        return NULL;
+    bpf_map_update_elem(&flow_stats, cookie, empty, BPF_NOEXIST);
+    return bpf_map_lookup_elem(&flow_stats, cookie);
+}
+
+// Send one in event_sampling samples to userspace as a per-packet event
+static __always_inline void emit_event(struct sock *sk, __u64 cookie, __u32 cell, __u32 kind,
+                                       struct tcp_metrics_config *cfg)
+{
+    __u32 sampling = cfg->event_sampling;
+    if (sampling == 0)
+        return;
+
+    __u32 zero = 0;
+    __u64 *counter = bpf_map_lookup_elem(&event_counter, &zero);
+    if (!counter || (*counter)++ % sampling != 0)
+        return;
+
+    struct tcp_metrics_event *e = bpf_ringbuf_reserve(&events, sizeof(*e), 0);
+    if (!e)
+        return;
+
+    struct tcp_sock *tp = (struct tcp_sock *)sk;
+    e->ts_ns = bpf_ktime_get_ns();
+    e->cookie = cookie;
+    e->cell = cell;
+    e->kind = kind;
+    e->saddr = BPF_CORE_READ(sk, __sk_common.skc_rcv_saddr);
+    e->daddr = BPF_CORE_READ(sk, __sk_common.skc_daddr);
+    e->sport = BPF_CORE_READ(sk, __sk_common.skc_num);
+    e->dport = bpf_ntohs(BPF_CORE_READ(sk, __sk_common.skc_dport));
+    e->snd_cwnd = BPF_CORE_READ(tp, snd_cwnd);
+    e->snd_ssthresh = BPF_CORE_READ(tp, snd_ssthresh);
+    e->rcv_wnd = BPF_CORE_READ(tp, rcv_wnd);
+    e->srtt_us = BPF_CORE_READ(tp, srtt_us) >> 3;   // Stored << 3
+    e->mdev_us = BPF_CORE_READ(tp, mdev_us) >> 2;   // Stored << 2
+    e->lost_out = BPF_CORE_READ(tp, lost_out);
+    e->retrans_out = BPF_CORE_READ(tp, retrans_out);
+    e->bytes_sent = BPF_CORE_READ(tp, bytes_sent);
+    e->bytes_acked = BPF_CORE_READ(tp, bytes_acked);
+    bpf_ringbuf_submit(e, 0);
+}
+
+// Common prologue: is this socket watched, and with which settings
+static __always_inline struct tcp_flow_stats *lookup_flow(struct sock *sk, __u64 *cookie,
+                                                         __u32 *cell,
+                                                         struct tcp_metrics_config **cfg)
+{
+    __u32 zero = 0;
+    *cfg = bpf_map_lookup_elem(&config, &zero);
+    if (!*cfg || !sk)
+        return NULL;
+
+    *cookie = bpf_get_socket_cookie(sk);
+    __u32 *registered = bpf_map_lookup_elem(&watched, cookie);
+    if (!registered)
+        return NULL;
+    *cell = *registered;
+
+    return flow_entry(cookie);
+}
+
+static __always_inline void record_cwnd(struct tcp_flow_stats *stats, __u32 cwnd)
+{
+    stats->cwnd_samples++;
+    if (cwnd > stats->snd_cwnd_max)
+        stats->snd_cwnd_max = cwnd;
+    stats->cwnd_hist[log2_slot(cwnd)]++;
+}
+
+// Every segment processed in the established state (mostly ACKs on the sender)
+SEC("tp_btf/tcp_probe")
+int BPF_PROG(on_tcp_probe, struct sock *sk, struct sk_buff *skb)
+{
+    struct tcp_metrics_config *cfg;
+    __u64 cookie;
+    __u32 cell;
+    struct tcp_flow_stats *stats = lookup_flow(sk, &cookie, &cell, &cfg);
+    if (!stats)
+        return 0;
+
+    struct tcp_sock *tp = (struct tcp_sock *)sk;
+    __u32 srtt_us = BPF_CORE_READ(tp, srtt_us) >> 3;
+    __u32 mdev_us = BPF_CORE_READ(tp, mdev_us) >> 2;
+    __u32 lost_out = BPF_CORE_READ(tp, lost_out);
+    __u32 retrans_out = BPF_CORE_READ(tp, retrans_out);
+
+    // Per-CPU entry: plain increments, no atomics
+    stats->samples++;
+    stats->srtt_sum_us += srtt_us;
+    stats->mdev_sum_us += mdev_us;
+    stats->lost_out_sum += lost_out;
+    stats->retrans_out_sum += retrans_out;
+    stats->bytes_acked = BPF_CORE_READ(tp, bytes_acked);
+    if (lost_out > stats->lost_out_max)
+        stats->lost_out_max = lost_out;
+    if (retrans_out > stats->retrans_out_max)
+        stats->retrans_out_max = retrans_out;
+    stats->srtt_hist[log2_slot(srtt_us)]++;
+    stats->mdev_hist[log2_slot(mdev_us)]++;
+
+    // Without the tcp_cong_control hook cwnd is sampled here instead
+    if (!cfg->cong_control_hooked)
+        record_cwnd(stats, BPF_CORE_READ(tp, snd_cwnd));
+
+    emit_event(sk, cookie, cell, TCP_METRICS_PROBE, cfg);
+    return 0;
+}
+
+SEC("tp_btf/tcp_retransmit_skb")
+int BPF_PROG(on_tcp_retransmit_skb, struct sock *sk, struct sk_buff *skb)
+{
+    struct tcp_metrics_config *cfg;
+    __u64 cookie;
+    __u32 cell;
+    struct tcp_flow_stats *stats = lookup_flow(sk, &cookie, &cell, &cfg);
+    if (!stats)
+        return 0;
+
+    stats->retransmits++;
+    emit_event(sk, cookie, cell, TCP_METRICS_RETRANSMIT, cfg);
+    return 0;
+}
+
+// cwnd right after the congestion control algorithm acted on an ACK.
+// tcp_cong_control() is static and may be inlined, so this is optional.
+SEC("fexit/tcp_cong_control")
+int BPF_PROG(on_tcp_cong_control, struct sock *sk)
+{
+    struct tcp_metrics_config *cfg;
+    __u64 cookie;
+    __u32 cell;
+    struct tcp_flow_stats *stats = lookup_flow(sk, &cookie, &cell, &cfg);
+    if (!stats)
+        return 0;
+
+    record_cwnd(stats, BPF_CORE_READ((struct tcp_sock *)sk, snd_cwnd));
+    emit_event(sk, cookie, cell, TCP_METRICS_CONG_CONTROL, cfg);
+    return 0;
+}
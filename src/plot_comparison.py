@@ -23,6 +23,109 @@ def load_data(throughput_file, latency_file):
         print(f"Error loading CSV files: {e}")
         sys.exit(1)
 
+# Layout of the binary results store (include/tcp_results_store.h); the
+# file is written in host byte order, which numpy's '=' prefix matches
+RESULTS_MAGIC = b'TCPRSLT1'
+INDEX_MAGIC = b'TCPRIDX1'
+CELL_BLOCK, SERIES_BLOCK, INDEX_BLOCK = 1, 2, 3
+COLUMN_TYPES = {1: np.dtype('=u4'), 2: np.dtype('=u8'), 3: np.dtype('=f8')}
+
+BLOCK_HEADER = np.dtype([('type', '=u4'), ('reserved', '=u4'), ('size', '=u8')])
+CELL_KEY = [('algorithm', 'S32'), ('bandwidth', '=i4'), ('latency', '=i4'),
+            ('trial', '=u4'), ('variant', '=u4')]
+INDEX_ENTRY = np.dtype(CELL_KEY + [('cell_offset', '=u8'), ('series_offset', '=u8')])
+CELL_RECORD = np.dtype(CELL_KEY + [('series_offset', '=u8'), ('metric_count', '=u4'),
+                                   ('sketch_count', '=u4')])
+METRIC = np.dtype([('name', 'S24'), ('value', '=f8')])
+SERIES_HEADER = np.dtype([('rows', '=u8'), ('column_count', '=u4'), ('reserved', '=u4')])
+COLUMN_INFO = np.dtype([('name', 'S20'), ('type', '=u4'), ('offset', '=u8')])
+
+class ResultsStore:
+    """Memory-mapped results store written by tcp_comparison_linux.
+
+    `cells` is a DataFrame with one row per cell (Algorithm, Bandwidth,
+    Latency, Variant, Trial and every summary metric). `series(i)` returns the time
+    series of cell i as a dict of numpy arrays viewing the mapping.
+    """
+
+    def __init__(self, path):
+        self.data = np.memmap(path, dtype=np.uint8, mode='r')
+        if self.data[:8].tobytes() != RESULTS_MAGIC:
+            raise ValueError(f"{path} is not a results store")
+        self.index = self._read_index()
+
+        rows = []
+        for entry in self.index:
+            record = self._view(int(entry['cell_offset']) + BLOCK_HEADER.itemsize, CELL_RECORD, 1)[0]
+            metrics = self._view(int(entry['cell_offset']) + BLOCK_HEADER.itemsize + CELL_RECORD.itemsize,
+                                 METRIC, int(record['metric_count']))
+            row = {'Algorithm': entry['algorithm'].decode(), 'Bandwidth': int(entry['bandwidth']),
+                   'Latency': int(entry['latency']), 'Variant': int(entry['variant']),
+                   'Trial': int(entry['trial'])}
+            row.update({m['name'].decode(): float(m['value']) for m in metrics})
+            rows.append(row)
+        self.cells = pd.DataFrame(rows)
+
+    def _view(self, offset, dtype, count):
+        return np.frombuffer(self.data, dtype=dtype, count=count, offset=offset)
+
+    def _read_index(self):
+        size = len(self.data)
+        if size >= 32 and self.data[size - 8:].tobytes() == INDEX_MAGIC:
+            index_offset = int(self._view(size - 16, np.dtype('=u8'), 1)[0])
+            count = int(self._view(index_offset + BLOCK_HEADER.itemsize, np.dtype('=u8'), 1)[0])
+            return self._view(index_offset + BLOCK_HEADER.itemsize + 8, INDEX_ENTRY, count)
+
+        # Interrupted sweep: walk the blocks and collect the cells
+        entries = []
+        offset = 16
+        while offset + BLOCK_HEADER.itemsize <= size:
+            block = self._view(offset, BLOCK_HEADER, 1)[0]
+            end = offset + BLOCK_HEADER.itemsize + int(block['size'])
+            if end > size:
+                break
+            if block['type'] == CELL_BLOCK:
+                record = self._view(offset + BLOCK_HEADER.itemsize, CELL_RECORD, 1)[0]
+                entries.append((record['algorithm'], record['bandwidth'], record['latency'],
+                                record['trial'], record['variant'], offset, record['series_offset']))
+            offset = end
+        index = np.array(entries, dtype=INDEX_ENTRY)
+        return np.sort(index, order=['algorithm', 'bandwidth', 'latency', 'variant', 'trial'])
+
+    def series(self, i):
+        """Time series of cell i, empty if it was not sampled"""
+        offset = int(self.index[i]['series_offset'])
+        if offset == 0:
+            return {}
+        payload = offset + BLOCK_HEADER.itemsize
+        header = self._view(payload, SERIES_HEADER, 1)[0]
+        columns = self._view(payload + SERIES_HEADER.itemsize, COLUMN_INFO, int(header['column_count']))
+        return {c['name'].decode(): self._view(payload + int(c['offset']), COLUMN_TYPES[int(c['type'])],
+                                               int(header['rows']))
+                for c in columns}
+
+def load_store(store_file):
+    """Build the throughput and latency tables from a binary results store"""
+    try:
+        cells = ResultsStore(store_file).cells
+    except Exception as e:
+        print(f"Error loading results store: {e}")
+        sys.exit(1)
+
+    # Same shape as throughput_vs_bandwidth.csv: trials averaged, the tuning
+    # variant with the highest throughput, one column per algorithm
+    cell = ['Algorithm', 'Bandwidth', 'Latency']
+    means = cells.groupby(cell + ['Variant'], as_index=False)[['throughput', 'latency']].mean()
+    best = means.loc[means.groupby(cell)['throughput'].idxmax()]
+
+    def table(metric):
+        pivot = best.pivot_table(index=['Bandwidth', 'Latency'], columns='Algorithm',
+                                 values=metric, aggfunc='mean')
+        pivot.columns.name = None
+        return pivot.reset_index()
+
+    return table('throughput'), table('latency')
+
 def plot_throughput_comparison(data, fixed_latency=None, output_dir="plots"):
     """Plot throughput comparison for all algorithms at a given latency"""
     # Filter by latency if specified
@@ -187,12 +290,17 @@ def main():
                         help='Path to throughput CSV file (default: throughput_vs_bandwidth.csv)')
     parser.add_argument('--latency', default='latency_vs_bandwidth.csv',
                         help='Path to latency CSV file (default: latency_vs_bandwidth.csv)')
+    parser.add_argument('--store',
+                        help='Read the binary results store (e.g. results.tcpr) instead of the CSV files')
     parser.add_argument('--output', default='plots',
                         help='Output directory for plots (default: plots/)')
     args = parser.parse_args()
     
-    # Load data from CSV files
-    throughput_data, latency_data = load_data(args.throughput, args.latency)
+    # Load data from the results store or the CSV files
+    if args.store:
+        throughput_data, latency_data = load_store(args.store)
+    else:
+        throughput_data, latency_data = load_data(args.throughput, args.latency)
     
     # Get unique latency values
     latencies = throughput_data['Latency'].unique()
@@ -0,0 +1,144 @@
+#include "tcp_bpf_congestion.h"
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include "tcp_socket_options.h"
+
+#if defined(ENABLE_EBPF_METRICS)
+#include <bpf/libbpf.h>
+#endif
+
+BpfCongestionLoader::~BpfCongestionLoader() {
+    unload();
+}
+
+std::string BpfCongestionLoader::object_of(const std::string& name) const {
+    for (const auto& algorithm : algorithms_) {
+        if (algorithm.name == name) {
+            return algorithm.object_path;
+        }
+    }
+    return std::string();
+}
+
+bool BpfCongestionLoader::load(const std::string& directory) {
+    if (!available()) {
+        std::cerr << "Loading BPF congestion controls needs a build with -DENABLE_EBPF_METRICS=ON\n";
+        return false;
+    }
+
+    DIR* entries = opendir(directory.c_str());
+    if (entries == nullptr) {
+        std::cerr << "Cannot open " << directory << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    std::vector<std::string> files;
+    while (dirent* entry = readdir(entries)) {
+        std::string name = entry->d_name;
+        if (name.size() > 2 && name.compare(name.size() - 2, 2, ".o") == 0) {
+            files.push_back(name);
+        }
+    }
+    closedir(entries);
+
+    // Sorted, so algorithms join the sweep in the same order every run
+    std::sort(files.begin(), files.end());
+    for (const auto& file : files) {
+        load_object(directory + "/" + file);
+    }
+    if (algorithms_.empty()) {
+        std::cerr << "No congestion control could be registered from " << directory << std::endl;
+        return false;
+    }
+    return true;
+}
+
+#if defined(ENABLE_EBPF_METRICS)
+
+bool BpfCongestionLoader::available() {
+    return true;
+}
+
+bool BpfCongestionLoader::load_object(const std::string& path) {
+    struct bpf_object* object = bpf_object__open_file(path.c_str(), nullptr);
+    if (object == nullptr) {
+        std::cerr << "Failed to open " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    int err = bpf_object__load(object);
+    if (err < 0) {
+        std::cerr << "Failed to load " << path << ": " << std::strerror(-err)
+                  << " (root or CAP_BPF and CAP_NET_ADMIN, and kernel BTF are required)" << std::endl;
+        bpf_object__close(object);
+        return false;
+    }
+
+    size_t registered = 0;
+    struct bpf_map* map;
+    bpf_object__for_each_map(map, object) {
+        if (bpf_map__type(map) != BPF_MAP_TYPE_STRUCT_OPS) {
+            continue;
+        }
+
+        // The new entry of the available list names the algorithm
+        std::vector<std::string> before = available_congestion_controls();
+        struct bpf_link* link = bpf_map__attach_struct_ops(map);
+        if (link == nullptr) {
+            std::cerr << "Failed to register " << bpf_map__name(map) << " from " << path << ": "
+                      << std::strerror(errno) << (errno == EEXIST ? " (name already registered)" : "")
+                      << std::endl;
+            continue;
+        }
+        links_.push_back(link);
+        ++registered;
+
+        for (const auto& name : available_congestion_controls()) {
+            if (std::find(before.begin(), before.end(), name) == before.end()) {
+                algorithms_.push_back({name, path});
+                std::cout << "Registered BPF congestion control " << name << " from " << path << std::endl;
+            }
+        }
+    }
+
+    if (registered == 0) {
+        std::cerr << "No tcp_congestion_ops registered from " << path << std::endl;
+        bpf_object__close(object);
+        return false;
+    }
+    objects_.push_back(object);
+    return true;
+}
+
+void BpfCongestionLoader::unload() {
+    // Sockets still using an algorithm keep it alive until they close
+    for (struct bpf_link* link : links_) {
+        bpf_link__destroy(link);
+    }
+    for (struct bpf_object* object : objects_) {
+        bpf_object__close(object);
+    }
+    links_.clear();
+    objects_.clear();
+    algorithms_.clear();
+}
+
+#else // !ENABLE_EBPF_METRICS
+
+bool BpfCongestionLoader::available() {
+    return false;
+}
+
+bool BpfCongestionLoader::load_object(const std::string&) {
+    return false;
+}
+
+void BpfCongestionLoader::unload() {
+    algorithms_.clear();
+}
+
+#endif // ENABLE_EBPF_METRICS
@@ -0,0 +1,221 @@
+#include "tcp_collector_trace.h"
+
+#include <algorithm>
+#include <iostream>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <string_view>
+#include <unordered_map>
+#include <dirent.h>
+
+#include "tcp_csv_reader.h"
+
+namespace {
+
+// "YYYYmmdd_HHMMSS"
+const size_t kTimestampLength = 15;
+
+bool is_timestamp(const std::string& text, size_t pos) {
+    if (pos + kTimestampLength > text.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < kTimestampLength; ++i) {
+        char c = text[pos + i];
+        if (i == 8 ? c != '_' : !std::isdigit(static_cast<unsigned char>(c))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Running totals of one algorithm
+struct Accumulator {
+    std::string algorithm;
+    uint64_t samples = 0;
+    uint64_t rtt_sum_us = 0;
+    uint64_t rttvar_sum_us = 0;
+    uint64_t cwnd_sum = 0;
+    uint64_t max_cwnd = 0;
+    uint64_t max_lost = 0;
+    uint64_t max_retrans = 0;
+    uint64_t first_ts = UINT64_MAX;
+    uint64_t last_ts = 0;
+};
+
+// bytes_acked is cumulative per socket, so each flow contributes last - first
+struct FlowSpan {
+    uint64_t first_acked;
+    uint64_t last_acked;
+};
+
+} // namespace
+
+bool parse_collector_trace_name(const std::string& filename, CollectorTraceName& name) {
+    // Algorithm names contain no underscore-led timestamps, so take the
+    // first "_YYYYmmdd_HHMMSS_" in the name
+    for (size_t pos = filename.find('_'); pos != std::string::npos; pos = filename.find('_', pos + 1)) {
+        if (pos == 0 || !is_timestamp(filename, pos + 1)) {
+            continue;
+        }
+        size_t output_pos = pos + 1 + kTimestampLength;
+        if (output_pos >= filename.size() || filename[output_pos] != '_' || output_pos + 1 == filename.size()) {
+            continue;
+        }
+        name.algorithm = filename.substr(0, pos);
+        name.timestamp = filename.substr(pos + 1, kTimestampLength);
+        name.output = filename.substr(output_pos + 1);
+        return true;
+    }
+    return false;
+}
+
+std::vector<std::string> find_collector_traces(const std::string& directory, const std::string& output) {
+    std::vector<std::string> paths;
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr) {
+        std::cerr << "Failed to open " << directory << ": " << std::strerror(errno) << std::endl;
+        return paths;
+    }
+
+    // Newest file name per algorithm
+    std::map<std::string, CollectorTraceName> newest;
+    while (struct dirent* entry = readdir(dir)) {
+        CollectorTraceName name;
+        if (!parse_collector_trace_name(entry->d_name, name) || name.output != output) {
+            continue;
+        }
+        auto it = newest.find(name.algorithm);
+        if (it == newest.end() || it->second.timestamp < name.timestamp) {
+            newest[name.algorithm] = name;
+        }
+    }
+    closedir(dir);
+
+    for (const auto& [algorithm, name] : newest) {
+        paths.push_back(directory + "/" + algorithm + "_" + name.timestamp + "_" + name.output);
+    }
+    return paths;
+}
+
+bool summarize_collector_trace(const std::string& path, std::vector<CollectorTraceSummary>& summaries,
+                               uint64_t& skipped) {
+    summaries.clear();
+    skipped = 0;
+
+    CsvReader reader;
+    if (!reader.open(path)) {
+        return false;
+    }
+
+    int rtt_col = reader.column("rtt_us");
+    if (rtt_col < 0) {
+        std::cerr << path << " has no rtt_us column, not a collector trace\n";
+        return false;
+    }
+    int ts_col = reader.column("timestamp");
+    int rttvar_col = reader.column("rttvar_us");
+    int cwnd_col = reader.column("cwnd");
+    int lost_col = reader.column("lost_packets");
+    int retrans_col = reader.column("retrans_packets");
+    int acked_col = reader.column("bytes_acked");
+    int sport_col = reader.column("src_port");
+    int dport_col = reader.column("dst_port");
+    int algo_col = reader.column("cc_algo");
+
+    // Without a cc_algo column the whole file belongs to the algorithm in its name
+    std::string fallback = "unknown";
+    CollectorTraceName name;
+    std::string filename = path.substr(path.find_last_of('/') + 1);
+    if (parse_collector_trace_name(filename, name)) {
+        fallback = name.algorithm;
+    }
+
+    std::vector<Accumulator> groups;
+    std::unordered_map<uint64_t, FlowSpan> flows;
+    size_t current = 0;
+
+    while (reader.next()) {
+        uint64_t rtt = 0;
+        if (!reader.number(rtt_col, rtt)) {
+            ++skipped;
+            continue;
+        }
+
+        // Rows of one algorithm come in runs; only a change costs a search
+        std::string_view algorithm = reader.field(algo_col);
+        if (algorithm.empty()) {
+            algorithm = fallback;
+        }
+        if (groups.empty() || groups[current].algorithm != algorithm) {
+            auto it = std::find_if(groups.begin(), groups.end(),
+                                   [&](const Accumulator& a) { return a.algorithm == algorithm; });
+            if (it == groups.end()) {
+                groups.emplace_back();
+                groups.back().algorithm = std::string(algorithm);
+                it = groups.end() - 1;
+            }
+            current = static_cast<size_t>(it - groups.begin());
+        }
+        Accumulator& group = groups[current];
+
+        uint64_t value = 0;
+        group.samples++;
+        group.rtt_sum_us += rtt;
+        if (reader.number(rttvar_col, value)) {
+            group.rttvar_sum_us += value;
+        }
+        if (reader.number(cwnd_col, value)) {
+            group.cwnd_sum += value;
+            group.max_cwnd = std::max(group.max_cwnd, value);
+        }
+        if (reader.number(lost_col, value)) {
+            group.max_lost = std::max(group.max_lost, value);
+        }
+        if (reader.number(retrans_col, value)) {
+            group.max_retrans = std::max(group.max_retrans, value);
+        }
+        if (reader.number(ts_col, value)) {
+            group.first_ts = std::min(group.first_ts, value);
+            group.last_ts = std::max(group.last_ts, value);
+        }
+
+        uint64_t sport = 0;
+        uint64_t dport = 0;
+        uint64_t acked = 0;
+        if (reader.number(acked_col, acked) && reader.number(sport_col, sport) &&
+            reader.number(dport_col, dport)) {
+            uint64_t key = (static_cast<uint64_t>(current) << 32) | ((sport & 0xFFFF) << 16) | (dport & 0xFFFF);
+            auto [it, inserted] = flows.try_emplace(key, FlowSpan{acked, acked});
+            if (!inserted) {
+                it->second.last_acked = acked;
+            }
+        }
+    }
+
+    for (const Accumulator& group : groups) {
+        CollectorTraceSummary summary;
+        summary.algorithm = group.algorithm;
+        summary.samples = group.samples;
+        summary.mean_rtt_ms = static_cast<double>(group.rtt_sum_us) / group.samples / 1000.0;
+        summary.mean_rttvar_ms = static_cast<double>(group.rttvar_sum_us) / group.samples / 1000.0;
+        summary.mean_cwnd = static_cast<double>(group.cwnd_sum) / group.samples;
+        summary.max_cwnd = group.max_cwnd;
+        summary.max_lost = group.max_lost;
+        summary.max_retrans = group.max_retrans;
+        if (group.last_ts > group.first_ts) {
+            summary.duration_s = static_cast<double>(group.last_ts - group.first_ts) / 1e9;
+        }
+        summaries.push_back(summary);
+    }
+
+    for (const auto& [key, span] : flows) {
+        CollectorTraceSummary& summary = summaries[key >> 32];
+        summary.flows++;
+        if (span.last_acked > span.first_acked && summary.duration_s > 0.0) {
+            summary.throughput_mbps += (span.last_acked - span.first_acked) * 8.0 / summary.duration_s / 1e6;
+        }
+    }
+    return true;
+}
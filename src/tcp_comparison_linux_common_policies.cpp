@@ -1,7 +1,9 @@
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <fstream>
+#include <map>
 #include <chrono>
 #include <thread>
 #include <sys/socket.h>
@@ -9,192 +11,304 @@
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
-#include <map>
 #include <sstream>
-#include <set>  // For unique algorithm tracking
+#include <memory>
+#include <mutex>
+#include <cstdlib>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <csignal>
+#include <cmath>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <net/if.h>
 
-// Define EBPF feature flag
-#if defined(ENABLE_EBPF_METRICS)
-  #define USE_EBPF_METRICS 1
-#else
-  #define USE_EBPF_METRICS 0
-#endif
+#include "tcp_bpf_congestion.h"
+#include "tcp_collector_trace.h"
+#include "tcp_cpu_counters.h"
+#include "tcp_ebpf_collector.h"
+#include "tcp_flow_churn.h"
+#include "tcp_flow_mux.h"
+#include "tcp_info_sampler.h"
+#include "tcp_link_emulation.h"
+#include "tcp_metrics_exporter.h"
+#include "tcp_netlink.h"
+#include "tcp_results_cache.h"
+#include "tcp_results_compare.h"
+#include "tcp_results_export.h"
+#include "tcp_results_store.h"
+#include "tcp_rpc_probe.h"
+#include "tcp_scenario.h"
+#include "tcp_series_export.h"
+#include "tcp_netns.h"
+#include "tcp_socket_options.h"
+#include "tcp_sweep_scheduler.h"
+#include "tcp_transfer_engine.h"
+#include "tcp_trial_stats.h"
+#include "tcp_userspace_emulator.h"
 
 using namespace std;
 
+// What a tuning search maximises over the cells of an algorithm: mean
+// throughput, or power (throughput over p99 RTT, in Mbps per ms)
+enum class TuningObjective { Throughput, Power };
+
+// Passes of the tuning search over all dimensions
+const int kTuningSearchPasses = 2;
+
+// Where each cell's sampled per-packet eBPF events are written
+const char* const kEbpfEventDirectory = "ebpf_events";
+
 class CongestionTester {
 private:
+    // TCP port of the test listener
+    static const uint16_t kTestPort = 5000;
+    
+    // Timeline resolution of contention runs
+    static const int kContentionIntervalMs = 100;
+    
     std::string current_algorithm;
     std::vector<std::string> available_algorithms;
     
+    // Algorithms registered from BPF object files for this run, and the
+    // system-wide default to put back before they are unregistered
+    std::unique_ptr<BpfCongestionLoader> bpf_congestion;
+    std::string default_algorithm;
+    
     // Socket file descriptors
     int server_fd;
     int client_fd;
+    int data_fd;                  // Server side of the client connection
+    
+    // Data plane settings used by measure_performance
+    TransferConfig transfer_config;
+    
+    // Select congestion control per connection (TCP_CONGESTION) instead
+    // of writing the system-wide default
+    bool per_socket_cc;
+    
+    // Link emulation: interface carrying the test traffic, the extra
+    // impairments applied to every cell, and the active emulator
+    EmulationMode emulation_mode;
+    std::string test_interface;
+    LinkConditions impairments;
+    std::string delivery_trace;   // Mahimahi trace for the userspace relay
+    std::unique_ptr<QdiscEmulator> qdisc_emulator;
+    std::unique_ptr<UserspaceLinkEmulator> userspace_emulator;
+    
+    // Kernel-side metrics, loaded on the first measurement and kept
+    // attached for the rest of the sweep
+    std::unique_ptr<EbpfCollector> ebpf_collector;
+    bool ebpf_failed;
+    int ebpf_interval_ms;         // How often in-kernel aggregates are read
+    uint32_t ebpf_event_sampling; // Per-packet events, one in N (0 = off)
+    std::vector<std::string> ebpf_event_traces;   // Written so far, for the series export
+    
+    // TCP_INFO polling rate of the sender sockets, 0 = off
+    int sample_rate_hz;
+    
+    // Live view of the sweep for scrapers, owned by main; null when off
+    MetricsExporter* metrics_exporter;
+    
+    // How often each cell is repeated and when it may stop early
+    TrialPolicy trial_policy;
+    
+    // Request/response probe on its own connection next to the bulk flow;
+    // the interleaved probe is part of transfer_config
+    RpcProbeConfig rpc_config;
+    
+    // Contention runs: epoll workers driving the flows (0 = automatic) and
+    // the CSV files every run appends to
+    int mux_workers;
+    std::ofstream contention_flows_csv;
+    std::ofstream contention_timeline_csv;
+    std::vector<std::string> contention_algorithms;   // Timeline columns
+    
+    // Short-flow churn runs: arrival settings, flow sizes and the CSV files
+    // every run appends to
+    ChurnConfig churn_config;
+    FlowSizeDistribution churn_sizes;
+    std::ofstream churn_summary_csv;
+    std::ofstream churn_fct_csv;
+    
+    // Scenario runs append to these
+    std::ofstream scenario_convergence_csv;
+    std::ofstream scenario_timeline_csv;
+    
+    // Tuning variant of the sequential sweep: socket options of each test
+    // connection, autotuning sysctls, the receiver's route and the queue
+    // at the bottleneck. The variant's index is part of the results key.
+    SocketTuning tuning;
+    uint32_t tuning_variant;
+    bool tuning_failed;         // Part of the variant could not be applied
+    SysctlOverride rmem_override;
+    SysctlOverride wmem_override;
+    InitcwndOverride route_override;
     
     // Performance metrics
     struct Metrics {
-        double throughput;        // In Mbps
+        double throughput;        // In Mbps, from bytes acknowledged
+        double goodput;           // In Mbps, from bytes read by the receiver
         double latency;           // In ms
         int packet_loss;          // Count
         double jitter;            // In ms
+        double warmup_seconds;    // Start of the window left out as warm-up
         int bandwidth_config;     // Test configuration (Mbps)
         int latency_config;       // Test configuration (ms)
+        TcpInfoSeries series;     // Sender TCP_INFO samples, if sampled
+        LatencySketch rtt_us;     // Sender smoothed RTT distribution
+        LatencySketch owd_us;     // Message one-way delay distribution
+        LatencySketch rpc_rtt_us; // Request/response probe on its own connection
+        LatencySketch rpc_owd_us;
+        LatencySketch inline_rtt_us;  // Requests interleaved with the bulk flow
+        LatencySketch inline_owd_us;
+        CpuCost cpu;              // CPU spent in the window, if measured
+        double cycles_per_byte;   // Per byte read by the receiver, if counted
+        double instructions_per_byte;
     };
     
-    // Test results storage
-    std::map<std::string, std::vector<Metrics>> all_results;
+    // Every finished cell, summary and time series, is appended to the
+    // results store; the CSV files are exported from it at the end
+    ResultsStoreWriter results_store;
+    std::string results_path;
+    std::mutex results_mutex;
+    SeriesOptions series_options;   // Downsampled series per cell, if enabled
+    
+    // Finished sequential cells are also kept in the cache, keyed by
+    // everything that decides their outcome, so reruns and interrupted
+    // sweeps only measure what is missing
+    std::unique_ptr<ResultsCache> results_cache;
+    std::string cache_host;       // Description lines shared by every cell
+    ResultsStoreWriter cache_entry;   // Trials of the cell being measured
     
     // Load available congestion algorithms
     void load_available_algorithms() {
-        std::ifstream alg_file("/proc/sys/net/ipv4/tcp_available_congestion_control");
-        std::string alg;
-        while (alg_file >> alg) {
-            available_algorithms.push_back(alg);
-        }
+        available_algorithms = available_congestion_controls();
     }
 
-    // Generate a CSV with detailed performance metrics
-    void save_detailed_metrics(const std::string& filename) {
-        std::ofstream csv_file(filename);
-        
-        // Write header
-        csv_file << "Algorithm,BandwidthConfig,LatencyConfig,Throughput,Latency,PacketLoss,Jitter\n";
-        
-        // Write data
-        for (const auto& [alg, results] : all_results) {
-            for (const auto& metrics : results) {
-                csv_file << alg << ","
-                         << metrics.bandwidth_config << ","
-                         << metrics.latency_config << ","
-                         << metrics.throughput << ","
-                         << metrics.latency << ","
-                         << metrics.packet_loss << ","
-                         << metrics.jitter << "\n";
-            }
+    // Append one finished trial of a cell to the results store, opening it
+    // on first use. Scheduler workers call this with results_mutex held.
+    void store_result(const std::string& algorithm, const Metrics& result, uint32_t trial) {
+        if (!open_results_store()) {
+            return;
         }
         
-        csv_file.close();
-        std::cout << "Detailed metrics saved to " << filename << std::endl;
-    }
-    
-    // Generate gnuplot-friendly CSV files for each metric
-    void save_gnuplot_friendly_metrics() {
-        // Throughput vs Bandwidth for each algorithm and latency
-        std::ofstream throughput_bw_file("throughput_vs_bandwidth.csv");
-        throughput_bw_file << "Bandwidth,Latency";
-        
-        // Get unique algorithms for column headers
-        std::set<std::string> algorithms;
-        for (const auto& [alg, _] : all_results) {
-            algorithms.insert(alg);
+        std::vector<MetricValue> metrics = {
+            {kMetricThroughput, result.throughput},
+            {kMetricGoodput, result.goodput},
+            {kMetricLatency, result.latency},
+            {kMetricPacketLoss, static_cast<double>(result.packet_loss)},
+            {kMetricJitter, result.jitter},
+            {kMetricWarmup, result.warmup_seconds},
+        };
+        if (result.cpu.measured) {
+            metrics.push_back({kMetricCpuUtil, result.cpu.cpu_percent});
+            metrics.push_back({kMetricSoftirqUtil, result.cpu.softirq_percent});
+            metrics.push_back({kMetricContextSwitches, static_cast<double>(result.cpu.context_switches)});
         }
-        
-        // Add algorithm names as column headers
-        for (const auto& alg : algorithms) {
-            throughput_bw_file << "," << alg;
+        if (result.cpu.counted) {
+            metrics.push_back({kMetricCyclesPerByte, result.cycles_per_byte});
+            metrics.push_back({kMetricInstructionsPerByte, result.instructions_per_byte});
         }
-        throughput_bw_file << "\n";
         
-        // Group by bandwidth and latency
-        std::map<std::pair<int, int>, std::map<std::string, double>> grouped_data;
-        for (const auto& [alg, results] : all_results) {
-            for (const auto& metrics : results) {
-                std::pair<int, int> config = {metrics.bandwidth_config, metrics.latency_config};
-                grouped_data[config][alg] = metrics.throughput;
-            }
-        }
+        const TcpInfoSeries& series = result.series;
+        std::vector<ColumnRef> columns = {
+            {"t_ns", ColumnType::U64, series.t_ns.data()},
+            {"rtt_us", ColumnType::U32, series.rtt_us.data()},
+            {"rttvar_us", ColumnType::U32, series.rttvar_us.data()},
+            {"snd_cwnd", ColumnType::U32, series.snd_cwnd.data()},
+            {"lost", ColumnType::U32, series.lost.data()},
+            {"total_retrans", ColumnType::U32, series.total_retrans.data()},
+            {"delivery_rate", ColumnType::U64, series.delivery_rate.data()},
+            {"pacing_rate", ColumnType::U64, series.pacing_rate.data()},
+            {"busy_time_us", ColumnType::U64, series.busy_time_us.data()},
+            {"rwnd_limited_us", ColumnType::U64, series.rwnd_limited_us.data()},
+            {"sndbuf_limited_us", ColumnType::U64, series.sndbuf_limited_us.data()},
+            {"bytes_acked", ColumnType::U64, series.bytes_acked.data()},
+        };
         
-        // Write data rows
-        for (const auto& [config, alg_metrics] : grouped_data) {
-            throughput_bw_file << config.first << "," << config.second;
-            for (const auto& alg : algorithms) {
-                if (alg_metrics.find(alg) != alg_metrics.end()) {
-                    throughput_bw_file << "," << alg_metrics.at(alg);
-                } else {
-                    throughput_bw_file << ",";  // Empty if no data
-                }
+        std::vector<SketchRef> sketches;
+        const std::pair<const char*, const LatencySketch*> distributions[] = {
+            {kSketchRtt, &result.rtt_us},
+            {kSketchOwd, &result.owd_us},
+            {kSketchRpcRtt, &result.rpc_rtt_us},
+            {kSketchRpcOwd, &result.rpc_owd_us},
+            {kSketchInlineRtt, &result.inline_rtt_us},
+            {kSketchInlineOwd, &result.inline_owd_us},
+        };
+        for (const auto& distribution : distributions) {
+            if (!distribution.second->empty()) {
+                sketches.push_back({distribution.first, distribution.second});
             }
-            throughput_bw_file << "\n";
         }
         
-        throughput_bw_file.close();
-        std::cout << "Gnuplot-friendly metrics saved to throughput_vs_bandwidth.csv" << std::endl;
-        
-        // Similar file for latency vs bandwidth
-        std::ofstream latency_bw_file("latency_vs_bandwidth.csv");
-        latency_bw_file << "Bandwidth,Latency";
-        for (const auto& alg : algorithms) {
-            latency_bw_file << "," << alg;
-        }
-        latency_bw_file << "\n";
-        
-        // Write latency data
-        for (const auto& [config, alg_metrics] : grouped_data) {
-            latency_bw_file << config.first << "," << config.second;
-            for (const auto& alg : algorithms) {
-                if (alg_metrics.find(alg) != alg_metrics.end()) {
-                    // Store the latency value from original metrics
-                    for (const auto& metrics : all_results[alg]) {
-                        if (metrics.bandwidth_config == config.first && metrics.latency_config == config.second) {
-                            latency_bw_file << "," << metrics.latency;
-                            break;
-                        }
-                    }
-                } else {
-                    latency_bw_file << ",";  // Empty if no data
-                }
-            }
-            latency_bw_file << "\n";
+        std::vector<std::pair<std::string, double>> tuned = tuning_numbers(tuning);
+        for (auto& value : tuned) {
+            value.first = kMetricTuningPrefix + value.first;
+            metrics.push_back({value.first.c_str(), value.second});
         }
         
-        latency_bw_file.close();
-        std::cout << "Gnuplot-friendly metrics saved to latency_vs_bandwidth.csv" << std::endl;
+        ResultsCellKey key = make_results_key(algorithm, result.bandwidth_config, result.latency_config, trial,
+                                              tuning_variant);
+        results_store.append_cell(key, metrics, series.rows(), columns, sketches);
+        if (cache_entry.is_open()) {
+            cache_entry.append_cell(key, metrics, series.rows(), columns, sketches);
+        }
     }
     
-    // Generate a CSV with algorithm comparison summary
-    void save_algorithm_comparison(const std::string& filename) {
-        std::ofstream csv_file(filename);
-        
-        // Calculate average metrics for each algorithm
-        std::map<std::string, std::map<std::string, double>> avg_metrics;
-        
-        for (const auto& [alg, results] : all_results) {
-            double avg_throughput = 0.0;
-            double avg_latency = 0.0;
-            double avg_packet_loss = 0.0;
-            double avg_jitter = 0.0;
-            int count = 0;
-            
-            for (const auto& metrics : results) {
-                avg_throughput += metrics.throughput;
-                avg_latency += metrics.latency;
-                avg_packet_loss += metrics.packet_loss;
-                avg_jitter += metrics.jitter;
-                count++;
-            }
-            
-            if (count > 0) {
-                avg_metrics[alg]["throughput"] = avg_throughput / count;
-                avg_metrics[alg]["latency"] = avg_latency / count;
-                avg_metrics[alg]["packet_loss"] = avg_packet_loss / count;
-                avg_metrics[alg]["jitter"] = avg_jitter / count;
-            }
+    // Replace the maximum of an autotuning sysctl ("min default max"),
+    // keeping its original minimum and default below the new maximum
+    static bool set_autotuning_max(SysctlOverride& sysctl, const std::string& name, uint64_t max_bytes) {
+        if (!sysctl.save(name)) {
+            return false;
         }
-        
-        // Write header
-        csv_file << "Algorithm,AvgThroughput,AvgLatency,AvgPacketLoss,AvgJitter\n";
-        
-        // Write data
-        for (const auto& [alg, metrics] : avg_metrics) {
-            csv_file << alg << ","
-                     << metrics.at("throughput") << ","
-                     << metrics.at("latency") << ","
-                     << metrics.at("packet_loss") << ","
-                     << metrics.at("jitter") << "\n";
+        std::istringstream fields(sysctl.original());
+        uint64_t min_bytes = 0;
+        uint64_t default_bytes = 0;
+        if (!(fields >> min_bytes >> default_bytes)) {
+            std::cerr << "Cannot parse sysctl " << name << ": " << sysctl.original() << std::endl;
+            return false;
         }
-        
-        csv_file.close();
-        std::cout << "Algorithm comparison saved to " << filename << std::endl;
+        return sysctl.set(name, std::to_string(std::min(min_bytes, max_bytes)) + " " +
+                                std::to_string(std::min(default_bytes, max_bytes)) + " " +
+                                std::to_string(max_bytes));
+    }
+    
+    bool open_results_store() {
+        return results_store.is_open() || results_store.open(results_path);
+    }
+    
+    // Everything that decides the outcome of a sequential cell with the
+    // current algorithm, one "name=value" line each, for the cache
+    std::string cell_description(int duration_seconds, int bandwidth_mbps, int latency_ms) const {
+        std::ostringstream text;
+        text << cache_host << ResultsCache::algorithm_description(current_algorithm);
+        std::string bpf_object = bpf_congestion ? bpf_congestion->object_of(current_algorithm) : std::string();
+        if (!bpf_object.empty()) {
+            text << "bpf_object=" << file_digest(bpf_object) << "\n";
+        }
+        text << "cell=" << bandwidth_mbps << " Mbps " << latency_ms << " ms " << duration_seconds << " s\n"
+             << "emulator=" << emulation_mode_name(emulation_mode) << " " << test_interface << "\n"
+             << "impairments=jitter " << impairments.jitter_ms << " loss " << impairments.loss_percent
+             << " reorder " << impairments.reorder_percent << "\n";
+        if (emulation_mode == EmulationMode::Userspace && !delivery_trace.empty()) {
+            text << "trace=" << file_digest(delivery_trace) << "\n";
+        }
+        text << "transfer=" << send_mode_name(transfer_config.send_mode) << " " << transfer_config.message_size
+             << " per-socket " << per_socket_cc << "\n"
+             << "sampler=" << sample_rate_hz << "\n"
+             << "trials=" << trial_policy.min_trials << "-" << trial_policy.max_trials << " tolerance "
+             << trial_policy.tolerance << " budget " << trial_policy.budget_seconds << "\n"
+             << "rpc=" << rpc_config.rate_hz << " " << rpc_config.request_size << "\n"
+             << "tuning=" << tuning.label() << "\n"
+             << "ebpf=";
+        if (EbpfCollector::available()) {
+            text << ebpf_interval_ms << " " << ebpf_event_sampling << "\n";
+        } else {
+            text << "off\n";
+        }
+        return text.str();
     }
 
 public:
@@ -207,6 +321,21 @@ public:
         // Initialize socket descriptors
         server_fd = -1;
         client_fd = -1;
+        data_fd = -1;
+        
+        per_socket_cc = false;
+        ebpf_failed = false;
+        ebpf_interval_ms = 100;
+        ebpf_event_sampling = 0;
+        sample_rate_hz = 1000;
+        metrics_exporter = nullptr;
+        mux_workers = 0;
+        tuning_variant = 0;
+        tuning_failed = false;
+        results_path = "results.tcpr";
+        
+        emulation_mode = EmulationMode::Qdisc;
+        test_interface = "lo";
     }
     
     // Destructor to clean up resources
@@ -214,27 +343,224 @@ public:
         if (server_fd >= 0) {
             close(server_fd);
         }
-        if (client_fd >= 0) {
-            close(client_fd);
+        close_client();
+        clear_tuning();
+        unload_bpf_congestion();
+    }
+    
+    // Configure the sender/receiver data plane
+    void set_transfer_config(const TransferConfig& config) {
+        transfer_config = config;
+    }
+    
+    // Configure link emulation: the mode, the interface carrying test
+    // traffic, jitter/loss/reorder applied on top of each cell's rate and
+    // delay, and an optional delivery trace for the userspace relay
+    void set_link_emulation(EmulationMode mode, const std::string& interface,
+                            const LinkConditions& extra, const std::string& trace) {
+        emulation_mode = mode;
+        test_interface = interface;
+        impairments = extra;
+        delivery_trace = trace;
+        qdisc_emulator.reset();
+        userspace_emulator.reset();
+    }
+    
+    // Configure the eBPF collector: aggregate read interval and optional
+    // sampled per-packet events
+    void set_ebpf_options(int interval_ms, uint32_t event_sampling) {
+        ebpf_interval_ms = interval_ms;
+        ebpf_event_sampling = event_sampling;
+    }
+    
+    // Configure the TCP_INFO sampler (0 disables it)
+    void set_sample_rate(int rate_hz) {
+        sample_rate_hz = rate_hz;
+    }
+    
+    // Publish progress and live flows to an exporter (null = off)
+    void set_metrics_exporter(MetricsExporter* exporter) {
+        metrics_exporter = exporter;
+    }
+    
+    // Cells the sweep is going to run (0 = not known) and one finished
+    void set_sweep_cells(uint64_t cells) {
+        if (metrics_exporter) {
+            metrics_exporter->set_cells_total(cells);
         }
     }
     
-    // Set congestion algorithm for testing
-    bool set_congestion_algorithm(const std::string& algorithm) {
-        // Check if algorithm is available
-        bool available = false;
+    void finish_cell() {
+        if (metrics_exporter) {
+            metrics_exporter->cell_finished();
+        }
+    }
+    
+    // Configure repeated trials per cell
+    void set_trial_policy(const TrialPolicy& policy) {
+        trial_policy = policy;
+    }
+    
+    // Configure the request/response probe on its own connection
+    void set_rpc_probe(const RpcProbeConfig& config) {
+        rpc_config = config;
+    }
+    
+    // Configure short-flow churn runs
+    void set_churn(const ChurnConfig& config, const FlowSizeDistribution& sizes) {
+        churn_config = config;
+        churn_sizes = sizes;
+    }
+    
+    // Worker threads of contention runs (0 = automatic)
+    void set_mux_workers(int workers) {
+        mux_workers = workers;
+    }
+    
+    // Take sequential cells from and keep them in a cache directory
+    bool set_results_cache(const std::string& directory) {
+        results_cache = std::make_unique<ResultsCache>(directory);
+        if (!results_cache->open()) {
+            results_cache.reset();
+            return false;
+        }
+        cache_host = ResultsCache::host_description();
+        return true;
+    }
+    
+    // Where the binary results store is written
+    void set_results_path(const std::string& path) {
+        results_path = path;
+    }
+    
+    // Also write each cell's time series for gnuplot at the end
+    void set_series_options(const SeriesOptions& options) {
+        series_options = options;
+    }
+    
+    // Read the host-wide settings the dimensions change once, before the
+    // first variant. They are put back after each variant and, through the
+    // overrides' crash restore, when the run is killed or exits early.
+    void save_tuning_defaults(const std::vector<TuningDimension>& dimensions) {
+        for (const auto& dimension : dimensions) {
+            if (dimension.name == "tcp_rmem") {
+                rmem_override.save("net/ipv4/tcp_rmem");
+            } else if (dimension.name == "tcp_wmem") {
+                wmem_override.save("net/ipv4/tcp_wmem");
+            } else if (dimension.name == "initcwnd") {
+                route_override.save("lo", "127.0.0.1");
+            }
+        }
+    }
+    
+    // Switch the sequential sweep to a tuning variant. Sysctls and the
+    // route change now; socket options and the queue follow with the next
+    // connection and cell. False when part of it could not be applied.
+    bool set_tuning(const SocketTuning& next, uint32_t variant) {
+        clear_tuning();
+        tuning = next;
+        tuning_variant = variant;
+        
+        bool applied = true;
+        if (next.tcp_rmem_max > 0) {
+            applied = set_autotuning_max(rmem_override, "net/ipv4/tcp_rmem", next.tcp_rmem_max) && applied;
+        }
+        if (next.tcp_wmem_max > 0) {
+            applied = set_autotuning_max(wmem_override, "net/ipv4/tcp_wmem", next.tcp_wmem_max) && applied;
+        }
+        if (next.initcwnd > 0) {
+            if (!route_override.set("lo", "127.0.0.1", next.initcwnd)) {
+                std::cerr << "Could not set initcwnd " << next.initcwnd << " on the route to 127.0.0.1\n";
+                applied = false;
+            }
+        }
+        if (emulation_mode == EmulationMode::Userspace && !next.qdisc.empty()) {
+            std::cerr << "The userspace emulator has its own queue, ignoring qdisc " << next.qdisc << std::endl;
+        }
+        std::cout << "Tuning: " << next.label() << std::endl;
+        tuning_failed = !applied;
+        return applied;
+    }
+    
+    // Back to the kernel's settings
+    void clear_tuning() {
+        rmem_override.restore();
+        wmem_override.restore();
+        route_override.restore();
+        
+        // The listener carries the receive buffer into accepted sockets
+        if (tuning.rcvbuf > 0 && server_fd >= 0) {
+            close(server_fd);
+            server_fd = -1;
+        }
+        tuning = SocketTuning();
+        tuning_variant = 0;
+        tuning_failed = false;
+    }
+    
+    // Choose between per-socket and system-wide congestion control
+    void set_per_socket_congestion(bool enabled) {
+        per_socket_cc = enabled;
+    }
+    
+    // Register the BPF congestion controls in directory for the rest of the
+    // run; returns their names, empty when none could be registered
+    std::vector<std::string> load_bpf_congestion(const std::string& directory) {
+        unload_bpf_congestion();
+        bpf_congestion = std::make_unique<BpfCongestionLoader>();
+        std::vector<std::string> names;
+        if (!bpf_congestion->load(directory)) {
+            bpf_congestion.reset();
+            return names;
+        }
+        default_algorithm = SysctlOverride::read("net/ipv4/tcp_congestion_control");
+        for (const auto& algorithm : bpf_congestion->algorithms()) {
+            names.push_back(algorithm.name);
+        }
+        load_available_algorithms();
+        return names;
+    }
+    
+    // Unregister the BPF congestion controls, first putting the original
+    // system-wide default back if one of them is still the default
+    void unload_bpf_congestion() {
+        if (!bpf_congestion) {
+            return;
+        }
+        std::string active = SysctlOverride::read("net/ipv4/tcp_congestion_control");
+        if (!bpf_congestion->object_of(active).empty()) {
+            std::ofstream cc_file("/proc/sys/net/ipv4/tcp_congestion_control");
+            cc_file << default_algorithm;
+        }
+        bpf_congestion.reset();
+        load_available_algorithms();
+    }
+    
+    // Check whether the kernel offers an algorithm
+    bool is_algorithm_available(const std::string& algorithm) const {
         for (const auto& alg : available_algorithms) {
             if (alg == algorithm) {
-                available = true;
-                break;
+                return true;
             }
         }
-        
-        if (!available) {
+        return false;
+    }
+    
+    // Set congestion algorithm for testing
+    bool set_congestion_algorithm(const std::string& algorithm) {
+        // Check if algorithm is available
+        if (!is_algorithm_available(algorithm)) {
             std::cerr << "Algorithm " << algorithm << " not available\n";
             return false;
         }
         
+        if (per_socket_cc) {
+            // Applied to each test connection in setup_client
+            current_algorithm = algorithm;
+            std::cout << "Using per-socket congestion control: " << algorithm << std::endl;
+            return true;
+        }
+        
         // Set the algorithm system-wide (for testing purposes)
         std::ofstream cc_file("/proc/sys/net/ipv4/tcp_congestion_control");
         cc_file << algorithm;
@@ -245,289 +571,2169 @@ public:
     }
     
     // Run a test with the current algorithm
-    Metrics run_test(int duration_seconds, int bandwidth_limit_mbps, int latency_ms) {
+    Metrics run_test(int duration_seconds, int bandwidth_limit_mbps, int latency_ms, uint32_t trial = 0) {
         std::cout << "Running test with " << current_algorithm 
-                  << " (Bandwidth: " << bandwidth_limit_mbps << " Mbps, Latency: " << latency_ms << " ms)\n";
+                  << " (Bandwidth: " << bandwidth_limit_mbps << " Mbps, Latency: " << latency_ms << " ms";
+        if (trial > 0) {
+            std::cout << ", trial " << trial + 1;
+        }
+        std::cout << ")\n";
         
         // Setup server if not already done
         if (server_fd < 0) {
             setup_server();
         }
         
-        // Setup client connection
-        setup_client();
+        // Setup client connection; the userspace relay has to be in the
+        // path before the client connects
+        uint16_t port = start_userspace_emulator(bandwidth_limit_mbps, latency_ms);
+        setup_client(port);
         
         // Apply network conditions
         apply_network_conditions(bandwidth_limit_mbps, latency_ms);
         
-        // Run the actual test
-        Metrics result = measure_performance(duration_seconds);
+        // A test on the kernel's defaults would pass for the tuned one
+        if (tuning_failed) {
+            close_client();
+            clear_network_conditions();
+            return Metrics();
+        }
+        
+        // Run the actual test, then drop the connection so the next
+        // test starts from a fresh slow start
+        Metrics result = measure_performance(duration_seconds, bandwidth_limit_mbps, latency_ms, trial);
+        close_client();
+        clear_network_conditions();
         
         // Store configuration parameters
         result.bandwidth_config = bandwidth_limit_mbps;
         result.latency_config = latency_ms;
         
         // Store results
-        all_results[current_algorithm].push_back(result);
+        store_result(current_algorithm, result, trial);
         
         return result;
     }
     
-    // Run a comprehensive test suite
-    void run_test_suite() {
-        std::vector<int> bandwidths = {10, 50, 100}; // Mbps
-        std::vector<int> latencies = {5, 20, 100};   // ms
+    // Repeat a cell with the current algorithm as the trial policy asks,
+    // unless the cache already has it; returns the cell's trials
+    TrialTracker run_cell(int duration_seconds, int bandwidth_limit_mbps, int latency_ms) {
+        TrialTracker tracker(trial_policy);
+        std::string description;
+        if (results_cache) {
+            description = cell_description(duration_seconds, bandwidth_limit_mbps, latency_ms);
+            ResultsStoreReader cached;
+            ResultsCellKey key = make_results_key(current_algorithm, bandwidth_limit_mbps, latency_ms, 0,
+                                                  tuning_variant);
+            if (open_results_store() && results_cache->load(description, key, results_store, cached)) {
+                std::cout << "Cached: " << current_algorithm << " (Bandwidth: " << bandwidth_limit_mbps
+                          << " Mbps, Latency: " << latency_ms << " ms)\n";
+                LatencySketch rtt_us;
+                for (size_t i = 0; i < cached.size(); ++i) {
+                    bool has_rtt = cached.sketch(i, kSketchRtt, rtt_us) && !rtt_us.empty();
+                    tracker.add(cached.metric(i, kMetricThroughput), has_rtt ? rtt_us.quantile(0.99) / 1000.0 : -1.0);
+                }
+                finish_cell();
+                return tracker;
+            }
+            results_cache->begin(description, cache_entry);
+        }
         
-        for (const auto& alg : available_algorithms) {
-            if (set_congestion_algorithm(alg)) {
-                std::cout << "\n=== Testing " << alg << " ===\n";
-                
-                for (int bw : bandwidths) {
-                    for (int lat : latencies) {
-                        auto metrics = run_test(30, bw, lat);  // 30 seconds duration
-                        
-                        // Display results
-                        std::cout << "Results: " 
-                                  << "BW=" << bw << "Mbps, "
-                                  << "Lat=" << lat << "ms -> "
-                                  << "Throughput=" << metrics.throughput << "Mbps, "
-                                  << "Latency=" << metrics.latency << "ms, "
-                                  << "PacketLoss=" << metrics.packet_loss << ", "
-                                  << "Jitter=" << metrics.jitter << "ms\n";
-                    }
+        bool measured = true;
+        do {
+            Metrics result = run_test(duration_seconds, bandwidth_limit_mbps, latency_ms,
+                                      static_cast<uint32_t>(tracker.trials()));
+            if (tuning_failed) {
+                if (cache_entry.is_open()) {
+                    results_cache->discard(description, cache_entry);
                 }
+                finish_cell();
+                return tracker;
+            }
+            tracker.add(result.throughput, p99_rtt_ms(result));
+            measured = measured && result.goodput > 0.0;
+        } while (!tracker.done(duration_seconds));
+        report_trials(current_algorithm, bandwidth_limit_mbps, latency_ms, tracker, duration_seconds);
+        
+        // A cell that moved no data is measured again next time
+        if (cache_entry.is_open()) {
+            if (measured) {
+                results_cache->commit(description, cache_entry);
+            } else {
+                results_cache->discard(description, cache_entry);
             }
         }
+        finish_cell();
+        return tracker;
     }
     
-    // Save results to CSV files
-    void save_results() {
-        save_detailed_metrics("detailed_metrics.csv");
-        save_algorithm_comparison("algorithm_comparison.csv");
-        save_gnuplot_friendly_metrics(); // Generate additional files for gnuplot
+    // Run every cell with the current algorithm and tuning; returns the
+    // objective averaged over the cells. Stops early when the tuning could
+    // not be applied.
+    double run_cells(int duration_seconds, const std::vector<int>& bandwidths,
+                     const std::vector<int>& latencies, TuningObjective objective) {
+        double total = 0.0;
+        size_t cells = 0;
+        for (int bw : bandwidths) {
+            for (int lat : latencies) {
+                if (tuning_failed) {
+                    return 0.0;
+                }
+                TrialTracker tracker = run_cell(duration_seconds, bw, lat);
+                double throughput = tracker.throughput().mean;
+                if (objective == TuningObjective::Throughput) {
+                    total += throughput;
+                    ++cells;
+                } else if (tracker.p99_rtt().n > 0 && tracker.p99_rtt().mean > 0.0) {
+                    total += throughput / tracker.p99_rtt().mean;
+                    ++cells;
+                }
+            }
+        }
+        return cells > 0 ? total / cells : 0.0;
     }
     
-    // Display available algorithms
-    void show_available_algorithms() {
-        std::cout << "Available congestion control algorithms:\n";
-        std::cout << "AVAILABLE TCP CONGESTION CONTROL POLICIES:\n";
-        for (const auto& alg : available_algorithms) {
-            std::cout << "- " << alg << std::endl;
+    // Run every cell with one tuning variant and set score to the objective.
+    // False when the tuning could not be applied: the variant's cells are
+    // then dropped from the results, and the failing cell is not cached.
+    // Cells finished before it stay cached: they ran with the whole tuning
+    // in effect, so a later run where it applies can take them.
+    bool run_tuned_cells(const SocketTuning& point, uint32_t variant, int duration_seconds,
+                         const std::vector<int>& bandwidths, const std::vector<int>& latencies,
+                         TuningObjective objective, double& score) {
+        size_t stored = results_store.cells();
+        bool applied = set_tuning(point, variant);
+        if (applied) {
+            score = run_cells(duration_seconds, bandwidths, latencies, objective);
+            applied = !tuning_failed;
         }
+        clear_tuning();
+        if (!applied) {
+            results_store.drop_cells(stored);
+            std::cerr << "Skipping tuning " << point.label() << " of " << current_algorithm
+                      << ": it could not be applied\n";
+        }
+        return applied;
     }
     
-private:
-    // Setup server socket
-    void setup_server() {
-        server_fd = socket(AF_INET, SOCK_STREAM, 0);
-        if (server_fd < 0) {
-            std::cerr << "Failed to create server socket\n";
-            return;
-        }
+    // Coordinate descent over the tuning dimensions for the current
+    // algorithm: start from every dimension's first value, try the other
+    // values of one dimension with the rest fixed, keep the best and move
+    // on to the next dimension, until a pass finds nothing better. Each
+    // configuration tried becomes a variant in the results and is measured
+    // once. Returns the best configuration.
+    SocketTuning search_tuning(const std::vector<TuningDimension>& dimensions, TuningObjective objective,
+                               int duration_seconds, const std::vector<int>& bandwidths,
+                               const std::vector<int>& latencies) {
+        std::map<std::vector<size_t>, double> scores;
+        auto tuning_of = [&dimensions](const std::vector<size_t>& choice) {
+            SocketTuning point;
+            for (size_t i = 0; i < dimensions.size(); ++i) {
+                set_tuning_value(point, dimensions[i].name, dimensions[i].values[choice[i]]);
+            }
+            return point;
+        };
+        auto score = [&](const std::vector<size_t>& choice) {
+            auto found = scores.find(choice);
+            if (found != scores.end()) {
+                return found->second;
+            }
+            // A configuration that could not be applied never wins
+            SocketTuning point = tuning_of(choice);
+            double value = 0.0;
+            if (run_tuned_cells(point, static_cast<uint32_t>(scores.size()), duration_seconds, bandwidths,
+                                latencies, objective, value)) {
+                std::cout << "Tuning " << point.label() << " of " << current_algorithm << " scores " << value << "\n";
+            } else {
+                value = -std::numeric_limits<double>::infinity();
+            }
+            scores[choice] = value;
+            return value;
+        };
         
-        // Set socket options
-        int opt = 1;
-        if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))) {
-            std::cerr << "Failed to set socket options\n";
-            close(server_fd);
-            server_fd = -1;
-            return;
+        std::vector<size_t> best(dimensions.size(), 0);
+        double best_score = score(best);
+        for (int pass = 0; pass < kTuningSearchPasses; ++pass) {
+            bool improved = false;
+            for (size_t d = 0; d < dimensions.size(); ++d) {
+                std::vector<size_t> candidate = best;
+                for (size_t v = 0; v < dimensions[d].values.size(); ++v) {
+                    candidate[d] = v;
+                    double value = score(candidate);
+                    if (value > best_score) {
+                        best_score = value;
+                        best = candidate;
+                        improved = true;
+                    }
+                }
+            }
+            if (!improved) {
+                break;
+            }
         }
         
-        // Bind to port
-        struct sockaddr_in address;
-        address.sin_family = AF_INET;
-        address.sin_addr.s_addr = INADDR_ANY;
-        address.sin_port = htons(5000);  // Use port 5000 for testing
-        
-        if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
-            std::cerr << "Failed to bind socket\n";
-            close(server_fd);
-            server_fd = -1;
-            return;
+        SocketTuning result = tuning_of(best);
+        if (std::isinf(best_score)) {
+            std::cerr << "No tuning of " << current_algorithm << " could be applied\n";
+            return result;
         }
-        
-        // Listen for connections
-        if (listen(server_fd, 3) < 0) {
-            std::cerr << "Failed to listen\n";
-            close(server_fd);
-            server_fd = -1;
+        std::cout << "Best tuning of " << current_algorithm << " after " << scores.size() << " configurations: "
+                  << result.label() << " ("
+                  << (objective == TuningObjective::Throughput ? "throughput " : "power ") << best_score << ")\n";
+        return result;
+    }
+    
+    // Run one test per algorithm at the same time over the same network
+    // conditions. Every connection selects its own algorithm with
+    // TCP_CONGESTION, so this requires per-socket mode. The flows share the
+    // loopback path and therefore compete for any emulated bottleneck.
+    // Trials repeat the whole group until every algorithm's trials are done,
+    // so each trial has the same set of competitors.
+    void run_concurrent_test(const std::vector<std::string>& algorithms,
+                             int duration_seconds, int bandwidth_limit_mbps, int latency_ms) {
+        if (!per_socket_cc) {
+            std::cerr << "Concurrent tests require per-socket congestion control\n";
             return;
         }
         
-        std::cout << "Server initialized on port 5000\n";
+        std::map<std::string, TrialTracker> trackers;
+        for (uint32_t trial = 0;; ++trial) {
+            if (!run_concurrent_trial(algorithms, duration_seconds, bandwidth_limit_mbps, latency_ms,
+                                      trial, trackers)) {
+                break;
+            }
+            bool done = true;
+            for (const auto& entry : trackers) {
+                done = done && entry.second.done(duration_seconds);
+            }
+            if (done) {
+                break;
+            }
+        }
+        for (const auto& entry : trackers) {
+            report_trials(entry.first, bandwidth_limit_mbps, latency_ms, entry.second, duration_seconds);
+        }
     }
     
-    // Setup client connection
-    void setup_client() {
-        client_fd = socket(AF_INET, SOCK_STREAM, 0);
-        if (client_fd < 0) {
-            std::cerr << "Failed to create client socket\n";
-            return;
+    // One concurrent window; records each flow's trial in trackers.
+    // Returns false when no connection could be opened.
+    bool run_concurrent_trial(const std::vector<std::string>& algorithms, int duration_seconds,
+                              int bandwidth_limit_mbps, int latency_ms, uint32_t trial,
+                              std::map<std::string, TrialTracker>& trackers) {
+        // Setup server if not already done
+        if (server_fd < 0) {
+            setup_server();
         }
         
-        // Connect to server
-        struct sockaddr_in server_addr;
-        server_addr.sin_family = AF_INET;
-        server_addr.sin_port = htons(5000);
+        std::cout << "Running concurrent test (Bandwidth: " << bandwidth_limit_mbps
+                  << " Mbps, Latency: " << latency_ms << " ms";
+        if (trial > 0) {
+            std::cout << ", trial " << trial + 1;
+        }
+        std::cout << ") with";
         
-        // Convert IPv4 address from text to binary
-        if (inet_pton(AF_INET, "127.0.0.1", &server_addr.sin_addr) <= 0) {
-            std::cerr << "Invalid address\n";
-            close(client_fd);
-            client_fd = -1;
-            return;
+        // Open one connection per available algorithm
+        struct Flow {
+            std::string algorithm;
+            int client_fd;
+            int data_fd;
+        };
+        std::vector<Flow> flows;
+        for (const auto& alg : algorithms) {
+            if (!is_algorithm_available(alg)) {
+                continue;
+            }
+            Flow flow = {alg, -1, -1};
+            if (open_connection(server_fd, "127.0.0.1", kTestPort, alg, flow.client_fd, flow.data_fd)) {
+                flows.push_back(flow);
+                std::cout << " " << alg;
+            }
         }
+        std::cout << std::endl;
         
-        if (connect(client_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
-            std::cerr << "Connection failed\n";
-            close(client_fd);
-            client_fd = -1;
-            return;
+        if (flows.empty()) {
+            std::cerr << "No connections could be opened\n";
+            return false;
         }
         
-        std::cout << "Client connected to server\n";
-    }
-    
-    // Apply network conditions (bandwidth and latency)
-    void apply_network_conditions(int bandwidth_mbps, int latency_ms) {
-        // This is a placeholder - in a real implementation, you would use
-        // tc (traffic control) or similar tools to emulate network conditions
+        // Apply network conditions
+        apply_network_conditions(bandwidth_limit_mbps, latency_ms);
         
-        std::cout << "Applied network conditions: " 
+        // Start every data plane before waiting, so all flows share the window
+        std::vector<std::unique_ptr<TransferEngine>> engines;
+        std::vector<int> senders;
+        for (const auto& flow : flows) {
+            engines.push_back(std::make_unique<TransferEngine>(flow.client_fd, flow.data_fd, transfer_config));
+            engines.back()->start();
+            senders.push_back(flow.client_fd);
+        }
+        
+        // One sampler thread polls every sender
+        std::vector<LiveFlowLabels> labels;
+        for (const auto& flow : flows) {
+            labels.push_back({flow.algorithm, bandwidth_limit_mbps, latency_ms});
+        }
+        auto sampler = start_tcp_info_sampler(senders, labels, duration_seconds);
+        std::this_thread::sleep_for(std::chrono::seconds(duration_seconds));
+        if (sampler) {
+            sampler->stop();
+        }
+        
+        for (size_t i = 0; i < flows.size(); i++) {
+            Metrics result = metrics_from_transfer(engines[i]->stop());
+            if (sampler) {
+                take_tcp_info_samples(*sampler, i, result);
+            }
+            result.bandwidth_config = bandwidth_limit_mbps;
+            result.latency_config = latency_ms;
+            store_result(flows[i].algorithm, result, trial);
+            trackers.emplace(flows[i].algorithm, TrialTracker(trial_policy)).first->second
+                .add(result.throughput, p99_rtt_ms(result));
+            
+            std::cout << "  " << flows[i].algorithm << ": Throughput=" << result.throughput
+                      << "Mbps, Latency=" << result.latency << "ms, Retransmits="
+                      << result.packet_loss << std::endl;
+            
+            close(flows[i].client_fd);
+            close(flows[i].data_fd);
+        }
+        clear_network_conditions();
+        return true;
+    }
+    
+    // Start many flows through one emulated bottleneck, each with its own
+    // algorithm, start offset and duration, driven by a few epoll workers.
+    // Every interval the receivers' progress gives per-flow throughput,
+    // Jain's fairness index over the flows active for the whole interval and
+    // bottleneck utilisation; per-flow results and the timeline are appended
+    // to contention_flows.csv and contention_timeline.csv.
+    void run_contention_test(const std::vector<ContentionFlowSpec>& specs, int duration_seconds,
+                             int bandwidth_limit_mbps, int latency_ms) {
+        if (server_fd < 0) {
+            setup_server();
+        }
+        if (!open_contention_files(specs)) {
+            return;
+        }
+        reserve_descriptors(specs.size() * 2);
+        
+        std::cout << "Running contention test (Bandwidth: " << bandwidth_limit_mbps << " Mbps, Latency: "
+                  << latency_ms << " ms) with " << specs.size() << " flows\n";
+        
+        // Connect every flow up front; the run is as long as the latest flow
+        FlowMux mux(transfer_config.message_size, mux_workers);
+        std::vector<size_t> spec_of_flow;
+        std::vector<std::pair<int, int>> sockets;
+        double window = duration_seconds;
+        for (size_t i = 0; i < specs.size(); ++i) {
+            const ContentionFlowSpec& spec = specs[i];
+            int client = -1;
+            int server_side = -1;
+            if (!is_algorithm_available(spec.algorithm) ||
+                !open_connection(server_fd, "127.0.0.1", kTestPort, spec.algorithm, client, server_side)) {
+                std::cerr << "Skipping flow " << i << " (" << spec.algorithm << ")\n";
+                continue;
+            }
+            double length = spec.duration_seconds > 0.0 ? spec.duration_seconds : duration_seconds - spec.start_seconds;
+            if (length <= 0.0) {
+                std::cerr << "Flow " << i << " starts after the run ends, skipping\n";
+                close(client);
+                close(server_side);
+                continue;
+            }
+            mux.add_flow(client, server_side, spec.start_seconds, length);
+            spec_of_flow.push_back(i);
+            sockets.emplace_back(client, server_side);
+            window = std::max(window, spec.start_seconds + length);
+        }
+        if (sockets.empty()) {
+            std::cerr << "No connections could be opened\n";
+            return;
+        }
+        
+        apply_network_conditions(bandwidth_limit_mbps, latency_ms);
+        if (!mux.start()) {
+            clear_network_conditions();
+            for (const auto& pair : sockets) {
+                close(pair.first);
+                close(pair.second);
+            }
+            return;
+        }
+        std::cout << "  " << sockets.size() << " flows on " << mux.workers() << " workers\n";
+        
+        // Sample the receivers' progress on absolute deadlines
+        const bool bottleneck = emulation_mode != EmulationMode::None;
+        const auto interval = std::chrono::milliseconds(kContentionIntervalMs);
+        const double interval_seconds = kContentionIntervalMs / 1000.0;
+        std::vector<uint64_t> previous(mux.flows(), 0);
+        std::vector<bool> was_sending(mux.flows(), false);
+        std::vector<double> algorithm_mbps(contention_algorithms.size());
+        double utilisation_sum = 0.0;
+        int utilisation_samples = 0;
+        auto start = std::chrono::steady_clock::now();
+        auto next = start + interval;
+        for (int tick = 1; tick * interval_seconds <= window + 1e-9; ++tick, next += interval) {
+            std::this_thread::sleep_until(next);
+            
+            double total_mbps = 0.0;
+            double jain_sum = 0.0;
+            double jain_squares = 0.0;
+            int active = 0;
+            std::fill(algorithm_mbps.begin(), algorithm_mbps.end(), 0.0);
+            for (size_t f = 0; f < mux.flows(); ++f) {
+                uint64_t received = mux.bytes_received(f);
+                double mbps = (received - previous[f]) * 8.0 / interval_seconds / 1e6;
+                previous[f] = received;
+                bool sending = mux.sending(f);
+                
+                total_mbps += mbps;
+                algorithm_mbps[contention_column(specs[spec_of_flow[f]].algorithm)] += mbps;
+                if (sending && was_sending[f]) {
+                    jain_sum += mbps;
+                    jain_squares += mbps * mbps;
+                    active++;
+                }
+                was_sending[f] = sending;
+            }
+            
+            contention_timeline_csv << bandwidth_limit_mbps << "," << latency_ms << ","
+                                    << tick * interval_seconds << "," << active << "," << total_mbps << ",";
+            if (bottleneck && bandwidth_limit_mbps > 0) {
+                double utilisation = total_mbps / bandwidth_limit_mbps;
+                contention_timeline_csv << utilisation;
+                utilisation_sum += utilisation;
+                utilisation_samples++;
+            }
+            contention_timeline_csv << ",";
+            if (active > 0 && jain_squares > 0.0) {
+                contention_timeline_csv << jain_sum * jain_sum / (active * jain_squares);
+            }
+            for (double mbps : algorithm_mbps) {
+                contention_timeline_csv << "," << mbps;
+            }
+            contention_timeline_csv << "\n";
+        }
+        mux.stop();
+        clear_network_conditions();
+        
+        // Per-flow results, and fairness over each flow's own active span
+        std::vector<double> flow_mbps;
+        std::vector<double> algorithm_total(contention_algorithms.size(), 0.0);
+        std::vector<int> algorithm_flows(contention_algorithms.size(), 0);
+        for (size_t f = 0; f < mux.flows(); ++f) {
+            const ContentionFlowSpec& spec = specs[spec_of_flow[f]];
+            const MuxFlowStats& stats = mux.stats(f);
+            double mbps = stats.goodput_mbps();
+            flow_mbps.push_back(mbps);
+            size_t column = contention_column(spec.algorithm);
+            algorithm_total[column] += mbps;
+            algorithm_flows[column]++;
+            
+            contention_flows_csv << bandwidth_limit_mbps << "," << latency_ms << "," << spec_of_flow[f] << ","
+                                 << spec.algorithm << "," << stats.started_seconds << ","
+                                 << stats.ended_seconds - stats.started_seconds << "," << stats.bytes_received
+                                 << "," << mbps << "," << stats.rtt_ms << "," << stats.retransmits << "\n";
+            close(sockets[f].first);
+            close(sockets[f].second);
+        }
+        contention_flows_csv.flush();
+        contention_timeline_csv.flush();
+        
+        double sum = 0.0;
+        double squares = 0.0;
+        for (double mbps : flow_mbps) {
+            sum += mbps;
+            squares += mbps * mbps;
+        }
+        std::cout << "  Jain's fairness index " << (squares > 0.0 ? sum * sum / (flow_mbps.size() * squares) : 0.0);
+        if (utilisation_samples > 0) {
+            std::cout << ", mean bottleneck utilisation " << utilisation_sum / utilisation_samples * 100.0 << "%";
+        }
+        std::cout << "\n";
+        for (size_t a = 0; a < contention_algorithms.size(); ++a) {
+            if (algorithm_flows[a] > 0) {
+                std::cout << "  " << contention_algorithms[a] << ": " << algorithm_flows[a] << " flows, "
+                          << algorithm_total[a] / algorithm_flows[a] << " Mbps per flow\n";
+            }
+        }
+    }
+    
+    // Run the current algorithm on one connection through a scenario of
+    // changing link conditions, then report for every change how long
+    // throughput took to settle and how far the queue overshot its new
+    // steady level. Both come from the TCP_INFO samples; results are
+    // appended to scenario_convergence.csv and scenario_timeline.csv.
+    void run_scenario_test(const Scenario& scenario, int duration_seconds) {
+        if (sample_rate_hz <= 0) {
+            std::cerr << "Scenarios need the TCP_INFO sampler (--sample-rate above 0)\n";
+            return;
+        }
+        if (!open_scenario_files()) {
+            return;
+        }
+        double length = scenario.length_seconds(duration_seconds);
+        std::cout << "Running scenario " << scenario.name << " with " << current_algorithm
+                  << " for " << length << " s\n";
+        
+        if (server_fd < 0) {
+            setup_server();
+        }
+        const LinkConditions& initial = scenario.steps.front().conditions;
+        uint16_t port = start_userspace_emulator(static_cast<int>(initial.rate_mbps),
+                                                 static_cast<int>(initial.delay_ms));
+        setup_client(port);
+        if (client_fd < 0 || data_fd < 0) {
+            clear_network_conditions();
+            return;
+        }
+        if (!apply_link_conditions(initial)) {
+            std::cerr << "Scenario " << scenario.name << " not run with " << current_algorithm << "\n";
+            close_client();
+            clear_network_conditions();
+            return;
+        }
+        
+        TransferEngine engine(client_fd, data_fd, transfer_config);
+        if (!engine.start()) {
+            std::cerr << "Failed to start transfer engine\n";
+            close_client();
+            clear_network_conditions();
+            return;
+        }
+        LiveFlowLabels labels = {current_algorithm, static_cast<int>(initial.rate_mbps),
+                                 static_cast<int>(initial.delay_ms)};
+        auto sampler = start_tcp_info_sampler({client_fd}, {labels}, static_cast<int>(std::ceil(length)));
+        auto origin = std::chrono::steady_clock::now();
+        
+        // Verdicts on conditions that never took effect would be made up,
+        // so a step that fails ends the run without results
+        const ScenarioStep* failed = nullptr;
+        for (size_t i = 1; i < scenario.steps.size() && failed == nullptr; ++i) {
+            const ScenarioStep& step = scenario.steps[i];
+            std::this_thread::sleep_until(origin + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(step.at_seconds)));
+            if (apply_link_conditions(step.conditions)) {
+                std::cout << "  " << step.at_seconds << " s: " << step.text << "\n";
+            } else {
+                failed = &step;
+            }
+        }
+        if (failed == nullptr) {
+            std::this_thread::sleep_until(origin + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(length)));
+        }
+        if (sampler) {
+            sampler->stop();
+        }
+        engine.stop();
+        close_client();
+        clear_network_conditions();
+        if (failed != nullptr) {
+            std::cerr << "Scenario " << scenario.name << " with " << current_algorithm << " failed at "
+                      << failed->at_seconds << " s (" << failed->text << "), no results\n";
+            return;
+        }
+        if (!sampler) {
+            return;
+        }
+        
+        TcpInfoSeries series;
+        sampler->export_series(0, series);
+        std::vector<ConvergenceResult> results = analyze_convergence(series, scenario, length);
+        for (size_t i = 0; i < results.size(); ++i) {
+            const ConvergenceResult& result = results[i];
+            std::cout << "  After " << scenario.steps[i].text << ": ";
+            if (result.convergence_seconds >= 0.0) {
+                std::cout << "converged in " << result.convergence_seconds << " s";
+            } else {
+                std::cout << "did not converge";
+            }
+            std::cout << " to " << result.steady_mbps << " Mbps, queue " << result.steady_queue_ms
+                      << " ms steady, " << result.peak_queue_ms << " ms peak (overshoot " << result.overshoot_ms
+                      << " ms, " << result.overshoot_bytes / 1000.0 << " KB)\n";
+            
+            scenario_convergence_csv << current_algorithm << ",\"" << scenario.name << "\"," << result.at_seconds
+                                     << ",\"" << scenario.steps[i].text << "\",";
+            if (result.convergence_seconds >= 0.0) {
+                scenario_convergence_csv << result.convergence_seconds;
+            }
+            scenario_convergence_csv << "," << result.steady_mbps << "," << result.steady_queue_ms << ","
+                                     << result.peak_queue_ms << "," << result.overshoot_ms << ","
+                                     << result.overshoot_bytes << "\n";
+        }
+        
+        std::vector<double> mbps;
+        std::vector<double> rtt_ms;
+        scenario_bins(series, length, mbps, rtt_ms);
+        for (size_t b = 0; b < mbps.size(); ++b) {
+            scenario_timeline_csv << current_algorithm << ",\"" << scenario.name << "\","
+                                  << (b + 1) * kScenarioBinSeconds << "," << mbps[b] << "," << rtt_ms[b] << "\n";
+        }
+    }
+    
+    // Open short connections at the churn rate for one cell, each sending a
+    // flow drawn from the size distribution with the given algorithm, and
+    // report flow completion times per size bucket, connection setup cost
+    // and TIME_WAIT pressure. Results are appended to churn_summary.csv and
+    // churn_fct.csv.
+    void run_churn_test(const std::string& algorithm, int duration_seconds,
+                        int bandwidth_limit_mbps, int latency_ms) {
+        if (!open_churn_files()) {
+            return;
+        }
+        std::cout << "Running churn test with " << algorithm << " (Bandwidth: " << bandwidth_limit_mbps
+                  << " Mbps, Latency: " << latency_ms << " ms): " << churn_config.rate
+                  << " connections/s, " << churn_sizes.name() << " flow sizes (mean "
+                  << churn_sizes.mean() / 1000.0 << " KB)\n";
+        
+        ChurnConfig config = churn_config;
+        config.algorithm = algorithm;
+        FlowChurn churn(config, churn_sizes);
+        ChurnStats stats;
+        apply_network_conditions(bandwidth_limit_mbps, latency_ms);
+        bool ok = churn.run(duration_seconds, stats);
+        clear_network_conditions();
+        if (!ok) {
+            return;
+        }
+        
+        double connect_p50 = stats.connect_us.quantile(0.50) / 1000.0;
+        double connect_p99 = stats.connect_us.quantile(0.99) / 1000.0;
+        std::cout << "  " << stats.completed << " of " << stats.arrivals << " flows completed ("
+                  << stats.completed / stats.elapsed_seconds << "/s), " << stats.failed << " failed, "
+                  << stats.dropped << " dropped at the concurrency cap, " << stats.unfinished << " unfinished\n"
+                  << "  Setup: " << stats.setup_cpu_us << " us per connection in the generator, connect p50/p99 "
+                  << connect_p50 << "/" << connect_p99 << " ms; TIME_WAIT peak " << stats.peak_time_wait;
+        if (stats.ephemeral_ports > 0) {
+            std::cout << " (" << 100.0 * stats.peak_time_wait / stats.ephemeral_ports << "% of "
+                      << stats.ephemeral_ports << " ephemeral ports)";
+        }
+        if (stats.port_exhausted > 0) {
+            std::cout << ", " << stats.port_exhausted << " connects out of ports";
+        }
+        std::cout << "\n";
+        
+        churn_summary_csv << algorithm << "," << bandwidth_limit_mbps << "," << latency_ms << ","
+                          << churn_config.rate << "," << stats.arrivals << "," << stats.completed << ","
+                          << stats.failed << "," << stats.dropped << "," << stats.unfinished << ","
+                          << stats.port_exhausted << "," << connect_p50 << "," << connect_p99 << ","
+                          << stats.setup_cpu_us << "," << stats.peak_time_wait << "," << stats.ephemeral_ports << "\n";
+        for (size_t bucket = 0; bucket < kChurnBuckets; ++bucket) {
+            const LatencySketch& fct = stats.fct_us[bucket];
+            if (fct.empty()) {
+                continue;
+            }
+            std::cout << "  FCT " << churn_bucket_name(bucket) << " (" << fct.count()
+                      << " flows) p50/p99/p99.9/max: " << format_percentiles(fct) << " ms\n";
+            churn_fct_csv << algorithm << "," << bandwidth_limit_mbps << "," << latency_ms << ","
+                          << churn_bucket_name(bucket) << "," << fct.count() << "," << fct.mean() / 1000.0 << ","
+                          << fct.quantile(0.50) / 1000.0 << "," << fct.quantile(0.90) / 1000.0 << ","
+                          << fct.quantile(0.99) / 1000.0 << "," << fct.quantile(0.999) / 1000.0 << ","
+                          << fct.max() / 1000.0 << "\n";
+        }
+    }
+    
+    // Run one cell on its own sender/receiver network namespaces joined by a
+    // veth pair, with the sender and receiver threads pinned to the given
+    // cores. Safe to call from several scheduler workers at once. Every
+    // trial of the cell gets a fresh path.
+    void run_isolated_test(const SweepCell& cell, int duration_seconds, const CpuPair& cpus) {
+        TrialTracker tracker(trial_policy);
+        Metrics result;
+        do {
+            if (!run_isolated_trial(cell, duration_seconds, cpus, static_cast<uint32_t>(tracker.trials()), result)) {
+                break;
+            }
+            tracker.add(result.throughput, p99_rtt_ms(result));
+        } while (!tracker.done(duration_seconds));
+        
+        std::lock_guard<std::mutex> lock(results_mutex);
+        report_trials(cell.algorithm, cell.bandwidth_mbps, cell.latency_ms, tracker, duration_seconds);
+        finish_cell();
+    }
+    
+    // One trial of an isolated cell; false when the path could not be set up
+    bool run_isolated_trial(const SweepCell& cell, int duration_seconds, const CpuPair& cpus, uint32_t trial,
+                            Metrics& result) {
+        IsolatedPath path;
+        if (!path.create()) {
+            std::cerr << "Skipping " << cell.algorithm << " " << cell.bandwidth_mbps << "Mbps/"
+                      << cell.latency_ms << "ms: could not create isolated path\n";
+            return false;
+        }
+        
+        in_addr_t receiver_address = inet_addr(IsolatedPath::kReceiverAddress);
+        int listen_fd = -1;
+        {
+            ScopedNetns in_receiver(path.receiver_netns());
+            if (in_receiver.ok()) {
+                listen_fd = create_listener(receiver_address);
+            }
+        }
+        if (listen_fd < 0) {
+            return false;
+        }
+        
+        // The algorithm is always set per socket: other cells run other algorithms
+        int client = -1;
+        int server_side = -1;
+        bool connected = false;
+        std::unique_ptr<RpcProbe> probe;
+        {
+            ScopedNetns in_sender(path.sender_netns());
+            connected = in_sender.ok() &&
+                        open_connection(listen_fd, IsolatedPath::kReceiverAddress, kTestPort,
+                                        cell.algorithm, client, server_side);
+            if (connected) {
+                probe = start_rpc_probe(listen_fd, IsolatedPath::kReceiverAddress, cell.algorithm);
+            }
+        }
+        close(listen_fd);
+        if (!connected) {
+            return false;
+        }
+        
+        // Emulate the link on the sender's veth egress. Only data crosses it,
+        // ACKs return through the receiver's end, so it carries the full RTT.
+        // The emulator lives in the sender namespace, which dies with the cell.
+        std::unique_ptr<QdiscEmulator> cell_emulator;
+        if (emulation_mode == EmulationMode::Qdisc) {
+            ScopedNetns in_sender(path.sender_netns());
+            cell_emulator = std::make_unique<QdiscEmulator>(IsolatedPath::kSenderInterface);
+            if (!in_sender.ok() ||
+                !cell_emulator->apply(cell_conditions(cell.bandwidth_mbps, cell.latency_ms, false))) {
+                std::cerr << "Running " << cell.algorithm << " without link emulation\n";
+            }
+        }
+        
+        TransferConfig config = transfer_config;
+        config.sender_cpu = cpus.sender_cpu;
+        config.receiver_cpu = cpus.receiver_cpu;
+        
+        TransferEngine engine(client, server_side, config);
+        result = Metrics();
+        if (engine.start()) {
+            auto sampler = start_tcp_info_sampler({client}, {{cell.algorithm, cell.bandwidth_mbps, cell.latency_ms}},
+                                                  duration_seconds);
+            std::this_thread::sleep_for(std::chrono::seconds(duration_seconds));
+            if (sampler) {
+                sampler->stop();
+            }
+            RpcProbeStats probe_stats = stop_rpc_probe(probe);
+            result = metrics_from_transfer(engine.stop());
+            result.rpc_rtt_us = probe_stats.rtt_us;
+            result.rpc_owd_us = probe_stats.owd_us;
+            if (sampler) {
+                take_tcp_info_samples(*sampler, 0, result);
+            }
+        } else {
+            stop_rpc_probe(probe);
+        }
+        close(client);
+        close(server_side);
+        
+        result.bandwidth_config = cell.bandwidth_mbps;
+        result.latency_config = cell.latency_ms;
+        
+        std::lock_guard<std::mutex> lock(results_mutex);
+        store_result(cell.algorithm, result, trial);
+        std::cout << "Finished " << cell.algorithm << " (Bandwidth: " << cell.bandwidth_mbps
+                  << " Mbps, Latency: " << cell.latency_ms << " ms";
+        if (trial > 0) {
+            std::cout << ", trial " << trial + 1;
+        }
+        std::cout << ") on CPUs " << cpus.sender_cpu << "/" << cpus.receiver_cpu
+                  << ": Throughput=" << result.throughput << "Mbps, Latency="
+                  << result.latency << "ms" << std::endl;
+        return true;
+    }
+    
+    // Run every (algorithm, bandwidth, latency) cell through the parallel
+    // scheduler, each on an isolated path
+    void run_parallel_sweep(const std::vector<SweepCell>& cells, int duration_seconds, int max_jobs) {
+        SweepScheduler scheduler(max_jobs);
+        std::cout << "Running " << cells.size() << " cells on " << scheduler.jobs()
+                  << " parallel workers\n";
+        
+        scheduler.run(cells, [&](const SweepCell& cell, const CpuPair& cpus) {
+            run_isolated_test(cell, duration_seconds, cpus);
+        });
+    }
+    
+    // Run a comprehensive test suite
+    void run_test_suite() {
+        std::vector<int> bandwidths = {10, 50, 100}; // Mbps
+        std::vector<int> latencies = {5, 20, 100};   // ms
+        
+        for (const auto& alg : available_algorithms) {
+            if (set_congestion_algorithm(alg)) {
+                std::cout << "\n=== Testing " << alg << " ===\n";
+                
+                for (int bw : bandwidths) {
+                    for (int lat : latencies) {
+                        auto metrics = run_test(30, bw, lat);  // 30 seconds duration
+                        
+                        // Display results
+                        std::cout << "Results: " 
+                                  << "BW=" << bw << "Mbps, "
+                                  << "Lat=" << lat << "ms -> "
+                                  << "Throughput=" << metrics.throughput << "Mbps, "
+                                  << "Latency=" << metrics.latency << "ms, "
+                                  << "PacketLoss=" << metrics.packet_loss << ", "
+                                  << "Jitter=" << metrics.jitter << "ms\n";
+                    }
+                }
+            }
+        }
+    }
+    
+    // Finish the results store and export the CSV files from it
+    void save_results() {
+        bool other_results = contention_timeline_csv.is_open() || churn_summary_csv.is_open() ||
+                             scenario_convergence_csv.is_open();
+        if (scenario_convergence_csv.is_open()) {
+            scenario_convergence_csv.close();
+            scenario_timeline_csv.close();
+            std::cout << "Scenario results saved to scenario_convergence.csv and scenario_timeline.csv\n";
+        }
+        if (contention_timeline_csv.is_open()) {
+            contention_flows_csv.close();
+            contention_timeline_csv.close();
+            std::cout << "Contention results saved to contention_flows.csv and contention_timeline.csv\n";
+        }
+        if (churn_summary_csv.is_open()) {
+            churn_summary_csv.close();
+            churn_fct_csv.close();
+            std::cout << "Churn results saved to churn_summary.csv and churn_fct.csv\n";
+        }
+        if (!results_store.is_open()) {
+            if (!other_results) {
+                std::cerr << "No results to save\n";
+            }
+            return;
+        }
+        size_t cells = results_store.cells();
+        if (!results_store.close()) {
+            return;
+        }
+        std::cout << "Results of " << cells << " cells saved to " << results_path << std::endl;
+        
+        ResultsStoreReader reader;
+        if (reader.open(results_path)) {
+            export_results_csv(reader, "");
+            if (series_options.points > 0) {
+                export_series_gnuplot(reader, series_options);
+            }
+        }
+        if (series_options.points > 0 && !ebpf_event_traces.empty()) {
+            export_collector_series(ebpf_event_traces, series_options);
+        }
+    }
+    
+    // Display available algorithms
+    void show_available_algorithms() {
+        std::cout << "Available congestion control algorithms:\n";
+        std::cout << "AVAILABLE TCP CONGESTION CONTROL POLICIES:\n";
+        for (const auto& alg : available_algorithms) {
+            std::cout << "- " << alg << std::endl;
+        }
+    }
+    
+private:
+    // Setup server socket
+    void setup_server() {
+        server_fd = create_listener(INADDR_ANY);
+        if (server_fd >= 0) {
+            std::cout << "Server initialized on port " << kTestPort << "\n";
+        }
+    }
+    
+    // Create a listening socket on the test port in the calling thread's
+    // network namespace; returns -1 on failure
+    int create_listener(in_addr_t bind_address) {
+        int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (listen_fd < 0) {
+            std::cerr << "Failed to create server socket\n";
+            return -1;
+        }
+        
+        // Set socket options
+        int opt = 1;
+        if (setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))) {
+            std::cerr << "Failed to set socket options\n";
+            close(listen_fd);
+            return -1;
+        }
+        
+        // Bind to port
+        struct sockaddr_in address;
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = bind_address;
+        address.sin_port = htons(kTestPort);
+        
+        if (bind(listen_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+            std::cerr << "Failed to bind socket\n";
+            close(listen_fd);
+            return -1;
+        }
+        
+        // Listen for connections
+        if (listen(listen_fd, 3) < 0) {
+            std::cerr << "Failed to listen\n";
+            close(listen_fd);
+            return -1;
+        }
+        
+        return listen_fd;
+    }
+    
+    // Setup client connection to the test listener or the relay in front of it
+    void setup_client(uint16_t port) {
+        close_client();
+        
+        // The receive buffer decides the window scale offered in the
+        // handshake, so it goes on the listener accepted sockets inherit
+        bool applied = apply_receiver_tuning(server_fd, tuning);
+        
+        if (open_connection(server_fd, "127.0.0.1", port, per_socket_cc ? current_algorithm : std::string(),
+                            client_fd, data_fd)) {
+            std::cout << "Client connected to server\n";
+            applied = apply_sender_tuning(client_fd, tuning) && applied;
+        }
+        tuning_failed = tuning_failed || !applied;
+    }
+    
+    // Connect a new client to address:port and accept its server side on
+    // listen_fd. A non-empty algorithm is applied to the client with
+    // TCP_CONGESTION.
+    bool open_connection(int listen_fd, const char* address, uint16_t port,
+                         const std::string& algorithm, int& client, int& server_side) {
+        client = socket(AF_INET, SOCK_STREAM, 0);
+        server_side = -1;
+        if (client < 0) {
+            std::cerr << "Failed to create client socket\n";
+            return false;
+        }
+        
+        // Select the sender's algorithm before the handshake
+        if (!algorithm.empty() && !set_socket_congestion(client, algorithm)) {
+            close(client);
+            client = -1;
+            return false;
+        }
+        
+        // Connect to server
+        struct sockaddr_in server_addr;
+        server_addr.sin_family = AF_INET;
+        server_addr.sin_port = htons(port);
+        
+        // Convert IPv4 address from text to binary
+        if (inet_pton(AF_INET, address, &server_addr.sin_addr) <= 0) {
+            std::cerr << "Invalid address\n";
+            close(client);
+            client = -1;
+            return false;
+        }
+        
+        if (connect(client, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+            std::cerr << "Connection failed\n";
+            close(client);
+            client = -1;
+            return false;
+        }
+        
+        // Pick up the server side of the connection for the receiver
+        if (listen_fd >= 0) {
+            server_side = accept(listen_fd, nullptr, nullptr);
+            if (server_side < 0) {
+                std::cerr << "Failed to accept client connection\n";
+                close(client);
+                client = -1;
+                return false;
+            }
+        }
+        
+        // Confirm the algorithm survived the handshake
+        if (!algorithm.empty() && get_socket_congestion(client) != algorithm) {
+            std::cerr << "Connection is not using " << algorithm << std::endl;
+            close(client);
+            close(server_side);
+            client = -1;
+            server_side = -1;
+            return false;
+        }
+        
+        return true;
+    }
+    
+    // Create the contention CSV files on first use; the timeline has a
+    // throughput column per algorithm of the flow specification
+    bool open_contention_files(const std::vector<ContentionFlowSpec>& specs) {
+        if (contention_timeline_csv.is_open()) {
+            return true;
+        }
+        contention_flows_csv.open("contention_flows.csv");
+        contention_timeline_csv.open("contention_timeline.csv");
+        if (!contention_flows_csv || !contention_timeline_csv) {
+            std::cerr << "Failed to create contention CSV files\n";
+            return false;
+        }
+        
+        for (const auto& spec : specs) {
+            if (std::find(contention_algorithms.begin(), contention_algorithms.end(), spec.algorithm) ==
+                contention_algorithms.end()) {
+                contention_algorithms.push_back(spec.algorithm);
+            }
+        }
+        contention_flows_csv << "BandwidthConfig,LatencyConfig,Flow,Algorithm,Start,Duration,Bytes,"
+                             << "Throughput,Latency,Retransmits\n";
+        contention_timeline_csv << "BandwidthConfig,LatencyConfig,Time,ActiveFlows,Throughput,Utilisation,JainIndex";
+        for (const auto& alg : contention_algorithms) {
+            contention_timeline_csv << "," << alg;
+        }
+        contention_timeline_csv << "\n";
+        return true;
+    }
+    
+    // Create the scenario CSV files on first use
+    bool open_scenario_files() {
+        if (scenario_convergence_csv.is_open()) {
+            return true;
+        }
+        scenario_convergence_csv.open("scenario_convergence.csv");
+        scenario_timeline_csv.open("scenario_timeline.csv");
+        if (!scenario_convergence_csv || !scenario_timeline_csv) {
+            std::cerr << "Failed to create scenario CSV files\n";
+            return false;
+        }
+        scenario_convergence_csv << "Algorithm,Scenario,Time,Step,ConvergenceTime,SteadyThroughput,SteadyQueue,"
+                                 << "PeakQueue,Overshoot,OvershootBytes\n";
+        scenario_timeline_csv << "Algorithm,Scenario,Time,Throughput,Rtt\n";
+        return true;
+    }
+    
+    // Create the churn CSV files on first use
+    bool open_churn_files() {
+        if (churn_summary_csv.is_open()) {
+            return true;
+        }
+        churn_summary_csv.open("churn_summary.csv");
+        churn_fct_csv.open("churn_fct.csv");
+        if (!churn_summary_csv || !churn_fct_csv) {
+            std::cerr << "Failed to create churn CSV files\n";
+            return false;
+        }
+        churn_summary_csv << "Algorithm,BandwidthConfig,LatencyConfig,Rate,Arrivals,Completed,Failed,Dropped,"
+                          << "Unfinished,PortExhausted,ConnectP50,ConnectP99,SetupCpu,PeakTimeWait,EphemeralPorts\n";
+        churn_fct_csv << "Algorithm,BandwidthConfig,LatencyConfig,SizeBucket,Flows,FctMean,FctP50,FctP90,"
+                      << "FctP99,FctP999,FctMax\n";
+        return true;
+    }
+    
+    size_t contention_column(const std::string& algorithm) const {
+        return static_cast<size_t>(std::find(contention_algorithms.begin(), contention_algorithms.end(), algorithm) -
+                                   contention_algorithms.begin());
+    }
+    
+    // Close both ends of the test connection
+    void close_client() {
+        if (client_fd >= 0) {
+            close(client_fd);
+            client_fd = -1;
+        }
+        if (data_fd >= 0) {
+            close(data_fd);
+            data_fd = -1;
+        }
+    }
+    
+    // Conditions for one cell. latency_ms is the intended RTT; when the
+    // emulated interface carries both directions it gets half on each pass.
+    LinkConditions cell_conditions(int bandwidth_mbps, int latency_ms, bool both_directions) const {
+        LinkConditions conditions = impairments;
+        conditions.rate_mbps = bandwidth_mbps;
+        conditions.delay_ms = both_directions ? latency_ms / 2.0 : latency_ms;
+        return conditions;
+    }
+    
+    // Start the userspace relay for one cell when it is the selected
+    // emulator. Returns the port the client must connect to.
+    uint16_t start_userspace_emulator(int bandwidth_mbps, int latency_ms) {
+        if (emulation_mode != EmulationMode::Userspace) {
+            return kTestPort;
+        }
+        
+        UserspaceEmulatorConfig config;
+        config.rate_mbps = bandwidth_mbps;
+        config.delay_ms = latency_ms;
+        config.trace_file = delivery_trace;
+        config.target_port = kTestPort;
+        
+        userspace_emulator = std::make_unique<UserspaceLinkEmulator>(config);
+        if (!userspace_emulator->start()) {
+            std::cerr << "Could not start the userspace emulator, measuring the raw path\n";
+            userspace_emulator.reset();
+            return kTestPort;
+        }
+        
+        std::cout << "Relaying through userspace emulator on port " << userspace_emulator->port() << ": "
+                  << (delivery_trace.empty() ? std::to_string(bandwidth_mbps) + " Mbps"
+                                             : "trace " + delivery_trace)
+                  << ", " << latency_ms << " ms latency\n";
+        return userspace_emulator->port();
+    }
+    
+    // Apply network conditions (bandwidth and latency)
+    void apply_network_conditions(int bandwidth_mbps, int latency_ms) {
+        if (emulation_mode == EmulationMode::Userspace) {
+            return;  // Applied by the relay started before the connection
+        }
+        if (!qdisc_emulator && (emulation_mode == EmulationMode::Qdisc || !tuning.qdisc.empty())) {
+            qdisc_emulator = std::make_unique<QdiscEmulator>(test_interface);
+        }
+        if (emulation_mode == EmulationMode::None) {
+            std::cout << "Link emulation disabled, not applying "
+                      << bandwidth_mbps << " Mbps, " << latency_ms << " ms latency\n";
+            
+            // A tuned queue still replaces the interface's root qdisc
+            LinkConditions queue_only;
+            queue_only.queue = tuning.qdisc;
+            if (!tuning.qdisc.empty() && !qdisc_emulator->apply(queue_only)) {
+                std::cerr << "Could not install qdisc " << tuning.qdisc << " on " << test_interface << std::endl;
+                tuning_failed = true;
+            }
+            return;
+        }
+        
+        // Loopback carries data and ACKs, so the delay is split across both
+        bool both_directions = (test_interface == "lo");
+        LinkConditions conditions = cell_conditions(bandwidth_mbps, latency_ms, both_directions);
+        conditions.queue = tuning.qdisc;
+        if (!qdisc_emulator->apply(conditions)) {
+            std::cerr << "Could not emulate " << bandwidth_mbps << " Mbps, " << latency_ms
+                      << " ms on " << test_interface << ", measuring the raw path\n";
+            tuning_failed = tuning_failed || !tuning.qdisc.empty();
+            return;
+        }
+        
+        std::cout << "Applied network conditions on " << test_interface << ": "
                   << bandwidth_mbps << " Mbps, " 
                   << latency_ms << " ms latency\n";
     }
     
-    // Measure performance metrics
-    Metrics measure_performance(int duration_seconds) {
-        Metrics result;
+    // Apply one scenario step on the test interface; delay_ms is the RTT.
+    // Only the qdisc emulator changes mid-run: the userspace relay keeps
+    // the conditions it was started with. False when the step is not in
+    // effect.
+    bool apply_link_conditions(const LinkConditions& conditions) {
+        if (emulation_mode != EmulationMode::Qdisc) {
+            return emulation_mode == EmulationMode::Userspace;
+        }
+        if (!qdisc_emulator) {
+            qdisc_emulator = std::make_unique<QdiscEmulator>(test_interface);
+        }
+        LinkConditions applied = conditions;
+        if (test_interface == "lo") {
+            applied.delay_ms /= 2.0;
+        }
+        if (!qdisc_emulator->apply(applied)) {
+            std::cerr << "Could not apply scenario conditions on " << test_interface << std::endl;
+            return false;
+        }
+        return true;
+    }
+    
+    // Put the test interface's original qdisc back, or stop the relay
+    void clear_network_conditions() {
+        if (qdisc_emulator) {
+            qdisc_emulator->restore();
+        }
+        if (userspace_emulator) {
+            userspace_emulator->stop();
+            std::cout << "Userspace emulator forwarded " << userspace_emulator->bytes_forwarded()
+                      << " bytes, peak queue " << userspace_emulator->max_queue_bytes() / 1024 << " KiB\n";
+            userspace_emulator.reset();
+        }
+    }
+    
+    // Per-flow metrics as seen by the data plane
+    Metrics metrics_from_transfer(const TransferStats& stats) {
+        Metrics result = {};
+        result.throughput = stats.throughput_mbps;
+        result.goodput = stats.goodput_mbps;
+        result.latency = stats.rtt_ms;
+        result.packet_loss = static_cast<int>(stats.retransmits);
+        result.jitter = stats.rttvar_ms;
+        result.owd_us = stats.owd_us;
+        result.inline_rtt_us = stats.inline_rtt_us;
+        result.inline_owd_us = stats.inline_owd_us;
+        return result;
+    }
+    
+    // Connect the request/response probe through listen_fd and start it;
+    // returns null when the probe is off or could not start. The userspace
+    // relay forwards a single connection, so there the probe is left out.
+    std::unique_ptr<RpcProbe> start_rpc_probe(int listen_fd, const char* address, const std::string& algorithm) {
+        if (rpc_config.rate_hz <= 0 || userspace_emulator) {
+            return nullptr;
+        }
+        int client = -1;
+        int server_side = -1;
+        if (!open_connection(listen_fd, address, kTestPort, algorithm, client, server_side)) {
+            std::cerr << "Could not connect the request/response probe\n";
+            return nullptr;
+        }
+        auto probe = std::make_unique<RpcProbe>(client, server_side, rpc_config);
+        if (!probe->start()) {
+            close(client);
+            close(server_side);
+            return nullptr;
+        }
+        return probe;
+    }
+    
+    // Stop a probe started by start_rpc_probe and close its connection;
+    // empty stats without a probe
+    static RpcProbeStats stop_rpc_probe(std::unique_ptr<RpcProbe>& probe) {
+        if (!probe) {
+            return RpcProbeStats();
+        }
+        RpcProbeStats stats = probe->stop();
+        close(probe->client_fd());
+        close(probe->server_fd());
+        probe.reset();
+        return stats;
+    }
+    
+    // Poll TCP_INFO on the sender sockets for one measurement window;
+    // returns null when sampling is off or could not start. With an
+    // exporter each sender is also shown as a live flow under its labels.
+    std::unique_ptr<TcpInfoSampler> start_tcp_info_sampler(const std::vector<int>& senders,
+                                                           const std::vector<LiveFlowLabels>& labels,
+                                                           int duration_seconds) {
+        if (sample_rate_hz <= 0) {
+            return nullptr;
+        }
         
-#if USE_EBPF_METRICS
-        // Start eBPF collector in the background if we have BCC support
-        std::string command = "python3 ./src/tcp_ebpf_collector.py";
-        command += " --algorithm=" + current_algorithm;
-        command += " --duration=" + std::to_string(duration_seconds);
-        command += " --output=metrics_" + current_algorithm + ".csv";
-        
-        std::cout << "Starting eBPF collector for " << duration_seconds << " seconds...\n";
-        int ret = system(command.c_str());
-#else
-        // Skip eBPF collection if we don't have BCC support
-        std::cout << "eBPF metrics collection not available (BCC not found at build time)\n";
-        int ret = -1;
-#endif
-        if (ret != 0) {
-            std::cerr << "Error running eBPF collector (error code: " << ret << ")\n";
-            std::cerr << "If BCC tools aren't installed, run: sudo apt-get install bpfcc-tools python3-bpfcc\n";
-            
-            // Fallback to dummy values if eBPF collector fails
-            result.throughput = 85.7;  // e.g., 85.7 Mbps
-            result.latency = 15.2;     // e.g., 15.2 ms
-            result.packet_loss = 2;    // e.g., 2 packets lost
-            result.jitter = 3.5;       // e.g., 3.5 ms jitter
+        auto sampler = std::make_unique<TcpInfoSampler>(sample_rate_hz);
+        size_t capacity = TcpInfoSampler::capacity_for(sample_rate_hz, duration_seconds);
+        for (size_t i = 0; i < senders.size(); ++i) {
+            LiveFlow* live = metrics_exporter ? metrics_exporter->claim_flow(labels[i]) : nullptr;
+            sampler->add_socket(senders[i], capacity, live);
+        }
+        if (!sampler->start()) {
+            return nullptr;
+        }
+        return sampler;
+    }
+    
+    // Take the CPU cost of a window into a result and print it; cycles and
+    // instructions are per byte read by the receiver
+    static void report_cpu_cost(const CpuCost& cpu, uint64_t bytes, Metrics& result) {
+        result.cpu = cpu;
+        if (!cpu.measured) {
+            return;
+        }
+        std::cout << "CPU: ";
+        if (cpu.counted && bytes > 0) {
+            result.cycles_per_byte = static_cast<double>(cpu.cycles) / bytes;
+            result.instructions_per_byte = static_cast<double>(cpu.instructions) / bytes;
+            std::cout << result.cycles_per_byte << " cycles/byte, " << result.instructions_per_byte
+                      << " instructions/byte (" << (cpu.system_wide ? "all CPUs" : "tester threads") << "), ";
         } else {
-            // Read results from the generated CSV
-            std::string metrics_file = "metrics_" + current_algorithm + ".csv";
-            std::ifstream file(metrics_file);
-            
-            if (file.is_open()) {
-                // Skip header
-                std::string line;
-                std::getline(file, line);
-                
-                // Initialize aggregation variables
-                double total_throughput = 0.0;
-                double total_latency = 0.0;
-                int total_packet_loss = 0;
-                double total_jitter = 0.0;
-                int count = 0;
-                
-                // Process each line
-                while (std::getline(file, line)) {
-                    // Parse CSV line (simplified example - a real implementation would use a proper CSV parser)
-                    std::stringstream ss(line);
-                    std::vector<std::string> values;
-                    std::string token;
-                    
-                    while (std::getline(ss, token, ',')) {
-                        values.push_back(token);
-                    }
-                    
-                    // Extract values from the parsed CSV
-                    // This depends on the exact format of tcp_ebpf_collector.py output
-                    // Assuming columns: throughput_kbps, rtt_ms, lost_packets, rttvar_ms
-                    if (values.size() >= 20) {
-                        // Indices will need to be adjusted based on the actual CSV format
-                        // These are placeholders
-                        int throughput_idx = 17;
-                        int latency_idx = 12; 
-                        int packet_loss_idx = 15;
-                        int jitter_idx = 13;
-                        
-                        try {
-                            total_throughput += std::stod(values[throughput_idx]) / 1000.0; // Convert to Mbps
-                            total_latency += std::stod(values[latency_idx]);
-                            total_packet_loss += std::stoi(values[packet_loss_idx]);
-                            total_jitter += std::stod(values[jitter_idx]);
-                            count++;
-                        } catch (const std::exception& e) {
-                            // Handle conversion errors
-                            std::cerr << "Error parsing metrics: " << e.what() << std::endl;
-                        }
-                    }
+            result.cpu.counted = false;
+            std::cout << "cycles not counted, ";
+        }
+        std::cout << cpu.cpu_percent << "% busy, " << cpu.softirq_percent << "% softirq, "
+                  << cpu.context_switches << " context switches\n";
+    }
+    
+    // "p50/p99/p99.9/max" of a microsecond sketch in ms, "-" when empty
+    static std::string format_percentiles(const LatencySketch& sketch) {
+        if (sketch.empty()) {
+            return "-";
+        }
+        std::ostringstream text;
+        text << sketch.quantile(0.50) / 1000.0 << "/" << sketch.quantile(0.99) / 1000.0 << "/"
+             << sketch.quantile(0.999) / 1000.0 << "/" << sketch.max() / 1000.0;
+        return text.str();
+    }
+    
+    // Take one sender's TCP_INFO samples into a result. The warm-up at the
+    // start of the window is found from the samples and left out: latency
+    // and jitter become the means of the remaining samples instead of the
+    // snapshot taken when the transfer stopped, their RTTs fill the sketch,
+    // and throughput is what was acknowledged after the warm-up.
+    void take_tcp_info_samples(const TcpInfoSampler& sampler, size_t socket, Metrics& result) {
+        sampler.export_series(socket, result.series);
+        const TcpInfoSeries& series = result.series;
+        size_t rows = series.rows();
+        if (rows == 0) {
+            return;
+        }
+        
+        size_t first = warmup_end(series);
+        double rtt_sum = 0.0;
+        double rttvar_sum = 0.0;
+        for (size_t i = first; i < rows; ++i) {
+            rtt_sum += series.rtt_us[i];
+            rttvar_sum += series.rttvar_us[i];
+            result.rtt_us.record(series.rtt_us[i]);
+        }
+        result.latency = rtt_sum / (rows - first) / 1000.0;
+        result.jitter = rttvar_sum / (rows - first) / 1000.0;
+        
+        double steady_seconds = (series.t_ns[rows - 1] - series.t_ns[first]) / 1e9;
+        if (first > 0 && steady_seconds > 0.0) {
+            result.warmup_seconds = (series.t_ns[first] - series.t_ns[0]) / 1e9;
+            result.throughput = (series.bytes_acked[rows - 1] - series.bytes_acked[first]) * 8.0 /
+                                steady_seconds / 1e6;
+        }
+    }
+    
+    // Application-level request latency of both probes, if any ran
+    static void report_requests(const Metrics& result) {
+        if (!result.rpc_rtt_us.empty()) {
+            std::cout << "Requests on own connection p50/p99/p99.9/max: RTT " << format_percentiles(result.rpc_rtt_us)
+                      << " ms, one-way " << format_percentiles(result.rpc_owd_us) << " ms ("
+                      << result.rpc_rtt_us.count() << " requests)\n";
+        }
+        if (!result.inline_rtt_us.empty()) {
+            std::cout << "Requests behind bulk data p50/p99/p99.9/max: RTT " << format_percentiles(result.inline_rtt_us)
+                      << " ms, one-way " << format_percentiles(result.inline_owd_us) << " ms ("
+                      << result.inline_rtt_us.count() << " requests)\n";
+        }
+    }
+    
+    // p99 of a result's RTT sketch in ms, -1 without RTT samples
+    static double p99_rtt_ms(const Metrics& result) {
+        return result.rtt_us.empty() ? -1.0 : result.rtt_us.quantile(0.99) / 1000.0;
+    }
+    
+    // Summarise a repeated cell; silent when only one trial was asked for
+    void report_trials(const std::string& algorithm, int bandwidth_mbps, int latency_ms,
+                       const TrialTracker& tracker, int duration_seconds) const {
+        if (trial_policy.max_trials <= 1) {
+            return;
+        }
+        ConfidenceInterval throughput = tracker.throughput();
+        ConfidenceInterval p99 = tracker.p99_rtt();
+        std::cout << algorithm << " (Bandwidth: " << bandwidth_mbps << " Mbps, Latency: " << latency_ms
+                  << " ms): " << tracker.trials() << " trials (" << tracker.stop_reason(duration_seconds)
+                  << "), throughput " << throughput.mean << " +/- " << throughput.half_width << " Mbps";
+        if (p99.n > 0) {
+            std::cout << ", p99 RTT " << p99.mean << " +/- " << p99.half_width << " ms";
+        }
+        std::cout << " (95% CI)\n";
+    }
+    
+    // Load the eBPF collector once; later calls reuse it or report failure
+    bool open_ebpf_collector() {
+        if (ebpf_collector) {
+            return true;
+        }
+        if (ebpf_failed) {
+            return false;
+        }
+        
+        ebpf_failed = true;
+        if (!EbpfCollector::available()) {
+            std::cout << "eBPF metrics collection not available (built without ENABLE_EBPF_METRICS)\n";
+            return false;
+        }
+        
+        auto collector = std::make_unique<EbpfCollector>();
+        collector->set_event_sampling(ebpf_event_sampling);
+        if (!collector->open()) {
+            std::cerr << "eBPF collector could not be loaded, using TCP_INFO only\n";
+            return false;
+        }
+        
+        ebpf_collector = std::move(collector);
+        ebpf_failed = false;
+        return true;
+    }
+    
+    // Trace of a cell's per-packet eBPF events, named like its series file;
+    // empty when events are off or the directory cannot be created
+    std::string ebpf_event_trace(int bandwidth_mbps, int latency_ms, uint32_t trial) const {
+        if (ebpf_event_sampling == 0) {
+            return std::string();
+        }
+        if (mkdir(kEbpfEventDirectory, 0755) != 0 && errno != EEXIST) {
+            std::cerr << "Failed to create " << kEbpfEventDirectory << ": " << std::strerror(errno) << std::endl;
+            return std::string();
+        }
+        return std::string(kEbpfEventDirectory) + "/" + current_algorithm + "_" + std::to_string(bandwidth_mbps) +
+               "mbps_" + std::to_string(latency_ms) + "ms_v" + std::to_string(tuning_variant) + "_t" +
+               std::to_string(trial) + ".csv";
+    }
+    
+    // Measure performance metrics of the test connection in one cell
+    Metrics measure_performance(int duration_seconds, int bandwidth_mbps, int latency_ms, uint32_t trial) {
+        Metrics result = {};
+        
+        if (client_fd < 0 || data_fd < 0) {
+            std::cerr << "No test connection, skipping measurement\n";
+            return result;
+        }
+        
+        // Count CPU before any thread of the window exists, so the
+        // inherited counters cover all of them
+        CpuCounters cpu_counters;
+        bool counting = cpu_counters.start();
+        
+        // Start the data plane; it runs for the whole measurement window
+        TransferEngine engine(client_fd, data_fd, transfer_config);
+        if (!engine.start()) {
+            std::cerr << "Failed to start transfer engine\n";
+            return result;
+        }
+        auto probe = start_rpc_probe(server_fd, "127.0.0.1", per_socket_cc ? current_algorithm : std::string());
+        
+        // Stream kernel-side samples of the sender while the transfer runs
+        bool collecting = false;
+        EbpfCellSummary ebpf = {};
+        if (open_ebpf_collector()) {
+            std::string trace = ebpf_event_trace(bandwidth_mbps, latency_ms, trial);
+            collecting = ebpf_collector->begin_cell(client_fd, trace, current_algorithm);
+            if (collecting && !trace.empty()) {
+                ebpf_event_traces.push_back(trace);
+            }
+        }
+        
+        // TCP_INFO needs no privileges and runs next to eBPF when both are on
+        auto sampler = start_tcp_info_sampler({client_fd}, {{current_algorithm, bandwidth_mbps, latency_ms}},
+                                              duration_seconds);
+        
+        if (collecting) {
+            // The kernel aggregates every sample; read the aggregates once
+            // per interval and drain sampled per-packet events in between
+            auto start = std::chrono::steady_clock::now();
+            auto deadline = start + std::chrono::seconds(duration_seconds);
+            auto next_sample = start + std::chrono::milliseconds(ebpf_interval_ms);
+            EbpfFlowStats flow;
+            for (auto now = start; now < deadline; now = std::chrono::steady_clock::now()) {
+                if (now >= next_sample) {
+                    ebpf_collector->sample(flow);
+                    next_sample += std::chrono::milliseconds(ebpf_interval_ms);
                 }
-                
-                file.close();
-                
-                // Calculate averages
-                if (count > 0) {
-                    result.throughput = total_throughput / count;
-                    result.latency = total_latency / count;
-                    result.packet_loss = total_packet_loss;
-                    result.jitter = total_jitter / count;
-                } else {
-                    // Fallback to dummy values if no data was parsed
-                    result.throughput = 85.7;
-                    result.latency = 15.2;
-                    result.packet_loss = 2;
-                    result.jitter = 3.5;
+                auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::min(deadline, next_sample) - now).count();
+                ebpf_collector->poll(static_cast<int>(std::max<long long>(wait, 1)));
+            }
+        } else {
+            std::this_thread::sleep_for(std::chrono::seconds(duration_seconds));
+        }
+        
+        if (sampler) {
+            sampler->stop();
+        }
+        RpcProbeStats probe_stats = stop_rpc_probe(probe);
+        TransferStats stats = engine.stop();
+        CpuCost cpu = counting ? cpu_counters.stop() : CpuCost();
+        if (collecting) {
+            ebpf = ebpf_collector->end_cell();
+        }
+        
+        // Throughput comes from the data plane, or from the bytes acknowledged
+        // after the warm-up when the TCP_INFO sampler found one. Latency and
+        // jitter come from the sampler's samples after the warm-up, else from
+        // eBPF samples over the whole cell, else from the sender's TCP_INFO
+        // at stop time.
+        result = metrics_from_transfer(stats);
+        result.rpc_rtt_us = probe_stats.rtt_us;
+        result.rpc_owd_us = probe_stats.owd_us;
+        
+        std::cout << "Transferred " << stats.bytes_received << " bytes in "
+                  << stats.elapsed_seconds << " s (" << send_mode_name(transfer_config.send_mode)
+                  << " mode, " << transfer_config.message_size << " byte messages)\n";
+        report_cpu_cost(cpu, stats.bytes_received, result);
+        if (metrics_exporter) {
+            metrics_exporter->set_cell_cpu(cpu);
+        }
+        
+        if (sampler) {
+            TcpInfoSummary info = sampler->summarize(0);
+            take_tcp_info_samples(*sampler, 0, result);
+            std::cout << "TCP_INFO: " << info.samples << " samples at " << sampler->rate_hz()
+                      << " Hz, RTT " << info.min_rtt_ms << "/" << info.mean_rtt_ms << "/"
+                      << info.max_rtt_ms << " ms min/mean/max, peak cwnd " << info.max_cwnd
+                      << " packets, delivery rate " << info.mean_delivery_mbps << " Mbps mean, "
+                      << "rwnd-limited " << info.rwnd_limited * 100.0 << "%, sndbuf-limited "
+                      << info.sndbuf_limited * 100.0 << "%";
+            if (sampler->missed_ticks() > 0) {
+                std::cout << ", " << sampler->missed_ticks() << " ticks missed";
+            }
+            if (result.warmup_seconds > 0.0) {
+                std::cout << ", first " << result.warmup_seconds << " s left out as warm-up";
+            }
+            std::cout << "\n";
+        }
+        
+        if (ebpf.samples > 0) {
+            // eBPF aggregates cannot be cut at the warm-up; keep the
+            // sampler's values, which match its steady-state throughput
+            if (result.series.rows() == 0) {
+                result.latency = ebpf.mean_rtt_ms;
+                result.jitter = ebpf.mean_rttvar_ms;
+            }
+            std::cout << "eBPF: " << ebpf.samples << " samples, RTT p50/p99 ~" << ebpf.p50_rtt_ms
+                      << "/" << ebpf.p99_rtt_ms << " ms, peak cwnd " << ebpf.max_cwnd
+                      << " packets, " << ebpf.retransmits << " retransmitted segments"
+                      << ", peak " << ebpf.peak_interval_mbps << " Mbps per interval";
+            if (ebpf.events > 0) {
+                std::cout << ", " << ebpf.events << " sampled events";
+            }
+            std::cout << "\n";
+            
+            // Without TCP_INFO samples, take the RTT distribution from the
+            // kernel's log2 histogram at the middle of each bucket
+            if (result.rtt_us.empty()) {
+                for (size_t slot = 0; slot < ebpf.flow.srtt_hist.size(); ++slot) {
+                    uint64_t low = uint64_t(1) << slot;
+                    result.rtt_us.record(low + low / 2, ebpf.flow.srtt_hist[slot]);
                 }
-            } else {
-                std::cerr << "Could not open metrics file: " << metrics_file << std::endl;
-                // Fallback to dummy values if file could not be opened
-                result.throughput = 85.7;
-                result.latency = 15.2;
-                result.packet_loss = 2;
-                result.jitter = 3.5;
             }
         }
         
+        if (!result.rtt_us.empty() || !result.owd_us.empty()) {
+            std::cout << "Latency p50/p99/p99.9/max: RTT " << format_percentiles(result.rtt_us)
+                      << " ms, one-way " << format_percentiles(result.owd_us) << " ms\n";
+        }
+        report_requests(result);
+        
         return result;
     }
 };
 
-int main() {
+static void print_usage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --duration=SECONDS      Length of each test (default: 20)\n"
+              << "  --message-size=BYTES    Bytes per send call (default: 131072)\n"
+              << "  --send-mode=MODE        copy, zerocopy or splice (default: copy)\n"
+              << "  --per-socket-cc         Set congestion control per connection (TCP_CONGESTION)\n"
+              << "                          instead of the system-wide default\n"
+              << "  --concurrent            Run all algorithms of a cell at the same time\n"
+              << "                          (implies --per-socket-cc)\n"
+              << "  --parallel              Run independent cells in parallel, each in its own\n"
+              << "                          network namespaces joined by a veth pair\n"
+              << "  --jobs=N                Cap on parallel cells (default: one per core pair)\n"
+              << "  --contention=SPEC       Run competing flows through one bottleneck instead of\n"
+              << "                          the algorithm sweep; SPEC is a comma-separated list of\n"
+              << "                          ALG[:COUNT][@START][+DURATION] groups, times in seconds\n"
+              << "                          (implies --per-socket-cc)\n"
+              << "  --mux-workers=N         Threads driving contention flows (default: one per CPU,\n"
+              << "                          at most 4)\n"
+              << "  --churn=RATE            Open RATE short connections per second per cell instead\n"
+              << "                          of one bulk flow and measure flow completion times\n"
+              << "  --flow-sizes=DIST       Churn flow sizes: websearch, datamining or a file of\n"
+              << "                          \"BYTES CDF\" lines (default: websearch)\n"
+              << "  --churn-max-flows=N     Churn flows open at once (default: 1000)\n"
+              << "  --scenario=SPEC         Change link conditions during one run per algorithm and\n"
+              << "                          measure convergence: step-down, step-up, rtt-spike,\n"
+              << "                          loss-burst, a file, or SECONDS:rate=MBPS,delay=MS,...\n"
+              << "                          steps separated by ';'\n"
+              << "  --interface=IFACE       Interface carrying test traffic (default: lo)\n"
+              << "  --jitter=MS             Delay jitter added to every cell\n"
+              << "  --loss=PERCENT          Random loss added to every cell\n"
+              << "  --reorder=PERCENT       Reordering added to every cell\n"
+              << "  --emulator=MODE         qdisc, userspace or none (default: qdisc)\n"
+              << "  --trace=FILE            Mahimahi delivery trace for the userspace emulator\n"
+              << "                          (implies --emulator=userspace)\n"
+              << "  --no-emulation          Same as --emulator=none\n"
+              << "  --ebpf-interval=MS      Read in-kernel eBPF aggregates every MS (default: 100)\n"
+              << "  --ebpf-events=N         Also stream one per-packet eBPF event in N into a\n"
+              << "                          trace per cell in ebpf_events/ (default: off)\n"
+              << "  --sample-rate=HZ        Poll the senders' TCP_INFO HZ times per second,\n"
+              << "                          at most 10000, 0 = off (default: 1000)\n"
+              << "  --rpc-rate=HZ           Measure request/response latency under load with HZ\n"
+              << "                          ping-pong requests per second, on a separate\n"
+              << "                          connection and interleaved with the bulk flow\n"
+              << "                          (default: 0 = off)\n"
+              << "  --rpc-size=BYTES        Bytes per probe request and response (default: 64)\n"
+              << "  --trials=N              Run each cell up to N times (default: 1)\n"
+              << "  --min-trials=N          Trials before a cell may stop early (default: 3)\n"
+              << "  --tolerance=PERCENT     Stop a cell once the 95% confidence intervals of\n"
+              << "                          throughput and p99 RTT are within PERCENT of their\n"
+              << "                          means, 0 = always run N trials (default: 5)\n"
+              << "  --cell-budget=SECONDS   Start no trial that would take a cell past SECONDS\n"
+              << "                          (default: unlimited)\n"
+              << "  --bpf-cc=DIR            Register the BPF struct_ops congestion controls of\n"
+              << "                          every *.o file in DIR and add them to the sweep\n"
+              << "                          (needs -DENABLE_EBPF_METRICS=ON)\n"
+              << "  --tune=NAME=V1,V2,...   Repeat the sweep for every combination of tuning\n"
+              << "                          values; NAME is sndbuf, rcvbuf, notsent_lowat,\n"
+              << "                          max_pacing (Mbps), tcp_rmem, tcp_wmem (autotuning\n"
+              << "                          ceilings), initcwnd or qdisc (fq, fq_codel, cake,\n"
+              << "                          pfifo); sizes take K/M/G, \"default\" keeps the\n"
+              << "                          kernel's setting. May be given more than once\n"
+              << "  --tune-search=GOAL      Instead of every combination, search the --tune\n"
+              << "                          dimensions per algorithm for the best throughput\n"
+              << "                          or power (throughput / p99 RTT)\n"
+              << "  --metrics-port=PORT     Serve live OpenMetrics of the sweep on\n"
+              << "                          http://127.0.0.1:PORT/metrics (default: off)\n"
+              << "  --results=FILE          Binary results store (default: results.tcpr)\n"
+              << "  --cache=DIR             Keep finished cells in DIR and take cells measured\n"
+              << "                          under the same conditions from it (default:\n"
+              << "                          results-cache)\n"
+              << "  --no-cache              Measure every cell and leave the cache alone\n"
+              << "  --series-points=N       Also write every cell's cwnd, RTT, delivery rate,\n"
+              << "                          retransmission and queueing delay series for gnuplot,\n"
+              << "                          downsampled to N points each (default: off)\n"
+              << "  --series-method=METHOD  lttb or minmax (default: lttb)\n"
+              << "  --series-dir=DIR        Directory of the series files (default: series)\n"
+              << "  --export=FILE           Write the CSV files (and series) from an existing\n"
+              << "                          results store and exit\n"
+              << "  --compare=BASE,CAND     Compare two results stores cell by cell, write\n"
+              << "                          regression_report.csv and exit with 2 if any\n"
+              << "                          throughput, p99 RTT or CPU-per-byte regressed\n"
+              << "  --regression-threshold=PERCENT\n"
+              << "                          Change a regression must exceed (default: 5)\n"
+              << "  --ingest=PATH           Summarise traces of the standalone collector and exit;\n"
+              << "                          PATH is a trace or a directory holding the newest\n"
+              << "                          {alg}_{timestamp}_{output} trace per algorithm;\n"
+              << "                          with --series-points also writes per-flow series\n"
+              << "  --collector-output=NAME Output name the collector was given (default: "
+              << kCollectorDefaultOutput << ")\n"
+              << "  --help                  Show this message\n";
+}
+
+// Print per-algorithm summaries of tcp_ebpf_collector.py traces
+static bool ingest_collector_traces(const std::string& path, const std::string& output,
+                                    const SeriesOptions& series_options) {
+    std::vector<std::string> traces;
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+        traces = find_collector_traces(path, output);
+        if (traces.empty()) {
+            std::cerr << "No {alg}_{timestamp}_" << output << " traces in " << path << std::endl;
+            return false;
+        }
+    } else {
+        traces.push_back(path);
+    }
+    
+    bool ok = true;
+    for (const auto& trace : traces) {
+        std::vector<CollectorTraceSummary> summaries;
+        uint64_t skipped = 0;
+        if (!summarize_collector_trace(trace, summaries, skipped)) {
+            ok = false;
+            continue;
+        }
+        
+        std::cout << trace << ":";
+        if (skipped > 0) {
+            std::cout << " " << skipped << " rows without rtt_us skipped";
+        }
+        std::cout << "\n";
+        for (const auto& summary : summaries) {
+            std::cout << "  " << summary.algorithm << ": " << summary.samples << " samples, "
+                      << summary.flows << " flows over " << summary.duration_s << " s, RTT "
+                      << summary.mean_rtt_ms << " ms (rttvar " << summary.mean_rttvar_ms
+                      << " ms), cwnd " << summary.mean_cwnd << " mean/" << summary.max_cwnd
+                      << " peak, peak lost " << summary.max_lost << ", peak retrans "
+                      << summary.max_retrans << ", throughput " << summary.throughput_mbps << " Mbps\n";
+        }
+    }
+    if (series_options.points > 0 && !export_collector_series(traces, series_options)) {
+        ok = false;
+    }
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    TransferConfig transfer_config;
+    int duration = 20;
+    bool per_socket_cc = false;
+    bool concurrent = false;
+    bool parallel = false;
+    int jobs = 0;
+    EmulationMode emulation = EmulationMode::Qdisc;
+    std::string trace;
+    std::string interface = "lo";
+    LinkConditions impairments;
+    int ebpf_interval_ms = 100;
+    uint32_t ebpf_event_sampling = 0;
+    int sample_rate_hz = 1000;
+    TrialPolicy trial_policy;
+    RpcProbeConfig rpc_config;
+    std::vector<ContentionFlowSpec> contention;
+    int mux_workers = 0;
+    ChurnConfig churn_config;
+    churn_config.rate = 0.0;
+    std::string flow_sizes = "websearch";
+    std::string scenario_spec;
+    std::string ingest_path;
+    std::string results_path = "results.tcpr";
+    std::string cache_directory = "results-cache";
+    std::string export_path;
+    std::string compare_paths;
+    SeriesOptions series_options;
+    CompareOptions compare_options;
+    std::string collector_output = kCollectorDefaultOutput;
+    std::vector<TuningDimension> tuning_dimensions;
+    bool tuning_search = false;
+    std::string bpf_directory;
+    int metrics_port = 0;
+    TuningObjective tuning_objective = TuningObjective::Throughput;
+    
+    static const struct option long_options[] = {
+        {"duration",     required_argument, nullptr, 'd'},
+        {"message-size", required_argument, nullptr, 'm'},
+        {"send-mode",    required_argument, nullptr, 's'},
+        {"per-socket-cc", no_argument,      nullptr, 'p'},
+        {"concurrent",   no_argument,       nullptr, 'c'},
+        {"parallel",     no_argument,       nullptr, 'P'},
+        {"jobs",         required_argument, nullptr, 'j'},
+        {"contention",   required_argument, nullptr, 'C'},
+        {"mux-workers",  required_argument, nullptr, 'W'},
+        {"churn",        required_argument, nullptr, 'n'},
+        {"flow-sizes",   required_argument, nullptr, 'F'},
+        {"churn-max-flows", required_argument, nullptr, 'L'},
+        {"scenario",     required_argument, nullptr, 'S'},
+        {"interface",    required_argument, nullptr, 'i'},
+        {"jitter",       required_argument, nullptr, 'J'},
+        {"loss",         required_argument, nullptr, 'l'},
+        {"reorder",      required_argument, nullptr, 'r'},
+        {"emulator",     required_argument, nullptr, 'e'},
+        {"trace",        required_argument, nullptr, 't'},
+        {"no-emulation", no_argument,       nullptr, 'N'},
+        {"ebpf-interval", required_argument, nullptr, 'I'},
+        {"ebpf-events",  required_argument, nullptr, 'E'},
+        {"sample-rate",  required_argument, nullptr, 'R'},
+        {"rpc-rate",     required_argument, nullptr, 'q'},
+        {"rpc-size",     required_argument, nullptr, 'Q'},
+        {"trials",       required_argument, nullptr, 'T'},
+        {"min-trials",   required_argument, nullptr, 'M'},
+        {"tolerance",    required_argument, nullptr, 'u'},
+        {"cell-budget",  required_argument, nullptr, 'B'},
+        {"ingest",       required_argument, nullptr, 'g'},
+        {"bpf-cc",       required_argument, nullptr, 'b'},
+        {"tune",         required_argument, nullptr, 'U'},
+        {"tune-search",  required_argument, nullptr, 'Y'},
+        {"metrics-port", required_argument, nullptr, 'G'},
+        {"results",      required_argument, nullptr, 'O'},
+        {"cache",        required_argument, nullptr, 'K'},
+        {"no-cache",     no_argument,       nullptr, 'k'},
+        {"series-points", required_argument, nullptr, 'v'},
+        {"series-method", required_argument, nullptr, 'V'},
+        {"series-dir",   required_argument, nullptr, 'X'},
+        {"export",       required_argument, nullptr, 'x'},
+        {"compare",      required_argument, nullptr, 'D'},
+        {"regression-threshold", required_argument, nullptr, 'Z'},
+        {"collector-output", required_argument, nullptr, 'o'},
+        {"help",         no_argument,       nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
+    
+    int opt;
+    while ((opt = getopt_long(argc, argv, "h", long_options, nullptr)) != -1) {
+        switch (opt) {
+            case 'd':
+                duration = std::atoi(optarg);
+                break;
+            case 'm':
+                transfer_config.message_size = std::strtoul(optarg, nullptr, 10);
+                break;
+            case 's':
+                if (!parse_send_mode(optarg, transfer_config.send_mode)) {
+                    std::cerr << "Unknown send mode: " << optarg << std::endl;
+                    return 1;
+                }
+                break;
+            case 'p':
+                per_socket_cc = true;
+                break;
+            case 'c':
+                concurrent = true;
+                per_socket_cc = true;
+                break;
+            case 'P':
+                parallel = true;
+                break;
+            case 'j':
+                jobs = std::atoi(optarg);
+                break;
+            case 'C':
+                if (!parse_contention_spec(optarg, contention)) {
+                    std::cerr << "Invalid flow specification: " << optarg << std::endl;
+                    return 1;
+                }
+                per_socket_cc = true;
+                break;
+            case 'W':
+                mux_workers = std::atoi(optarg);
+                break;
+            case 'n':
+                churn_config.rate = std::atof(optarg);
+                break;
+            case 'F':
+                flow_sizes = optarg;
+                break;
+            case 'L':
+                churn_config.max_active = std::strtoul(optarg, nullptr, 10);
+                break;
+            case 'S':
+                scenario_spec = optarg;
+                break;
+            case 'i':
+                interface = optarg;
+                break;
+            case 'J':
+                impairments.jitter_ms = std::atof(optarg);
+                break;
+            case 'l':
+                impairments.loss_percent = std::atof(optarg);
+                break;
+            case 'r':
+                impairments.reorder_percent = std::atof(optarg);
+                break;
+            case 'e':
+                if (!parse_emulation_mode(optarg, emulation)) {
+                    std::cerr << "Unknown emulator: " << optarg << std::endl;
+                    return 1;
+                }
+                break;
+            case 't':
+                trace = optarg;
+                emulation = EmulationMode::Userspace;
+                break;
+            case 'N':
+                emulation = EmulationMode::None;
+                break;
+            case 'I':
+                ebpf_interval_ms = std::atoi(optarg);
+                break;
+            case 'E':
+                ebpf_event_sampling = static_cast<uint32_t>(std::strtoul(optarg, nullptr, 10));
+                break;
+            case 'R':
+                sample_rate_hz = std::atoi(optarg);
+                break;
+            case 'q':
+                rpc_config.rate_hz = std::atoi(optarg);
+                break;
+            case 'Q':
+                rpc_config.request_size = std::strtoul(optarg, nullptr, 10);
+                break;
+            case 'T':
+                trial_policy.max_trials = std::atoi(optarg);
+                break;
+            case 'M':
+                trial_policy.min_trials = std::atoi(optarg);
+                break;
+            case 'u':
+                trial_policy.tolerance = std::atof(optarg) / 100.0;
+                break;
+            case 'B':
+                trial_policy.budget_seconds = std::atof(optarg);
+                break;
+            case 'g':
+                ingest_path = optarg;
+                break;
+            case 'b':
+                bpf_directory = optarg;
+                break;
+            case 'U':
+                tuning_dimensions.emplace_back();
+                if (!parse_tuning_dimension(optarg, tuning_dimensions.back())) {
+                    return 1;
+                }
+                break;
+            case 'Y':
+                tuning_search = true;
+                if (std::string(optarg) == "power") {
+                    tuning_objective = TuningObjective::Power;
+                } else if (std::string(optarg) != "throughput") {
+                    std::cerr << "Unknown tuning goal: " << optarg << std::endl;
+                    return 1;
+                }
+                break;
+            case 'G':
+                metrics_port = std::atoi(optarg);
+                if (metrics_port <= 0 || metrics_port > 65535) {
+                    std::cerr << "Invalid metrics port: " << optarg << std::endl;
+                    return 1;
+                }
+                break;
+            case 'O':
+                results_path = optarg;
+                break;
+            case 'K':
+                cache_directory = optarg;
+                break;
+            case 'k':
+                cache_directory.clear();
+                break;
+            case 'v':
+                if (std::atoi(optarg) < 4) {
+                    std::cerr << "Series need at least 4 points: " << optarg << std::endl;
+                    return 1;
+                }
+                series_options.points = static_cast<size_t>(std::atoi(optarg));
+                break;
+            case 'V':
+                if (!parse_downsample_method(optarg, series_options.method)) {
+                    std::cerr << "Unknown downsampling method: " << optarg << std::endl;
+                    return 1;
+                }
+                break;
+            case 'X':
+                series_options.directory = optarg;
+                break;
+            case 'x':
+                export_path = optarg;
+                break;
+            case 'D':
+                compare_paths = optarg;
+                break;
+            case 'Z':
+                compare_options.threshold = std::atof(optarg) / 100.0;
+                if (compare_options.threshold <= 0.0) {
+                    std::cerr << "Invalid regression threshold: " << optarg << std::endl;
+                    return 1;
+                }
+                break;
+            case 'o':
+                collector_output = optarg;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    
+    if (!ingest_path.empty()) {
+        return ingest_collector_traces(ingest_path, collector_output, series_options) ? 0 : 1;
+    }
+    if (!export_path.empty()) {
+        ResultsStoreReader reader;
+        if (!reader.open(export_path) || !export_results_csv(reader, "")) {
+            return 1;
+        }
+        return series_options.points == 0 || export_series_gnuplot(reader, series_options) ? 0 : 1;
+    }
+    if (!compare_paths.empty()) {
+        size_t comma = compare_paths.find(',');
+        if (comma == std::string::npos) {
+            std::cerr << "--compare needs BASELINE,CANDIDATE" << std::endl;
+            return 1;
+        }
+        ResultsStoreReader baseline;
+        ResultsStoreReader candidate;
+        CompareSummary summary;
+        if (!baseline.open(compare_paths.substr(0, comma)) || !candidate.open(compare_paths.substr(comma + 1)) ||
+            !compare_results(baseline, candidate, compare_options, "", summary)) {
+            return 1;
+        }
+        return summary.regressions > 0 ? 2 : 0;
+    }
+    
+    if (duration <= 0 || transfer_config.message_size == 0 || ebpf_interval_ms <= 0) {
+        std::cerr << "Duration, message size and eBPF interval must be positive\n";
+        return 1;
+    }
+    if (sample_rate_hz < 0 || sample_rate_hz > kMaxTcpInfoSampleRate) {
+        std::cerr << "Sample rate must be between 0 and " << kMaxTcpInfoSampleRate << " Hz\n";
+        return 1;
+    }
+    if (rpc_config.rate_hz < 0 || rpc_config.request_size < kMinRpcRequestSize) {
+        std::cerr << "Request rate must not be negative and requests at least "
+                  << kMinRpcRequestSize << " bytes\n";
+        return 1;
+    }
+    if (rpc_config.rate_hz > 0 && transfer_config.send_mode != SendMode::Copy) {
+        std::cerr << "Requests interleaved with the bulk flow need --send-mode=copy; "
+                  << "only the separate connection is probed\n";
+    }
+    transfer_config.inline_rpc_hz = rpc_config.rate_hz;
+    if (trial_policy.max_trials < 1 || trial_policy.min_trials < 1 || trial_policy.tolerance < 0.0 ||
+        trial_policy.budget_seconds < 0.0) {
+        std::cerr << "Trials must be positive, tolerance and cell budget not negative\n";
+        return 1;
+    }
+    
+    if (churn_config.rate < 0.0 || churn_config.max_active == 0) {
+        std::cerr << "Churn rate must not be negative and at least one churn flow must be allowed\n";
+        return 1;
+    }
+    FlowSizeDistribution churn_sizes;
+    if (churn_config.rate > 0.0 && !churn_sizes.load(flow_sizes)) {
+        std::cerr << "Unknown flow size distribution: " << flow_sizes << std::endl;
+        return 1;
+    }
+    
+    Scenario scenario;
+    if (!scenario_spec.empty() && !parse_scenario(scenario_spec, impairments, scenario)) {
+        return 1;
+    }
+    if (!scenario_spec.empty() && emulation == EmulationMode::None) {
+        std::cerr << "--scenario needs link emulation, not --no-emulation or --emulator=none\n";
+        return 1;
+    }
+    if (!scenario_spec.empty() && emulation == EmulationMode::Userspace) {
+        std::cerr << "The userspace emulator keeps the first scenario step for the whole run\n";
+    }
+    
+    if (tuning_search && tuning_dimensions.empty()) {
+        std::cerr << "--tune-search needs at least one --tune dimension\n";
+        return 1;
+    }
+    if (!tuning_dimensions.empty() &&
+        (parallel || concurrent || !contention.empty() || churn_config.rate > 0.0 || !scenario.steps.empty())) {
+        std::cerr << "Tuning dimensions apply to the sequential sweep only and are ignored\n";
+    }
+    
+    if (emulation == EmulationMode::Userspace &&
+        (parallel || concurrent || !contention.empty() || churn_config.rate > 0.0)) {
+        std::cerr << "The userspace emulator relays a single connection; "
+                  << "--parallel, --concurrent, --contention and --churn run without emulation\n";
+    }
+    
+    // splice() into a shut-down socket raises SIGPIPE; errors are handled via EPIPE
+    std::signal(SIGPIPE, SIG_IGN);
+    
+    // Declared before the tester, whose samplers publish to it
+    std::unique_ptr<MetricsExporter> exporter;
+    if (metrics_port > 0) {
+        exporter = std::make_unique<MetricsExporter>(static_cast<uint16_t>(metrics_port));
+        if (!exporter->start()) {
+            return 1;
+        }
+    }
+    
     CongestionTester tester;
-    tester.show_available_algorithms();
+    tester.set_metrics_exporter(exporter.get());
+    tester.set_transfer_config(transfer_config);
+    tester.set_per_socket_congestion(per_socket_cc);
+    tester.set_ebpf_options(ebpf_interval_ms, ebpf_event_sampling);
+    tester.set_sample_rate(sample_rate_hz);
+    tester.set_trial_policy(trial_policy);
+    tester.set_rpc_probe(rpc_config);
+    tester.set_mux_workers(mux_workers);
+    tester.set_churn(churn_config, churn_sizes);
+    tester.set_results_path(results_path);
+    tester.set_series_options(series_options);
+    if (!tuning_dimensions.empty()) {
+        tester.save_tuning_defaults(tuning_dimensions);
+    }
+    if (!cache_directory.empty() && !tester.set_results_cache(cache_directory)) {
+        return 1;
+    }
+    tester.set_link_emulation(emulation, interface, impairments, trace);
     
     // Option 1: Test specific algorithms with granular bandwidth increments for better gnuplot visualization
     std::vector<std::string> algorithms_to_test = {"cubic", "bbr", "reno"};
     
+    // BPF algorithms join the sweep after the kernel ones
+    if (!bpf_directory.empty()) {
+        std::vector<std::string> bpf_algorithms = tester.load_bpf_congestion(bpf_directory);
+        if (bpf_algorithms.empty()) {
+            return 1;
+        }
+        algorithms_to_test.insert(algorithms_to_test.end(), bpf_algorithms.begin(), bpf_algorithms.end());
+    }
+    tester.show_available_algorithms();
+    
     // Create more granular bandwidth values for better comparison plots
     std::vector<int> bandwidths = {10, 20, 30, 40, 50, 60, 70, 80, 90, 100, 150, 200};
     std::vector<int> latencies = {5, 20, 50, 100};
     
+    uint64_t grid = bandwidths.size() * latencies.size();
+    if (!contention.empty()) {
+        // The given flows compete in every cell
+        tester.set_sweep_cells(grid);
+        for (const auto& bw : bandwidths) {
+            for (const auto& lat : latencies) {
+                tester.run_contention_test(contention, duration, bw, lat);
+                tester.finish_cell();
+            }
+        }
+        algorithms_to_test.clear();
+    } else if (churn_config.rate > 0.0) {
+        // Every algorithm opens short flows through every cell
+        tester.set_sweep_cells(algorithms_to_test.size() * grid);
+        for (const auto& alg : algorithms_to_test) {
+            if (!tester.is_algorithm_available(alg)) {
+                std::cerr << "Algorithm " << alg << " not available\n";
+                continue;
+            }
+            for (const auto& bw : bandwidths) {
+                for (const auto& lat : latencies) {
+                    tester.run_churn_test(alg, duration, bw, lat);
+                    tester.finish_cell();
+                }
+            }
+        }
+        algorithms_to_test.clear();
+    } else if (!scenario.steps.empty()) {
+        // One run per algorithm through the changing conditions
+        tester.set_sweep_cells(algorithms_to_test.size());
+        for (const auto& alg : algorithms_to_test) {
+            if (tester.set_congestion_algorithm(alg)) {
+                tester.run_scenario_test(scenario, duration);
+            }
+            tester.finish_cell();
+        }
+        algorithms_to_test.clear();
+    } else if (parallel) {
+        // Every cell is independent; the scheduler isolates and pins them
+        std::vector<SweepCell> cells;
+        for (const auto& alg : algorithms_to_test) {
+            if (!tester.is_algorithm_available(alg)) {
+                std::cerr << "Algorithm " << alg << " not available\n";
+                continue;
+            }
+            for (const auto& bw : bandwidths) {
+                for (const auto& lat : latencies) {
+                    cells.push_back({alg, bw, lat});
+                }
+            }
+        }
+        tester.set_sweep_cells(cells.size());
+        tester.run_parallel_sweep(cells, duration, jobs);
+        algorithms_to_test.clear();
+    } else if (concurrent) {
+        // All algorithms share each cell's measurement window
+        tester.set_sweep_cells(grid);
+        for (const auto& bw : bandwidths) {
+            for (const auto& lat : latencies) {
+                tester.run_concurrent_test(algorithms_to_test, duration, bw, lat);
+                tester.finish_cell();
+            }
+        }
+        algorithms_to_test.clear();
+    }
+    
+    std::vector<SocketTuning> tuning_variants = tuning_grid(tuning_dimensions);
+    if (!algorithms_to_test.empty()) {
+        // A tuning search decides as it goes how many configurations it tries
+        tester.set_sweep_cells(tuning_search ? 0 : algorithms_to_test.size() * tuning_variants.size() * grid);
+    }
     for (const auto& alg : algorithms_to_test) {
         if (tester.set_congestion_algorithm(alg)) {
             std::cout << "Testing " << alg << "...\n";
             
-            // For each algorithm, test with all bandwidth and latency combinations
+            if (tuning_search) {
+                tester.search_tuning(tuning_dimensions, tuning_objective, duration, bandwidths, latencies);
+                continue;
+            }
+            
+            // For each algorithm and tuning, test with all bandwidth and latency combinations
             // This creates a comprehensive dataset for gnuplot comparison
-            for (const auto& bw : bandwidths) {
-                for (const auto& lat : latencies) {
-                    // Only run the test with lower duration to save time
-                    tester.run_test(20, bw, lat);  // 20 sec duration, varying bandwidth and latency
+            for (size_t variant = 0; variant < tuning_variants.size(); ++variant) {
+                double score = 0.0;
+                if (tuning_dimensions.empty()) {
+                    tester.run_cells(duration, bandwidths, latencies, tuning_objective);
+                } else {
+                    tester.run_tuned_cells(tuning_variants[variant], static_cast<uint32_t>(variant), duration,
+                                           bandwidths, latencies, tuning_objective, score);
                 }
             }
         }
@@ -0,0 +1,174 @@
+#include "tcp_cpu_counters.h"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+// Counter value scaled up for the time it was multiplexed out
+struct CounterReading {
+    uint64_t value;
+    uint64_t time_enabled;
+    uint64_t time_running;
+};
+
+int open_counter(uint32_t type, uint64_t config, pid_t pid, int cpu, bool inherit) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = inherit ? 1 : 0;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, pid, cpu, -1, PERF_FLAG_FD_CLOEXEC));
+}
+
+uint64_t read_counter(int fd) {
+    CounterReading reading = {};
+    if (fd < 0 || read(fd, &reading, sizeof(reading)) != static_cast<ssize_t>(sizeof(reading)) ||
+        reading.time_running == 0) {
+        return 0;
+    }
+    if (reading.time_running >= reading.time_enabled) {
+        return reading.value;
+    }
+    return static_cast<uint64_t>(static_cast<double>(reading.value) * reading.time_enabled /
+                                 reading.time_running);
+}
+
+void close_counter(int& fd) {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+} // namespace
+
+CpuCounters::~CpuCounters() {
+    close_all();
+}
+
+bool CpuCounters::read_proc_stat(ProcStat& stat) {
+    std::ifstream file("/proc/stat");
+    std::string line;
+    if (!std::getline(file, line) || line.compare(0, 4, "cpu ") != 0) {
+        return false;
+    }
+
+    // user nice system idle iowait irq softirq steal; guest time is
+    // already part of user
+    std::istringstream fields(line.substr(4));
+    uint64_t values[8] = {};
+    for (uint64_t& value : values) {
+        if (!(fields >> value)) {
+            return false;
+        }
+    }
+    stat = ProcStat();
+    for (uint64_t value : values) {
+        stat.total += value;
+    }
+    stat.idle = values[3] + values[4];
+    stat.softirq = values[6];
+    return true;
+}
+
+bool CpuCounters::start() {
+    close_all();
+    if (!read_proc_stat(start_stat_)) {
+        return false;
+    }
+
+    thread_cycles_ = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, 0, -1, true);
+    thread_instructions_ = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, 0, -1, true);
+    thread_switches_ = open_counter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, 0, -1, true);
+
+    // System-wide counting is all or nothing: a missing CPU would undercount
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int cpu = 0; cpu < cpus; ++cpu) {
+        int cycles = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1, cpu, false);
+        int instructions = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1, cpu, false);
+        system_cycles_.push_back(cycles);
+        system_instructions_.push_back(instructions);
+        if (cycles < 0 || instructions < 0) {
+            for (int& fd : system_cycles_) {
+                close_counter(fd);
+            }
+            for (int& fd : system_instructions_) {
+                close_counter(fd);
+            }
+            system_cycles_.clear();
+            system_instructions_.clear();
+            break;
+        }
+    }
+
+    start_time_ = std::chrono::steady_clock::now();
+    for (int fd : {thread_cycles_, thread_instructions_, thread_switches_}) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    for (size_t i = 0; i < system_cycles_.size(); ++i) {
+        ioctl(system_cycles_[i], PERF_EVENT_IOC_ENABLE, 0);
+        ioctl(system_instructions_[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+    return true;
+}
+
+CpuCost CpuCounters::stop() {
+    CpuCost cost;
+    ProcStat end_stat;
+    if (!read_proc_stat(end_stat)) {
+        close_all();
+        return cost;
+    }
+    cost.elapsed_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time_).count();
+
+    if (!system_cycles_.empty()) {
+        for (size_t i = 0; i < system_cycles_.size(); ++i) {
+            cost.cycles += read_counter(system_cycles_[i]);
+            cost.instructions += read_counter(system_instructions_[i]);
+        }
+        cost.counted = true;
+        cost.system_wide = true;
+    } else if (thread_cycles_ >= 0 && thread_instructions_ >= 0) {
+        cost.cycles = read_counter(thread_cycles_);
+        cost.instructions = read_counter(thread_instructions_);
+        cost.counted = true;
+    }
+    cost.context_switches = read_counter(thread_switches_);
+
+    uint64_t total = end_stat.total - start_stat_.total;
+    if (total > 0) {
+        cost.cpu_percent = 100.0 * (total - (end_stat.idle - start_stat_.idle)) / total;
+        cost.softirq_percent = 100.0 * (end_stat.softirq - start_stat_.softirq) / total;
+    }
+    cost.measured = true;
+    close_all();
+    return cost;
+}
+
+void CpuCounters::close_all() {
+    close_counter(thread_cycles_);
+    close_counter(thread_instructions_);
+    close_counter(thread_switches_);
+    for (int& fd : system_cycles_) {
+        close_counter(fd);
+    }
+    for (int& fd : system_instructions_) {
+        close_counter(fd);
+    }
+    system_cycles_.clear();
+    system_instructions_.clear();
+}
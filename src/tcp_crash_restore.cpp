@@ -0,0 +1,129 @@
+#include "tcp_crash_restore.h"
+
+#include <atomic>
+#include <mutex>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/netlink.h>
+
+namespace {
+
+// Each slot holds a descriptor and the bytes to send or write to it. Sysctl
+// slots own an fd opened on /proc/sys at registration, so the handler only
+// needs sendto() or pwrite().
+
+const int kCrashSlots = 64;
+const size_t kCrashMessageMax = 512;
+
+enum class RestoreKind { Netlink, Sysctl };
+
+struct CrashSlot {
+    std::atomic<int> fd;
+    RestoreKind kind;
+    size_t length;
+    char message[kCrashMessageMax];
+};
+
+CrashSlot crash_slots[kCrashSlots];
+std::mutex crash_slots_mutex;
+std::once_flag crash_handlers_once;
+
+const int kCrashSignals[] = {SIGINT, SIGTERM, SIGHUP, SIGQUIT, SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+
+void restore_all() {
+    for (auto& slot : crash_slots) {
+        int fd = slot.fd.exchange(-1);
+        if (fd < 0) {
+            continue;
+        }
+        if (slot.kind == RestoreKind::Netlink) {
+            struct sockaddr_nl kernel;
+            std::memset(&kernel, 0, sizeof(kernel));
+            kernel.nl_family = AF_NETLINK;
+            sendto(fd, slot.message, slot.length, 0,
+                   reinterpret_cast<struct sockaddr*>(&kernel), sizeof(kernel));
+        } else {
+            // Nothing more can be done if the write fails
+            ssize_t ignored = pwrite(fd, slot.message, slot.length, 0);
+            (void)ignored;
+            close(fd);
+        }
+    }
+}
+
+void crash_handler(int sig) {
+    restore_all();
+    // SA_RESETHAND restored the default action; deliver the signal again
+    raise(sig);
+}
+
+void install_crash_handlers() {
+    for (auto& slot : crash_slots) {
+        slot.fd.store(-1);
+    }
+
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = crash_handler;
+    action.sa_flags = SA_RESETHAND;
+    sigemptyset(&action.sa_mask);
+    for (int sig : kCrashSignals) {
+        sigaction(sig, &action, nullptr);
+    }
+    std::atexit(restore_all);
+}
+
+int register_restore(RestoreKind kind, int fd, const char* data, size_t length) {
+    std::call_once(crash_handlers_once, install_crash_handlers);
+    if (length > kCrashMessageMax) {
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(crash_slots_mutex);
+    for (int i = 0; i < kCrashSlots; i++) {
+        if (crash_slots[i].fd.load() < 0) {
+            std::memcpy(crash_slots[i].message, data, length);
+            crash_slots[i].length = length;
+            crash_slots[i].kind = kind;
+            crash_slots[i].fd.store(fd);
+            return i;
+        }
+    }
+    return -1;
+}
+
+} // namespace
+
+int register_netlink_restore(int fd, const std::vector<char>& message) {
+    if (fd < 0) {
+        return -1;
+    }
+    return register_restore(RestoreKind::Netlink, fd, message.data(), message.size());
+}
+
+int register_sysctl_restore(const std::string& name, const std::string& value) {
+    std::string path = "/proc/sys/" + name;
+    int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    int slot = register_restore(RestoreKind::Sysctl, fd, value.data(), value.size());
+    if (slot < 0) {
+        close(fd);
+    }
+    return slot;
+}
+
+void unregister_crash_restore(int slot) {
+    if (slot < 0) {
+        return;
+    }
+    int fd = crash_slots[slot].fd.exchange(-1);
+    if (fd >= 0 && crash_slots[slot].kind == RestoreKind::Sysctl) {
+        close(fd);
+    }
+}
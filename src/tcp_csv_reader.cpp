@@ -0,0 +1,142 @@
+#include "tcp_csv_reader.h"
+
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+#include <cstring>
+
+CsvReader::CsvReader() : cursor_(nullptr), end_(nullptr), line_(0) {}
+
+bool CsvReader::open(const std::string& path) {
+    header_.clear();
+    fields_.clear();
+    line_ = 0;
+    if (!file_.open(path)) {
+        return false;
+    }
+    cursor_ = file_.data();
+    end_ = cursor_ + file_.size();
+
+    if (cursor_ == end_) {
+        std::cerr << path << " is empty\n";
+        return false;
+    }
+
+    size_t count = split_line();
+    for (size_t i = 0; i < count; ++i) {
+        header_.emplace_back(fields_[i].first, fields_[i].second);
+    }
+    fields_.resize(header_.size());
+    return true;
+}
+
+int CsvReader::column(std::string_view name) const {
+    for (size_t i = 0; i < header_.size(); ++i) {
+        if (header_[i] == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+bool CsvReader::next() {
+    while (cursor_ < end_) {
+        size_t count = split_line();
+        // A bare line break leaves one empty field
+        if (count > 1 || fields_[0].second > 0) {
+            for (size_t i = count; i < fields_.size(); ++i) {
+                fields_[i] = {nullptr, 0};
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string_view CsvReader::field(int index) const {
+    if (index < 0 || static_cast<size_t>(index) >= fields_.size() || fields_[index].first == nullptr) {
+        return std::string_view();
+    }
+    return std::string_view(fields_[index].first, fields_[index].second);
+}
+
+bool CsvReader::number(int index, double& value) const {
+    std::string_view text = field(index);
+    if (text.empty()) {
+        return false;
+    }
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+bool CsvReader::number(int index, uint64_t& value) const {
+    std::string_view text = field(index);
+    if (text.empty()) {
+        return false;
+    }
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (result.ec == std::errc() && result.ptr == text.data() + text.size()) {
+        return true;
+    }
+
+    // pandas writes integer columns that held a NaN as floats ("1234.0")
+    double real = 0.0;
+    if (!number(index, real) || real < 0.0) {
+        return false;
+    }
+    value = static_cast<uint64_t>(real);
+    return true;
+}
+
+size_t CsvReader::split_line() {
+    ++line_;
+    size_t count = 0;
+    for (;;) {
+        const char* start = cursor_;
+        const char* stop = nullptr;
+        const char* next = nullptr;
+
+        if (cursor_ < end_ && *cursor_ == '"') {
+            // Quoted field: runs to the first quote not followed by another
+            const char* p = cursor_ + 1;
+            for (;;) {
+                p = static_cast<const char*>(std::memchr(p, '"', static_cast<size_t>(end_ - p)));
+                if (p == nullptr || p + 1 >= end_ || p[1] != '"') {
+                    break;
+                }
+                p += 2;
+            }
+            start = cursor_ + 1;
+            stop = p != nullptr ? p : end_;
+            next = std::min(stop + 1, end_);
+        } else {
+            next = cursor_;
+            while (next < end_ && *next != ',' && *next != '\n') {
+                ++next;
+            }
+            stop = next;
+        }
+
+        // Skip anything between a closing quote and the separator
+        while (next < end_ && *next != ',' && *next != '\n') {
+            ++next;
+        }
+
+        size_t length = static_cast<size_t>(stop - start);
+        if (length > 0 && start[length - 1] == '\r' && (next >= end_ || *next == '\n')) {
+            --length;
+        }
+        if (count < fields_.size()) {
+            fields_[count] = {start, length};
+        } else if (header_.empty()) {
+            fields_.emplace_back(start, length);  // Only while reading the header
+        }
+        ++count;
+
+        if (next >= end_ || *next == '\n') {
+            cursor_ = next < end_ ? next + 1 : end_;
+            return std::min(count, std::max<size_t>(fields_.size(), 1));
+        }
+        cursor_ = next + 1;
+    }
+}
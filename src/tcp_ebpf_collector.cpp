@@ -0,0 +1,373 @@
+#include "tcp_ebpf_collector.h"
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <sys/socket.h>
+
+#if defined(ENABLE_EBPF_METRICS)
+#include <cstdarg>
+#include <bpf/btf.h>
+#include <bpf/libbpf.h>
+#include "tcp_metrics.skel.h"
+#endif
+
+double ebpf_histogram_quantile(const EbpfHistogram& histogram, double quantile) {
+    uint64_t total = 0;
+    for (uint64_t count : histogram) {
+        total += count;
+    }
+    if (total == 0) {
+        return 0.0;
+    }
+
+    // Report the geometric middle of the bucket holding the quantile
+    uint64_t rank = static_cast<uint64_t>(std::ceil(quantile * static_cast<double>(total)));
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t seen = 0;
+    for (size_t slot = 0; slot < histogram.size(); ++slot) {
+        seen += histogram[slot];
+        if (seen >= rank) {
+            return slot == 0 ? 1.0 : std::ldexp(std::sqrt(2.0), static_cast<int>(slot));
+        }
+    }
+    return std::ldexp(1.0, static_cast<int>(histogram.size()));
+}
+
+EbpfCollector::EbpfCollector()
+    : skel_(nullptr), ring_(nullptr), cell_(0), event_sampling_(0), cookie_(0), cong_control_hooked_(false),
+      events_(0), last_sample_ns_(0), last_bytes_acked_(0), peak_interval_mbps_(0.0), trace_(nullptr) {}
+
+#if defined(ENABLE_EBPF_METRICS)
+
+namespace {
+
+// libbpf warnings are useful, its debug chatter is not
+int print_libbpf(enum libbpf_print_level level, const char* format, va_list args) {
+    if (level == LIBBPF_DEBUG) {
+        return 0;
+    }
+    return std::vfprintf(stderr, format, args);
+}
+
+uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+template <size_t N>
+void add_histogram(std::array<uint64_t, N>& into, const __u64 (&from)[N]) {
+    for (size_t i = 0; i < N; ++i) {
+        into[i] += from[i];
+    }
+}
+
+// fentry/fexit programs only load if the target has BTF, which static
+// functions lose when they are inlined
+bool kernel_has_function(const char* name) {
+    struct btf* vmlinux = btf__load_vmlinux_btf();
+    if (vmlinux == nullptr) {
+        return false;
+    }
+    bool found = btf__find_by_name_kind(vmlinux, name, BTF_KIND_FUNC) >= 0;
+    btf__free(vmlinux);
+    return found;
+}
+
+const char* event_kind_name(uint32_t kind) {
+    switch (kind) {
+        case TCP_METRICS_PROBE:        return "probe";
+        case TCP_METRICS_RETRANSMIT:   return "retransmit";
+        case TCP_METRICS_CONG_CONTROL: return "cong_control";
+        default:                       return "unknown";
+    }
+}
+
+} // namespace
+
+EbpfCollector::~EbpfCollector() {
+    close_trace();
+    ring_buffer__free(ring_);
+    tcp_metrics_bpf__destroy(skel_);
+}
+
+bool EbpfCollector::available() {
+    return true;
+}
+
+bool EbpfCollector::open() {
+    if (skel_ != nullptr) {
+        return true;
+    }
+
+    libbpf_set_print(print_libbpf);
+
+    int cpus = libbpf_num_possible_cpus();
+    if (cpus <= 0) {
+        std::cerr << "Failed to count possible CPUs: " << std::strerror(-cpus) << std::endl;
+        return false;
+    }
+    percpu_values_.assign(static_cast<size_t>(cpus) * sizeof(struct tcp_flow_stats), 0);
+
+    skel_ = tcp_metrics_bpf__open();
+    if (skel_ == nullptr) {
+        std::cerr << "Failed to open eBPF programs: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    cong_control_hooked_ = kernel_has_function("tcp_cong_control");
+    if (!cong_control_hooked_) {
+        bpf_program__set_autoload(skel_->progs.on_tcp_cong_control, false);
+    }
+
+    int err = tcp_metrics_bpf__load(skel_);
+    if (err < 0) {
+        std::cerr << "Failed to load eBPF programs: " << std::strerror(-err)
+                  << " (root or CAP_BPF and CAP_PERFMON, and kernel BTF are required)" << std::endl;
+        tcp_metrics_bpf__destroy(skel_);
+        skel_ = nullptr;
+        return false;
+    }
+
+    skel_->links.on_tcp_probe = bpf_program__attach(skel_->progs.on_tcp_probe);
+    skel_->links.on_tcp_retransmit_skb = bpf_program__attach(skel_->progs.on_tcp_retransmit_skb);
+    if (skel_->links.on_tcp_probe == nullptr || skel_->links.on_tcp_retransmit_skb == nullptr) {
+        std::cerr << "Failed to attach to the tcp tracepoints: " << std::strerror(errno) << std::endl;
+        tcp_metrics_bpf__destroy(skel_);
+        skel_ = nullptr;
+        return false;
+    }
+
+    if (cong_control_hooked_) {
+        skel_->links.on_tcp_cong_control = bpf_program__attach(skel_->progs.on_tcp_cong_control);
+        cong_control_hooked_ = skel_->links.on_tcp_cong_control != nullptr;
+    }
+    if (!cong_control_hooked_) {
+        std::cerr << "tcp_cong_control cannot be traced on this kernel, "
+                  << "sampling cwnd on incoming segments" << std::endl;
+    }
+
+    ring_ = ring_buffer__new(bpf_map__fd(skel_->maps.events), handle_event, this, nullptr);
+    if (ring_ == nullptr) {
+        std::cerr << "Failed to open eBPF ring buffer: " << std::strerror(errno) << std::endl;
+        tcp_metrics_bpf__destroy(skel_);
+        skel_ = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool EbpfCollector::write_config() {
+    struct tcp_metrics_config value;
+    std::memset(&value, 0, sizeof(value));
+    value.event_sampling = event_sampling_;
+    value.cong_control_hooked = cong_control_hooked_ ? 1 : 0;
+
+    uint32_t key = 0;
+    int err = bpf_map__update_elem(skel_->maps.config, &key, sizeof(key),
+                                   &value, sizeof(value), BPF_ANY);
+    if (err < 0) {
+        std::cerr << "Failed to update eBPF config: " << std::strerror(-err) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool EbpfCollector::begin_cell(int socket_fd, const std::string& trace_path, const std::string& algorithm) {
+    close_trace();
+    if (skel_ == nullptr || !write_config()) {
+        return false;
+    }
+
+    // The same cookie the programs get from bpf_get_socket_cookie()
+    uint64_t cookie = 0;
+    socklen_t len = sizeof(cookie);
+    if (getsockopt(socket_fd, SOL_SOCKET, SO_COOKIE, &cookie, &len) < 0) {
+        std::cerr << "Failed to read socket cookie: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Events still queued from the previous cell carry the old number
+    ++cell_;
+    cookie_ = cookie;
+    events_ = 0;
+    last_sample_ns_ = 0;
+    last_bytes_acked_ = 0;
+    peak_interval_mbps_ = 0.0;
+
+    bpf_map__delete_elem(skel_->maps.flow_stats, &cookie_, sizeof(cookie_), 0);
+    int err = bpf_map__update_elem(skel_->maps.watched, &cookie_, sizeof(cookie_),
+                                   &cell_, sizeof(cell_), BPF_ANY);
+    if (err < 0) {
+        std::cerr << "Failed to register socket with eBPF: " << std::strerror(-err) << std::endl;
+        return false;
+    }
+
+    // The events are still counted when their trace cannot be written
+    if (event_sampling_ > 0 && !trace_path.empty()) {
+        trace_ = std::fopen(trace_path.c_str(), "w");
+        if (trace_ == nullptr) {
+            std::cerr << "Failed to create " << trace_path << ": " << std::strerror(errno) << std::endl;
+        } else {
+            trace_path_ = trace_path;
+            trace_algorithm_ = algorithm;
+            std::fprintf(trace_, "timestamp,src_port,dst_port,cc_algo,rtt_us,rttvar_us,cwnd,ssthresh,rwnd,"
+                                 "lost_packets,retrans_packets,bytes_sent,bytes_acked,event\n");
+        }
+    }
+    return true;
+}
+
+bool EbpfCollector::sample(EbpfFlowStats& stats) {
+    stats = EbpfFlowStats();
+    if (skel_ == nullptr) {
+        return false;
+    }
+
+    int err = bpf_map__lookup_elem(skel_->maps.flow_stats, &cookie_, sizeof(cookie_),
+                                   percpu_values_.data(), percpu_values_.size(), 0);
+    if (err < 0) {
+        return false;  // No sample for this flow yet
+    }
+
+    size_t cpus = percpu_values_.size() / sizeof(struct tcp_flow_stats);
+    for (size_t cpu = 0; cpu < cpus; ++cpu) {
+        struct tcp_flow_stats value;
+        std::memcpy(&value, percpu_values_.data() + cpu * sizeof(value), sizeof(value));
+        stats.samples += value.samples;
+        stats.srtt_sum_us += value.srtt_sum_us;
+        stats.mdev_sum_us += value.mdev_sum_us;
+        stats.lost_out_sum += value.lost_out_sum;
+        stats.retrans_out_sum += value.retrans_out_sum;
+        stats.bytes_acked = std::max<uint64_t>(stats.bytes_acked, value.bytes_acked);
+        stats.retransmits += value.retransmits;
+        stats.cwnd_samples += value.cwnd_samples;
+        stats.snd_cwnd_max = std::max<uint32_t>(stats.snd_cwnd_max, value.snd_cwnd_max);
+        stats.lost_out_max = std::max<uint32_t>(stats.lost_out_max, value.lost_out_max);
+        stats.retrans_out_max = std::max<uint32_t>(stats.retrans_out_max, value.retrans_out_max);
+        add_histogram(stats.srtt_hist, value.srtt_hist);
+        add_histogram(stats.mdev_hist, value.mdev_hist);
+        add_histogram(stats.cwnd_hist, value.cwnd_hist);
+    }
+
+    // Delivery rate between consecutive reads
+    uint64_t now = now_ns();
+    if (last_sample_ns_ != 0 && now > last_sample_ns_ && stats.bytes_acked >= last_bytes_acked_) {
+        double seconds = static_cast<double>(now - last_sample_ns_) / 1e9;
+        double mbps = static_cast<double>(stats.bytes_acked - last_bytes_acked_) * 8.0 / seconds / 1e6;
+        peak_interval_mbps_ = std::max(peak_interval_mbps_, mbps);
+    }
+    last_sample_ns_ = now;
+    last_bytes_acked_ = stats.bytes_acked;
+    return true;
+}
+
+void EbpfCollector::poll(int timeout_ms) {
+    if (ring_ != nullptr) {
+        ring_buffer__poll(ring_, timeout_ms);
+    }
+}
+
+EbpfCellSummary EbpfCollector::end_cell() {
+    EbpfCellSummary summary;
+    if (skel_ == nullptr) {
+        return summary;
+    }
+
+    bpf_map__delete_elem(skel_->maps.watched, &cookie_, sizeof(cookie_), 0);
+    ring_buffer__consume(ring_);
+    close_trace();
+
+    EbpfFlowStats& flow = summary.flow;
+    if (sample(flow) && flow.samples > 0) {
+        summary.samples = flow.samples;
+        summary.mean_rtt_ms = static_cast<double>(flow.srtt_sum_us) / flow.samples / 1000.0;
+        summary.mean_rttvar_ms = static_cast<double>(flow.mdev_sum_us) / flow.samples / 1000.0;
+        summary.p50_rtt_ms = ebpf_histogram_quantile(flow.srtt_hist, 0.50) / 1000.0;
+        summary.p99_rtt_ms = ebpf_histogram_quantile(flow.srtt_hist, 0.99) / 1000.0;
+        summary.max_cwnd = flow.snd_cwnd_max;
+        summary.max_lost_out = flow.lost_out_max;
+        summary.max_retrans_out = flow.retrans_out_max;
+        summary.retransmits = flow.retransmits;
+    }
+    summary.events = events_;
+    summary.peak_interval_mbps = peak_interval_mbps_;
+
+    // The flow's entry is not needed once the cell is summarised
+    bpf_map__delete_elem(skel_->maps.flow_stats, &cookie_, sizeof(cookie_), 0);
+    return summary;
+}
+
+int EbpfCollector::handle_event(void* ctx, void* data, size_t size) {
+    EbpfCollector* self = static_cast<EbpfCollector*>(ctx);
+    if (size < sizeof(struct tcp_metrics_event)) {
+        return 0;
+    }
+
+    const struct tcp_metrics_event* event = static_cast<const struct tcp_metrics_event*>(data);
+    if (event->cell != self->cell_) {
+        return 0;
+    }
+    ++self->events_;
+    if (self->trace_ != nullptr) {
+        std::fprintf(self->trace_, "%llu,%u,%u,%s,%u,%u,%u,%u,%u,%u,%u,%llu,%llu,%s\n",
+                     static_cast<unsigned long long>(event->ts_ns), event->sport, event->dport,
+                     self->trace_algorithm_.c_str(), event->srtt_us, event->mdev_us, event->snd_cwnd,
+                     event->snd_ssthresh, event->rcv_wnd, event->lost_out, event->retrans_out,
+                     static_cast<unsigned long long>(event->bytes_sent),
+                     static_cast<unsigned long long>(event->bytes_acked), event_kind_name(event->kind));
+    }
+    return 0;
+}
+
+void EbpfCollector::close_trace() {
+    if (trace_ == nullptr) {
+        return;
+    }
+    if (std::fclose(trace_) != 0) {
+        std::cerr << "Failed to write " << trace_path_ << ": " << std::strerror(errno) << std::endl;
+    }
+    trace_ = nullptr;
+}
+
+#else // !ENABLE_EBPF_METRICS
+
+EbpfCollector::~EbpfCollector() {}
+
+bool EbpfCollector::available() {
+    return false;
+}
+
+bool EbpfCollector::open() {
+    return false;
+}
+
+bool EbpfCollector::begin_cell(int, const std::string&, const std::string&) {
+    return false;
+}
+
+bool EbpfCollector::sample(EbpfFlowStats& stats) {
+    stats = EbpfFlowStats();
+    return false;
+}
+
+void EbpfCollector::poll(int) {}
+
+EbpfCellSummary EbpfCollector::end_cell() {
+    return EbpfCellSummary();
+}
+
+int EbpfCollector::handle_event(void*, void*, size_t) {
+    return 0;
+}
+
+bool EbpfCollector::write_config() {
+    return false;
+}
+
+void EbpfCollector::close_trace() {}
+
+#endif // ENABLE_EBPF_METRICS
@@ -24,7 +24,9 @@ struct tcp_metrics_t {
 };
 
 BPF_PERF_OUTPUT(tcp_metrics_events);
-BPF_HASH(flow_metrics, u32, struct tcp_metrics_t);
+// Keyed by socket address: in softirq context the current PID belongs to
+// whatever task happens to be running, not to the flow
+BPF_TABLE("lru_hash", u64, struct tcp_metrics_t, flow_metrics, 10240);
 
 // Probe tcp_rcv_established to track received packets
 int kprobe__tcp_rcv_established(struct pt_regs *ctx, struct sock *sk, struct sk_buff *skb)
@@ -68,7 +70,7 @@ int kprobe__tcp_rcv_established(struct pt_regs *ctx, struct sock *sk, struct sk_
                       tp->icsk_ca_ops->name);
     
     // Store metrics by socket address
-    u32 key = pid;
+    u64 key = (u64)sk;
     flow_metrics.update(&key, &metrics);
     
     // Emit event with metrics
@@ -82,12 +84,11 @@ int kprobe__tcp_cwnd_event(struct pt_regs *ctx, struct sock *sk, enum tcp_cm_eve
     if (sk == NULL)
         return 0;
         
-    u32 pid = bpf_get_current_pid_tgid() >> 32;
     struct tcp_sock *tp = (struct tcp_sock *)sk;
     
     // Get metrics from flow_metrics and update
     struct tcp_metrics_t *metrics;
-    u32 key = pid;
+    u64 key = (u64)sk;
     metrics = flow_metrics.lookup(&key);
     if (metrics) {
         metrics->cwnd = tp->snd_cwnd;
@@ -0,0 +1,542 @@
+#include "tcp_flow_churn.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/tcp.h>
+
+#include "tcp_flow_mux.h"
+#include "tcp_socket_options.h"
+
+namespace {
+
+// Upper bounds of the first kChurnBuckets - 1 size buckets, in bytes
+const uint64_t kBucketLimits[kChurnBuckets - 1] = {10000, 100000, 1000000, 10000000};
+const char* const kBucketNames[kChurnBuckets] = {
+    "0-10KB", "10KB-100KB", "100KB-1MB", "1MB-10MB", ">10MB",
+};
+
+// Web search flow sizes of the DCTCP paper and data mining flow sizes of
+// VL2, as (bytes, CDF) in the form the pFabric and HPCC generators use
+const std::vector<std::pair<double, double>> kWebSearchCdf = {
+    {0, 0.0}, {10000, 0.15}, {20000, 0.2}, {30000, 0.3}, {50000, 0.4}, {80000, 0.53},
+    {200000, 0.6}, {1000000, 0.7}, {2000000, 0.8}, {5000000, 0.9}, {10000000, 0.97},
+    {30000000, 1.0},
+};
+const std::vector<std::pair<double, double>> kDataMiningCdf = {
+    {1460, 0.0}, {1460, 0.5}, {2920, 0.6}, {4380, 0.7}, {10220, 0.8}, {389820, 0.9},
+    {3076220, 0.95}, {97333820, 0.99}, {973333820, 1.0},
+};
+
+// Events handled per epoll_wait() and the longest wait without one, so the
+// arrival schedule and TIME_WAIT sampling stay on time
+const int kChurnMaxEvents = 256;
+const int kChurnMaxWaitMs = 100;
+const uint64_t kTimeWaitIntervalNs = 100 * 1000 * 1000;
+
+// Shared payload and receive buffers
+const size_t kChurnBufferSize = 256 * 1024;
+
+const uint64_t kListenerTag = UINT64_MAX;
+const size_t kHeaderSize = sizeof(uint64_t);
+
+uint64_t monotonic_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// TIME_WAIT sockets of this network namespace, from /proc/net/sockstat
+uint32_t time_wait_sockets() {
+    std::ifstream sockstat("/proc/net/sockstat");
+    std::string line;
+    while (std::getline(sockstat, line)) {
+        if (line.compare(0, 4, "TCP:") != 0) {
+            continue;
+        }
+        std::istringstream fields(line.substr(4));
+        std::string key;
+        uint32_t value = 0;
+        while (fields >> key >> value) {
+            if (key == "tw") {
+                return value;
+            }
+        }
+    }
+    return 0;
+}
+
+uint32_t ephemeral_port_count() {
+    std::ifstream range("/proc/sys/net/ipv4/ip_local_port_range");
+    uint32_t low = 0;
+    uint32_t high = 0;
+    if (!(range >> low >> high) || high < low) {
+        return 0;
+    }
+    return high - low + 1;
+}
+
+} // namespace
+
+size_t churn_bucket(uint64_t bytes) {
+    size_t bucket = 0;
+    while (bucket < kChurnBuckets - 1 && bytes > kBucketLimits[bucket]) {
+        ++bucket;
+    }
+    return bucket;
+}
+
+const char* churn_bucket_name(size_t bucket) {
+    return bucket < kChurnBuckets ? kBucketNames[bucket] : "";
+}
+
+bool FlowSizeDistribution::set_points(const std::vector<std::pair<double, double>>& points) {
+    if (points.empty() || std::fabs(points.back().second - 1.0) > 1e-6) {
+        return false;
+    }
+    for (size_t i = 0; i < points.size(); ++i) {
+        if (points[i].first < 0.0 || points[i].second < 0.0 ||
+            (i > 0 && (points[i].first < points[i - 1].first || points[i].second < points[i - 1].second))) {
+            return false;
+        }
+    }
+    points_ = points;
+    points_.back().second = 1.0;
+    return true;
+}
+
+bool FlowSizeDistribution::load(const std::string& name_or_path) {
+    if (name_or_path == "websearch") {
+        name_ = name_or_path;
+        return set_points(kWebSearchCdf);
+    }
+    if (name_or_path == "datamining") {
+        name_ = name_or_path;
+        return set_points(kDataMiningCdf);
+    }
+
+    std::ifstream file(name_or_path);
+    if (!file) {
+        std::cerr << "Cannot open flow size distribution " << name_or_path << std::endl;
+        return false;
+    }
+    std::vector<std::pair<double, double>> points;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        double bytes = 0.0;
+        double cdf = 0.0;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        if (!(fields >> bytes >> cdf)) {
+            std::cerr << "Bad line in " << name_or_path << ": " << line << std::endl;
+            return false;
+        }
+        points.emplace_back(bytes, cdf);
+    }
+    if (!set_points(points)) {
+        std::cerr << name_or_path << " is not a CDF: sizes and probabilities must not decrease "
+                  << "and the last probability must be 1\n";
+        return false;
+    }
+    name_ = name_or_path;
+    return true;
+}
+
+uint64_t FlowSizeDistribution::sample(double u) const {
+    if (points_.empty()) {
+        return 1;
+    }
+    // First point above u; steps (equal sizes) are taken as a whole
+    auto it = std::upper_bound(points_.begin(), points_.end(), u,
+                               [](double value, const std::pair<double, double>& point) {
+                                   return value < point.second;
+                               });
+    double bytes;
+    if (it == points_.end()) {
+        bytes = points_.back().first;
+    } else if (it == points_.begin()) {
+        bytes = it->first;
+    } else {
+        const auto& low = *(it - 1);
+        double fraction = (u - low.second) / (it->second - low.second);
+        bytes = low.first + fraction * (it->first - low.first);
+    }
+    return std::max<uint64_t>(1, static_cast<uint64_t>(bytes));
+}
+
+double FlowSizeDistribution::mean() const {
+    double sum = 0.0;
+    for (size_t i = 1; i < points_.size(); ++i) {
+        sum += (points_[i].second - points_[i - 1].second) * (points_[i].first + points_[i - 1].first) / 2.0;
+    }
+    return sum;
+}
+
+FlowChurn::FlowChurn(const ChurnConfig& config, const FlowSizeDistribution& sizes)
+    : config_(config),
+      sizes_(sizes),
+      listen_fd_(-1),
+      epoll_fd_(-1),
+      active_(0),
+      send_buffer_(kChurnBufferSize, 'x'),
+      recv_buffer_(kChurnBufferSize) {
+    config_.max_active = std::max<size_t>(config_.max_active, 1);
+}
+
+FlowChurn::~FlowChurn() {
+    for (size_t fd = 0; fd < connections_.size(); ++fd) {
+        if (connections_[fd].role != kUnused) {
+            close(static_cast<int>(fd));
+        }
+    }
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+    }
+    if (epoll_fd_ >= 0) {
+        close(epoll_fd_);
+    }
+}
+
+bool FlowChurn::open_listener() {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        std::cerr << "Failed to create churn listener: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    int one = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(config_.port);
+    if (bind(listen_fd_, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0 ||
+        listen(listen_fd_, SOMAXCONN) < 0) {
+        std::cerr << "Failed to listen on churn port " << config_.port << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u64 = kListenerTag;
+    return epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event) == 0;
+}
+
+FlowChurn::Connection& FlowChurn::slot(int fd) {
+    if (static_cast<size_t>(fd) >= connections_.size()) {
+        connections_.resize(std::max<size_t>(static_cast<size_t>(fd) + 1, connections_.size() * 2));
+    }
+    return connections_[static_cast<size_t>(fd)];
+}
+
+uint64_t FlowChurn::tag(int fd) {
+    return (static_cast<uint64_t>(connections_[static_cast<size_t>(fd)].generation) << 32) |
+           static_cast<uint32_t>(fd);
+}
+
+bool FlowChurn::run(double seconds, ChurnStats& stats) {
+    stats = ChurnStats();
+    stats.ephemeral_ports = ephemeral_port_count();
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0 || !open_listener()) {
+        return false;
+    }
+
+    // Check the algorithm once with a read-back; every flow then only pays
+    // for the setsockopt()
+    if (!config_.algorithm.empty()) {
+        int probe = socket(AF_INET, SOCK_STREAM, 0);
+        bool ok = probe >= 0 && set_socket_congestion(probe, config_.algorithm);
+        if (probe >= 0) {
+            close(probe);
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    reserve_descriptors(2 * config_.max_active + 16);
+    connections_.resize(4 * config_.max_active + 64);
+
+    std::mt19937_64 rng(config_.seed);
+    std::exponential_distribution<double> gap(config_.rate);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    uint64_t setup_ns = 0;
+    uint64_t start = monotonic_ns();
+    uint64_t arrivals_end = start + static_cast<uint64_t>(seconds * 1e9);
+    uint64_t drain_end = arrivals_end + static_cast<uint64_t>(config_.drain_seconds * 1e9);
+    double next_arrival = static_cast<double>(start) + gap(rng) * 1e9;
+    uint64_t next_sample = start;
+    struct epoll_event events[kChurnMaxEvents];
+
+    for (;;) {
+        uint64_t now = monotonic_ns();
+        while (next_arrival <= static_cast<double>(now) && next_arrival < static_cast<double>(arrivals_end)) {
+            stats.arrivals++;
+            if (active_ >= config_.max_active) {
+                stats.dropped++;
+            } else {
+                uint64_t before = monotonic_ns();
+                start_flow(sizes_.sample(uniform(rng)), stats);
+                setup_ns += monotonic_ns() - before;
+            }
+            next_arrival += gap(rng) * 1e9;
+        }
+        if (now >= next_sample) {
+            stats.peak_time_wait = std::max(stats.peak_time_wait, time_wait_sockets());
+            next_sample = now + kTimeWaitIntervalNs;
+        }
+        if (now >= drain_end || (now >= arrivals_end && active_ == 0)) {
+            break;
+        }
+
+        int wait_ms = kChurnMaxWaitMs;
+        if (next_arrival < static_cast<double>(arrivals_end)) {
+            double until = std::max(0.0, next_arrival - static_cast<double>(now)) / 1e6;
+            wait_ms = std::min(wait_ms, static_cast<int>(std::ceil(until)));
+        }
+        int ready = epoll_wait(epoll_fd_, events, kChurnMaxEvents, wait_ms);
+        if (ready < 0 && errno != EINTR) {
+            std::cerr << "Churn epoll_wait failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        for (int i = 0; i < ready; ++i) {
+            uint64_t event_tag = events[i].data.u64;
+            if (event_tag == kListenerTag) {
+                accept_flows();
+                continue;
+            }
+            int fd = static_cast<int>(event_tag & 0xffffffffu);
+            if (static_cast<size_t>(fd) >= connections_.size() || tag(fd) != event_tag) {
+                continue;  // Closed earlier in this batch
+            }
+            if (connections_[static_cast<size_t>(fd)].role == kClient) {
+                on_client(fd, events[i].events, stats);
+            } else if (connections_[static_cast<size_t>(fd)].role == kServer) {
+                on_server(fd);
+            }
+        }
+    }
+
+    stats.elapsed_seconds = std::min(seconds, (monotonic_ns() - start) / 1e9);
+    stats.unfinished = active_;
+    uint64_t setups = stats.arrivals - stats.dropped;
+    stats.setup_cpu_us = setups > 0 ? setup_ns / 1000.0 / static_cast<double>(setups) : 0.0;
+    stats.peak_time_wait = std::max(stats.peak_time_wait, time_wait_sockets());
+
+    for (size_t fd = 0; fd < connections_.size(); ++fd) {
+        if (connections_[fd].role != kUnused) {
+            close_connection(static_cast<int>(fd));
+        }
+    }
+    active_ = 0;
+    close(listen_fd_);
+    listen_fd_ = -1;
+    return true;
+}
+
+void FlowChurn::start_flow(uint64_t size, ChurnStats& stats) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        stats.failed++;
+        return;
+    }
+    if (!config_.algorithm.empty() &&
+        setsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, config_.algorithm.c_str(),
+                   static_cast<socklen_t>(config_.algorithm.size())) < 0) {
+        stats.failed++;
+        close(fd);
+        return;
+    }
+
+    uint64_t started = monotonic_ns();
+    struct sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(config_.port);
+    if (connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0 && errno != EINPROGRESS) {
+        if (errno == EADDRNOTAVAIL) {
+            stats.port_exhausted++;
+        }
+        stats.failed++;
+        close(fd);
+        return;
+    }
+
+    Connection& conn = slot(fd);
+    conn.role = kClient;
+    conn.phase = kConnecting;
+    conn.generation++;
+    conn.size = size;
+    conn.done = 0;
+    conn.started_ns = started;
+    conn.header = size;
+
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+    event.data.u64 = tag(fd);
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+        stats.failed++;
+        close_connection(fd);
+        return;
+    }
+    active_++;
+}
+
+void FlowChurn::accept_flows() {
+    for (;;) {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            return;  // EAGAIN: backlog drained, or out of descriptors
+        }
+        Connection& conn = slot(fd);
+        conn.role = kServer;
+        conn.phase = kReceiving;
+        conn.generation++;
+        conn.size = 0;
+        conn.done = 0;
+        conn.header = 0;
+
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLET;
+        event.data.u64 = tag(fd);
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+            close_connection(fd);
+        }
+    }
+}
+
+void FlowChurn::on_client(int fd, uint32_t events, ChurnStats& stats) {
+    Connection& conn = connections_[static_cast<size_t>(fd)];
+    if (conn.phase == kConnecting) {
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error != 0) {
+            if (error == EADDRNOTAVAIL) {
+                stats.port_exhausted++;
+            }
+            finish_client(fd, false, stats);
+            return;
+        }
+        if (!(events & EPOLLOUT)) {
+            return;
+        }
+        stats.connect_us.record((monotonic_ns() - conn.started_ns) / 1000);
+        conn.phase = kSending;
+    }
+
+    if (conn.phase == kSending && (events & EPOLLOUT) && !send_flow(fd, conn)) {
+        finish_client(fd, false, stats);
+        return;
+    }
+
+    if (conn.phase == kAwaitingReply && (events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+        char reply;
+        ssize_t n = recv(fd, &reply, 1, 0);
+        if (n == 1) {
+            stats.fct_us[churn_bucket(conn.size)].record((monotonic_ns() - conn.started_ns) / 1000);
+            stats.bytes += conn.size;
+            finish_client(fd, true, stats);
+        } else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+            finish_client(fd, false, stats);
+        }
+    } else if (events & (EPOLLERR | EPOLLHUP)) {
+        finish_client(fd, false, stats);
+    }
+}
+
+bool FlowChurn::send_flow(int fd, Connection& conn) {
+    uint64_t total = kHeaderSize + conn.size;
+    while (conn.done < total) {
+        ssize_t n;
+        if (conn.done < kHeaderSize) {
+            const char* header = reinterpret_cast<const char*>(&conn.header);
+            n = send(fd, header + conn.done, kHeaderSize - conn.done, MSG_NOSIGNAL | MSG_MORE);
+        } else {
+            size_t chunk = static_cast<size_t>(std::min<uint64_t>(send_buffer_.size(), total - conn.done));
+            n = send(fd, send_buffer_.data(), chunk, MSG_NOSIGNAL);
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        conn.done += static_cast<uint64_t>(n);
+    }
+    conn.phase = kAwaitingReply;
+    return true;
+}
+
+void FlowChurn::on_server(int fd) {
+    Connection& conn = connections_[static_cast<size_t>(fd)];
+    for (;;) {
+        ssize_t n = recv(fd, recv_buffer_.data(), recv_buffer_.size(), 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                close_connection(fd);
+            }
+            return;
+        }
+        if (n == 0) {
+            close_connection(fd);  // The client closed after the reply
+            return;
+        }
+
+        // The header arrives first and may be split across reads
+        if (conn.done < kHeaderSize) {
+            size_t take = std::min(kHeaderSize - static_cast<size_t>(conn.done), static_cast<size_t>(n));
+            std::memcpy(reinterpret_cast<char*>(&conn.header) + conn.done, recv_buffer_.data(), take);
+            if (conn.done + take == kHeaderSize) {
+                conn.size = conn.header;
+            }
+        }
+        conn.done += static_cast<uint64_t>(n);
+
+        if (conn.phase == kReceiving && conn.done >= kHeaderSize && conn.done >= kHeaderSize + conn.size) {
+            char reply = 'k';
+            if (send(fd, &reply, 1, MSG_NOSIGNAL) != 1) {
+                close_connection(fd);
+                return;
+            }
+            conn.phase = kReplied;
+        }
+    }
+}
+
+void FlowChurn::finish_client(int fd, bool completed, ChurnStats& stats) {
+    if (!completed) {
+        stats.failed++;
+    } else {
+        stats.completed++;
+    }
+    close_connection(fd);
+    active_--;
+}
+
+void FlowChurn::close_connection(int fd) {
+    // close() also drops the descriptor from the epoll set
+    connections_[static_cast<size_t>(fd)].role = kUnused;
+    close(fd);
+}
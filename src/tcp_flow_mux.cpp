@@ -0,0 +1,397 @@
+#include "tcp_flow_mux.h"
+
+#include <algorithm>
+#include <iostream>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/tcp.h>
+
+namespace {
+
+// Per worker: receive buffer and events handled per epoll_wait()
+const size_t kMuxReceiveBuffer = 256 * 1024;
+const int kMuxMaxEvents = 256;
+
+// Longest a worker sleeps without an event, so stop() is never late
+const int kMuxMaxWaitMs = 100;
+
+// Event tags: flow index shifted left, low bit set for the receiver socket
+const uint64_t kWakeTag = UINT64_MAX;
+
+uint64_t send_tag(size_t flow) {
+    return static_cast<uint64_t>(flow) << 1;
+}
+
+uint64_t receive_tag(size_t flow) {
+    return (static_cast<uint64_t>(flow) << 1) | 1;
+}
+
+bool set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+// Parse a non-negative number filling all of text
+bool parse_seconds(const std::string& text, double& value) {
+    char* end = nullptr;
+    value = std::strtod(text.c_str(), &end);
+    return !text.empty() && end == text.c_str() + text.size() && value >= 0.0 && std::isfinite(value);
+}
+
+} // namespace
+
+bool parse_contention_spec(const std::string& text, std::vector<ContentionFlowSpec>& flows) {
+    size_t begin = 0;
+    while (begin <= text.size()) {
+        size_t comma = text.find(',', begin);
+        std::string group = text.substr(begin, comma == std::string::npos ? std::string::npos : comma - begin);
+        begin = comma == std::string::npos ? text.size() + 1 : comma + 1;
+
+        // Split off the optional parts from the back: +DURATION, @START, :COUNT
+        ContentionFlowSpec spec;
+        long count = 1;
+        size_t plus = group.find('+');
+        if (plus != std::string::npos) {
+            if (!parse_seconds(group.substr(plus + 1), spec.duration_seconds) || spec.duration_seconds <= 0.0) {
+                std::cerr << "Bad duration in flow group '" << group << "'\n";
+                return false;
+            }
+            group.resize(plus);
+        }
+        size_t at = group.find('@');
+        if (at != std::string::npos) {
+            if (!parse_seconds(group.substr(at + 1), spec.start_seconds)) {
+                std::cerr << "Bad start offset in flow group '" << group << "'\n";
+                return false;
+            }
+            group.resize(at);
+        }
+        size_t colon = group.find(':');
+        if (colon != std::string::npos) {
+            char* end = nullptr;
+            count = std::strtol(group.c_str() + colon + 1, &end, 10);
+            if (end != group.c_str() + group.size() || count <= 0) {
+                std::cerr << "Bad flow count in flow group '" << group << "'\n";
+                return false;
+            }
+            group.resize(colon);
+        }
+        if (group.empty()) {
+            std::cerr << "Flow group without an algorithm in '" << text << "'\n";
+            return false;
+        }
+
+        spec.algorithm = group;
+        flows.insert(flows.end(), static_cast<size_t>(count), spec);
+    }
+    return !flows.empty();
+}
+
+bool reserve_descriptors(size_t descriptors) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) < 0) {
+        return false;
+    }
+
+    // Open descriptors are not known cheaply; leave room for the usual few dozen
+    rlim_t wanted = static_cast<rlim_t>(descriptors) + 64;
+    if (limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < wanted) {
+        if (limit.rlim_max != RLIM_INFINITY && limit.rlim_max < wanted) {
+            std::cerr << "Open file limit " << limit.rlim_max << " is too low for " << descriptors
+                      << " sockets\n";
+            return false;
+        }
+        limit.rlim_cur = wanted;
+        if (setrlimit(RLIMIT_NOFILE, &limit) < 0) {
+            std::cerr << "Failed to raise the open file limit: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+double MuxFlowStats::goodput_mbps() const {
+    double seconds = ended_seconds - started_seconds;
+    return seconds > 0.0 ? bytes_received * 8.0 / seconds / 1e6 : 0.0;
+}
+
+FlowMux::FlowMux(size_t message_size, int workers)
+    : message_size_(message_size > 0 ? message_size : 128 * 1024),
+      requested_workers_(workers),
+      wake_fd_(-1),
+      stop_requested_(false),
+      running_(false) {
+    // Payload content is irrelevant and shared read-only by every worker
+    send_buffer_.assign(message_size_, 'x');
+}
+
+FlowMux::~FlowMux() {
+    if (running_) {
+        stop();
+    }
+    for (auto& worker : workers_) {
+        if (worker->epoll_fd >= 0) {
+            close(worker->epoll_fd);
+        }
+    }
+    if (wake_fd_ >= 0) {
+        close(wake_fd_);
+    }
+}
+
+size_t FlowMux::add_flow(int send_fd, int recv_fd, double start_seconds, double duration_seconds) {
+    double end_seconds = duration_seconds > 0.0 ? start_seconds + duration_seconds : 0.0;
+    flows_.push_back(std::make_unique<Flow>(send_fd, recv_fd, start_seconds, end_seconds));
+    return flows_.size() - 1;
+}
+
+double FlowMux::elapsed() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time_).count();
+}
+
+bool FlowMux::start() {
+    if (running_ || flows_.empty()) {
+        return running_;
+    }
+
+    int count = requested_workers_;
+    if (count <= 0) {
+        count = std::min(static_cast<int>(std::max(1u, std::thread::hardware_concurrency())), kMuxDefaultMaxWorkers);
+    }
+    count = std::min(count, static_cast<int>(flows_.size()));
+
+    wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wake_fd_ < 0) {
+        std::cerr << "Failed to create eventfd: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    for (int i = 0; i < count; ++i) {
+        auto worker = std::make_unique<Worker>();
+        worker->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u64 = kWakeTag;
+        if (worker->epoll_fd < 0 || epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, wake_fd_, &event) < 0) {
+            std::cerr << "Failed to set up epoll: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        worker->recv_buffer.resize(kMuxReceiveBuffer);
+        workers_.push_back(std::move(worker));
+    }
+
+    // Round-robin the flows, then order each worker's schedule
+    for (size_t i = 0; i < flows_.size(); ++i) {
+        Flow& flow = *flows_[i];
+        if (!set_nonblocking(flow.send_fd) || !set_nonblocking(flow.recv_fd)) {
+            std::cerr << "Failed to make flow " << i << " non-blocking\n";
+            return false;
+        }
+        Worker& worker = *workers_[i % workers_.size()];
+        worker.starts.push_back(i);
+        if (flow.end_seconds > 0.0) {
+            worker.ends.push_back(i);
+        }
+    }
+    for (auto& worker : workers_) {
+        std::stable_sort(worker->starts.begin(), worker->starts.end(), [this](size_t a, size_t b) {
+            return flows_[a]->start_seconds < flows_[b]->start_seconds;
+        });
+        std::stable_sort(worker->ends.begin(), worker->ends.end(), [this](size_t a, size_t b) {
+            return flows_[a]->end_seconds < flows_[b]->end_seconds;
+        });
+    }
+
+    stop_requested_.store(false, std::memory_order_relaxed);
+    start_time_ = std::chrono::steady_clock::now();
+    for (auto& worker : workers_) {
+        worker->thread = std::thread(&FlowMux::worker_loop, this, std::ref(*worker));
+    }
+    running_ = true;
+    return true;
+}
+
+void FlowMux::stop() {
+    if (!running_) {
+        return;
+    }
+
+    // Flows still sending end now; snapshot them before the workers stop
+    // reading, so draining does not count towards their window
+    double now = elapsed();
+    std::vector<uint64_t> received(flows_.size());
+    for (size_t i = 0; i < flows_.size(); ++i) {
+        received[i] = flows_[i]->received.load(std::memory_order_relaxed);
+    }
+
+    stop_requested_.store(true, std::memory_order_relaxed);
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_fd_, &one, sizeof(one));
+    (void)ignored;
+    for (auto& worker : workers_) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+    running_ = false;
+
+    for (size_t i = 0; i < flows_.size(); ++i) {
+        Flow& flow = *flows_[i];
+        if (flow.state.load(std::memory_order_relaxed) != kSending) {
+            continue;
+        }
+        struct tcp_info info;
+        socklen_t len = sizeof(info);
+        std::memset(&info, 0, sizeof(info));
+        if (getsockopt(flow.send_fd, IPPROTO_TCP, TCP_INFO, &info, &len) == 0) {
+            flow.stats.bytes_acked = info.tcpi_bytes_acked;
+            flow.stats.rtt_ms = info.tcpi_rtt / 1000.0;
+            flow.stats.retransmits = info.tcpi_total_retrans;
+        }
+        flow.stats.ended_seconds = now;
+        flow.stats.bytes_received = received[i];
+        flow.state.store(kDone, std::memory_order_relaxed);
+    }
+}
+
+void FlowMux::begin_flow(Worker& worker, size_t index) {
+    Flow& flow = *flows_[index];
+    flow.stats.started_seconds = elapsed();
+    flow.state.store(kSending, std::memory_order_relaxed);
+
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLET;
+    event.data.u64 = receive_tag(index);
+    bool ok = epoll_ctl(worker.epoll_fd, EPOLL_CTL_ADD, flow.recv_fd, &event) == 0;
+    event.events = EPOLLOUT | EPOLLET;
+    event.data.u64 = send_tag(index);
+    ok = ok && epoll_ctl(worker.epoll_fd, EPOLL_CTL_ADD, flow.send_fd, &event) == 0;
+    if (!ok) {
+        std::cerr << "Failed to start flow " << index << ": " << std::strerror(errno) << std::endl;
+    }
+}
+
+void FlowMux::end_flow(Worker& worker, size_t index) {
+    Flow& flow = *flows_[index];
+    if (flow.state.load(std::memory_order_relaxed) != kSending) {
+        return;
+    }
+
+    // The window closes here; the receiver keeps draining until EOF
+    struct tcp_info info;
+    socklen_t len = sizeof(info);
+    std::memset(&info, 0, sizeof(info));
+    if (getsockopt(flow.send_fd, IPPROTO_TCP, TCP_INFO, &info, &len) == 0) {
+        flow.stats.bytes_acked = info.tcpi_bytes_acked;
+        flow.stats.rtt_ms = info.tcpi_rtt / 1000.0;
+        flow.stats.retransmits = info.tcpi_total_retrans;
+    }
+    flow.stats.ended_seconds = elapsed();
+    flow.stats.bytes_received = flow.received.load(std::memory_order_relaxed);
+    flow.state.store(kDraining, std::memory_order_relaxed);
+
+    epoll_ctl(worker.epoll_fd, EPOLL_CTL_DEL, flow.send_fd, nullptr);
+    shutdown(flow.send_fd, SHUT_WR);
+}
+
+void FlowMux::send_more(size_t index) {
+    Flow& flow = *flows_[index];
+    if (flow.state.load(std::memory_order_relaxed) != kSending) {
+        return;
+    }
+
+    // Edge-triggered: fill the socket buffer until the kernel pushes back
+    for (;;) {
+        ssize_t n = send(flow.send_fd, send_buffer_.data(), message_size_, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n > 0) {
+            flow.stats.bytes_sent += static_cast<uint64_t>(n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            std::cerr << "Flow " << index << " sender error: " << std::strerror(errno) << std::endl;
+        }
+        return;
+    }
+}
+
+void FlowMux::receive(Worker& worker, size_t index) {
+    Flow& flow = *flows_[index];
+    uint64_t received = flow.received.load(std::memory_order_relaxed);
+    for (;;) {
+        ssize_t n = recv(flow.recv_fd, worker.recv_buffer.data(), worker.recv_buffer.size(), MSG_DONTWAIT);
+        if (n > 0) {
+            received += static_cast<uint64_t>(n);
+            flow.received.store(received, std::memory_order_relaxed);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n == 0) {
+            // Sender shut down and everything was read
+            epoll_ctl(worker.epoll_fd, EPOLL_CTL_DEL, flow.recv_fd, nullptr);
+            flow.state.store(kDone, std::memory_order_relaxed);
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            std::cerr << "Flow " << index << " receiver error: " << std::strerror(errno) << std::endl;
+        }
+        break;
+    }
+}
+
+void FlowMux::worker_loop(Worker& worker) {
+    std::vector<struct epoll_event> events(kMuxMaxEvents);
+    size_t next_start = 0;
+    size_t next_end = 0;
+
+    while (!stop_requested_.load(std::memory_order_relaxed)) {
+        // Start and end flows that are due, then sleep until the next one
+        double now = elapsed();
+        while (next_start < worker.starts.size() && flows_[worker.starts[next_start]]->start_seconds <= now) {
+            begin_flow(worker, worker.starts[next_start++]);
+        }
+        while (next_end < worker.ends.size() && flows_[worker.ends[next_end]]->end_seconds <= now) {
+            end_flow(worker, worker.ends[next_end++]);
+        }
+
+        double wake = now + kMuxMaxWaitMs / 1000.0;
+        if (next_start < worker.starts.size()) {
+            wake = std::min(wake, flows_[worker.starts[next_start]]->start_seconds);
+        }
+        if (next_end < worker.ends.size()) {
+            wake = std::min(wake, flows_[worker.ends[next_end]]->end_seconds);
+        }
+        int timeout = static_cast<int>(std::ceil(std::max(wake - now, 0.0) * 1000.0));
+
+        int count = epoll_wait(worker.epoll_fd, events.data(), kMuxMaxEvents, timeout);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "epoll_wait failed: " << std::strerror(errno) << std::endl;
+            return;
+        }
+        for (int i = 0; i < count; ++i) {
+            uint64_t tag = events[i].data.u64;
+            if (tag == kWakeTag) {
+                return;
+            }
+            size_t index = static_cast<size_t>(tag >> 1);
+            if (tag & 1) {
+                receive(worker, index);
+            } else {
+                send_more(index);
+            }
+        }
+    }
+}
@@ -0,0 +1,249 @@
+#include "tcp_info_sampler.h"
+
+#include <algorithm>
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <netinet/in.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <linux/tcp.h>
+
+#include "tcp_metrics_exporter.h"
+
+namespace {
+
+// Slack on top of the nominal ring size, in seconds of samples
+const int kCapacitySlackSeconds = 2;
+
+uint64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+struct timespec to_timespec(uint64_t ns) {
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(ns / 1000000000ull);
+    ts.tv_nsec = static_cast<long>(ns % 1000000000ull);
+    return ts;
+}
+
+// Older kernels fill a shorter struct; the fields they lack stay zero
+bool read_sample(int fd, uint64_t t_ns, TcpInfoSample& sample) {
+    struct tcp_info info;
+    socklen_t len = sizeof(info);
+    std::memset(&info, 0, sizeof(info));
+    if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) < 0) {
+        return false;
+    }
+
+    sample.t_ns = t_ns;
+    sample.rtt_us = info.tcpi_rtt;
+    sample.rttvar_us = info.tcpi_rttvar;
+    sample.snd_cwnd = info.tcpi_snd_cwnd;
+    sample.lost = info.tcpi_lost;
+    sample.total_retrans = info.tcpi_total_retrans;
+    sample.delivery_rate = info.tcpi_delivery_rate;
+    sample.pacing_rate = info.tcpi_pacing_rate;
+    sample.busy_time_us = info.tcpi_busy_time;
+    sample.rwnd_limited_us = info.tcpi_rwnd_limited;
+    sample.sndbuf_limited_us = info.tcpi_sndbuf_limited;
+    sample.bytes_acked = info.tcpi_bytes_acked;
+    return true;
+}
+
+} // namespace
+
+TcpInfoSampler::TcpInfoSampler(int rate_hz)
+    : rate_hz_(std::min(std::max(rate_hz, 1), kMaxTcpInfoSampleRate)),
+      stop_requested_(false), missed_(0), running_(false) {}
+
+TcpInfoSampler::~TcpInfoSampler() {
+    stop();
+}
+
+size_t TcpInfoSampler::capacity_for(int rate_hz, int seconds) {
+    rate_hz = std::min(std::max(rate_hz, 1), kMaxTcpInfoSampleRate);
+    return static_cast<size_t>(rate_hz) * static_cast<size_t>(std::max(seconds, 0) + kCapacitySlackSeconds);
+}
+
+size_t TcpInfoSampler::add_socket(int fd, size_t capacity, LiveFlow* live) {
+    rings_.push_back(std::make_unique<Ring>(fd, std::max<size_t>(capacity, 1), live));
+    return rings_.size() - 1;
+}
+
+bool TcpInfoSampler::start() {
+    if (running_) {
+        return true;
+    }
+    if (rings_.empty()) {
+        std::cerr << "TCP_INFO sampler has no sockets to sample\n";
+        return false;
+    }
+
+    stop_requested_.store(false, std::memory_order_relaxed);
+    missed_.store(0, std::memory_order_relaxed);
+    thread_ = std::thread(&TcpInfoSampler::sample_loop, this);
+    running_ = true;
+    return true;
+}
+
+void TcpInfoSampler::stop() {
+    if (running_) {
+        stop_requested_.store(true, std::memory_order_relaxed);
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        running_ = false;
+    }
+
+    // The flows are not live once sampling ends
+    for (auto& ring : rings_) {
+        if (ring->live != nullptr) {
+            ring->live->release();
+            ring->live = nullptr;
+        }
+    }
+}
+
+void TcpInfoSampler::sample_loop() {
+    // The default 50 us timer slack alone would halve a 10 kHz rate
+    prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+
+    const uint64_t period_ns = 1000000000ull / static_cast<uint64_t>(rate_hz_);
+    const uint64_t start_ns = monotonic_ns();
+    uint64_t deadline = start_ns;
+
+    while (!stop_requested_.load(std::memory_order_relaxed)) {
+        uint64_t now = monotonic_ns();
+        for (auto& ring : rings_) {
+            uint64_t written = ring->written.load(std::memory_order_relaxed);
+            TcpInfoSample& slot = ring->samples[written % ring->samples.size()];
+            if (read_sample(ring->fd, now - start_ns, slot)) {
+                // Publish the slot to readers of size()/at()
+                ring->written.store(written + 1, std::memory_order_release);
+                if (ring->live != nullptr) {
+                    ring->live->publish(slot);
+                }
+            }
+        }
+
+        // Absolute deadlines keep the rate exact; a round that overran
+        // drops the ticks it missed instead of bursting to catch up
+        deadline += period_ns;
+        now = monotonic_ns();
+        if (now >= deadline) {
+            uint64_t behind = (now - deadline) / period_ns + 1;
+            missed_.fetch_add(behind, std::memory_order_relaxed);
+            deadline += behind * period_ns;
+        }
+
+        struct timespec wake = to_timespec(deadline);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, nullptr) == EINTR) {
+        }
+    }
+}
+
+size_t TcpInfoSampler::size(size_t socket) const {
+    const Ring& ring = *rings_[socket];
+    uint64_t written = ring.written.load(std::memory_order_acquire);
+    return static_cast<size_t>(std::min<uint64_t>(written, ring.samples.size()));
+}
+
+const TcpInfoSample& TcpInfoSampler::at(size_t socket, size_t index) const {
+    const Ring& ring = *rings_[socket];
+    uint64_t written = ring.written.load(std::memory_order_acquire);
+    uint64_t oldest = written > ring.samples.size() ? written - ring.samples.size() : 0;
+    return ring.samples[(oldest + index) % ring.samples.size()];
+}
+
+TcpInfoSummary TcpInfoSampler::summarize(size_t socket) const {
+    TcpInfoSummary summary;
+    size_t count = size(socket);
+    if (count == 0) {
+        return summary;
+    }
+
+    uint64_t written = rings_[socket]->written.load(std::memory_order_acquire);
+    summary.samples = count;
+    summary.overwritten = written - count;
+
+    uint64_t rtt_sum = 0;
+    uint64_t rttvar_sum = 0;
+    uint32_t min_rtt = UINT32_MAX;
+    uint32_t max_rtt = 0;
+    double delivery_sum = 0.0;
+    double pacing_sum = 0.0;
+    uint64_t rate_samples = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const TcpInfoSample& s = at(socket, i);
+        rtt_sum += s.rtt_us;
+        rttvar_sum += s.rttvar_us;
+        min_rtt = std::min(min_rtt, s.rtt_us);
+        max_rtt = std::max(max_rtt, s.rtt_us);
+        summary.max_cwnd = std::max(summary.max_cwnd, s.snd_cwnd);
+        summary.max_lost = std::max(summary.max_lost, s.lost);
+        summary.max_delivery_mbps = std::max(summary.max_delivery_mbps, s.delivery_rate * 8.0 / 1e6);
+        // No rate estimate until the first ACK of the window
+        if (s.delivery_rate > 0) {
+            delivery_sum += s.delivery_rate * 8.0 / 1e6;
+            pacing_sum += s.pacing_rate * 8.0 / 1e6;
+            ++rate_samples;
+        }
+    }
+
+    summary.mean_rtt_ms = static_cast<double>(rtt_sum) / count / 1000.0;
+    summary.mean_rttvar_ms = static_cast<double>(rttvar_sum) / count / 1000.0;
+    summary.min_rtt_ms = min_rtt / 1000.0;
+    summary.max_rtt_ms = max_rtt / 1000.0;
+    if (rate_samples > 0) {
+        summary.mean_delivery_mbps = delivery_sum / rate_samples;
+        summary.mean_pacing_mbps = pacing_sum / rate_samples;
+    }
+
+    // The counters are cumulative, so the window is last minus first
+    const TcpInfoSample& first = at(socket, 0);
+    const TcpInfoSample& last = at(socket, count - 1);
+    summary.retransmits = last.total_retrans - first.total_retrans;
+    if (last.busy_time_us > first.busy_time_us) {
+        double busy = static_cast<double>(last.busy_time_us - first.busy_time_us);
+        summary.rwnd_limited = (last.rwnd_limited_us - first.rwnd_limited_us) / busy;
+        summary.sndbuf_limited = (last.sndbuf_limited_us - first.sndbuf_limited_us) / busy;
+    }
+    return summary;
+}
+
+void TcpInfoSampler::export_series(size_t socket, TcpInfoSeries& series) const {
+    size_t count = size(socket);
+    series = TcpInfoSeries();
+    series.t_ns.reserve(count);
+    series.rtt_us.reserve(count);
+    series.rttvar_us.reserve(count);
+    series.snd_cwnd.reserve(count);
+    series.lost.reserve(count);
+    series.total_retrans.reserve(count);
+    series.delivery_rate.reserve(count);
+    series.pacing_rate.reserve(count);
+    series.busy_time_us.reserve(count);
+    series.rwnd_limited_us.reserve(count);
+    series.sndbuf_limited_us.reserve(count);
+    series.bytes_acked.reserve(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        const TcpInfoSample& s = at(socket, i);
+        series.t_ns.push_back(s.t_ns);
+        series.rtt_us.push_back(s.rtt_us);
+        series.rttvar_us.push_back(s.rttvar_us);
+        series.snd_cwnd.push_back(s.snd_cwnd);
+        series.lost.push_back(s.lost);
+        series.total_retrans.push_back(s.total_retrans);
+        series.delivery_rate.push_back(s.delivery_rate);
+        series.pacing_rate.push_back(s.pacing_rate);
+        series.busy_time_us.push_back(s.busy_time_us);
+        series.rwnd_limited_us.push_back(s.rwnd_limited_us);
+        series.sndbuf_limited_us.push_back(s.sndbuf_limited_us);
+        series.bytes_acked.push_back(s.bytes_acked);
+    }
+}
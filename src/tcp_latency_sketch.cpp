@@ -0,0 +1,119 @@
+#include "tcp_latency_sketch.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const int kHalfBits = LatencySketch::kSubBucketBits - 1;
+const uint64_t kMaxValue = (uint64_t(1) << (LatencySketch::kMaxBucket + LatencySketch::kSubBucketBits)) - 1;
+
+// Values below 2^kSubBucketBits map to themselves; above, the bucket is how
+// far the top bit sits past the sub-bucket range and the slot within it
+// comes from the next kSubBucketBits bits
+size_t slot_of(uint64_t value) {
+    value = std::min(value, kMaxValue);
+    int top = 63 - __builtin_clzll(value | 1);
+    int bucket = std::max(0, top - (LatencySketch::kSubBucketBits - 1));
+    return (static_cast<size_t>(bucket) << kHalfBits) + static_cast<size_t>(value >> bucket);
+}
+
+// Lowest value of a slot and its width
+void slot_range(size_t slot, uint64_t& low, uint64_t& width) {
+    size_t bucket = slot >> kHalfBits;
+    if (bucket > 0) {
+        bucket -= 1;  // Buckets above 0 only use the upper half of their slots
+    }
+    uint64_t sub = slot - (bucket << kHalfBits);
+    low = sub << bucket;
+    width = uint64_t(1) << bucket;
+}
+
+} // namespace
+
+LatencySketch::LatencySketch() {
+    clear();
+}
+
+void LatencySketch::clear() {
+    counts_.fill(0);
+    total_ = 0;
+    min_ = UINT64_MAX;
+    max_ = 0;
+    sum_ = 0.0;
+}
+
+void LatencySketch::record(uint64_t value, uint64_t count) {
+    if (count == 0) {
+        return;
+    }
+    counts_[slot_of(value)] += count;
+    total_ += count;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+    sum_ += static_cast<double>(value) * static_cast<double>(count);
+}
+
+void LatencySketch::merge(const LatencySketch& other) {
+    if (other.total_ == 0) {
+        return;
+    }
+    for (size_t i = other.first_slot(); i <= other.last_slot(); ++i) {
+        counts_[i] += other.counts_[i];
+    }
+    total_ += other.total_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+    sum_ += other.sum_;
+}
+
+double LatencySketch::quantile(double q) const {
+    if (total_ == 0) {
+        return 0.0;
+    }
+    if (q >= 1.0) {
+        return static_cast<double>(max_);
+    }
+
+    uint64_t rank = static_cast<uint64_t>(std::ceil(std::max(q, 0.0) * static_cast<double>(total_)));
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t seen = 0;
+    for (size_t i = first_slot(); i < kSlots; ++i) {
+        seen += counts_[i];
+        if (seen >= rank) {
+            uint64_t low = 0;
+            uint64_t width = 0;
+            slot_range(i, low, width);
+            double middle = static_cast<double>(low) + static_cast<double>(width - 1) / 2.0;
+            return std::min(std::max(middle, static_cast<double>(min_)), static_cast<double>(max_));
+        }
+    }
+    return static_cast<double>(max_);
+}
+
+size_t LatencySketch::first_slot() const {
+    return total_ > 0 ? slot_of(min_) : 0;
+}
+
+size_t LatencySketch::last_slot() const {
+    return total_ > 0 ? slot_of(max_) : 0;
+}
+
+bool LatencySketch::restore(size_t first, size_t count, const uint64_t* slots, uint64_t min, uint64_t max,
+                            double sum) {
+    clear();
+    if (count == 0) {
+        return true;
+    }
+    if (first >= kSlots || count > kSlots - first) {
+        return false;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        counts_[first + i] = slots[i];
+        total_ += slots[i];
+    }
+    min_ = min;
+    max_ = max;
+    sum_ = sum;
+    return true;
+}
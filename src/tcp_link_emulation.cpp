@@ -0,0 +1,383 @@
+#include "tcp_link_emulation.h"
+
+#include <algorithm>
+#include <iostream>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/pkt_sched.h>
+#include <linux/rtnetlink.h>
+
+#include "tcp_crash_restore.h"
+
+namespace {
+
+const uint32_t kTbfHandle = TC_H_MAKE(1U << 16, 0);       // 1:
+const uint32_t kTbfClass = TC_H_MAKE(1U << 16, 1);        // 1:1
+const uint32_t kNetemChildHandle = TC_H_MAKE(10U << 16, 0); // 10:
+const uint32_t kQueueChildHandle = TC_H_MAKE(20U << 16, 0); // 20:
+
+// netem queue floor in packets (the tc default)
+const uint32_t kMinNetemLimit = 1000;
+
+// Scale a percentage to the kernel's 0..UINT32_MAX probability
+uint32_t probability(double percent) {
+    double clamped = std::min(std::max(percent, 0.0), 100.0);
+    return static_cast<uint32_t>(clamped / 100.0 * UINT32_MAX);
+}
+
+uint32_t interface_mtu(const std::string& interface) {
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return 1500;
+    }
+    struct ifreq ifr;
+    std::memset(&ifr, 0, sizeof(ifr));
+    std::strncpy(ifr.ifr_name, interface.c_str(), IFNAMSIZ - 1);
+    uint32_t mtu = 1500;
+    if (ioctl(fd, SIOCGIFMTU, &ifr) == 0 && ifr.ifr_mtu > 0) {
+        mtu = static_cast<uint32_t>(ifr.ifr_mtu);
+    }
+    close(fd);
+    return mtu;
+}
+
+} // namespace
+
+bool parse_emulation_mode(const std::string& name, EmulationMode& mode) {
+    if (name == "qdisc") {
+        mode = EmulationMode::Qdisc;
+    } else if (name == "userspace") {
+        mode = EmulationMode::Userspace;
+    } else if (name == "none") {
+        mode = EmulationMode::None;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* emulation_mode_name(EmulationMode mode) {
+    switch (mode) {
+        case EmulationMode::None:      return "none";
+        case EmulationMode::Userspace: return "userspace";
+        case EmulationMode::Qdisc:
+        default:                       return "qdisc";
+    }
+}
+
+QdiscEmulator::QdiscEmulator(const std::string& interface)
+    : interface_(interface),
+      ifindex_(0),
+      mtu_(1500),
+      saved_(false),
+      crash_slot_(-1),
+      applied_(false),
+      applied_rate_(false),
+      applied_netem_(false) {}
+
+QdiscEmulator::~QdiscEmulator() {
+    restore();
+    unregister_crash_restore(crash_slot_);
+}
+
+bool QdiscEmulator::prepare() {
+    if (saved_) {
+        return true;
+    }
+
+    ifindex_ = static_cast<int>(if_nametoindex(interface_.c_str()));
+    if (ifindex_ == 0) {
+        std::cerr << "Unknown test interface: " << interface_ << std::endl;
+        return false;
+    }
+    mtu_ = interface_mtu(interface_);
+
+    if (!nl_.open() || !save_previous_root()) {
+        return false;
+    }
+
+    crash_slot_ = register_netlink_restore(nl_.fd(), restore_message_);
+    saved_ = true;
+    return true;
+}
+
+bool QdiscEmulator::save_previous_root() {
+    NetlinkMessage query(RTM_GETQDISC, 0);
+    query.put_header<struct tcmsg>()->tcm_family = AF_UNSPEC;
+
+    std::string kind;
+    uint32_t handle = 0;
+    std::vector<char> options;
+
+    int err = nl_.dump(query, [&](const struct nlmsghdr* reply) {
+        if (reply->nlmsg_type != RTM_NEWQDISC) {
+            return;
+        }
+        const struct tcmsg* tcm = static_cast<const struct tcmsg*>(NLMSG_DATA(reply));
+        if (tcm->tcm_ifindex != ifindex_ || tcm->tcm_parent != TC_H_ROOT) {
+            return;
+        }
+
+        handle = tcm->tcm_handle;
+        int len = static_cast<int>(reply->nlmsg_len - NLMSG_LENGTH(sizeof(*tcm)));
+        const struct rtattr* attr = reinterpret_cast<const struct rtattr*>(
+            reinterpret_cast<const char*>(tcm) + NLMSG_ALIGN(sizeof(*tcm)));
+        for (; RTA_OK(attr, len); attr = RTA_NEXT(attr, len)) {
+            const char* payload = static_cast<const char*>(RTA_DATA(attr));
+            if (attr->rta_type == TCA_KIND) {
+                kind.assign(payload, strnlen(payload, RTA_PAYLOAD(attr)));
+            } else if (attr->rta_type == TCA_OPTIONS) {
+                options.assign(payload, payload + RTA_PAYLOAD(attr));
+            }
+        }
+    });
+    if (err < 0) {
+        std::cerr << "Failed to read qdiscs of " << interface_ << ": " << std::strerror(-err) << std::endl;
+        return false;
+    }
+
+    // Kernel-attached defaults (noqueue, pfifo_fast, mq, ...) have handle 0:
+    // deleting our root makes the kernel attach its default again
+    if (kind.empty() || TC_H_MAJ(handle) == 0) {
+        NetlinkMessage msg(RTM_DELQDISC, 0);
+        struct tcmsg* tcm = msg.put_header<struct tcmsg>();
+        tcm->tcm_family = AF_UNSPEC;
+        tcm->tcm_ifindex = ifindex_;
+        tcm->tcm_parent = TC_H_ROOT;
+        restore_message_.assign(msg.data(), msg.data() + msg.size());
+    } else {
+        NetlinkMessage msg(RTM_NEWQDISC, NLM_F_CREATE | NLM_F_REPLACE);
+        struct tcmsg* tcm = msg.put_header<struct tcmsg>();
+        tcm->tcm_family = AF_UNSPEC;
+        tcm->tcm_ifindex = ifindex_;
+        tcm->tcm_parent = TC_H_ROOT;
+        tcm->tcm_handle = handle;
+        msg.add_attr_string(TCA_KIND, kind);
+        if (!options.empty()) {
+            msg.add_attr(TCA_OPTIONS, options.data(), options.size());
+        }
+        restore_message_.assign(msg.data(), msg.data() + msg.size());
+    }
+    return true;
+}
+
+bool QdiscEmulator::delete_root() {
+    NetlinkMessage msg(RTM_DELQDISC, 0);
+    struct tcmsg* tcm = msg.put_header<struct tcmsg>();
+    tcm->tcm_family = AF_UNSPEC;
+    tcm->tcm_ifindex = ifindex_;
+    tcm->tcm_parent = TC_H_ROOT;
+
+    int err = nl_.request(msg);
+    // ENOENT: nothing of ours is attached any more
+    return err == 0 || err == -ENOENT || err == -EINVAL;
+}
+
+bool QdiscEmulator::put_tbf(const LinkConditions& conditions, uint16_t flags) {
+    uint64_t rate_bytes = static_cast<uint64_t>(conditions.rate_mbps * 1e6 / 8.0);
+
+    // The bucket must hold at least one full frame of this interface
+    // (64 KiB GSO frames on loopback), or about 4 ms of traffic at high rates
+    uint32_t burst = std::max<uint32_t>(2 * (mtu_ + 64), static_cast<uint32_t>(rate_bytes / 250));
+
+    // Queue one bandwidth-delay product behind the bucket, at least a few frames
+    uint64_t bdp = static_cast<uint64_t>(rate_bytes * std::max(2.0 * conditions.delay_ms, 1.0) / 1000.0);
+    uint32_t limit = static_cast<uint32_t>(std::min<uint64_t>(std::max<uint64_t>(bdp, 4ULL * burst), UINT32_MAX));
+
+    struct tc_tbf_qopt qopt;
+    std::memset(&qopt, 0, sizeof(qopt));
+    qopt.rate.rate = static_cast<uint32_t>(std::min<uint64_t>(rate_bytes, UINT32_MAX));
+    qopt.rate.linklayer = TC_LINKLAYER_ETHERNET;
+    qopt.limit = limit;
+
+    NetlinkMessage msg(RTM_NEWQDISC, flags);
+    struct tcmsg* tcm = msg.put_header<struct tcmsg>();
+    tcm->tcm_family = AF_UNSPEC;
+    tcm->tcm_ifindex = ifindex_;
+    tcm->tcm_parent = TC_H_ROOT;
+    tcm->tcm_handle = kTbfHandle;
+    msg.add_attr_string(TCA_KIND, "tbf");
+
+    size_t options = msg.begin_nested(TCA_OPTIONS);
+    msg.add_attr(TCA_TBF_PARMS, &qopt, sizeof(qopt));
+    msg.add_attr_u32(TCA_TBF_BURST, burst);
+    if (rate_bytes > UINT32_MAX) {
+        msg.add_attr(TCA_TBF_RATE64, &rate_bytes, sizeof(rate_bytes));
+    }
+    msg.end_nested(options);
+
+    int err = nl_.request(msg);
+    if (err < 0) {
+        std::cerr << "Failed to program tbf on " << interface_ << ": " << std::strerror(-err) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool QdiscEmulator::put_netem(const LinkConditions& conditions, uint32_t parent,
+                              uint32_t handle, uint16_t flags) {
+    int64_t latency_ns = static_cast<int64_t>(conditions.delay_ms * 1e6);
+    int64_t jitter_ns = static_cast<int64_t>(conditions.jitter_ms * 1e6);
+
+    // Enough room for everything in flight through the delay line
+    double rate_bytes = conditions.rate_mbps > 0.0 ? conditions.rate_mbps * 1e6 / 8.0 : 1.25e9;
+    double in_flight = rate_bytes * (conditions.delay_ms + conditions.jitter_ms) / 1000.0 / 1500.0;
+    uint32_t limit = std::max<uint32_t>(kMinNetemLimit,
+                                        static_cast<uint32_t>(std::min(2.0 * in_flight, 1e7)));
+
+    // The legacy fields are in scheduler ticks (64 ns); the 64-bit attributes
+    // below take precedence on kernels that understand them
+    struct tc_netem_qopt qopt;
+    std::memset(&qopt, 0, sizeof(qopt));
+    qopt.latency = static_cast<uint32_t>(std::min<int64_t>(latency_ns >> 6, UINT32_MAX));
+    qopt.jitter = static_cast<uint32_t>(std::min<int64_t>(jitter_ns >> 6, UINT32_MAX));
+    qopt.limit = limit;
+    qopt.loss = probability(conditions.loss_percent);
+
+    NetlinkMessage msg(RTM_NEWQDISC, flags);
+    struct tcmsg* tcm = msg.put_header<struct tcmsg>();
+    tcm->tcm_family = AF_UNSPEC;
+    tcm->tcm_ifindex = ifindex_;
+    tcm->tcm_parent = parent;
+    tcm->tcm_handle = handle;
+    msg.add_attr_string(TCA_KIND, "netem");
+
+    // netem options are a bare tc_netem_qopt followed by attributes
+    size_t options = msg.begin_nested(TCA_OPTIONS);
+    msg.append(&qopt, sizeof(qopt));
+    msg.add_attr(TCA_NETEM_LATENCY64, &latency_ns, sizeof(latency_ns));
+    msg.add_attr(TCA_NETEM_JITTER64, &jitter_ns, sizeof(jitter_ns));
+    if (conditions.reorder_percent > 0.0) {
+        struct tc_netem_reorder reorder;
+        reorder.probability = probability(conditions.reorder_percent);
+        reorder.correlation = 0;
+        msg.add_attr(TCA_NETEM_REORDER, &reorder, sizeof(reorder));
+    }
+    msg.end_nested(options);
+
+    int err = nl_.request(msg);
+    if (err < 0) {
+        std::cerr << "Failed to program netem on " << interface_ << ": " << std::strerror(-err);
+        if (err == -ENOENT) {
+            std::cerr << " (is the sch_netem module available?)";
+        }
+        std::cerr << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool QdiscEmulator::put_queue(const std::string& kind, uint32_t parent, uint32_t handle, uint16_t flags) {
+    NetlinkMessage msg(RTM_NEWQDISC, flags);
+    struct tcmsg* tcm = msg.put_header<struct tcmsg>();
+    tcm->tcm_family = AF_UNSPEC;
+    tcm->tcm_ifindex = ifindex_;
+    tcm->tcm_parent = parent;
+    tcm->tcm_handle = handle;
+    msg.add_attr_string(TCA_KIND, kind);
+
+    // No options: the kernel's defaults, as "tc qdisc add ... KIND" gives
+    int err = nl_.request(msg);
+    if (err < 0) {
+        std::cerr << "Failed to program " << kind << " on " << interface_ << ": " << std::strerror(-err);
+        if (err == -ENOENT) {
+            std::cerr << " (is the sch_" << kind << " module available?)";
+        }
+        std::cerr << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool QdiscEmulator::apply(const LinkConditions& conditions) {
+    if (!prepare()) {
+        return false;
+    }
+
+    bool want_rate = conditions.needs_rate();
+    bool want_netem = conditions.needs_netem();
+    if (!want_rate && !want_netem && conditions.queue.empty()) {
+        return restore();
+    }
+
+    // Same layout: change the installed qdiscs in place; the queue qdisc
+    // has no settings of its own
+    if (applied_ && applied_rate_ == want_rate && applied_netem_ == want_netem &&
+        applied_queue_ == conditions.queue) {
+        bool ok = true;
+        if (want_rate) {
+            ok = put_tbf(conditions, NLM_F_REPLACE);
+        }
+        if (ok && want_netem) {
+            ok = want_rate ? put_netem(conditions, kTbfClass, kNetemChildHandle, NLM_F_REPLACE)
+                           : put_netem(conditions, TC_H_ROOT, kTbfHandle, NLM_F_REPLACE);
+        }
+        return ok;
+    }
+
+    // New layout: start from a clean root, then stack each qdisc below the
+    // first class of the previous one
+    if (applied_) {
+        delete_root();
+        applied_ = false;
+    }
+
+    bool ok = true;
+    uint32_t parent = TC_H_ROOT;
+    uint32_t handle = kTbfHandle;
+    auto descend = [&]() {
+        parent = TC_H_MAKE(handle, 1);
+        handle = handle == kTbfHandle ? kNetemChildHandle : kQueueChildHandle;
+    };
+    auto flags = [&]() {
+        return static_cast<uint16_t>(parent == TC_H_ROOT ? NLM_F_CREATE | NLM_F_REPLACE : NLM_F_CREATE | NLM_F_EXCL);
+    };
+    if (want_rate) {
+        ok = put_tbf(conditions, flags());
+        descend();
+    }
+    if (ok && want_netem) {
+        ok = put_netem(conditions, parent, handle, flags());
+        descend();
+    }
+    if (ok && !conditions.queue.empty()) {
+        ok = put_queue(conditions.queue, parent, handle, flags());
+    }
+
+    applied_ = true;  // Even a partial hierarchy must be cleaned up
+    applied_rate_ = want_rate;
+    applied_netem_ = want_netem;
+    applied_queue_ = conditions.queue;
+    if (!ok) {
+        restore();
+    }
+    return ok;
+}
+
+bool QdiscEmulator::restore() {
+    if (!applied_) {
+        return true;
+    }
+
+    // Replay the prebuilt request used by the crash handler
+    std::vector<char> bytes = restore_message_;
+    struct nlmsghdr* hdr = reinterpret_cast<struct nlmsghdr*>(bytes.data());
+
+    NetlinkMessage request(hdr->nlmsg_type, hdr->nlmsg_flags & ~NLM_F_REQUEST);
+    request.append(bytes.data() + NLMSG_HDRLEN, bytes.size() - NLMSG_HDRLEN);
+
+    int err = nl_.request(request);
+    applied_ = false;
+    if (err < 0 && err != -ENOENT && err != -EINVAL) {
+        std::cerr << "Failed to restore qdisc on " << interface_ << ": " << std::strerror(-err) << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,344 @@
+#include "tcp_metrics_exporter.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "tcp_socket_options.h"
+
+namespace {
+
+// How often the serving thread checks for stop()
+const int kPollIntervalMs = 200;
+
+// Longest request line and headers read from a scraper
+const size_t kMaxRequestBytes = 8192;
+
+const double kRttQuantiles[] = {0.5, 0.9, 0.99};
+
+static_assert(sizeof(uint64_t) * 2 >= kCongestionNameMax, "algorithm name does not fit the label words");
+
+// CPU time of this process (every thread) in seconds, from /proc/self/stat
+double process_cpu_seconds() {
+    std::ifstream file("/proc/self/stat");
+    std::string stat;
+    std::getline(file, stat);
+
+    // Fields after the parenthesised command name: state is field 3,
+    // utime and stime are fields 14 and 15
+    size_t close = stat.rfind(')');
+    if (close == std::string::npos) {
+        return 0.0;
+    }
+    std::istringstream fields(stat.substr(close + 2));
+    std::string field;
+    unsigned long long utime = 0;
+    unsigned long long stime = 0;
+    for (int i = 3; i < 14; ++i) {
+        fields >> field;
+    }
+    fields >> utime >> stime;
+    long ticks = sysconf(_SC_CLK_TCK);
+    return ticks > 0 ? static_cast<double>(utime + stime) / ticks : 0.0;
+}
+
+// Label values escape backslashes, quotes and newlines
+std::string escape_label(const std::string& value) {
+    std::string escaped;
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            escaped += '\\';
+            escaped += c;
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+void write_all(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return;
+        }
+        sent += static_cast<size_t>(n);
+    }
+}
+
+} // namespace
+
+void LiveFlow::publish(const TcpInfoSample& sample) {
+    uint64_t count = samples_.load(std::memory_order_relaxed);
+    rtt_window_[count % kLiveRttWindow].store(sample.rtt_us, std::memory_order_relaxed);
+    rtt_sum_us_.store(rtt_sum_us_.load(std::memory_order_relaxed) + sample.rtt_us, std::memory_order_relaxed);
+    snd_cwnd_.store(sample.snd_cwnd, std::memory_order_relaxed);
+    total_retrans_.store(sample.total_retrans, std::memory_order_relaxed);
+    delivery_rate_.store(sample.delivery_rate, std::memory_order_relaxed);
+    bytes_acked_.store(sample.bytes_acked, std::memory_order_relaxed);
+    samples_.store(count + 1, std::memory_order_release);
+}
+
+void LiveFlow::release() {
+    claimed_.store(false, std::memory_order_release);
+}
+
+MetricsExporter::MetricsExporter(uint16_t port)
+    : port_(port), listen_fd_(-1), stop_requested_(false),
+      cells_total_(0), cells_finished_(0), cell_cpu_percent_(0.0), cell_softirq_percent_(0.0) {}
+
+MetricsExporter::~MetricsExporter() {
+    stop();
+}
+
+bool MetricsExporter::start() {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        std::cerr << "Failed to create metrics socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    // Local scrapers only: the sweep's state is nobody else's business
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port_);
+    if (bind(listen_fd_, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0 ||
+        listen(listen_fd_, 8) < 0) {
+        std::cerr << "Failed to listen for metrics on 127.0.0.1:" << port_ << ": "
+                  << std::strerror(errno) << std::endl;
+        close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+
+    stop_requested_.store(false, std::memory_order_relaxed);
+    thread_ = std::thread(&MetricsExporter::serve_loop, this);
+    std::cout << "Serving OpenMetrics on http://127.0.0.1:" << port_ << "/metrics\n";
+    return true;
+}
+
+void MetricsExporter::stop() {
+    stop_requested_.store(true, std::memory_order_relaxed);
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        listen_fd_ = -1;
+    }
+}
+
+LiveFlow* MetricsExporter::claim_flow(const LiveFlowLabels& labels) {
+    for (LiveFlow& flow : flows_) {
+        bool free = false;
+        if (!flow.claimed_.compare_exchange_strong(free, true, std::memory_order_acquire)) {
+            continue;
+        }
+
+        uint64_t words[2] = {};
+        std::memcpy(words, labels.algorithm.data(), std::min(labels.algorithm.size(), sizeof(words)));
+        uint64_t sequence = flow.sequence_.load(std::memory_order_relaxed);
+        flow.sequence_.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        flow.algorithm_[0].store(words[0], std::memory_order_relaxed);
+        flow.algorithm_[1].store(words[1], std::memory_order_relaxed);
+        flow.bandwidth_mbps_.store(labels.bandwidth_mbps, std::memory_order_relaxed);
+        flow.latency_ms_.store(labels.latency_ms, std::memory_order_relaxed);
+        flow.samples_.store(0, std::memory_order_relaxed);
+        flow.rtt_sum_us_.store(0, std::memory_order_relaxed);
+        flow.sequence_.store(sequence + 2, std::memory_order_release);
+        return &flow;
+    }
+    return nullptr;
+}
+
+void MetricsExporter::set_cell_cpu(const CpuCost& cpu) {
+    if (cpu.measured) {
+        cell_cpu_percent_.store(cpu.cpu_percent, std::memory_order_relaxed);
+        cell_softirq_percent_.store(cpu.softirq_percent, std::memory_order_relaxed);
+    }
+}
+
+std::string MetricsExporter::render() const {
+    std::ostringstream text;
+    text << "# TYPE tcp_sweep_cells gauge\n"
+         << "# HELP tcp_sweep_cells Cells the sweep runs, 0 when not known in advance.\n"
+         << "tcp_sweep_cells " << cells_total_.load(std::memory_order_relaxed) << "\n"
+         << "# TYPE tcp_sweep_cells_finished counter\n"
+         << "# HELP tcp_sweep_cells_finished Cells finished so far.\n"
+         << "tcp_sweep_cells_finished_total " << cells_finished_.load(std::memory_order_relaxed) << "\n"
+         << "# TYPE tcp_sweep_cell_cpu_busy_ratio gauge\n"
+         << "# UNIT tcp_sweep_cell_cpu_busy_ratio ratio\n"
+         << "# HELP tcp_sweep_cell_cpu_busy_ratio Busy share of all CPUs during the last measured cell.\n"
+         << "tcp_sweep_cell_cpu_busy_ratio " << cell_cpu_percent_.load(std::memory_order_relaxed) / 100.0 << "\n"
+         << "# TYPE tcp_sweep_cell_cpu_softirq_ratio gauge\n"
+         << "# UNIT tcp_sweep_cell_cpu_softirq_ratio ratio\n"
+         << "# HELP tcp_sweep_cell_cpu_softirq_ratio Share of all CPUs in softirq during the last measured cell.\n"
+         << "tcp_sweep_cell_cpu_softirq_ratio "
+         << cell_softirq_percent_.load(std::memory_order_relaxed) / 100.0 << "\n"
+         << "# TYPE process_cpu_seconds counter\n"
+         << "# UNIT process_cpu_seconds seconds\n"
+         << "# HELP process_cpu_seconds CPU time of the harness, all threads.\n"
+         << "process_cpu_seconds_total " << process_cpu_seconds() << "\n";
+
+    // Take a consistent copy of every live flow first; families are
+    // written one after the other
+    struct FlowView {
+        std::string labels;
+        uint64_t samples;
+        uint64_t rtt_sum_us;
+        uint32_t snd_cwnd;
+        uint32_t total_retrans;
+        uint64_t delivery_rate;
+        uint64_t bytes_acked;
+        std::vector<uint32_t> rtt_us;
+    };
+    std::vector<FlowView> views;
+    for (size_t slot = 0; slot < flows_.size(); ++slot) {
+        const LiveFlow& flow = flows_[slot];
+        uint64_t before = flow.sequence_.load(std::memory_order_acquire);
+        if (!flow.claimed_.load(std::memory_order_acquire) || (before & 1) != 0) {
+            continue;
+        }
+        uint64_t words[2] = {flow.algorithm_[0].load(std::memory_order_relaxed),
+                             flow.algorithm_[1].load(std::memory_order_relaxed)};
+        int bandwidth = flow.bandwidth_mbps_.load(std::memory_order_relaxed);
+        int latency = flow.latency_ms_.load(std::memory_order_relaxed);
+
+        FlowView view;
+        view.samples = flow.samples_.load(std::memory_order_acquire);
+        view.rtt_sum_us = flow.rtt_sum_us_.load(std::memory_order_relaxed);
+        view.snd_cwnd = flow.snd_cwnd_.load(std::memory_order_relaxed);
+        view.total_retrans = flow.total_retrans_.load(std::memory_order_relaxed);
+        view.delivery_rate = flow.delivery_rate_.load(std::memory_order_relaxed);
+        view.bytes_acked = flow.bytes_acked_.load(std::memory_order_relaxed);
+        size_t window = static_cast<size_t>(std::min<uint64_t>(view.samples, kLiveRttWindow));
+        for (size_t i = 0; i < window; ++i) {
+            view.rtt_us.push_back(flow.rtt_window_[i].load(std::memory_order_relaxed));
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (flow.sequence_.load(std::memory_order_relaxed) != before || view.samples == 0) {
+            continue;
+        }
+
+        const char* name = reinterpret_cast<const char*>(words);
+        std::ostringstream labels;
+        labels << "flow=\"" << slot << "\",algorithm=\""
+               << escape_label(std::string(name, strnlen(name, sizeof(words)))) << "\",bandwidth_mbps=\""
+               << bandwidth << "\",latency_ms=\"" << latency << "\"";
+        view.labels = labels.str();
+        views.push_back(std::move(view));
+    }
+
+    text << "# TYPE tcp_flow_delivery_rate_bytes_per_second gauge\n"
+         << "# HELP tcp_flow_delivery_rate_bytes_per_second Sender's latest tcpi_delivery_rate.\n";
+    for (const auto& view : views) {
+        text << "tcp_flow_delivery_rate_bytes_per_second{" << view.labels << "} " << view.delivery_rate << "\n";
+    }
+    text << "# TYPE tcp_flow_acked_bytes counter\n"
+         << "# UNIT tcp_flow_acked_bytes bytes\n"
+         << "# HELP tcp_flow_acked_bytes Bytes acknowledged to the sender.\n";
+    for (const auto& view : views) {
+        text << "tcp_flow_acked_bytes_total{" << view.labels << "} " << view.bytes_acked << "\n";
+    }
+    text << "# TYPE tcp_flow_cwnd_packets gauge\n"
+         << "# HELP tcp_flow_cwnd_packets Sender's congestion window.\n";
+    for (const auto& view : views) {
+        text << "tcp_flow_cwnd_packets{" << view.labels << "} " << view.snd_cwnd << "\n";
+    }
+    text << "# TYPE tcp_flow_retransmits counter\n"
+         << "# HELP tcp_flow_retransmits Segments the sender retransmitted.\n";
+    for (const auto& view : views) {
+        text << "tcp_flow_retransmits_total{" << view.labels << "} " << view.total_retrans << "\n";
+    }
+    text << "# TYPE tcp_flow_rtt_seconds summary\n"
+         << "# UNIT tcp_flow_rtt_seconds seconds\n"
+         << "# HELP tcp_flow_rtt_seconds Sender's smoothed RTT, quantiles over the last "
+         << kLiveRttWindow << " samples.\n";
+    for (auto& view : views) {
+        std::sort(view.rtt_us.begin(), view.rtt_us.end());
+        for (double quantile : kRttQuantiles) {
+            size_t rank = static_cast<size_t>(quantile * static_cast<double>(view.rtt_us.size() - 1) + 0.5);
+            text << "tcp_flow_rtt_seconds{" << view.labels << ",quantile=\"" << quantile << "\"} "
+                 << view.rtt_us[rank] / 1e6 << "\n";
+        }
+        text << "tcp_flow_rtt_seconds_sum{" << view.labels << "} " << view.rtt_sum_us / 1e6 << "\n"
+             << "tcp_flow_rtt_seconds_count{" << view.labels << "} " << view.samples << "\n";
+    }
+    text << "# EOF\n";
+    return text.str();
+}
+
+void MetricsExporter::serve_loop() {
+    while (!stop_requested_.load(std::memory_order_relaxed)) {
+        struct pollfd listener = {listen_fd_, POLLIN, 0};
+        if (poll(&listener, 1, kPollIntervalMs) <= 0) {
+            continue;
+        }
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+
+        // A stalled scraper must not hold the thread for long
+        struct timeval timeout = {1, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        answer(fd);
+        close(fd);
+    }
+}
+
+void MetricsExporter::answer(int fd) const {
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < kMaxRequestBytes) {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            return;
+        }
+        request.append(buffer, static_cast<size_t>(n));
+    }
+
+    std::string line = request.substr(0, request.find("\r\n"));
+    std::string status = "200 OK";
+    std::string type = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+    std::string body;
+    if (line.compare(0, 4, "GET ") != 0) {
+        status = "405 Method Not Allowed";
+    } else if (line.compare(4, 9, "/metrics ") != 0 && line.compare(4, 9, "/metrics?") != 0) {
+        status = "404 Not Found";
+    } else {
+        body = render();
+    }
+    if (body.empty()) {
+        type = "text/plain; charset=utf-8";
+        body = status + "\n";
+    }
+
+    std::ostringstream response;
+    response << "HTTP/1.1 " << status << "\r\n"
+             << "Content-Type: " << type << "\r\n"
+             << "Content-Length: " << body.size() << "\r\n"
+             << "Connection: close\r\n\r\n"
+             << body;
+    write_all(fd, response.str());
+}
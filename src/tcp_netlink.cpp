@@ -0,0 +1,365 @@
+#include "tcp_netlink.h"
+
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/if_link.h>
+#include <linux/rtnetlink.h>
+#include <linux/veth.h>
+
+namespace {
+
+// Large enough for a full dump batch from the kernel
+const size_t kReceiveBufferSize = 32 * 1024;
+
+// Same route the kernel installs for a local address, plus the metric
+void put_local_route(NetlinkMessage& msg, int ifindex, const struct in_addr& addr, uint32_t initcwnd) {
+    struct rtmsg* rtm = msg.put_header<struct rtmsg>();
+    rtm->rtm_family = AF_INET;
+    rtm->rtm_dst_len = 32;
+    rtm->rtm_table = RT_TABLE_LOCAL;
+    rtm->rtm_protocol = RTPROT_KERNEL;
+    rtm->rtm_scope = RT_SCOPE_HOST;
+    rtm->rtm_type = RTN_LOCAL;
+    msg.add_attr_u32(RTA_TABLE, RT_TABLE_LOCAL);
+    msg.add_attr(RTA_DST, &addr, sizeof(addr));
+    msg.add_attr(RTA_PREFSRC, &addr, sizeof(addr));
+    msg.add_attr_u32(RTA_OIF, static_cast<uint32_t>(ifindex));
+    if (initcwnd > 0) {
+        size_t metrics = msg.begin_nested(RTA_METRICS);
+        msg.add_attr_u32(RTAX_INITCWND, initcwnd);
+        msg.end_nested(metrics);
+    }
+}
+
+bool parse_ipv4(const std::string& address, struct in_addr& addr) {
+    if (inet_pton(AF_INET, address.c_str(), &addr) != 1) {
+        std::cerr << "Invalid IPv4 address: " << address << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+NetlinkMessage::NetlinkMessage(uint16_t type, uint16_t flags) {
+    struct nlmsghdr hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    hdr.nlmsg_type = type;
+    hdr.nlmsg_flags = NLM_F_REQUEST | flags;
+    append(&hdr, sizeof(hdr));
+}
+
+size_t NetlinkMessage::append(const void* data, size_t len) {
+    size_t offset = buffer_.size();
+    buffer_.resize(offset + NLMSG_ALIGN(len), 0);
+    if (data != nullptr) {
+        std::memcpy(buffer_.data() + offset, data, len);
+    }
+    header()->nlmsg_len = static_cast<uint32_t>(buffer_.size());
+    return offset;
+}
+
+void NetlinkMessage::add_attr(uint16_t type, const void* data, size_t len) {
+    struct rtattr attr;
+    attr.rta_type = type;
+    attr.rta_len = static_cast<unsigned short>(RTA_LENGTH(len));
+
+    size_t offset = buffer_.size();
+    buffer_.resize(offset + RTA_SPACE(len), 0);
+    std::memcpy(buffer_.data() + offset, &attr, sizeof(attr));
+    if (len > 0) {
+        std::memcpy(buffer_.data() + offset + RTA_LENGTH(0), data, len);
+    }
+    header()->nlmsg_len = static_cast<uint32_t>(buffer_.size());
+}
+
+void NetlinkMessage::add_attr_u32(uint16_t type, uint32_t value) {
+    add_attr(type, &value, sizeof(value));
+}
+
+void NetlinkMessage::add_attr_string(uint16_t type, const std::string& value) {
+    add_attr(type, value.c_str(), value.size() + 1);
+}
+
+size_t NetlinkMessage::begin_nested(uint16_t type) {
+    size_t offset = buffer_.size();
+    add_attr(type, nullptr, 0);
+    return offset;
+}
+
+void NetlinkMessage::end_nested(size_t offset) {
+    struct rtattr* attr = reinterpret_cast<struct rtattr*>(buffer_.data() + offset);
+    attr->rta_len = static_cast<unsigned short>(buffer_.size() - offset);
+}
+
+NetlinkSocket::NetlinkSocket() : fd_(-1), sequence_(0) {}
+
+NetlinkSocket::~NetlinkSocket() {
+    close();
+}
+
+bool NetlinkSocket::open() {
+    if (fd_ >= 0) {
+        return true;
+    }
+
+    fd_ = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd_ < 0) {
+        std::cerr << "Failed to create netlink socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct sockaddr_nl local;
+    std::memset(&local, 0, sizeof(local));
+    local.nl_family = AF_NETLINK;
+    if (bind(fd_, reinterpret_cast<struct sockaddr*>(&local), sizeof(local)) < 0) {
+        std::cerr << "Failed to bind netlink socket: " << std::strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+
+    receive_buffer_.resize(kReceiveBufferSize);
+    return true;
+}
+
+void NetlinkSocket::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+int NetlinkSocket::send_message(NetlinkMessage& message) {
+    if (fd_ < 0) {
+        return -EBADF;
+    }
+
+    struct nlmsghdr* hdr = message.header();
+    hdr->nlmsg_seq = ++sequence_;
+
+    struct sockaddr_nl kernel;
+    std::memset(&kernel, 0, sizeof(kernel));
+    kernel.nl_family = AF_NETLINK;
+
+    ssize_t sent = sendto(fd_, message.data(), message.size(), 0,
+                          reinterpret_cast<struct sockaddr*>(&kernel), sizeof(kernel));
+    if (sent < 0) {
+        return -errno;
+    }
+    return 0;
+}
+
+int NetlinkSocket::receive_replies(uint32_t sequence,
+                                   const std::function<void(const struct nlmsghdr*)>& callback) {
+    for (;;) {
+        ssize_t len = recv(fd_, receive_buffer_.data(), receive_buffer_.size(), 0);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+
+        const struct nlmsghdr* hdr = reinterpret_cast<const struct nlmsghdr*>(receive_buffer_.data());
+        size_t remaining = static_cast<size_t>(len);
+        for (; NLMSG_OK(hdr, remaining); hdr = NLMSG_NEXT(hdr, remaining)) {
+            if (hdr->nlmsg_seq != sequence) {
+                continue;  // Stale reply from an earlier request
+            }
+            if (hdr->nlmsg_type == NLMSG_DONE) {
+                return 0;
+            }
+            if (hdr->nlmsg_type == NLMSG_ERROR) {
+                const struct nlmsgerr* err = static_cast<const struct nlmsgerr*>(NLMSG_DATA(hdr));
+                return err->error;  // 0 is a plain acknowledgement
+            }
+            if (callback) {
+                callback(hdr);
+            }
+        }
+    }
+}
+
+int NetlinkSocket::request(NetlinkMessage& message) {
+    message.header()->nlmsg_flags |= NLM_F_ACK;
+    int err = send_message(message);
+    if (err < 0) {
+        return err;
+    }
+    return receive_replies(message.header()->nlmsg_seq, nullptr);
+}
+
+int NetlinkSocket::dump(NetlinkMessage& message,
+                        const std::function<void(const struct nlmsghdr*)>& callback) {
+    message.header()->nlmsg_flags |= NLM_F_DUMP;
+    int err = send_message(message);
+    if (err < 0) {
+        return err;
+    }
+    return receive_replies(message.header()->nlmsg_seq, callback);
+}
+
+bool netlink_create_veth(NetlinkSocket& nl, const std::string& name,
+                         const std::string& peer_name, int peer_netns_fd) {
+    NetlinkMessage msg(RTM_NEWLINK, NLM_F_CREATE | NLM_F_EXCL);
+    msg.put_header<struct ifinfomsg>()->ifi_family = AF_UNSPEC;
+    msg.add_attr_string(IFLA_IFNAME, name);
+
+    size_t linkinfo = msg.begin_nested(IFLA_LINKINFO);
+    msg.add_attr_string(IFLA_INFO_KIND, "veth");
+    size_t info_data = msg.begin_nested(IFLA_INFO_DATA);
+
+    // The peer description is an ifinfomsg followed by link attributes
+    size_t peer = msg.begin_nested(VETH_INFO_PEER);
+    msg.put_header<struct ifinfomsg>()->ifi_family = AF_UNSPEC;
+    msg.add_attr_string(IFLA_IFNAME, peer_name);
+    if (peer_netns_fd >= 0) {
+        msg.add_attr_u32(IFLA_NET_NS_FD, static_cast<uint32_t>(peer_netns_fd));
+    }
+    msg.end_nested(peer);
+
+    msg.end_nested(info_data);
+    msg.end_nested(linkinfo);
+
+    int err = nl.request(msg);
+    if (err < 0) {
+        std::cerr << "Failed to create veth pair " << name << "/" << peer_name
+                  << ": " << std::strerror(-err) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool netlink_set_link_up(NetlinkSocket& nl, int ifindex) {
+    NetlinkMessage msg(RTM_NEWLINK, 0);
+    struct ifinfomsg* ifi = msg.put_header<struct ifinfomsg>();
+    ifi->ifi_family = AF_UNSPEC;
+    ifi->ifi_index = ifindex;
+    ifi->ifi_flags = IFF_UP;
+    ifi->ifi_change = IFF_UP;
+
+    int err = nl.request(msg);
+    if (err < 0) {
+        std::cerr << "Failed to bring up interface " << ifindex << ": "
+                  << std::strerror(-err) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool netlink_add_ipv4_address(NetlinkSocket& nl, int ifindex,
+                              const std::string& address, int prefix_len) {
+    struct in_addr addr;
+    if (inet_pton(AF_INET, address.c_str(), &addr) != 1) {
+        std::cerr << "Invalid IPv4 address: " << address << std::endl;
+        return false;
+    }
+
+    NetlinkMessage msg(RTM_NEWADDR, NLM_F_CREATE | NLM_F_REPLACE);
+    struct ifaddrmsg* ifa = msg.put_header<struct ifaddrmsg>();
+    ifa->ifa_family = AF_INET;
+    ifa->ifa_prefixlen = static_cast<unsigned char>(prefix_len);
+    ifa->ifa_index = static_cast<unsigned int>(ifindex);
+    msg.add_attr(IFA_LOCAL, &addr, sizeof(addr));
+    msg.add_attr(IFA_ADDRESS, &addr, sizeof(addr));
+
+    int err = nl.request(msg);
+    if (err < 0) {
+        std::cerr << "Failed to add address " << address << ": "
+                  << std::strerror(-err) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool netlink_get_local_route_initcwnd(NetlinkSocket& nl, int ifindex,
+                                      const std::string& address, uint32_t& initcwnd) {
+    struct in_addr addr;
+    if (!parse_ipv4(address, addr)) {
+        return false;
+    }
+
+    NetlinkMessage query(RTM_GETROUTE, 0);
+    query.put_header<struct rtmsg>()->rtm_family = AF_INET;
+
+    bool found = false;
+    initcwnd = 0;
+    int err = nl.dump(query, [&](const struct nlmsghdr* reply) {
+        if (reply->nlmsg_type != RTM_NEWROUTE || found) {
+            return;
+        }
+        const struct rtmsg* rtm = static_cast<const struct rtmsg*>(NLMSG_DATA(reply));
+        if (rtm->rtm_type != RTN_LOCAL || rtm->rtm_dst_len != 32) {
+            return;
+        }
+
+        bool same_dst = false;
+        bool same_oif = false;
+        uint32_t metric = 0;
+        int len = static_cast<int>(RTM_PAYLOAD(reply));
+        for (const struct rtattr* attr = RTM_RTA(rtm); RTA_OK(attr, len); attr = RTA_NEXT(attr, len)) {
+            if (attr->rta_type == RTA_DST && RTA_PAYLOAD(attr) == sizeof(addr)) {
+                same_dst = std::memcmp(RTA_DATA(attr), &addr, sizeof(addr)) == 0;
+            } else if (attr->rta_type == RTA_OIF && RTA_PAYLOAD(attr) == sizeof(uint32_t)) {
+                same_oif = *static_cast<const uint32_t*>(RTA_DATA(attr)) == static_cast<uint32_t>(ifindex);
+            } else if (attr->rta_type == RTA_METRICS) {
+                int metrics_len = static_cast<int>(RTA_PAYLOAD(attr));
+                for (const struct rtattr* m = static_cast<const struct rtattr*>(RTA_DATA(attr));
+                     RTA_OK(m, metrics_len); m = RTA_NEXT(m, metrics_len)) {
+                    if (m->rta_type == RTAX_INITCWND && RTA_PAYLOAD(m) == sizeof(uint32_t)) {
+                        metric = *static_cast<const uint32_t*>(RTA_DATA(m));
+                    }
+                }
+            }
+        }
+        if (same_dst && same_oif) {
+            found = true;
+            initcwnd = metric;
+        }
+    });
+    if (err < 0) {
+        std::cerr << "Failed to read routes: " << std::strerror(-err) << std::endl;
+        return false;
+    }
+    if (!found) {
+        std::cerr << "No local route to " << address << " on interface " << ifindex << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool netlink_local_route_message(int ifindex, const std::string& address, uint32_t initcwnd,
+                                 std::vector<char>& message) {
+    struct in_addr addr;
+    if (!parse_ipv4(address, addr)) {
+        return false;
+    }
+    NetlinkMessage msg(RTM_NEWROUTE, NLM_F_CREATE | NLM_F_REPLACE);
+    put_local_route(msg, ifindex, addr, initcwnd);
+    message.assign(msg.data(), msg.data() + msg.size());
+    return true;
+}
+
+bool netlink_set_local_route_initcwnd(NetlinkSocket& nl, int ifindex,
+                                      const std::string& address, uint32_t initcwnd) {
+    struct in_addr addr;
+    if (!parse_ipv4(address, addr)) {
+        return false;
+    }
+
+    NetlinkMessage msg(RTM_NEWROUTE, NLM_F_CREATE | NLM_F_REPLACE);
+    put_local_route(msg, ifindex, addr, initcwnd);
+
+    int err = nl.request(msg);
+    if (err < 0) {
+        std::cerr << "Failed to set initcwnd on the route to " << address << ": "
+                  << std::strerror(-err) << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,129 @@
+#include "tcp_netns.h"
+#include "tcp_netlink.h"
+
+#include <iostream>
+#include <thread>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <net/if.h>
+#include <sched.h>
+#include <unistd.h>
+
+namespace {
+
+// Point-to-point subnet shared by every isolated path; namespaces keep
+// identical addresses in different cells apart
+const int kPathPrefixLen = 30;
+
+int open_current_netns() {
+    int fd = open("/proc/thread-self/ns/net", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "Failed to open network namespace: " << std::strerror(errno) << std::endl;
+    }
+    return fd;
+}
+
+} // namespace
+
+const char* const IsolatedPath::kSenderAddress = "10.77.0.1";
+const char* const IsolatedPath::kReceiverAddress = "10.77.0.2";
+const char* const IsolatedPath::kSenderInterface = "veth-snd";
+const char* const IsolatedPath::kReceiverInterface = "veth-rcv";
+
+int create_network_namespace() {
+    // unshare() moves the calling thread, so do it on a throwaway thread
+    // and keep only an fd to the new namespace
+    int netns_fd = -1;
+    std::thread creator([&netns_fd]() {
+        if (unshare(CLONE_NEWNET) < 0) {
+            std::cerr << "Failed to create network namespace: " << std::strerror(errno)
+                      << " (requires CAP_SYS_ADMIN)\n";
+            return;
+        }
+        netns_fd = open_current_netns();
+    });
+    creator.join();
+    return netns_fd;
+}
+
+ScopedNetns::ScopedNetns(int target_netns_fd) : original_fd_(-1), entered_(false) {
+    original_fd_ = open_current_netns();
+    if (original_fd_ < 0) {
+        return;
+    }
+    if (setns(target_netns_fd, CLONE_NEWNET) < 0) {
+        std::cerr << "Failed to enter network namespace: " << std::strerror(errno) << std::endl;
+        return;
+    }
+    entered_ = true;
+}
+
+ScopedNetns::~ScopedNetns() {
+    if (entered_ && setns(original_fd_, CLONE_NEWNET) < 0) {
+        std::cerr << "Failed to restore network namespace: " << std::strerror(errno) << std::endl;
+    }
+    if (original_fd_ >= 0) {
+        close(original_fd_);
+    }
+}
+
+IsolatedPath::IsolatedPath() : sender_netns_(-1), receiver_netns_(-1) {}
+
+IsolatedPath::~IsolatedPath() {
+    // Dropping the last reference destroys the namespace and its veth end
+    if (sender_netns_ >= 0) {
+        close(sender_netns_);
+    }
+    if (receiver_netns_ >= 0) {
+        close(receiver_netns_);
+    }
+}
+
+bool IsolatedPath::create() {
+    sender_netns_ = create_network_namespace();
+    receiver_netns_ = create_network_namespace();
+    if (sender_netns_ < 0 || receiver_netns_ < 0) {
+        return false;
+    }
+
+    // Create the pair from the sender side, with the peer end placed
+    // directly in the receiver namespace
+    {
+        ScopedNetns in_sender(sender_netns_);
+        if (!in_sender.ok()) {
+            return false;
+        }
+        NetlinkSocket nl;
+        if (!nl.open() ||
+            !netlink_create_veth(nl, kSenderInterface, kReceiverInterface, receiver_netns_)) {
+            return false;
+        }
+    }
+
+    return configure_side(sender_netns_, kSenderInterface, kSenderAddress) &&
+           configure_side(receiver_netns_, kReceiverInterface, kReceiverAddress);
+}
+
+bool IsolatedPath::configure_side(int netns_fd, const char* interface, const char* address) {
+    ScopedNetns in_netns(netns_fd);
+    if (!in_netns.ok()) {
+        return false;
+    }
+
+    NetlinkSocket nl;
+    if (!nl.open()) {
+        return false;
+    }
+
+    int veth_index = static_cast<int>(if_nametoindex(interface));
+    int lo_index = static_cast<int>(if_nametoindex("lo"));
+    if (veth_index == 0 || lo_index == 0) {
+        std::cerr << "Interface " << interface << " not found in test namespace\n";
+        return false;
+    }
+
+    return netlink_add_ipv4_address(nl, veth_index, address, kPathPrefixLen) &&
+           netlink_set_link_up(nl, lo_index) &&
+           netlink_set_link_up(nl, veth_index);
+}
@@ -0,0 +1,205 @@
+#include "tcp_results_cache.h"
+
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <dirent.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+// Sysctls that change how a TCP flow behaves on this host.
+// net.ipv4.tcp_congestion_control is left out: the tester sets it itself.
+const char* const kCachedSysctls[] = {
+    "net/core/default_qdisc",
+    "net/core/rmem_max",
+    "net/core/wmem_max",
+    "net/core/netdev_max_backlog",
+    "net/ipv4/tcp_rmem",
+    "net/ipv4/tcp_wmem",
+    "net/ipv4/tcp_mem",
+    "net/ipv4/tcp_ecn",
+    "net/ipv4/tcp_sack",
+    "net/ipv4/tcp_dsack",
+    "net/ipv4/tcp_timestamps",
+    "net/ipv4/tcp_window_scaling",
+    "net/ipv4/tcp_moderate_rcvbuf",
+    "net/ipv4/tcp_slow_start_after_idle",
+    "net/ipv4/tcp_no_metrics_save",
+    "net/ipv4/tcp_autocorking",
+    "net/ipv4/tcp_notsent_lowat",
+    "net/ipv4/tcp_limit_output_bytes",
+    "net/ipv4/tcp_pacing_ss_ratio",
+    "net/ipv4/tcp_pacing_ca_ratio",
+    "net/ipv4/tcp_min_tso_segs",
+    "net/ipv4/tcp_mtu_probing",
+    "net/ipv4/tcp_recovery",
+    "net/ipv4/tcp_early_retrans",
+    "net/ipv4/tcp_frto",
+    "net/ipv4/tcp_reordering",
+};
+
+const uint64_t kFnvOffset = 14695981039346656037ULL;
+const uint64_t kFnvPrime = 1099511628211ULL;
+
+uint64_t fnv1a(const char* data, size_t size, uint64_t hash = kFnvOffset) {
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= kFnvPrime;
+    }
+    return hash;
+}
+
+std::string hex(uint64_t value) {
+    char text[17];
+    std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(value));
+    return text;
+}
+
+// First line of a file with tabs as spaces, "-" when it cannot be read
+std::string read_value(const std::string& path) {
+    std::ifstream file(path);
+    std::string value;
+    if (!std::getline(file, value)) {
+        return "-";
+    }
+    std::replace(value.begin(), value.end(), '\t', ' ');
+    return value;
+}
+
+std::string read_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+} // namespace
+
+std::string file_digest(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return std::string();
+    }
+    uint64_t hash = kFnvOffset;
+    std::vector<char> buffer(64 * 1024);
+    while (file.read(buffer.data(), static_cast<std::streamsize>(buffer.size())) || file.gcount() > 0) {
+        hash = fnv1a(buffer.data(), static_cast<size_t>(file.gcount()), hash);
+    }
+    return hex(hash);
+}
+
+ResultsCache::ResultsCache(const std::string& directory) : directory_(directory) {}
+
+bool ResultsCache::open() {
+    if (mkdir(directory_.c_str(), 0755) != 0 && errno != EEXIST) {
+        std::cerr << "Failed to create cache directory " << directory_ << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::string ResultsCache::host_description() {
+    std::ostringstream text;
+    text << "tool=" << kToolVersion << "\n";
+    struct utsname host;
+    if (uname(&host) == 0) {
+        text << "kernel=" << host.release << " " << host.version << "\n";
+    }
+    for (const char* sysctl : kCachedSysctls) {
+        text << "sysctl." << sysctl << "=" << read_value(std::string("/proc/sys/") + sysctl) << "\n";
+    }
+    return text.str();
+}
+
+std::string ResultsCache::algorithm_description(const std::string& algorithm) {
+    std::ostringstream text;
+    text << "algorithm=" << algorithm << "\n";
+
+    // Built-in algorithms have no module directory and no parameters
+    std::string directory = "/sys/module/tcp_" + algorithm + "/parameters";
+    std::vector<std::string> names;
+    if (DIR* parameters = opendir(directory.c_str())) {
+        while (dirent* entry = readdir(parameters)) {
+            if (entry->d_name[0] != '.') {
+                names.push_back(entry->d_name);
+            }
+        }
+        closedir(parameters);
+    }
+    std::sort(names.begin(), names.end());
+    for (const auto& name : names) {
+        text << "module." << algorithm << "." << name << "=" << read_value(directory + "/" + name) << "\n";
+    }
+    return text.str();
+}
+
+std::string ResultsCache::entry_path(const std::string& description) const {
+    return directory_ + "/" + hex(fnv1a(description.data(), description.size()));
+}
+
+bool ResultsCache::load(const std::string& description, const ResultsCellKey& key, ResultsStoreWriter& store,
+                        ResultsStoreReader& cached) const {
+    std::string path = entry_path(description);
+    struct stat info;
+    if (stat((path + ".tcpr").c_str(), &info) != 0) {
+        return false;
+    }
+
+    // Hashes can collide; the description has to match as well
+    if (read_file(path + ".key") != description) {
+        return false;
+    }
+    if (!cached.open(path + ".tcpr") || cached.size() == 0 || !store.is_open()) {
+        return false;
+    }
+
+    // All trials or none: a cell measured again must not find some of its
+    // cached trials already in the store
+    for (size_t i = 0; i < cached.size(); ++i) {
+        if (cached.entry(i).series_offset != 0 && cached.series_block(i) == nullptr) {
+            return false;
+        }
+    }
+    size_t cells = store.cells();
+    ResultsCellKey trial_key = key;
+    for (size_t i = 0; i < cached.size(); ++i) {
+        trial_key.trial = key.trial + static_cast<uint32_t>(i);
+        if (!store.copy_cell(cached, i, trial_key)) {
+            store.drop_cells(cells);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ResultsCache::begin(const std::string& description, ResultsStoreWriter& writer) const {
+    return writer.open(entry_path(description) + ".tcpr.tmp");
+}
+
+bool ResultsCache::commit(const std::string& description, ResultsStoreWriter& writer) const {
+    std::string path = entry_path(description);
+    if (!writer.close()) {
+        return false;
+    }
+    std::ofstream key(path + ".key", std::ios::binary | std::ios::trunc);
+    key << description;
+    key.close();
+    if (!key || std::rename((path + ".tcpr.tmp").c_str(), (path + ".tcpr").c_str()) != 0) {
+        std::cerr << "Failed to save cache entry " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void ResultsCache::discard(const std::string& description, ResultsStoreWriter& writer) const {
+    writer.close();
+    std::remove((entry_path(description) + ".tcpr.tmp").c_str());
+}
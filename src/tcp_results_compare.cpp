@@ -0,0 +1,206 @@
+#include "tcp_results_compare.h"
+
+#include "tcp_results_export.h"
+#include "tcp_trial_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+// Regressions listed on stdout; the report has all of them
+const size_t kMaxPrintedRegressions = 20;
+
+// Per-trial values of one cell of a store
+struct CellSamples {
+    std::string algorithm;
+    int bandwidth_mbps = 0;
+    int latency_ms = 0;
+    std::string tuning;
+    std::vector<double> throughput;             // Mbps
+    std::vector<double> p99_rtt;                // ms, trials with RTT samples
+    std::vector<double> cycles_per_byte;        // Trials that measured it
+    double merged_p99_rtt = 0.0;                // ms, over all trials' samples
+
+    bool operator<(const CellSamples& other) const {
+        return std::tie(algorithm, bandwidth_mbps, latency_ms, tuning) <
+               std::tie(other.algorithm, other.bandwidth_mbps, other.latency_ms, other.tuning);
+    }
+};
+
+// Group a store's trials into cells, sorted by algorithm, bandwidth,
+// latency and tuning label. The index already keeps the trials of a cell
+// together; variant numbers are not compared, since two sweeps can number
+// the same tuning differently.
+std::vector<CellSamples> read_cells(const ResultsStoreReader& store) {
+    std::vector<CellSamples> cells;
+    LatencySketch trial_us;
+    LatencySketch merged_us;
+    const double missing = std::numeric_limits<double>::quiet_NaN();
+
+    for (size_t i = 0; i < store.size(); ++i) {
+        const ResultsCellKey& key = store.entry(i).key;
+        std::string_view alg = results_key_algorithm(key);
+        if (cells.empty() || cells.back().algorithm != alg || cells.back().bandwidth_mbps != key.bandwidth_mbps ||
+            cells.back().latency_ms != key.latency_ms || store.entry(i - 1).key.variant != key.variant) {
+            if (!cells.empty()) {
+                cells.back().merged_p99_rtt = merged_us.quantile(0.99) / 1000.0;
+            }
+            merged_us.clear();
+            cells.emplace_back();
+            cells.back().algorithm = std::string(alg);
+            cells.back().bandwidth_mbps = key.bandwidth_mbps;
+            cells.back().latency_ms = key.latency_ms;
+            cells.back().tuning = results_tuning_label(store, i);
+        }
+        CellSamples& cell = cells.back();
+        cell.throughput.push_back(store.metric(i, kMetricThroughput));
+        if (store.sketch(i, kSketchRtt, trial_us) && !trial_us.empty()) {
+            cell.p99_rtt.push_back(trial_us.quantile(0.99) / 1000.0);
+            merged_us.merge(trial_us);
+        }
+        double cycles = store.metric(i, kMetricCyclesPerByte, missing);
+        if (!std::isnan(cycles)) {
+            cell.cycles_per_byte.push_back(cycles);
+        }
+    }
+    if (!cells.empty()) {
+        cells.back().merged_p99_rtt = merged_us.quantile(0.99) / 1000.0;
+    }
+    std::sort(cells.begin(), cells.end());
+    return cells;
+}
+
+double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    size_t middle = values.size() / 2;
+    return values.size() % 2 == 1 ? values[middle] : (values[middle - 1] + values[middle]) / 2.0;
+}
+
+// One metric of a cell pair, with the per-trial values its test runs on
+struct MetricDelta {
+    const char* name;
+    bool higher_is_better;
+    double baseline;
+    double candidate;
+    const std::vector<double>* baseline_trials;
+    const std::vector<double>* candidate_trials;
+};
+
+enum class Verdict { Ok, Regression, Improvement };
+
+const char* verdict_name(Verdict verdict) {
+    switch (verdict) {
+        case Verdict::Regression: return "regression";
+        case Verdict::Improvement: return "improvement";
+        default: return "ok";
+    }
+}
+
+// Write the report row of one metric and return its verdict
+Verdict compare_metric(std::ofstream& report, const CellSamples& cell, const MetricDelta& metric,
+                       const CompareOptions& options) {
+    const std::vector<double>& a = *metric.baseline_trials;
+    const std::vector<double>& b = *metric.candidate_trials;
+    double delta = (metric.candidate - metric.baseline) / metric.baseline;
+    double p = mann_whitney_p(a, b);
+    bool significant = p < options.alpha || mann_whitney_min_p(a.size(), b.size()) >= options.alpha;
+
+    Verdict verdict = Verdict::Ok;
+    if (significant && std::fabs(delta) > options.threshold) {
+        bool worse = metric.higher_is_better ? delta < 0.0 : delta > 0.0;
+        verdict = worse ? Verdict::Regression : Verdict::Improvement;
+    }
+    report << cell.algorithm << "," << cell.bandwidth_mbps << "," << cell.latency_ms << "," << cell.tuning << ","
+           << metric.name << "," << metric.baseline << "," << metric.candidate << "," << delta * 100.0 << ","
+           << p << "," << a.size() << "," << b.size() << "," << verdict_name(verdict) << "\n";
+    return verdict;
+}
+
+} // namespace
+
+bool compare_results(const ResultsStoreReader& baseline, const ResultsStoreReader& candidate,
+                     const CompareOptions& options, const std::string& directory, CompareSummary& summary) {
+    std::string path = (directory.empty() ? std::string() : directory + "/") + "regression_report.csv";
+    std::ofstream report(path);
+    if (!report) {
+        std::cerr << "Failed to create " << path << std::endl;
+        return false;
+    }
+    report << "Algorithm,BandwidthConfig,LatencyConfig,Tuning,Metric,Baseline,Candidate,DeltaPercent,PValue,"
+           << "BaselineTrials,CandidateTrials,Verdict\n";
+
+    std::vector<CellSamples> before = read_cells(baseline);
+    std::vector<CellSamples> after = read_cells(candidate);
+    summary = CompareSummary();
+    std::vector<std::string> flagged;
+
+    size_t i = 0;
+    size_t j = 0;
+    while (i < before.size() || j < after.size()) {
+        if (j == after.size() || (i < before.size() && before[i] < after[j])) {
+            summary.baseline_only++;
+            ++i;
+            continue;
+        }
+        if (i == before.size() || after[j] < before[i]) {
+            summary.candidate_only++;
+            ++j;
+            continue;
+        }
+        const CellSamples& a = before[i++];
+        const CellSamples& b = after[j++];
+        summary.cells++;
+
+        std::vector<MetricDelta> metrics;
+        metrics.push_back({"throughput", true, median(a.throughput), median(b.throughput),
+                           &a.throughput, &b.throughput});
+        if (!a.p99_rtt.empty() && !b.p99_rtt.empty()) {
+            metrics.push_back({"p99_rtt", false, a.merged_p99_rtt, b.merged_p99_rtt, &a.p99_rtt, &b.p99_rtt});
+        }
+        if (!a.cycles_per_byte.empty() && !b.cycles_per_byte.empty()) {
+            metrics.push_back({"cycles_per_byte", false, median(a.cycles_per_byte), median(b.cycles_per_byte),
+                               &a.cycles_per_byte, &b.cycles_per_byte});
+        }
+        for (const MetricDelta& metric : metrics) {
+            // A zero baseline has no relative change to judge
+            if (metric.baseline <= 0.0) {
+                continue;
+            }
+            Verdict verdict = compare_metric(report, b, metric, options);
+            if (verdict == Verdict::Regression) {
+                summary.regressions++;
+                if (flagged.size() < kMaxPrintedRegressions) {
+                    flagged.push_back(b.algorithm + " " + std::to_string(b.bandwidth_mbps) + "Mbps " +
+                                      std::to_string(b.latency_ms) + "ms " + b.tuning + ": " + metric.name +
+                                      " " + std::to_string(metric.baseline) + " -> " +
+                                      std::to_string(metric.candidate));
+                }
+            } else if (verdict == Verdict::Improvement) {
+                summary.improvements++;
+            }
+        }
+    }
+    report.close();
+
+    std::cout << "Compared " << summary.cells << " cells: " << summary.regressions << " regressions, "
+              << summary.improvements << " improvements";
+    if (summary.baseline_only > 0 || summary.candidate_only > 0) {
+        std::cout << " (" << summary.baseline_only << " cells only in the baseline, "
+                  << summary.candidate_only << " only in the candidate)";
+    }
+    std::cout << std::endl;
+    for (const auto& line : flagged) {
+        std::cout << "  " << line << std::endl;
+    }
+    if (summary.regressions > flagged.size()) {
+        std::cout << "  ... and " << summary.regressions - flagged.size() << " more" << std::endl;
+    }
+    std::cout << "Regression report saved to " << path << std::endl;
+    return true;
+}
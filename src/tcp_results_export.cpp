@@ -0,0 +1,330 @@
+#include "tcp_results_export.h"
+
+#include "tcp_socket_options.h"
+#include "tcp_trial_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Trial-averaged values of one (algorithm, bandwidth, latency) cell
+struct CellMean {
+    std::pair<int, int> config;     // Bandwidth, latency
+    size_t algorithm;               // Index into the algorithm list
+    double throughput;
+    double latency;
+};
+
+// Per-trial values of the cell being read, for its confidence intervals
+struct CellTrials {
+    std::vector<double> throughput;
+    std::vector<double> latency;
+    std::vector<double> p99_rtt;
+    double warmup = 0.0;
+    LatencySketch rpc_rtt_us;       // Request probes, merged over the trials
+    LatencySketch rpc_owd_us;
+    LatencySketch inline_rtt_us;
+    LatencySketch inline_owd_us;
+
+    void clear() {
+        throughput.clear();
+        latency.clear();
+        p99_rtt.clear();
+        warmup = 0.0;
+        rpc_rtt_us.clear();
+        rpc_owd_us.clear();
+        inline_rtt_us.clear();
+        inline_owd_us.clear();
+    }
+};
+
+void write_interval(std::ofstream& csv_file, const ConfidenceInterval& interval) {
+    if (interval.n == 0) {
+        csv_file << ",,";
+        return;
+    }
+    csv_file << "," << interval.mean << "," << interval.half_width;
+}
+
+// Running sums of one algorithm for algorithm_comparison.csv
+struct AlgorithmTotals {
+    double throughput = 0.0;
+    double latency = 0.0;
+    double packet_loss = 0.0;
+    double jitter = 0.0;
+    int count = 0;
+    LatencySketch rtt_us;           // Merged over every cell
+    LatencySketch owd_us;
+};
+
+const char* const kPercentileColumns = "P50,P90,P99,P999,Max";
+
+// Header columns for one distribution, e.g. RttP50,...,RttMax
+void write_percentile_header(std::ofstream& csv_file, const char* prefix) {
+    std::string_view columns = kPercentileColumns;
+    while (!columns.empty()) {
+        size_t comma = columns.find(',');
+        csv_file << "," << prefix << columns.substr(0, comma);
+        columns.remove_prefix(comma == std::string_view::npos ? columns.size() : comma + 1);
+    }
+}
+
+// A summary value that not every cell carries; an empty field without it
+void write_optional_metric(std::ofstream& csv_file, const ResultsStoreReader& store, size_t index,
+                           const char* name) {
+    double value = store.metric(index, name, std::numeric_limits<double>::quiet_NaN());
+    csv_file << ",";
+    if (!std::isnan(value)) {
+        csv_file << value;
+    }
+}
+
+// Percentiles of a microsecond sketch in ms; empty fields without samples
+void write_percentiles(std::ofstream& csv_file, const LatencySketch& sketch) {
+    if (sketch.empty()) {
+        csv_file << ",,,,,";
+        return;
+    }
+    csv_file << "," << sketch.quantile(0.50) / 1000.0
+             << "," << sketch.quantile(0.90) / 1000.0
+             << "," << sketch.quantile(0.99) / 1000.0
+             << "," << sketch.quantile(0.999) / 1000.0
+             << "," << sketch.max() / 1000.0;
+}
+
+// One request_latency.csv row of a cell; nothing when the probe did not run
+void write_request_row(std::ofstream& csv_file, std::string_view algorithm, const ResultsCellKey& key,
+                       const char* probe, const LatencySketch& rtt_us, const LatencySketch& owd_us) {
+    if (rtt_us.empty()) {
+        return;
+    }
+    csv_file << algorithm << "," << key.bandwidth_mbps << "," << key.latency_ms << ","
+             << probe << "," << rtt_us.count();
+    write_percentiles(csv_file, rtt_us);
+    write_percentiles(csv_file, owd_us);
+    csv_file << "\n";
+}
+
+void write_comparison_row(std::ofstream& csv_file, std::string_view algorithm, const AlgorithmTotals& totals) {
+    if (totals.count == 0) {
+        return;
+    }
+    csv_file << algorithm << ","
+             << totals.throughput / totals.count << ","
+             << totals.latency / totals.count << ","
+             << totals.packet_loss / totals.count << ","
+             << totals.jitter / totals.count;
+    write_percentiles(csv_file, totals.rtt_us);
+    write_percentiles(csv_file, totals.owd_us);
+    csv_file << "\n";
+}
+
+// One bandwidth/latency table: a row per configuration, a column per algorithm
+void write_pivot(const std::string& filename, const std::vector<std::string>& algorithms,
+                 const std::vector<std::pair<int, int>>& configs, const std::vector<double>& grid,
+                 const std::vector<bool>& present) {
+    std::ofstream csv_file(filename);
+    csv_file << "Bandwidth,Latency";
+    for (const auto& alg : algorithms) {
+        csv_file << "," << alg;
+    }
+    csv_file << "\n";
+
+    for (size_t row = 0; row < configs.size(); ++row) {
+        csv_file << configs[row].first << "," << configs[row].second;
+        for (size_t col = 0; col < algorithms.size(); ++col) {
+            size_t slot = row * algorithms.size() + col;
+            csv_file << ",";
+            if (present[slot]) {
+                csv_file << grid[slot];
+            }
+        }
+        csv_file << "\n";
+    }
+
+    csv_file.close();
+    std::cout << "Gnuplot-friendly metrics saved to " << filename << std::endl;
+}
+
+} // namespace
+
+std::string results_tuning_label(const ResultsStoreReader& store, size_t index) {
+    SocketTuning tuning;
+    std::string_view prefix = kMetricTuningPrefix;
+    const ResultsMetric* values = store.metrics(index);
+    for (uint32_t i = 0; i < store.cell(index).metric_count; ++i) {
+        std::string name(values[i].name, strnlen(values[i].name, sizeof(values[i].name)));
+        if (name.compare(0, prefix.size(), prefix) == 0) {
+            set_tuning_number(tuning, name.substr(prefix.size()), values[i].value);
+        }
+    }
+    return tuning.label();
+}
+
+bool export_results_csv(const ResultsStoreReader& store, const std::string& directory) {
+    std::string prefix = directory.empty() ? std::string() : directory + "/";
+
+    std::ofstream detailed(prefix + "detailed_metrics.csv");
+    std::ofstream comparison(prefix + "algorithm_comparison.csv");
+    std::ofstream confidence(prefix + "cell_confidence.csv");
+    std::ofstream requests(prefix + "request_latency.csv");
+    if (!detailed || !comparison || !confidence || !requests) {
+        std::cerr << "Failed to create CSV files in " << (directory.empty() ? "." : directory) << std::endl;
+        return false;
+    }
+    detailed << "Algorithm,BandwidthConfig,LatencyConfig,Tuning,Trial,Throughput,Latency,PacketLoss,Jitter,Goodput,"
+             << "CyclesPerByte,InstructionsPerByte,CpuUtil,SoftirqUtil,ContextSwitches";
+    comparison << "Algorithm,AvgThroughput,AvgLatency,AvgPacketLoss,AvgJitter";
+    for (std::ofstream* csv_file : {&detailed, &comparison}) {
+        write_percentile_header(*csv_file, "Rtt");
+        write_percentile_header(*csv_file, "Owd");
+        *csv_file << "\n";
+    }
+    confidence << "Algorithm,BandwidthConfig,LatencyConfig,Tuning,Trials,Throughput,ThroughputCI95,"
+               << "Latency,LatencyCI95,RttP99,RttP99CI95,Warmup\n";
+    requests << "Algorithm,BandwidthConfig,LatencyConfig,Probe,Requests";
+    write_percentile_header(requests, "Rtt");
+    write_percentile_header(requests, "Owd");
+    requests << "\n";
+
+    // The index is sorted by algorithm, bandwidth, latency, variant and
+    // trial, so algorithms and the trials of a cell arrive as contiguous runs
+    std::vector<std::string> algorithms;
+    std::vector<CellMean> means;
+    AlgorithmTotals totals;
+    LatencySketch rtt_us;
+    LatencySketch owd_us;
+    LatencySketch probe_us;
+    CellTrials run;
+
+    for (size_t i = 0; i < store.size(); ++i) {
+        const ResultsCellKey& key = store.entry(i).key;
+        std::string_view alg = results_key_algorithm(key);
+        double throughput = store.metric(i, kMetricThroughput);
+        double latency = store.metric(i, kMetricLatency);
+        double packet_loss = store.metric(i, kMetricPacketLoss);
+        double jitter = store.metric(i, kMetricJitter);
+        std::string tuning = results_tuning_label(store, i);
+
+        detailed << alg << ","
+                 << key.bandwidth_mbps << ","
+                 << key.latency_ms << ","
+                 << tuning << ","
+                 << key.trial << ","
+                 << throughput << ","
+                 << latency << ","
+                 << packet_loss << ","
+                 << jitter << ","
+                 << store.metric(i, kMetricGoodput);
+        for (const char* name : {kMetricCyclesPerByte, kMetricInstructionsPerByte, kMetricCpuUtil,
+                                 kMetricSoftirqUtil, kMetricContextSwitches}) {
+            write_optional_metric(detailed, store, i, name);
+        }
+        store.sketch(i, kSketchRtt, rtt_us);
+        store.sketch(i, kSketchOwd, owd_us);
+        write_percentiles(detailed, rtt_us);
+        write_percentiles(detailed, owd_us);
+        detailed << "\n";
+
+        if (algorithms.empty() || algorithms.back() != alg) {
+            if (!algorithms.empty()) {
+                write_comparison_row(comparison, algorithms.back(), totals);
+            }
+            algorithms.emplace_back(alg);
+            totals = AlgorithmTotals();
+        }
+        totals.throughput += throughput;
+        totals.latency += latency;
+        totals.packet_loss += packet_loss;
+        totals.jitter += jitter;
+        totals.count++;
+        totals.rtt_us.merge(rtt_us);
+        totals.owd_us.merge(owd_us);
+
+        run.throughput.push_back(throughput);
+        run.latency.push_back(latency);
+        if (!rtt_us.empty()) {
+            run.p99_rtt.push_back(rtt_us.quantile(0.99) / 1000.0);
+        }
+        run.warmup += store.metric(i, kMetricWarmup);
+        const std::pair<const char*, LatencySketch*> probes[] = {
+            {kSketchRpcRtt, &run.rpc_rtt_us},
+            {kSketchRpcOwd, &run.rpc_owd_us},
+            {kSketchInlineRtt, &run.inline_rtt_us},
+            {kSketchInlineOwd, &run.inline_owd_us},
+        };
+        for (const auto& probe : probes) {
+            if (store.sketch(i, probe.first, probe_us)) {
+                probe.second->merge(probe_us);
+            }
+        }
+
+        // Close the run of trials at the last entry of this cell
+        const ResultsCellKey* next = i + 1 < store.size() ? &store.entry(i + 1).key : nullptr;
+        if (next == nullptr || results_key_algorithm(*next) != alg ||
+            next->bandwidth_mbps != key.bandwidth_mbps || next->latency_ms != key.latency_ms ||
+            next->variant != key.variant) {
+            ConfidenceInterval cell_throughput = confidence_interval(run.throughput);
+            ConfidenceInterval cell_latency = confidence_interval(run.latency);
+            means.push_back({{key.bandwidth_mbps, key.latency_ms}, algorithms.size() - 1,
+                             cell_throughput.mean, cell_latency.mean});
+
+            confidence << alg << "," << key.bandwidth_mbps << "," << key.latency_ms << "," << tuning << ","
+                       << run.throughput.size();
+            write_interval(confidence, cell_throughput);
+            write_interval(confidence, cell_latency);
+            write_interval(confidence, confidence_interval(run.p99_rtt));
+            confidence << "," << run.warmup / run.throughput.size() << "\n";
+            write_request_row(requests, alg, key, "connection", run.rpc_rtt_us, run.rpc_owd_us);
+            write_request_row(requests, alg, key, "interleaved", run.inline_rtt_us, run.inline_owd_us);
+            run.clear();
+        }
+    }
+    if (!algorithms.empty()) {
+        write_comparison_row(comparison, algorithms.back(), totals);
+    }
+
+    detailed.close();
+    comparison.close();
+    confidence.close();
+    requests.close();
+    std::cout << "Detailed metrics saved to " << prefix << "detailed_metrics.csv" << std::endl;
+    std::cout << "Algorithm comparison saved to " << prefix << "algorithm_comparison.csv" << std::endl;
+    std::cout << "Per-cell confidence intervals saved to " << prefix << "cell_confidence.csv" << std::endl;
+    std::cout << "Request latency under load saved to " << prefix << "request_latency.csv" << std::endl;
+
+    // Scatter the cell means into dense (configuration x algorithm) grids
+    std::vector<std::pair<int, int>> configs;
+    configs.reserve(means.size());
+    for (const auto& mean : means) {
+        configs.push_back(mean.config);
+    }
+    std::sort(configs.begin(), configs.end());
+    configs.erase(std::unique(configs.begin(), configs.end()), configs.end());
+
+    size_t slots = configs.size() * algorithms.size();
+    std::vector<double> throughput_grid(slots, 0.0);
+    std::vector<double> latency_grid(slots, 0.0);
+    std::vector<bool> present(slots, false);
+    for (const auto& mean : means) {
+        size_t row = static_cast<size_t>(std::lower_bound(configs.begin(), configs.end(), mean.config) - configs.begin());
+        size_t slot = row * algorithms.size() + mean.algorithm;
+        if (present[slot] && throughput_grid[slot] >= mean.throughput) {
+            continue;  // A better tuning variant of the same cell
+        }
+        throughput_grid[slot] = mean.throughput;
+        latency_grid[slot] = mean.latency;
+        present[slot] = true;
+    }
+
+    write_pivot(prefix + "throughput_vs_bandwidth.csv", algorithms, configs, throughput_grid, present);
+    write_pivot(prefix + "latency_vs_bandwidth.csv", algorithms, configs, latency_grid, present);
+    return true;
+}
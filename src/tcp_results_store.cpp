@@ -0,0 +1,472 @@
+#include "tcp_results_store.h"
+
+#include <algorithm>
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+
+namespace {
+
+// stdio buffer for the writer; series blocks are written in one go
+const size_t kWriteBuffer = 1024 * 1024;
+
+const uint64_t kZeroPad = 0;
+
+size_t column_width(ColumnType type) {
+    return type == ColumnType::U32 ? sizeof(uint32_t) : sizeof(uint64_t);
+}
+
+size_t padded(size_t bytes) {
+    return (bytes + 7) & ~static_cast<size_t>(7);
+}
+
+void copy_name(char* into, size_t size, const char* name) {
+    std::memset(into, 0, size);
+    std::memcpy(into, name, strnlen(name, size));
+}
+
+std::string_view name_view(const char* name, size_t size) {
+    return std::string_view(name, strnlen(name, size));
+}
+
+} // namespace
+
+bool results_key_less(const ResultsCellKey& a, const ResultsCellKey& b) {
+    int order = std::memcmp(a.algorithm, b.algorithm, kResultsNameLength);
+    if (order != 0) {
+        return order < 0;
+    }
+    if (a.bandwidth_mbps != b.bandwidth_mbps) {
+        return a.bandwidth_mbps < b.bandwidth_mbps;
+    }
+    if (a.latency_ms != b.latency_ms) {
+        return a.latency_ms < b.latency_ms;
+    }
+    if (a.variant != b.variant) {
+        return a.variant < b.variant;
+    }
+    return a.trial < b.trial;
+}
+
+ResultsCellKey make_results_key(const std::string& algorithm, int bandwidth_mbps, int latency_ms,
+                                uint32_t trial, uint32_t variant) {
+    ResultsCellKey key;
+    copy_name(key.algorithm, sizeof(key.algorithm), algorithm.c_str());
+    key.bandwidth_mbps = bandwidth_mbps;
+    key.latency_ms = latency_ms;
+    key.trial = trial;
+    key.variant = variant;
+    return key;
+}
+
+std::string_view results_key_algorithm(const ResultsCellKey& key) {
+    return name_view(key.algorithm, sizeof(key.algorithm));
+}
+
+ResultsStoreWriter::ResultsStoreWriter() : file_(nullptr), offset_(0) {}
+
+ResultsStoreWriter::~ResultsStoreWriter() {
+    close();
+}
+
+bool ResultsStoreWriter::open(const std::string& path) {
+    close();
+    index_.clear();
+
+    file_ = std::fopen(path.c_str(), "wb");
+    if (file_ == nullptr) {
+        std::cerr << "Failed to create " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    std::setvbuf(file_, nullptr, _IOFBF, kWriteBuffer);
+    path_ = path;
+
+    ResultsFileHeader header;
+    std::memcpy(header.magic, kResultsMagic, sizeof(header.magic));
+    header.version = kResultsVersion;
+    header.reserved = 0;
+    if (std::fwrite(&header, sizeof(header), 1, file_) != 1) {
+        std::cerr << "Failed to write " << path << ": " << std::strerror(errno) << std::endl;
+        std::fclose(file_);
+        file_ = nullptr;
+        return false;
+    }
+    offset_ = sizeof(header);
+    return true;
+}
+
+bool ResultsStoreWriter::write_block(uint32_t type, const std::vector<std::pair<const void*, size_t>>& parts) {
+    ResultsBlockHeader header;
+    header.type = type;
+    header.reserved = 0;
+    header.size = 0;
+    for (const auto& part : parts) {
+        header.size += part.second;
+    }
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file_) == 1;
+    for (const auto& part : parts) {
+        if (ok && part.second > 0) {
+            ok = std::fwrite(part.first, 1, part.second, file_) == part.second;
+        }
+    }
+    if (!ok) {
+        std::cerr << "Failed to write " << path_ << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    offset_ += sizeof(header) + header.size;
+    return true;
+}
+
+bool ResultsStoreWriter::append_cell(const ResultsCellKey& key, const std::vector<MetricValue>& metrics,
+                                     uint64_t rows, const std::vector<ColumnRef>& columns,
+                                     const std::vector<SketchRef>& sketches) {
+    if (file_ == nullptr) {
+        return false;
+    }
+
+    ResultsIndexEntry entry;
+    entry.key = key;
+    entry.series_offset = 0;
+
+    if (rows > 0 && !columns.empty()) {
+        ResultsSeriesHeader series;
+        series.rows = rows;
+        series.column_count = static_cast<uint32_t>(columns.size());
+        series.reserved = 0;
+
+        // Column data follows the column directory, each column 8-byte aligned
+        std::vector<ResultsColumnInfo> infos(columns.size());
+        std::vector<std::pair<const void*, size_t>> parts;
+        parts.emplace_back(&series, sizeof(series));
+        parts.emplace_back(infos.data(), infos.size() * sizeof(ResultsColumnInfo));
+        uint64_t offset = sizeof(series) + infos.size() * sizeof(ResultsColumnInfo);
+        for (size_t i = 0; i < columns.size(); ++i) {
+            size_t bytes = static_cast<size_t>(rows) * column_width(columns[i].type);
+            copy_name(infos[i].name, sizeof(infos[i].name), columns[i].name);
+            infos[i].type = static_cast<uint32_t>(columns[i].type);
+            infos[i].offset = offset;
+            parts.emplace_back(columns[i].data, bytes);
+            parts.emplace_back(&kZeroPad, padded(bytes) - bytes);
+            offset += padded(bytes);
+        }
+
+        entry.series_offset = offset_;
+        if (!write_block(kResultsSeriesBlock, parts)) {
+            return false;
+        }
+    }
+
+    ResultsCellRecord record;
+    record.key = key;
+    record.series_offset = entry.series_offset;
+    record.metric_count = static_cast<uint32_t>(metrics.size());
+    record.sketch_count = static_cast<uint32_t>(sketches.size());
+    std::vector<ResultsMetric> values(metrics.size());
+    for (size_t i = 0; i < metrics.size(); ++i) {
+        copy_name(values[i].name, sizeof(values[i].name), metrics[i].name);
+        values[i].value = metrics[i].value;
+    }
+
+    // Each sketch is written as its non-zero slot range
+    std::vector<ResultsSketchHeader> heads(sketches.size());
+    std::vector<std::vector<uint64_t>> slots(sketches.size());
+    std::vector<std::pair<const void*, size_t>> parts;
+    parts.emplace_back(&record, sizeof(record));
+    parts.emplace_back(values.data(), values.size() * sizeof(ResultsMetric));
+    for (size_t i = 0; i < sketches.size(); ++i) {
+        const LatencySketch& sketch = *sketches[i].sketch;
+        ResultsSketchHeader& head = heads[i];
+        copy_name(head.name, sizeof(head.name), sketches[i].name);
+        head.min = sketch.min();
+        head.max = sketch.max();
+        head.sum = sketch.sum();
+        head.first_slot = static_cast<uint32_t>(sketch.first_slot());
+        head.slot_count = sketch.empty() ? 0 : static_cast<uint32_t>(sketch.last_slot() - sketch.first_slot() + 1);
+        for (uint32_t slot = 0; slot < head.slot_count; ++slot) {
+            slots[i].push_back(sketch.slot(head.first_slot + slot));
+        }
+        parts.emplace_back(&head, sizeof(head));
+        parts.emplace_back(slots[i].data(), slots[i].size() * sizeof(uint64_t));
+    }
+
+    entry.cell_offset = offset_;
+    if (!write_block(kResultsCellBlock, parts)) {
+        return false;
+    }
+
+    // Push finished cells to the kernel so an interrupted sweep keeps them
+    std::fflush(file_);
+    index_.push_back(entry);
+    return true;
+}
+
+bool ResultsStoreWriter::copy_cell(const ResultsStoreReader& from, size_t index, const ResultsCellKey& key) {
+    if (file_ == nullptr) {
+        return false;
+    }
+
+    // The record points at its series block, which moves with the copy
+    ResultsIndexEntry entry;
+    entry.key = key;
+    entry.series_offset = 0;
+    const ResultsBlockHeader* series = from.series_block(index);
+    if (series != nullptr) {
+        entry.series_offset = offset_;
+        if (!write_block(kResultsSeriesBlock, {{series + 1, series->size}})) {
+            return false;
+        }
+    }
+
+    const ResultsBlockHeader* cell = from.cell_block(index);
+    ResultsCellRecord record = from.cell(index);
+    record.key = key;
+    record.series_offset = entry.series_offset;
+    const char* rest = reinterpret_cast<const char*>(cell + 1) + sizeof(record);
+    entry.cell_offset = offset_;
+    if (!write_block(kResultsCellBlock, {{&record, sizeof(record)}, {rest, cell->size - sizeof(record)}})) {
+        return false;
+    }
+
+    std::fflush(file_);
+    index_.push_back(entry);
+    return true;
+}
+
+void ResultsStoreWriter::drop_cells(size_t cells) {
+    if (cells < index_.size()) {
+        index_.resize(cells);
+    }
+}
+
+bool ResultsStoreWriter::close() {
+    if (file_ == nullptr) {
+        return true;
+    }
+
+    std::sort(index_.begin(), index_.end(), [](const ResultsIndexEntry& a, const ResultsIndexEntry& b) {
+        return results_key_less(a.key, b.key);
+    });
+
+    ResultsTrailer trailer;
+    trailer.index_offset = offset_;
+    std::memcpy(trailer.magic, kResultsIndexMagic, sizeof(trailer.magic));
+
+    uint64_t count = index_.size();
+    bool ok = write_block(kResultsIndexBlock, {{&count, sizeof(count)},
+                                               {index_.data(), index_.size() * sizeof(ResultsIndexEntry)}}) &&
+              std::fwrite(&trailer, sizeof(trailer), 1, file_) == 1;
+    ok = std::fclose(file_) == 0 && ok;
+    file_ = nullptr;
+    if (!ok) {
+        std::cerr << "Failed to finish " << path_ << ": " << std::strerror(errno) << std::endl;
+    }
+    return ok;
+}
+
+double ColumnView::at(uint64_t row) const {
+    switch (type) {
+        case ColumnType::U32: return static_cast<const uint32_t*>(data)[row];
+        case ColumnType::F64: return static_cast<const double*>(data)[row];
+        case ColumnType::U64:
+        default:              return static_cast<double>(static_cast<const uint64_t*>(data)[row]);
+    }
+}
+
+ResultsStoreReader::ResultsStoreReader() : entries_(nullptr), count_(0) {}
+
+bool ResultsStoreReader::open(const std::string& path) {
+    entries_ = nullptr;
+    count_ = 0;
+    rebuilt_.clear();
+    if (!file_.open(path)) {
+        return false;
+    }
+
+    const char* data = file_.data();
+    size_t size = file_.size();
+    ResultsFileHeader header;
+    if (size < sizeof(header)) {
+        std::cerr << path << " is not a results file\n";
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, kResultsMagic, sizeof(header.magic)) != 0 ||
+        header.version != kResultsVersion) {
+        std::cerr << path << " is not a version " << kResultsVersion << " results file\n";
+        return false;
+    }
+
+    // Use the index when the writer got to close the file
+    ResultsTrailer trailer;
+    if (size >= sizeof(header) + sizeof(ResultsBlockHeader) + sizeof(uint64_t) + sizeof(trailer)) {
+        std::memcpy(&trailer, data + size - sizeof(trailer), sizeof(trailer));
+        uint64_t index_end = trailer.index_offset + sizeof(ResultsBlockHeader) + sizeof(uint64_t);
+        if (std::memcmp(trailer.magic, kResultsIndexMagic, sizeof(trailer.magic)) == 0 &&
+            trailer.index_offset % 8 == 0 && index_end <= size - sizeof(trailer)) {
+            const auto* block = reinterpret_cast<const ResultsBlockHeader*>(data + trailer.index_offset);
+            uint64_t count = *reinterpret_cast<const uint64_t*>(block + 1);
+            if (block->type == kResultsIndexBlock &&
+                count <= (size - sizeof(trailer) - index_end) / sizeof(ResultsIndexEntry)) {
+                entries_ = reinterpret_cast<const ResultsIndexEntry*>(data + index_end);
+                count_ = static_cast<size_t>(count);
+            }
+        }
+    }
+    if (entries_ == nullptr && !rebuild_index()) {
+        std::cerr << path << " is damaged\n";
+        return false;
+    }
+
+    // Entries must point at whole cell blocks before anything dereferences them
+    for (size_t i = 0; i < count_; ++i) {
+        uint64_t offset = entries_[i].cell_offset;
+        if (offset % 8 != 0 || offset + sizeof(ResultsBlockHeader) + sizeof(ResultsCellRecord) > size) {
+            std::cerr << path << " has a broken index\n";
+            count_ = 0;
+            return false;
+        }
+        const auto* block = reinterpret_cast<const ResultsBlockHeader*>(data + offset);
+        const auto* record = reinterpret_cast<const ResultsCellRecord*>(block + 1);
+        if (block->type != kResultsCellBlock || block->size < sizeof(*record) ||
+            block->size > size - offset - sizeof(*block) ||
+            record->metric_count > (size - offset - sizeof(*block) - sizeof(*record)) / sizeof(ResultsMetric)) {
+            std::cerr << path << " has a broken index\n";
+            count_ = 0;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ResultsStoreReader::rebuild_index() {
+    const char* data = file_.data();
+    size_t size = file_.size();
+
+    // Walk whole blocks; a partially written last block is dropped
+    uint64_t offset = sizeof(ResultsFileHeader);
+    while (offset + sizeof(ResultsBlockHeader) <= size) {
+        const auto* block = reinterpret_cast<const ResultsBlockHeader*>(data + offset);
+        if (block->size % 8 != 0 || block->size > size - offset - sizeof(*block)) {
+            break;
+        }
+        if (block->type == kResultsCellBlock && block->size >= sizeof(ResultsCellRecord)) {
+            const auto* record = reinterpret_cast<const ResultsCellRecord*>(block + 1);
+            ResultsIndexEntry entry;
+            entry.key = record->key;
+            entry.cell_offset = offset;
+            entry.series_offset = record->series_offset;
+            rebuilt_.push_back(entry);
+        }
+        offset += sizeof(*block) + block->size;
+    }
+
+    std::sort(rebuilt_.begin(), rebuilt_.end(), [](const ResultsIndexEntry& a, const ResultsIndexEntry& b) {
+        return results_key_less(a.key, b.key);
+    });
+    entries_ = rebuilt_.data();
+    count_ = rebuilt_.size();
+    return true;
+}
+
+const ResultsCellRecord& ResultsStoreReader::cell(size_t index) const {
+    const char* block = file_.data() + entries_[index].cell_offset;
+    return *reinterpret_cast<const ResultsCellRecord*>(block + sizeof(ResultsBlockHeader));
+}
+
+const ResultsMetric* ResultsStoreReader::metrics(size_t index) const {
+    return reinterpret_cast<const ResultsMetric*>(&cell(index) + 1);
+}
+
+double ResultsStoreReader::metric(size_t index, std::string_view name, double fallback) const {
+    const ResultsCellRecord& record = cell(index);
+    const ResultsMetric* values = metrics(index);
+    for (uint32_t i = 0; i < record.metric_count; ++i) {
+        if (name_view(values[i].name, sizeof(values[i].name)) == name) {
+            return values[i].value;
+        }
+    }
+    return fallback;
+}
+
+bool ResultsStoreReader::sketch(size_t index, std::string_view name, LatencySketch& sketch) const {
+    sketch.clear();
+    const ResultsCellRecord& record = cell(index);
+    const auto* block = reinterpret_cast<const ResultsBlockHeader*>(&record) - 1;
+    const char* end = reinterpret_cast<const char*>(block + 1) + block->size;
+    const char* at = reinterpret_cast<const char*>(metrics(index) + record.metric_count);
+
+    // Sketches are variable length, so walk them in order
+    for (uint32_t i = 0; i < record.sketch_count; ++i) {
+        if (static_cast<size_t>(end - at) < sizeof(ResultsSketchHeader)) {
+            return false;
+        }
+        const auto* head = reinterpret_cast<const ResultsSketchHeader*>(at);
+        const auto* slots = reinterpret_cast<const uint64_t*>(head + 1);
+        at += sizeof(*head);
+        if (head->slot_count > static_cast<size_t>(end - at) / sizeof(uint64_t)) {
+            return false;
+        }
+        at += head->slot_count * sizeof(uint64_t);
+        if (name_view(head->name, sizeof(head->name)) == name) {
+            return sketch.restore(head->first_slot, head->slot_count, slots, head->min, head->max, head->sum);
+        }
+    }
+    return false;
+}
+
+const ResultsBlockHeader* ResultsStoreReader::cell_block(size_t index) const {
+    return reinterpret_cast<const ResultsBlockHeader*>(file_.data() + entries_[index].cell_offset);
+}
+
+const ResultsBlockHeader* ResultsStoreReader::series_block(size_t index) const {
+    uint64_t offset = entries_[index].series_offset;
+    size_t size = file_.size();
+    if (offset == 0 || offset % 8 != 0 || offset + sizeof(ResultsBlockHeader) + sizeof(ResultsSeriesHeader) > size) {
+        return nullptr;
+    }
+    const auto* block = reinterpret_cast<const ResultsBlockHeader*>(file_.data() + offset);
+    if (block->type != kResultsSeriesBlock || block->size % 8 != 0 || block->size > size - offset - sizeof(*block)) {
+        return nullptr;
+    }
+    return block;
+}
+
+const ResultsSeriesHeader* ResultsStoreReader::series_header(size_t index) const {
+    const ResultsBlockHeader* block = series_block(index);
+    return block != nullptr ? reinterpret_cast<const ResultsSeriesHeader*>(block + 1) : nullptr;
+}
+
+uint64_t ResultsStoreReader::series_rows(size_t index) const {
+    const ResultsSeriesHeader* series = series_header(index);
+    return series != nullptr ? series->rows : 0;
+}
+
+ColumnView ResultsStoreReader::series_column(size_t index, std::string_view name) const {
+    ColumnView view;
+    const ResultsSeriesHeader* series = series_header(index);
+    if (series == nullptr) {
+        return view;
+    }
+
+    const auto* block = reinterpret_cast<const ResultsBlockHeader*>(series) - 1;
+    const char* payload = reinterpret_cast<const char*>(series);
+    const auto* infos = reinterpret_cast<const ResultsColumnInfo*>(series + 1);
+    if (series->column_count > (block->size - sizeof(*series)) / sizeof(ResultsColumnInfo)) {
+        return view;
+    }
+    for (uint32_t i = 0; i < series->column_count; ++i) {
+        if (name_view(infos[i].name, sizeof(infos[i].name)) != name) {
+            continue;
+        }
+        ColumnType type = static_cast<ColumnType>(infos[i].type);
+        uint64_t bytes = series->rows * column_width(type);
+        if (series->rows <= block->size && infos[i].offset % 8 == 0 && infos[i].offset <= block->size &&
+            bytes <= block->size - infos[i].offset) {
+            view.type = type;
+            view.data = payload + infos[i].offset;
+        }
+        break;
+    }
+    return view;
+}
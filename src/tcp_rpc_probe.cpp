@@ -0,0 +1,182 @@
+#include "tcp_rpc_probe.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <time.h>
+
+namespace {
+
+uint64_t monotonic_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Write or read exactly len bytes; false on error or end of stream
+bool send_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool recv_all(int fd, char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = recv(fd, data, len, MSG_WAITALL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Sleep until the monotonic deadline or until fd becomes readable, which
+// is how stop() interrupts the wait; false when woken by fd
+bool wait_until(int fd, uint64_t deadline_ns) {
+    for (;;) {
+        uint64_t now = monotonic_ns();
+        if (now >= deadline_ns) {
+            return true;
+        }
+        uint64_t wait = deadline_ns - now;
+        struct timespec timeout;
+        timeout.tv_sec = static_cast<time_t>(wait / 1000000000);
+        timeout.tv_nsec = static_cast<long>(wait % 1000000000);
+        struct pollfd pfd = {fd, POLLIN, 0};
+        int ready = ppoll(&pfd, 1, &timeout, nullptr);
+        if (ready > 0) {
+            return false;
+        }
+        if (ready < 0 && errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+} // namespace
+
+RpcProbe::RpcProbe(int client_fd, int server_fd, const RpcProbeConfig& config)
+    : client_fd_(client_fd),
+      server_fd_(server_fd),
+      config_(config),
+      stop_requested_(false),
+      running_(false) {
+    config_.request_size = std::max(config_.request_size, kMinRpcRequestSize);
+}
+
+RpcProbe::~RpcProbe() {
+    if (running_) {
+        stop();
+    }
+}
+
+bool RpcProbe::start() {
+    if (running_) {
+        return true;
+    }
+    if (client_fd_ < 0 || server_fd_ < 0 || config_.rate_hz <= 0) {
+        std::cerr << "Request/response probe needs a connected socket pair and a rate\n";
+        return false;
+    }
+
+    // Requests and responses are single small segments; Nagle would hold
+    // them back behind the delayed ACK of the previous one
+    int one = 1;
+    setsockopt(client_fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(server_fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    stats_ = RpcProbeStats();
+    stop_requested_.store(false, std::memory_order_relaxed);
+    server_ = std::thread(&RpcProbe::server_loop, this);
+    client_ = std::thread(&RpcProbe::client_loop, this);
+    running_ = true;
+    return true;
+}
+
+RpcProbeStats RpcProbe::stop() {
+    if (!running_) {
+        return RpcProbeStats();
+    }
+
+    // A read shutdown wakes the client from its wait or its pending
+    // response; the write shutdown ends the server's stream
+    stop_requested_.store(true, std::memory_order_relaxed);
+    shutdown(client_fd_, SHUT_RDWR);
+    shutdown(server_fd_, SHUT_RD);
+
+    if (client_.joinable()) {
+        client_.join();
+    }
+    if (server_.joinable()) {
+        server_.join();
+    }
+    running_ = false;
+    return stats_;
+}
+
+void RpcProbe::client_loop() {
+    std::vector<char> message(config_.request_size, 0);
+    const uint64_t interval_ns = 1000000000ull / static_cast<uint64_t>(config_.rate_hz);
+    uint64_t next = monotonic_ns();
+
+    while (!stop_requested_.load(std::memory_order_relaxed)) {
+        if (!wait_until(client_fd_, next)) {
+            break;
+        }
+
+        uint64_t header[3] = {stats_.requests, monotonic_ns(), 0};
+        std::memcpy(message.data(), header, sizeof(header));
+        if (!send_all(client_fd_, message.data(), message.size())) {
+            break;
+        }
+        stats_.requests++;
+
+        if (!recv_all(client_fd_, message.data(), message.size())) {
+            break;
+        }
+        uint64_t now = monotonic_ns();
+        std::memcpy(header, message.data(), sizeof(header));
+        stats_.responses++;
+        stats_.rtt_us.record((now - header[1]) / 1000);
+        if (header[2] >= header[1]) {
+            stats_.owd_us.record((header[2] - header[1]) / 1000);
+        }
+
+        // Ticks that passed while waiting for the response are skipped
+        next += interval_ns;
+        if (next < now) {
+            next += (now - next) / interval_ns * interval_ns + interval_ns;
+        }
+    }
+}
+
+void RpcProbe::server_loop() {
+    std::vector<char> message(config_.request_size, 0);
+
+    while (recv_all(server_fd_, message.data(), message.size())) {
+        uint64_t received_at = monotonic_ns();
+        std::memcpy(message.data() + 2 * sizeof(uint64_t), &received_at, sizeof(received_at));
+        if (!send_all(server_fd_, message.data(), message.size())) {
+            break;
+        }
+    }
+}
@@ -0,0 +1,237 @@
+#include "tcp_scenario.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+// Built-in scenarios: a capacity step each way, an RTT spike and a loss burst
+struct NamedScenario {
+    const char* name;
+    const char* steps;
+};
+const NamedScenario kBuiltinScenarios[] = {
+    {"step-down", "0:rate=100,delay=20;10:rate=10;20:rate=100"},
+    {"step-up", "0:rate=10,delay=20;10:rate=100;20:rate=10"},
+    {"rtt-spike", "0:rate=50,delay=20;10:delay=200;12:delay=20"},
+    {"loss-burst", "0:rate=50,delay=20;10:loss=5;11:loss=0"},
+};
+
+bool parse_number(const std::string& text, double& value) {
+    char* end = nullptr;
+    value = std::strtod(text.c_str(), &end);
+    return !text.empty() && end == text.c_str() + text.size() && std::isfinite(value) && value >= 0.0;
+}
+
+// "SECONDS:key=value,..." applied on top of the previous conditions
+bool parse_step(const std::string& text, const LinkConditions& previous, ScenarioStep& step) {
+    size_t colon = text.find(':');
+    if (colon == std::string::npos || !parse_number(text.substr(0, colon), step.at_seconds)) {
+        std::cerr << "Scenario step '" << text << "' does not start with SECONDS:\n";
+        return false;
+    }
+    step.conditions = previous;
+    step.text = text;
+
+    std::istringstream fields(text.substr(colon + 1));
+    std::string field;
+    while (std::getline(fields, field, ',')) {
+        size_t equals = field.find('=');
+        double value = 0.0;
+        if (equals == std::string::npos || !parse_number(field.substr(equals + 1), value)) {
+            std::cerr << "Bad setting '" << field << "' in scenario step '" << text << "'\n";
+            return false;
+        }
+        std::string key = field.substr(0, equals);
+        if (key == "rate") {
+            step.conditions.rate_mbps = value;
+        } else if (key == "delay") {
+            step.conditions.delay_ms = value;
+        } else if (key == "jitter") {
+            step.conditions.jitter_ms = value;
+        } else if (key == "loss") {
+            step.conditions.loss_percent = value;
+        } else if (key == "reorder") {
+            step.conditions.reorder_percent = value;
+        } else {
+            std::cerr << "Unknown setting '" << key << "' in scenario step '" << text << "'\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+double Scenario::length_seconds(double duration_seconds) const {
+    double last = steps.empty() ? 0.0 : steps.back().at_seconds;
+    return std::max(duration_seconds, last + kScenarioSettleSeconds);
+}
+
+bool parse_scenario(const std::string& text, const LinkConditions& base, Scenario& scenario) {
+    std::string steps = text;
+    for (const auto& builtin : kBuiltinScenarios) {
+        if (text == builtin.name) {
+            steps = builtin.steps;
+        }
+    }
+    if (steps == text) {
+        std::ifstream file(text);
+        if (file) {
+            steps.clear();
+            std::string line;
+            while (std::getline(file, line)) {
+                if (!line.empty() && line[0] != '#') {
+                    steps += line + ";";
+                }
+            }
+        }
+    }
+
+    scenario = Scenario();
+    scenario.name = text;
+    LinkConditions previous = base;
+    std::istringstream parts(steps);
+    std::string part;
+    while (std::getline(parts, part, ';')) {
+        part.erase(std::remove_if(part.begin(), part.end(), ::isspace), part.end());
+        if (part.empty()) {
+            continue;
+        }
+        ScenarioStep step;
+        if (!parse_step(part, previous, step)) {
+            return false;
+        }
+        if (!scenario.steps.empty() && step.at_seconds <= scenario.steps.back().at_seconds) {
+            std::cerr << "Scenario steps must be in increasing time order: '" << part << "'\n";
+            return false;
+        }
+        previous = step.conditions;
+        scenario.steps.push_back(step);
+    }
+    if (scenario.steps.empty()) {
+        std::cerr << "Scenario '" << text << "' has no steps\n";
+        return false;
+    }
+
+    // The run starts from the base conditions until the first step
+    if (scenario.steps.front().at_seconds > 0.0) {
+        ScenarioStep start;
+        start.conditions = base;
+        start.text = "0:base";
+        scenario.steps.insert(scenario.steps.begin(), start);
+    }
+    return true;
+}
+
+void scenario_bins(const TcpInfoSeries& series, double length_seconds,
+                   std::vector<double>& mbps, std::vector<double>& rtt_ms) {
+    size_t bins = static_cast<size_t>(std::ceil(length_seconds / kScenarioBinSeconds - 1e-9));
+    mbps.assign(bins, 0.0);
+    rtt_ms.assign(bins, 0.0);
+    if (series.rows() == 0 || bins == 0) {
+        return;
+    }
+
+    // Acknowledged bytes at the end of every bin, and RTT sums per bin
+    const uint64_t bin_ns = static_cast<uint64_t>(kScenarioBinSeconds * 1e9);
+    std::vector<uint64_t> acked(bins, 0);
+    std::vector<size_t> samples(bins, 0);
+    uint64_t last_acked = series.bytes_acked[0];
+    size_t row = 0;
+    for (size_t b = 0; b < bins; ++b) {
+        uint64_t end = (b + 1) * bin_ns;
+        for (; row < series.rows() && series.t_ns[row] < end; ++row) {
+            last_acked = series.bytes_acked[row];
+            rtt_ms[b] += series.rtt_us[row] / 1000.0;
+            samples[b]++;
+        }
+        acked[b] = last_acked;
+    }
+
+    uint64_t previous = series.bytes_acked[0];
+    for (size_t b = 0; b < bins; ++b) {
+        mbps[b] = (acked[b] - previous) * 8.0 / kScenarioBinSeconds / 1e6;
+        previous = acked[b];
+        // Bins without samples repeat the last RTT seen
+        if (samples[b] > 0) {
+            rtt_ms[b] /= static_cast<double>(samples[b]);
+        } else if (b > 0) {
+            rtt_ms[b] = rtt_ms[b - 1];
+        }
+    }
+}
+
+std::vector<ConvergenceResult> analyze_convergence(const TcpInfoSeries& series, const Scenario& scenario,
+                                                   double length_seconds) {
+    std::vector<ConvergenceResult> results;
+    std::vector<double> mbps;
+    std::vector<double> rtt_ms;
+    scenario_bins(series, length_seconds, mbps, rtt_ms);
+    if (mbps.empty() || series.rows() == 0) {
+        return results;
+    }
+
+    // Queueing delay is the RTT above the lowest one seen in the run and
+    // above the propagation delay a step adds over the run's lowest, so an
+    // RTT spike is not taken for a queue
+    uint32_t min_rtt_us = *std::min_element(series.rtt_us.begin(), series.rtt_us.end());
+    double min_delay_ms = scenario.steps.front().conditions.delay_ms;
+    for (const auto& step : scenario.steps) {
+        min_delay_ms = std::min(min_delay_ms, step.conditions.delay_ms);
+    }
+
+    for (size_t i = 0; i < scenario.steps.size(); ++i) {
+        ConvergenceResult result;
+        result.at_seconds = scenario.steps[i].at_seconds;
+        double end_seconds = i + 1 < scenario.steps.size() ? scenario.steps[i + 1].at_seconds : length_seconds;
+        size_t first = static_cast<size_t>(result.at_seconds / kScenarioBinSeconds + 1e-9);
+        size_t last = std::min(mbps.size(), static_cast<size_t>(end_seconds / kScenarioBinSeconds + 1e-9));
+        if (last <= first) {
+            results.push_back(result);
+            continue;
+        }
+
+        // After the delay drops, packets already on the path take the old
+        // one for about an old RTT
+        double delay_ms = scenario.steps[i].conditions.delay_ms;
+        double previous_ms = i > 0 ? std::max(delay_ms, scenario.steps[i - 1].conditions.delay_ms) : delay_ms;
+        size_t lingering = first + static_cast<size_t>(std::ceil(previous_ms / 1000.0 / kScenarioBinSeconds));
+        auto base_ms = [&](size_t bin) {
+            return min_rtt_us / 1000.0 + (bin < lingering ? previous_ms : delay_ms) - min_delay_ms;
+        };
+
+        // Steady state: the last quarter of the window
+        size_t tail = last - std::max<size_t>(1, (last - first) / 4);
+        double throughput_sum = 0.0;
+        double rtt_sum = 0.0;
+        for (size_t b = tail; b < last; ++b) {
+            throughput_sum += mbps[b];
+            rtt_sum += rtt_ms[b];
+        }
+        result.steady_mbps = throughput_sum / static_cast<double>(last - tail);
+        result.steady_queue_ms = std::max(0.0, rtt_sum / static_cast<double>(last - tail) - base_ms(tail));
+
+        // Converged after the last bin outside the band, unless that bin is
+        // part of the steady window itself
+        size_t settled = first;
+        for (size_t b = first; b < last; ++b) {
+            if (std::fabs(mbps[b] - result.steady_mbps) > kConvergenceTolerance * result.steady_mbps) {
+                settled = b + 1;
+            }
+            result.peak_queue_ms = std::max(result.peak_queue_ms, rtt_ms[b] - base_ms(b));
+        }
+        if (settled <= tail) {
+            result.convergence_seconds = (settled - first) * kScenarioBinSeconds;
+        }
+        result.overshoot_ms = std::max(0.0, result.peak_queue_ms - result.steady_queue_ms);
+        result.overshoot_bytes = result.overshoot_ms / 1000.0 * result.steady_mbps * 1e6 / 8.0;
+        results.push_back(result);
+    }
+    return results;
+}
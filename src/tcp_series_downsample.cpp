@@ -0,0 +1,149 @@
+#include "tcp_series_downsample.h"
+
+#include <cmath>
+
+namespace {
+
+SeriesPoint average(const std::vector<SeriesPoint>& points) {
+    SeriesPoint mean = {0.0, 0.0};
+    for (const auto& point : points) {
+        mean.x += point.x;
+        mean.y += point.y;
+    }
+    mean.x /= static_cast<double>(points.size());
+    mean.y /= static_cast<double>(points.size());
+    return mean;
+}
+
+} // namespace
+
+bool parse_downsample_method(const std::string& name, DownsampleMethod& method) {
+    if (name == "lttb") {
+        method = DownsampleMethod::Lttb;
+    } else if (name == "minmax") {
+        method = DownsampleMethod::MinMax;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* downsample_method_name(DownsampleMethod method) {
+    switch (method) {
+        case DownsampleMethod::MinMax: return "minmax";
+        case DownsampleMethod::Lttb:
+        default:                       return "lttb";
+    }
+}
+
+SeriesDownsampler::SeriesDownsampler(DownsampleMethod method, uint64_t points, size_t budget)
+    : method_(method), total_(points), seen_(0), buckets_(0), filling_bucket_(0),
+      low_{0.0, 0.0}, high_{0.0, 0.0}, bucket_(0), bucket_open_(false) {
+    // 0 buckets: the series fits and is kept whole. LTTB keeps the first
+    // and last point and one per bucket in between; min/max two per bucket.
+    if (method_ == DownsampleMethod::Lttb && budget >= 3 && points > budget) {
+        buckets_ = budget - 2;
+    } else if (method_ == DownsampleMethod::MinMax && budget >= 2 && points > budget) {
+        buckets_ = budget / 2;
+    }
+    kept_.reserve(buckets_ > 0 ? budget : static_cast<size_t>(points));
+}
+
+void SeriesDownsampler::add(double x, double y) {
+    if (seen_ >= total_) {
+        return;
+    }
+    ++seen_;
+    if (buckets_ == 0) {
+        kept_.push_back({x, y});
+    } else if (method_ == DownsampleMethod::Lttb) {
+        add_lttb(x, y);
+    } else {
+        add_minmax(x, y);
+    }
+}
+
+void SeriesDownsampler::add_lttb(double x, double y) {
+    SeriesPoint point = {x, y};
+    uint64_t index = seen_ - 1;
+    if (index == 0) {
+        kept_.push_back(point);
+        return;
+    }
+    if (index == total_ - 1) {
+        if (!pending_.empty()) {
+            select(pending_, filling_.empty() ? point : average(filling_));
+        }
+        if (!filling_.empty()) {
+            select(filling_, point);
+        }
+        kept_.push_back(point);
+        pending_.clear();
+        filling_.clear();
+        return;
+    }
+
+    // A point of a new bucket completes the one being filled, whose average
+    // is what the pending bucket's choice needs
+    uint64_t bucket = (index - 1) * buckets_ / (total_ - 2);
+    if (!filling_.empty() && bucket != filling_bucket_) {
+        if (!pending_.empty()) {
+            select(pending_, average(filling_));
+        }
+        pending_.swap(filling_);
+        filling_.clear();
+    }
+    filling_bucket_ = bucket;
+    filling_.push_back(point);
+}
+
+void SeriesDownsampler::select(const std::vector<SeriesPoint>& bucket, const SeriesPoint& next) {
+    const SeriesPoint& previous = kept_.back();
+    const SeriesPoint* best = &bucket.front();
+    double best_area = -1.0;
+    for (const auto& point : bucket) {
+        // Twice the triangle's area; only the comparison matters
+        double area = std::fabs((previous.x - next.x) * (point.y - previous.y) -
+                                (previous.x - point.x) * (next.y - previous.y));
+        if (area > best_area) {
+            best_area = area;
+            best = &point;
+        }
+    }
+    kept_.push_back(*best);
+}
+
+void SeriesDownsampler::add_minmax(double x, double y) {
+    SeriesPoint point = {x, y};
+    uint64_t bucket = (seen_ - 1) * buckets_ / total_;
+    if (bucket_open_ && bucket != bucket_) {
+        flush_minmax();
+    }
+    if (!bucket_open_) {
+        low_ = point;
+        high_ = point;
+        bucket_open_ = true;
+    } else if (y < low_.y) {
+        low_ = point;
+    } else if (y > high_.y) {
+        high_ = point;
+    }
+    bucket_ = bucket;
+    if (seen_ == total_) {
+        flush_minmax();
+    }
+}
+
+void SeriesDownsampler::flush_minmax() {
+    // Both extremes in time order, once if they are the same point
+    if (low_.x == high_.x && low_.y == high_.y) {
+        kept_.push_back(low_);
+    } else if (low_.x <= high_.x) {
+        kept_.push_back(low_);
+        kept_.push_back(high_);
+    } else {
+        kept_.push_back(high_);
+        kept_.push_back(low_);
+    }
+    bucket_open_ = false;
+}
@@ -0,0 +1,388 @@
+#include "tcp_series_export.h"
+
+#include "tcp_collector_trace.h"
+#include "tcp_csv_reader.h"
+#include "tcp_results_export.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// The data sets of a series file, in order
+enum SeriesChannel { kCwnd, kSrtt, kDelivery, kRetransmits, kQueueDelay, kChannelCount };
+
+const char* const kChannelColumns[kChannelCount] = {
+    "cwnd", "srtt_ms", "delivery_mbps", "retransmits", "queue_delay_ms",
+};
+const char* const kChannelTitles[kChannelCount] = {
+    "cwnd (packets)", "smoothed RTT (ms)", "delivery rate (Mbps)", "retransmitted segments",
+    "queueing delay (ms)",
+};
+
+// A written series file and the channels it holds, for series.gp
+struct SeriesFile {
+    std::string name;           // Without .dat
+    std::string title;
+    std::vector<int> channels;  // In file order, i.e. by gnuplot index
+};
+
+std::vector<SeriesDownsampler> make_channels(const SeriesOptions& options,
+                                             const uint64_t (&points)[kChannelCount]) {
+    std::vector<SeriesDownsampler> channels;
+    channels.reserve(kChannelCount);
+    for (int channel = 0; channel < kChannelCount; ++channel) {
+        channels.emplace_back(options.method, points[channel], options.points);
+    }
+    return channels;
+}
+
+// Write the non-empty channels as consecutive gnuplot data sets, separated
+// by two blank lines
+bool write_series_file(const SeriesOptions& options, SeriesFile& file, uint64_t samples,
+                       const std::vector<SeriesDownsampler>& channels) {
+    std::string path = options.directory + "/" + file.name + ".dat";
+    std::FILE* out = std::fopen(path.c_str(), "w");
+    if (out == nullptr) {
+        std::cerr << "Failed to create " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    std::fprintf(out, "# %s\n# %llu samples, %s to at most %zu points per series\n", file.title.c_str(),
+                 static_cast<unsigned long long>(samples), downsample_method_name(options.method), options.points);
+    for (int channel = 0; channel < kChannelCount; ++channel) {
+        const std::vector<SeriesPoint>& points = channels[channel].points();
+        if (points.empty()) {
+            continue;
+        }
+        std::fprintf(out, "%s# index %zu\n# time_s %s\n", file.channels.empty() ? "" : "\n\n",
+                     file.channels.size(), kChannelColumns[channel]);
+        for (const auto& point : points) {
+            std::fprintf(out, "%.9g %.9g\n", point.x, point.y);
+        }
+        file.channels.push_back(channel);
+    }
+    return std::fclose(out) == 0;
+}
+
+// series.gp: one PNG per file, a panel per channel
+bool write_plot_script(const SeriesOptions& options, const std::vector<SeriesFile>& files, const char* what) {
+    std::string path = options.directory + "/series.gp";
+    std::ofstream script(path);
+    if (!script) {
+        std::cerr << "Failed to create " << path << std::endl;
+        return false;
+    }
+    script << "# Plot every series file of this directory: cd " << options.directory << " && gnuplot series.gp\n"
+           << "set terminal pngcairo size 1200,1600\n"
+           << "set grid\n"
+           << "set xlabel 'time (s)'\n"
+           << "set key top left\n";
+    for (const auto& file : files) {
+        if (file.channels.empty()) {
+            continue;
+        }
+        script << "\nset output '" << file.name << ".png'\n"
+               << "set multiplot layout " << file.channels.size() << ",1 title '" << file.title << "'\n";
+        for (size_t index = 0; index < file.channels.size(); ++index) {
+            script << "plot '" << file.name << ".dat' index " << index << " using 1:2 with lines title '"
+                   << kChannelTitles[file.channels[index]] << "'\n";
+        }
+        script << "unset multiplot\n";
+    }
+    script.close();
+    std::cout << "Time series of " << files.size() << " " << what << " saved to " << options.directory
+              << "/ (plot with series.gp)" << std::endl;
+    return static_cast<bool>(script);
+}
+
+bool make_directory(const std::string& directory) {
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        std::cerr << "Failed to create " << directory << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Delivery rate of a collector flow over windows of acknowledged bytes
+struct RateWindow {
+    bool open = false;
+    uint64_t start_ns = 0;
+    uint64_t start_acked = 0;
+
+    // True when t_ns closes a window, with its rate in mbps
+    bool add(uint64_t t_ns, uint64_t acked, double& mbps) {
+        const uint64_t window_ns = static_cast<uint64_t>(kCollectorRateWindowMs) * 1000000;
+        if (!open || t_ns < start_ns) {
+            open = true;
+            start_ns = t_ns;
+            start_acked = acked;
+            return false;
+        }
+        if (t_ns - start_ns < window_ns) {
+            return false;
+        }
+        uint64_t bytes = acked > start_acked ? acked - start_acked : 0;
+        mbps = static_cast<double>(bytes) * 8.0 / (static_cast<double>(t_ns - start_ns) / 1e9) / 1e6;
+        start_ns = t_ns;
+        start_acked = acked;
+        return true;
+    }
+};
+
+// One flow of a collector trace across both passes
+struct CollectorFlow {
+    std::string algorithm;
+    uint64_t src_port = 0;
+    uint64_t dst_port = 0;
+    uint64_t points[kChannelCount] = {};
+    uint64_t min_rtt_us = UINT64_MAX;
+    uint64_t first_retrans = 0;
+    bool retrans_seen = false;
+    RateWindow rate;
+    std::vector<SeriesDownsampler> channels;
+};
+
+// One row of a collector trace, as far as it has the columns
+struct CollectorRow {
+    uint64_t t_ns = 0;
+    uint64_t rtt_us = 0;
+    uint64_t cwnd = 0;
+    uint64_t retrans = 0;
+    uint64_t acked = 0;
+    bool has_cwnd = false;
+    bool has_retrans = false;
+    bool has_acked = false;
+};
+
+// Stream a collector trace, calling visit(flow, row) for every row with a
+// timestamp and an RTT; the flow table persists across calls
+template <typename Visit>
+bool scan_collector_trace(const std::string& path, std::unordered_map<uint64_t, CollectorFlow>& flows,
+                          std::vector<std::string>& algorithms, Visit visit) {
+    CsvReader reader;
+    if (!reader.open(path)) {
+        return false;
+    }
+    int ts_col = reader.column("timestamp");
+    int rtt_col = reader.column("rtt_us");
+    if (ts_col < 0 || rtt_col < 0) {
+        std::cerr << path << " has no timestamp or rtt_us column" << std::endl;
+        return false;
+    }
+    int cwnd_col = reader.column("cwnd");
+    int retrans_col = reader.column("retrans_packets");
+    int acked_col = reader.column("bytes_acked");
+    int sport_col = reader.column("src_port");
+    int dport_col = reader.column("dst_port");
+    int algo_col = reader.column("cc_algo");
+
+    CollectorTraceName name;
+    std::string filename = path.substr(path.find_last_of('/') + 1);
+    std::string fallback = parse_collector_trace_name(filename, name) ? name.algorithm : "unknown";
+    size_t current = 0;
+
+    while (reader.next()) {
+        CollectorRow row;
+        if (!reader.number(ts_col, row.t_ns) || !reader.number(rtt_col, row.rtt_us)) {
+            continue;
+        }
+        row.has_cwnd = reader.number(cwnd_col, row.cwnd);
+        row.has_retrans = reader.number(retrans_col, row.retrans);
+        row.has_acked = reader.number(acked_col, row.acked);
+
+        // Rows of one algorithm come in runs; only a change costs a search
+        std::string_view algorithm = reader.field(algo_col);
+        if (algorithm.empty()) {
+            algorithm = fallback;
+        }
+        if (algorithms.empty() || algorithms[current] != algorithm) {
+            auto it = std::find(algorithms.begin(), algorithms.end(), algorithm);
+            if (it == algorithms.end()) {
+                algorithms.emplace_back(algorithm);
+                it = algorithms.end() - 1;
+            }
+            current = static_cast<size_t>(it - algorithms.begin());
+        }
+        uint64_t sport = 0;
+        uint64_t dport = 0;
+        reader.number(sport_col, sport);
+        reader.number(dport_col, dport);
+        uint64_t key = (static_cast<uint64_t>(current) << 32) | ((sport & 0xFFFF) << 16) | (dport & 0xFFFF);
+        CollectorFlow& flow = flows[key];
+        if (flow.algorithm.empty()) {
+            flow.algorithm = algorithms[current];
+            flow.src_port = sport;
+            flow.dst_port = dport;
+        }
+        visit(flow, row);
+    }
+    return true;
+}
+
+} // namespace
+
+bool export_series_gnuplot(const ResultsStoreReader& store, const SeriesOptions& options) {
+    if (!make_directory(options.directory)) {
+        return false;
+    }
+    std::vector<SeriesFile> files;
+    bool ok = true;
+
+    for (size_t i = 0; i < store.size(); ++i) {
+        uint64_t rows = store.series_rows(i);
+        ColumnView t_ns = store.series_column(i, "t_ns");
+        ColumnView rtt_us = store.series_column(i, "rtt_us");
+        ColumnView cwnd = store.series_column(i, "snd_cwnd");
+        ColumnView delivery = store.series_column(i, "delivery_rate");
+        ColumnView retrans = store.series_column(i, "total_retrans");
+        if (rows == 0 || !t_ns.valid() || !rtt_us.valid() || !cwnd.valid() || !delivery.valid() ||
+            !retrans.valid()) {
+            continue;
+        }
+
+        // Queueing delay is measured from the lowest RTT the cell saw
+        double min_rtt = 0.0;
+        bool have_rtt = false;
+        for (uint64_t row = 0; row < rows; ++row) {
+            double rtt = rtt_us.at(row);
+            if (rtt > 0.0 && (!have_rtt || rtt < min_rtt)) {
+                min_rtt = rtt;
+                have_rtt = true;
+            }
+        }
+
+        const uint64_t points[kChannelCount] = {rows, rows, rows, rows, rows};
+        std::vector<SeriesDownsampler> channels = make_channels(options, points);
+        double first_retrans = retrans.at(0);
+        for (uint64_t row = 0; row < rows; ++row) {
+            double t = t_ns.at(row) / 1e9;
+            double rtt = rtt_us.at(row);
+            channels[kCwnd].add(t, cwnd.at(row));
+            channels[kSrtt].add(t, rtt / 1000.0);
+            channels[kDelivery].add(t, delivery.at(row) * 8.0 / 1e6);
+            channels[kRetransmits].add(t, retrans.at(row) - first_retrans);
+            channels[kQueueDelay].add(t, std::max(rtt - min_rtt, 0.0) / 1000.0);
+        }
+
+        const ResultsCellKey& key = store.entry(i).key;
+        std::string algorithm(results_key_algorithm(key));
+        SeriesFile file;
+        file.name = algorithm + "_" + std::to_string(key.bandwidth_mbps) + "mbps_" +
+                    std::to_string(key.latency_ms) + "ms_v" + std::to_string(key.variant) + "_t" +
+                    std::to_string(key.trial);
+        file.title = algorithm + " " + std::to_string(key.bandwidth_mbps) + " Mbps " +
+                     std::to_string(key.latency_ms) + " ms, " + results_tuning_label(store, i) + ", trial " +
+                     std::to_string(key.trial);
+        if (!write_series_file(options, file, rows, channels)) {
+            ok = false;
+            continue;
+        }
+        files.push_back(file);
+    }
+    if (files.empty()) {
+        std::cout << "No cell has a time series (run with --sample-rate above 0)" << std::endl;
+        return ok;
+    }
+    return write_plot_script(options, files, "cells") && ok;
+}
+
+bool export_collector_series(const std::vector<std::string>& traces, const SeriesOptions& options) {
+    if (!make_directory(options.directory)) {
+        return false;
+    }
+    std::vector<SeriesFile> files;
+    bool ok = true;
+
+    for (const auto& path : traces) {
+        // First pass: how many points each flow's channels get, its lowest
+        // RTT and where the trace starts
+        std::unordered_map<uint64_t, CollectorFlow> flows;
+        std::vector<std::string> algorithms;
+        uint64_t start_ns = UINT64_MAX;
+        auto count = [&](CollectorFlow& flow, const CollectorRow& row) {
+            start_ns = std::min(start_ns, row.t_ns);
+            flow.points[kSrtt]++;
+            if (row.rtt_us > 0) {
+                flow.min_rtt_us = std::min(flow.min_rtt_us, row.rtt_us);
+            }
+            flow.points[kQueueDelay]++;
+            flow.points[kCwnd] += row.has_cwnd;
+            flow.points[kRetransmits] += row.has_retrans;
+            double mbps = 0.0;
+            if (row.has_acked && flow.rate.add(row.t_ns, row.acked, mbps)) {
+                flow.points[kDelivery]++;
+            }
+        };
+        if (!scan_collector_trace(path, flows, algorithms, count)) {
+            ok = false;
+            continue;
+        }
+        for (auto& entry : flows) {
+            entry.second.channels = make_channels(options, entry.second.points);
+            entry.second.rate = RateWindow();
+        }
+
+        // Second pass: feed the downsamplers
+        std::vector<std::string> second_algorithms;
+        auto feed = [&](CollectorFlow& flow, const CollectorRow& row) {
+            double t = static_cast<double>(row.t_ns - start_ns) / 1e9;
+            double rtt = static_cast<double>(row.rtt_us);
+            flow.channels[kSrtt].add(t, rtt / 1000.0);
+            double queue_us = row.rtt_us > flow.min_rtt_us ? rtt - static_cast<double>(flow.min_rtt_us) : 0.0;
+            flow.channels[kQueueDelay].add(t, queue_us / 1000.0);
+            if (row.has_cwnd) {
+                flow.channels[kCwnd].add(t, static_cast<double>(row.cwnd));
+            }
+            if (row.has_retrans) {
+                if (!flow.retrans_seen) {
+                    flow.first_retrans = row.retrans;
+                    flow.retrans_seen = true;
+                }
+                flow.channels[kRetransmits].add(t, static_cast<double>(row.retrans) -
+                                                   static_cast<double>(flow.first_retrans));
+            }
+            double mbps = 0.0;
+            if (row.has_acked && flow.rate.add(row.t_ns, row.acked, mbps)) {
+                flow.channels[kDelivery].add(t, mbps);
+            }
+        };
+        scan_collector_trace(path, flows, second_algorithms, feed);
+
+        // Files in a stable order: by algorithm, then ports
+        std::vector<const CollectorFlow*> ordered;
+        for (const auto& entry : flows) {
+            ordered.push_back(&entry.second);
+        }
+        std::sort(ordered.begin(), ordered.end(), [](const CollectorFlow* a, const CollectorFlow* b) {
+            return std::tie(a->algorithm, a->src_port, a->dst_port) <
+                   std::tie(b->algorithm, b->src_port, b->dst_port);
+        });
+        std::string trace = path.substr(path.find_last_of('/') + 1);
+        trace = trace.substr(0, trace.rfind('.'));
+        for (const CollectorFlow* flow : ordered) {
+            SeriesFile file;
+            std::string ports = std::to_string(flow->src_port) + "_" + std::to_string(flow->dst_port);
+            file.name = trace + "_" + flow->algorithm + "_" + ports;
+            file.title = flow->algorithm + " flow " + std::to_string(flow->src_port) + " -> " +
+                         std::to_string(flow->dst_port) + " of " + trace;
+            if (!write_series_file(options, file, flow->points[kSrtt], flow->channels)) {
+                ok = false;
+                continue;
+            }
+            files.push_back(file);
+        }
+    }
+    if (files.empty()) {
+        return ok;
+    }
+    return write_plot_script(options, files, "flows") && ok;
+}
@@ -0,0 +1,384 @@
+#include "tcp_socket_options.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "tcp_crash_restore.h"
+
+bool set_socket_congestion(int fd, const std::string& algorithm) {
+    if (algorithm.empty() || algorithm.size() >= kCongestionNameMax) {
+        std::cerr << "Invalid congestion control name: " << algorithm << std::endl;
+        return false;
+    }
+
+    if (setsockopt(fd, IPPROTO_TCP, TCP_CONGESTION,
+                   algorithm.c_str(), static_cast<socklen_t>(algorithm.size())) < 0) {
+        std::cerr << "Failed to set " << algorithm << " on socket: "
+                  << std::strerror(errno) << std::endl;
+        if (errno == EPERM) {
+            std::cerr << "Unprivileged users may only use algorithms listed in "
+                      << "/proc/sys/net/ipv4/tcp_allowed_congestion_control\n";
+        }
+        return false;
+    }
+
+    std::string active = get_socket_congestion(fd);
+    if (active != algorithm) {
+        std::cerr << "Socket reports congestion control '" << active
+                  << "' instead of '" << algorithm << "'\n";
+        return false;
+    }
+    return true;
+}
+
+std::string get_socket_congestion(int fd) {
+    char name[kCongestionNameMax] = {};
+    socklen_t len = sizeof(name);
+    if (getsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, name, &len) < 0) {
+        return std::string();
+    }
+    // The kernel does not always NUL-terminate a full-length name
+    return std::string(name, strnlen(name, len));
+}
+
+std::vector<std::string> available_congestion_controls() {
+    std::ifstream file("/proc/sys/net/ipv4/tcp_available_congestion_control");
+    std::vector<std::string> algorithms;
+    std::string algorithm;
+    while (file >> algorithm) {
+        algorithms.push_back(algorithm);
+    }
+    return algorithms;
+}
+
+namespace {
+
+const char* const kTuningNames[] = {"sndbuf", "rcvbuf", "notsent_lowat", "max_pacing",
+                                    "tcp_rmem", "tcp_wmem", "initcwnd", "qdisc"};
+
+// Byte size with an optional K, M or G suffix (powers of 1024)
+bool parse_bytes(const std::string& text, uint64_t& bytes) {
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long value = std::strtoull(text.c_str(), &end, 10);
+    if (end == text.c_str() || errno != 0 || text[0] == '-') {
+        return false;
+    }
+    std::string suffix(end);
+    int shift = 0;
+    if (suffix == "K" || suffix == "k") {
+        shift = 10;
+    } else if (suffix == "M" || suffix == "m") {
+        shift = 20;
+    } else if (suffix == "G" || suffix == "g") {
+        shift = 30;
+    } else if (!suffix.empty()) {
+        return false;
+    }
+    if (value > (ULLONG_MAX >> shift)) {
+        return false;
+    }
+    bytes = value << shift;
+    return true;
+}
+
+bool set_int_option(int fd, int level, int option, uint64_t value, const char* name) {
+    int v = static_cast<int>(std::min<uint64_t>(value, INT_MAX));
+    if (setsockopt(fd, level, option, &v, sizeof(v)) < 0) {
+        std::cerr << "Failed to set " << name << " to " << value << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// The FORCE variants ignore net.core.[rw]mem_max but need CAP_NET_ADMIN
+bool set_buffer(int fd, int force_option, int option, uint64_t bytes, const char* name) {
+    int v = static_cast<int>(std::min<uint64_t>(bytes, INT_MAX / 2));
+    if (setsockopt(fd, SOL_SOCKET, force_option, &v, sizeof(v)) == 0) {
+        return true;
+    }
+    return set_int_option(fd, SOL_SOCKET, option, bytes, name);
+}
+
+} // namespace
+
+std::string SocketTuning::label() const {
+    std::ostringstream text;
+    text << std::setprecision(15);  // Byte sizes in full
+    for (const auto& number : tuning_numbers(*this)) {
+        text << (text.tellp() > 0 ? " " : "") << number.first << "=";
+        if (number.first == "qdisc") {
+            text << qdisc;
+        } else {
+            text << number.second;
+        }
+    }
+    return text.tellp() > 0 ? text.str() : "default";
+}
+
+bool parse_tuning_dimension(const std::string& text, TuningDimension& dimension) {
+    size_t equals = text.find('=');
+    if (equals == std::string::npos) {
+        std::cerr << "Tuning dimension '" << text << "' is not NAME=VALUE,...\n";
+        return false;
+    }
+    dimension.name = text.substr(0, equals);
+    dimension.values.clear();
+
+    std::istringstream values(text.substr(equals + 1));
+    std::string value;
+    SocketTuning scratch;
+    while (std::getline(values, value, ',')) {
+        if (!set_tuning_value(scratch, dimension.name, value)) {
+            return false;
+        }
+        dimension.values.push_back(value);
+    }
+    if (dimension.values.empty()) {
+        std::cerr << "Tuning dimension " << dimension.name << " has no values\n";
+        return false;
+    }
+    return true;
+}
+
+std::vector<SocketTuning> tuning_grid(const std::vector<TuningDimension>& dimensions) {
+    std::vector<SocketTuning> grid(1);
+    for (const auto& dimension : dimensions) {
+        std::vector<SocketTuning> next;
+        for (const auto& tuning : grid) {
+            for (const auto& value : dimension.values) {
+                next.push_back(tuning);
+                set_tuning_value(next.back(), dimension.name, value);
+            }
+        }
+        grid.swap(next);
+    }
+    return grid;
+}
+
+bool set_tuning_value(SocketTuning& tuning, const std::string& name, const std::string& value) {
+    bool ok = true;
+    if (std::find(std::begin(kTuningNames), std::end(kTuningNames), name) == std::end(kTuningNames)) {
+        std::cerr << "Unknown tuning dimension: " << name << std::endl;
+        return false;
+    }
+    if (value == "default") {
+        return set_tuning_number(tuning, name, 0.0);
+    }
+
+    uint64_t bytes = 0;
+    if (name == "max_pacing") {
+        char* end = nullptr;
+        double mbps = std::strtod(value.c_str(), &end);
+        ok = end != value.c_str() && *end == '\0' && mbps > 0.0;
+        tuning.max_pacing_mbps = mbps;
+    } else if (name == "initcwnd") {
+        ok = parse_bytes(value, bytes) && bytes > 0 && bytes <= 1024;
+        tuning.initcwnd = static_cast<uint32_t>(bytes);
+    } else if (name == "qdisc") {
+        ok = std::find(std::begin(kTuningQdiscs), std::end(kTuningQdiscs), value) != std::end(kTuningQdiscs);
+        tuning.qdisc = value;
+    } else {
+        ok = parse_bytes(value, bytes) && bytes > 0;
+        set_tuning_number(tuning, name, static_cast<double>(bytes));
+    }
+    if (!ok) {
+        std::cerr << "Bad value '" << value << "' for tuning dimension " << name << std::endl;
+    }
+    return ok;
+}
+
+std::vector<std::pair<std::string, double>> tuning_numbers(const SocketTuning& tuning) {
+    std::vector<std::pair<std::string, double>> numbers;
+    size_t qdisc = std::find(std::begin(kTuningQdiscs), std::end(kTuningQdiscs), tuning.qdisc) -
+                   std::begin(kTuningQdiscs);
+    const double values[] = {
+        static_cast<double>(tuning.sndbuf), static_cast<double>(tuning.rcvbuf),
+        static_cast<double>(tuning.notsent_lowat), tuning.max_pacing_mbps,
+        static_cast<double>(tuning.tcp_rmem_max), static_cast<double>(tuning.tcp_wmem_max),
+        static_cast<double>(tuning.initcwnd),
+        tuning.qdisc.empty() ? 0.0 : static_cast<double>(qdisc + 1),
+    };
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+        if (values[i] > 0.0) {
+            numbers.emplace_back(kTuningNames[i], values[i]);
+        }
+    }
+    return numbers;
+}
+
+bool set_tuning_number(SocketTuning& tuning, const std::string& name, double value) {
+    uint64_t whole = static_cast<uint64_t>(std::max(value, 0.0));
+    if (name == "sndbuf") {
+        tuning.sndbuf = whole;
+    } else if (name == "rcvbuf") {
+        tuning.rcvbuf = whole;
+    } else if (name == "notsent_lowat") {
+        tuning.notsent_lowat = whole;
+    } else if (name == "max_pacing") {
+        tuning.max_pacing_mbps = std::max(value, 0.0);
+    } else if (name == "tcp_rmem") {
+        tuning.tcp_rmem_max = whole;
+    } else if (name == "tcp_wmem") {
+        tuning.tcp_wmem_max = whole;
+    } else if (name == "initcwnd") {
+        tuning.initcwnd = static_cast<uint32_t>(whole);
+    } else if (name == "qdisc") {
+        size_t count = sizeof(kTuningQdiscs) / sizeof(kTuningQdiscs[0]);
+        tuning.qdisc = whole >= 1 && whole <= count ? kTuningQdiscs[whole - 1] : "";
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool apply_sender_tuning(int fd, const SocketTuning& tuning) {
+    bool ok = true;
+    if (tuning.sndbuf > 0) {
+        ok = set_buffer(fd, SO_SNDBUFFORCE, SO_SNDBUF, tuning.sndbuf, "SO_SNDBUF") && ok;
+    }
+    if (tuning.notsent_lowat > 0) {
+        ok = set_int_option(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, tuning.notsent_lowat, "TCP_NOTSENT_LOWAT") && ok;
+    }
+    if (tuning.max_pacing_mbps > 0.0) {
+        // Bytes per second; kernels before 5.x only take 32 bits
+        uint64_t rate = static_cast<uint64_t>(tuning.max_pacing_mbps * 1e6 / 8.0);
+        uint32_t rate32 = static_cast<uint32_t>(std::min<uint64_t>(rate, UINT32_MAX));
+        int err = rate > UINT32_MAX ? setsockopt(fd, SOL_SOCKET, SO_MAX_PACING_RATE, &rate, sizeof(rate))
+                                    : setsockopt(fd, SOL_SOCKET, SO_MAX_PACING_RATE, &rate32, sizeof(rate32));
+        if (err < 0) {
+            std::cerr << "Failed to set SO_MAX_PACING_RATE: " << std::strerror(errno) << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool apply_receiver_tuning(int fd, const SocketTuning& tuning) {
+    if (tuning.rcvbuf > 0) {
+        return set_buffer(fd, SO_RCVBUFFORCE, SO_RCVBUF, tuning.rcvbuf, "SO_RCVBUF");
+    }
+    return true;
+}
+
+SysctlOverride::~SysctlOverride() {
+    restore();
+}
+
+std::string SysctlOverride::read(const std::string& name) {
+    std::ifstream file("/proc/sys/" + name);
+    std::string value;
+    std::getline(file, value);
+    return value;
+}
+
+bool SysctlOverride::save(const std::string& name) {
+    if (name == name_) {
+        return true;
+    }
+    restore();
+    std::string original = read(name);
+    if (original.empty()) {
+        std::cerr << "Cannot read sysctl " << name << std::endl;
+        return false;
+    }
+    name_ = name;
+    original_ = original;
+    return true;
+}
+
+bool SysctlOverride::set(const std::string& name, const std::string& value) {
+    if (!save(name)) {
+        return false;
+    }
+    // Registered before the write, so no moment is left uncovered
+    if (crash_slot_ < 0) {
+        crash_slot_ = register_sysctl_restore(name_, original_);
+    }
+    changed_ = true;
+    std::ofstream file("/proc/sys/" + name);
+    file << value;
+    file.close();
+    if (!file) {
+        std::cerr << "Cannot write sysctl " << name << " (needs root)\n";
+        return false;
+    }
+    return true;
+}
+
+void SysctlOverride::restore() {
+    if (!changed_) {
+        return;
+    }
+    std::ofstream file("/proc/sys/" + name_);
+    file << original_;
+    file.close();
+    if (!file) {
+        std::cerr << "Cannot restore sysctl " << name_ << " to " << original_ << std::endl;
+    }
+    unregister_crash_restore(crash_slot_);
+    crash_slot_ = -1;
+    changed_ = false;
+}
+
+InitcwndOverride::~InitcwndOverride() {
+    restore();
+}
+
+bool InitcwndOverride::save(const std::string& interface, const std::string& address) {
+    int ifindex = static_cast<int>(if_nametoindex(interface.c_str()));
+    if (ifindex != 0 && ifindex == ifindex_ && address == address_) {
+        return true;
+    }
+    restore();
+    if (ifindex == 0) {
+        std::cerr << "Unknown interface: " << interface << std::endl;
+        return false;
+    }
+    uint32_t original = 0;
+    std::vector<char> message;
+    if ((nl_.fd() < 0 && !nl_.open()) ||
+        !netlink_get_local_route_initcwnd(nl_, ifindex, address, original) ||
+        !netlink_local_route_message(ifindex, address, original, message)) {
+        return false;
+    }
+    ifindex_ = ifindex;
+    address_ = address;
+    original_ = original;
+    restore_message_ = message;
+    return true;
+}
+
+bool InitcwndOverride::set(const std::string& interface, const std::string& address, uint32_t initcwnd) {
+    if (!save(interface, address)) {
+        return false;
+    }
+    if (crash_slot_ < 0) {
+        crash_slot_ = register_netlink_restore(nl_.fd(), restore_message_);
+    }
+    changed_ = true;
+    return netlink_set_local_route_initcwnd(nl_, ifindex_, address_, initcwnd);
+}
+
+void InitcwndOverride::restore() {
+    if (!changed_) {
+        return;
+    }
+    if (!netlink_set_local_route_initcwnd(nl_, ifindex_, address_, original_)) {
+        std::cerr << "Could not restore the route to " << address_ << std::endl;
+    }
+    unregister_crash_restore(crash_slot_);
+    crash_slot_ = -1;
+    changed_ = false;
+}
@@ -0,0 +1,65 @@
+#include "tcp_sweep_scheduler.h"
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <sched.h>
+
+namespace {
+
+// CPUs in this process's affinity mask, in ascending order
+std::vector<int> allowed_cpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    return cpus;
+}
+
+} // namespace
+
+SweepScheduler::SweepScheduler(int max_jobs) {
+    std::vector<int> cpus = allowed_cpus();
+
+    // One sender core and one receiver core per worker
+    for (size_t i = 0; i + 1 < cpus.size(); i += 2) {
+        slots_.push_back({cpus[i], cpus[i + 1]});
+    }
+
+    // A single core cannot be split; run one unpinned worker
+    if (slots_.empty()) {
+        slots_.push_back({-1, -1});
+    }
+
+    if (max_jobs > 0 && static_cast<size_t>(max_jobs) < slots_.size()) {
+        slots_.resize(static_cast<size_t>(max_jobs));
+    }
+}
+
+void SweepScheduler::run(const std::vector<SweepCell>& cells,
+                         const std::function<void(const SweepCell&, const CpuPair&)>& run_cell) {
+    std::atomic<size_t> next_cell(0);
+    std::vector<std::thread> workers;
+
+    for (const auto& slot : slots_) {
+        workers.emplace_back([&, slot]() {
+            for (;;) {
+                size_t index = next_cell.fetch_add(1);
+                if (index >= cells.size()) {
+                    break;
+                }
+                run_cell(cells[index], slot);
+            }
+        });
+    }
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
@@ -0,0 +1,457 @@
+#include "tcp_transfer_engine.h"
+
+#include <algorithm>
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <linux/tcp.h>
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+namespace {
+
+// Receiver buffer floor; large reads keep the receiver off the critical path
+const size_t kMinReceiveBuffer = 1024 * 1024;
+
+// Reap zerocopy completions every this many sends even without ENOBUFS
+const uint64_t kZerocopyReapInterval = 64;
+
+// Send timestamp at the start of each copy-mode message
+const size_t kStampSize = sizeof(uint64_t);
+
+// Top stamp bit marks an interleaved request; monotonic time never gets there
+const uint64_t kRequestFlag = uint64_t(1) << 63;
+
+// Answer to an interleaved request: its send time and its receive time
+const size_t kResponseSize = 2 * sizeof(uint64_t);
+
+uint64_t monotonic_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+bool read_tcp_info(int fd, struct tcp_info& info) {
+    socklen_t len = sizeof(info);
+    std::memset(&info, 0, sizeof(info));
+    return getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) == 0;
+}
+
+} // namespace
+
+bool parse_send_mode(const std::string& name, SendMode& mode) {
+    if (name == "copy") {
+        mode = SendMode::Copy;
+    } else if (name == "zerocopy") {
+        mode = SendMode::ZeroCopy;
+    } else if (name == "splice") {
+        mode = SendMode::Splice;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* send_mode_name(SendMode mode) {
+    switch (mode) {
+        case SendMode::ZeroCopy: return "zerocopy";
+        case SendMode::Splice:   return "splice";
+        case SendMode::Copy:
+        default:                 return "copy";
+    }
+}
+
+bool pin_current_thread(int cpu) {
+    if (cpu < 0) {
+        return true;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0) {
+        std::cerr << "Failed to pin thread to CPU " << cpu << ": " << std::strerror(err) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+TransferEngine::TransferEngine(int send_fd, int recv_fd, const TransferConfig& config)
+    : send_fd_(send_fd),
+      recv_fd_(recv_fd),
+      config_(config),
+      pipe_fds_{-1, -1},
+      stop_requested_(false),
+      sent_(0),
+      received_(0),
+      running_(false),
+      stamp_messages_(false),
+      send_offset_(0),
+      inline_requests_(false),
+      request_interval_ns_(0),
+      next_request_ns_(0),
+      request_pending_(false),
+      acked_at_start_(0),
+      retrans_at_start_(0) {
+    if (config_.message_size == 0) {
+        config_.message_size = TransferConfig().message_size;
+    }
+
+    // Payload content is irrelevant; fill it once so pages are resident
+    send_buffer_.assign(config_.message_size, 'x');
+    recv_buffer_.resize(std::max(config_.message_size, kMinReceiveBuffer));
+}
+
+TransferEngine::~TransferEngine() {
+    if (running_) {
+        stop();
+    }
+    if (pipe_fds_[0] >= 0) {
+        close(pipe_fds_[0]);
+    }
+    if (pipe_fds_[1] >= 0) {
+        close(pipe_fds_[1]);
+    }
+}
+
+bool TransferEngine::setup_send_mode() {
+    if (config_.send_mode == SendMode::ZeroCopy) {
+        int one = 1;
+        if (setsockopt(send_fd_, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0) {
+            std::cerr << "SO_ZEROCOPY not supported (" << std::strerror(errno)
+                      << "), falling back to copy mode\n";
+            config_.send_mode = SendMode::Copy;
+        }
+    } else if (config_.send_mode == SendMode::Splice) {
+        if (pipe2(pipe_fds_, O_CLOEXEC) < 0) {
+            std::cerr << "Failed to create splice pipe (" << std::strerror(errno)
+                      << "), falling back to copy mode\n";
+            config_.send_mode = SendMode::Copy;
+            return true;
+        }
+
+        // Size the pipe to hold a full message; the kernel may round or cap it
+        int pipe_size = fcntl(pipe_fds_[1], F_SETPIPE_SZ, static_cast<int>(config_.message_size));
+        if (pipe_size < 0) {
+            pipe_size = fcntl(pipe_fds_[1], F_GETPIPE_SZ);
+        }
+        if (pipe_size > 0 && static_cast<size_t>(pipe_size) < config_.message_size) {
+            config_.message_size = static_cast<size_t>(pipe_size);
+        }
+    }
+    return true;
+}
+
+bool TransferEngine::start() {
+    if (running_) {
+        return true;
+    }
+    if (send_fd_ < 0 || recv_fd_ < 0) {
+        std::cerr << "Transfer engine needs a connected socket pair\n";
+        return false;
+    }
+    if (!setup_send_mode()) {
+        return false;
+    }
+
+    struct tcp_info info;
+    if (read_tcp_info(send_fd_, info)) {
+        acked_at_start_ = info.tcpi_bytes_acked;
+        retrans_at_start_ = info.tcpi_total_retrans;
+    }
+
+    // zerocopy and splice hand the buffer's pages to the kernel, so only
+    // copy mode may rewrite it between sends
+    stamp_messages_ = config_.send_mode == SendMode::Copy && config_.message_size >= kStampSize;
+    send_offset_ = 0;
+    owd_us_.clear();
+
+    inline_requests_ = stamp_messages_ && config_.inline_rpc_hz > 0;
+    inline_rtt_us_.clear();
+    inline_owd_us_.clear();
+    if (inline_requests_) {
+        request_interval_ns_ = 1000000000ull / static_cast<uint64_t>(config_.inline_rpc_hz);
+        next_request_ns_ = monotonic_ns();
+        request_pending_.store(false, std::memory_order_relaxed);
+        // Answers are lone small segments on the reverse direction
+        int one = 1;
+        setsockopt(recv_fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    stop_requested_.store(false, std::memory_order_relaxed);
+    sent_.store(0, std::memory_order_relaxed);
+    received_.store(0, std::memory_order_relaxed);
+    start_time_ = std::chrono::steady_clock::now();
+
+    receiver_ = std::thread(&TransferEngine::receiver_loop, this);
+    sender_ = std::thread(&TransferEngine::sender_loop, this);
+    if (inline_requests_) {
+        responses_ = std::thread(&TransferEngine::response_loop, this);
+    }
+    running_ = true;
+    return true;
+}
+
+TransferStats TransferEngine::stop() {
+    TransferStats stats;
+    if (!running_) {
+        return stats;
+    }
+
+    // Snapshot the measurement window before tearing the connection down,
+    // so draining queued data does not count towards the interval
+    auto end_time = std::chrono::steady_clock::now();
+    struct tcp_info info;
+    bool have_info = read_tcp_info(send_fd_, info);
+    stats.bytes_received = received_.load(std::memory_order_relaxed);
+    stats.bytes_sent = sent_.load(std::memory_order_relaxed);
+
+    // Wake up blocked threads: a write shutdown fails pending sends with EPIPE,
+    // a read shutdown makes pending recvs return 0
+    stop_requested_.store(true, std::memory_order_relaxed);
+    shutdown(send_fd_, SHUT_WR);
+    shutdown(recv_fd_, SHUT_RD);
+    if (inline_requests_) {
+        shutdown(send_fd_, SHUT_RD);
+    }
+
+    if (sender_.joinable()) {
+        sender_.join();
+    }
+    if (receiver_.joinable()) {
+        receiver_.join();
+    }
+    if (responses_.joinable()) {
+        responses_.join();
+    }
+    running_ = false;
+    stats.owd_us = owd_us_;
+    stats.inline_rtt_us = inline_rtt_us_;
+    stats.inline_owd_us = inline_owd_us_;
+
+    stats.elapsed_seconds = std::chrono::duration<double>(end_time - start_time_).count();
+    if (have_info) {
+        stats.bytes_acked = info.tcpi_bytes_acked - acked_at_start_;
+        stats.rtt_ms = info.tcpi_rtt / 1000.0;
+        stats.rttvar_ms = info.tcpi_rttvar / 1000.0;
+        stats.retransmits = info.tcpi_total_retrans - retrans_at_start_;
+    }
+    if (stats.elapsed_seconds > 0.0) {
+        stats.throughput_mbps = stats.bytes_acked * 8.0 / stats.elapsed_seconds / 1e6;
+        stats.goodput_mbps = stats.bytes_received * 8.0 / stats.elapsed_seconds / 1e6;
+    }
+    return stats;
+}
+
+ssize_t TransferEngine::send_copy() {
+    if (send_offset_ == 0 && stamp_messages_) {
+        uint64_t now = monotonic_ns();
+        uint64_t stamp = now;
+        if (inline_requests_ && now >= next_request_ns_ &&
+            !request_pending_.load(std::memory_order_acquire)) {
+            stamp |= kRequestFlag;
+            request_pending_.store(true, std::memory_order_relaxed);
+            next_request_ns_ = now + request_interval_ns_;
+        }
+        std::memcpy(send_buffer_.data(), &stamp, sizeof(stamp));
+    }
+    ssize_t n = send(send_fd_, send_buffer_.data() + send_offset_, config_.message_size - send_offset_,
+                     MSG_NOSIGNAL);
+    if (n > 0) {
+        send_offset_ = (send_offset_ + static_cast<size_t>(n)) % config_.message_size;
+    }
+    return n;
+}
+
+ssize_t TransferEngine::send_zerocopy() {
+    for (;;) {
+        ssize_t n = send(send_fd_, send_buffer_.data(), config_.message_size,
+                         MSG_ZEROCOPY | MSG_NOSIGNAL);
+        if (n >= 0 || errno != ENOBUFS) {
+            return n;
+        }
+        // Too many outstanding notifications pin optmem; reap and retry
+        reap_zerocopy_completions();
+        if (stop_requested_.load(std::memory_order_relaxed)) {
+            return -1;
+        }
+    }
+}
+
+ssize_t TransferEngine::send_splice() {
+    // The pages are referenced, not copied, by vmsplice; the buffer is never
+    // modified so in-flight pages stay valid
+    struct iovec iov;
+    iov.iov_base = send_buffer_.data();
+    iov.iov_len = config_.message_size;
+
+    ssize_t in_pipe = vmsplice(pipe_fds_[1], &iov, 1, 0);
+    if (in_pipe <= 0) {
+        return in_pipe;
+    }
+
+    ssize_t moved = 0;
+    while (moved < in_pipe) {
+        ssize_t n = splice(pipe_fds_[0], nullptr, send_fd_, nullptr,
+                           static_cast<size_t>(in_pipe - moved),
+                           SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (n <= 0) {
+            return -1;
+        }
+        moved += n;
+    }
+    return moved;
+}
+
+void TransferEngine::reap_zerocopy_completions() {
+    char control[128];
+    for (;;) {
+        struct msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(send_fd_, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            return;  // EAGAIN: queue drained
+        }
+        // Completion ranges only matter for buffer reuse; our buffer is
+        // immutable, so consuming the notifications is all that is needed
+    }
+}
+
+void TransferEngine::sender_loop() {
+    uint64_t local_sent = 0;
+    uint64_t sends = 0;
+
+    pin_current_thread(config_.sender_cpu);
+
+    while (!stop_requested_.load(std::memory_order_relaxed)) {
+        ssize_t n;
+        switch (config_.send_mode) {
+            case SendMode::ZeroCopy: n = send_zerocopy(); break;
+            case SendMode::Splice:   n = send_splice();   break;
+            case SendMode::Copy:
+            default:                 n = send_copy();     break;
+        }
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (!stop_requested_.load(std::memory_order_relaxed) && errno != EPIPE) {
+                std::cerr << "Sender error: " << std::strerror(errno) << std::endl;
+            }
+            break;
+        }
+
+        local_sent += static_cast<uint64_t>(n);
+        sent_.store(local_sent, std::memory_order_relaxed);
+
+        if (config_.send_mode == SendMode::ZeroCopy && ++sends % kZerocopyReapInterval == 0) {
+            reap_zerocopy_completions();
+        }
+    }
+
+    if (config_.send_mode == SendMode::ZeroCopy) {
+        reap_zerocopy_completions();
+    }
+}
+
+void TransferEngine::receiver_loop() {
+    uint64_t local_received = 0;
+    char stamp[kStampSize];
+
+    pin_current_thread(config_.receiver_cpu);
+
+    for (;;) {
+        ssize_t n = recv(recv_fd_, recv_buffer_.data(), recv_buffer_.size(), 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (!stop_requested_.load(std::memory_order_relaxed)) {
+                std::cerr << "Receiver error: " << std::strerror(errno) << std::endl;
+            }
+            break;
+        }
+        if (n == 0) {
+            break;  // Peer closed or local read shutdown
+        }
+
+        if (stamp_messages_) {
+            // Visit only the stamp bytes of each message in this read; a
+            // stamp split across reads is completed by the next one
+            uint64_t now = monotonic_ns();
+            size_t pos = 0;
+            while (pos < static_cast<size_t>(n)) {
+                size_t in_message = static_cast<size_t>((local_received + pos) % config_.message_size);
+                if (in_message >= kStampSize) {
+                    pos += config_.message_size - in_message;
+                    continue;
+                }
+                size_t take = std::min(kStampSize - in_message, static_cast<size_t>(n) - pos);
+                std::memcpy(stamp + in_message, recv_buffer_.data() + pos, take);
+                pos += take;
+                if (in_message + take == kStampSize) {
+                    uint64_t sent_at;
+                    std::memcpy(&sent_at, stamp, sizeof(sent_at));
+                    bool request = (sent_at & kRequestFlag) != 0;
+                    sent_at &= ~kRequestFlag;
+                    if (now >= sent_at) {
+                        owd_us_.record((now - sent_at) / 1000);
+                    }
+                    if (request) {
+                        // Answer on the reverse direction; it only carries ACKs
+                        // besides these, so the send does not block
+                        uint64_t response[2] = {sent_at, now};
+                        inline_owd_us_.record((now - sent_at) / 1000);
+                        send(recv_fd_, response, kResponseSize, MSG_NOSIGNAL);
+                    }
+                }
+            }
+        }
+
+        local_received += static_cast<uint64_t>(n);
+        received_.store(local_received, std::memory_order_relaxed);
+    }
+}
+
+void TransferEngine::response_loop() {
+    char response[kResponseSize];
+    size_t have = 0;
+
+    for (;;) {
+        ssize_t n = recv(send_fd_, response + have, kResponseSize - have, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;  // Read shutdown by stop() or peer closed
+        }
+        have += static_cast<size_t>(n);
+        if (have < kResponseSize) {
+            continue;
+        }
+        have = 0;
+
+        uint64_t now = monotonic_ns();
+        uint64_t sent_at;
+        std::memcpy(&sent_at, response, sizeof(sent_at));
+        if (now >= sent_at) {
+            inline_rtt_us_.record((now - sent_at) / 1000);
+        }
+        request_pending_.store(false, std::memory_order_release);
+    }
+}
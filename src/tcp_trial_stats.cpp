@@ -0,0 +1,264 @@
+#include "tcp_trial_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Two-sided 95% t quantiles for 1..30 degrees of freedom
+const double kStudentT95[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+const double kNormal95 = 1.960;
+
+// Largest total sample size the exact U distribution is computed for
+const size_t kMaxExactMannWhitney = 40;
+
+// Warm-up detection works on batch means of this length
+const uint64_t kWarmupBatchNs = 20 * 1000 * 1000;
+const size_t kMinWarmupBatches = 10;
+
+} // namespace
+
+double ConfidenceInterval::relative() const {
+    if (mean == 0.0) {
+        return half_width == 0.0 && n > 1 ? 0.0 : std::numeric_limits<double>::infinity();
+    }
+    return half_width / std::fabs(mean);
+}
+
+double student_t95(size_t degrees_of_freedom) {
+    const size_t table = sizeof(kStudentT95) / sizeof(kStudentT95[0]);
+    if (degrees_of_freedom == 0) {
+        return std::numeric_limits<double>::infinity();
+    }
+    if (degrees_of_freedom <= table) {
+        return kStudentT95[degrees_of_freedom - 1];
+    }
+    // Beyond the table the excess over the normal quantile falls as 1/dof
+    return kNormal95 + (kStudentT95[table - 1] - kNormal95) * table / degrees_of_freedom;
+}
+
+ConfidenceInterval confidence_interval(const std::vector<double>& values) {
+    ConfidenceInterval interval;
+    interval.n = values.size();
+    if (values.empty()) {
+        return interval;
+    }
+
+    // Welford's update keeps the variance accurate for large, close values
+    double mean = 0.0;
+    double m2 = 0.0;
+    for (size_t i = 0; i < values.size(); ++i) {
+        double delta = values[i] - mean;
+        mean += delta / static_cast<double>(i + 1);
+        m2 += delta * (values[i] - mean);
+    }
+    interval.mean = mean;
+    if (values.size() > 1) {
+        double stddev = std::sqrt(m2 / static_cast<double>(values.size() - 1));
+        interval.half_width = student_t95(values.size() - 1) * stddev / std::sqrt(static_cast<double>(values.size()));
+    }
+    return interval;
+}
+
+double mann_whitney_min_p(size_t n1, size_t n2) {
+    if (n1 == 0 || n2 == 0) {
+        return 1.0;
+    }
+    // Both extreme orderings out of C(n1 + n2, n1)
+    double orderings = 1.0;
+    for (size_t i = 1; i <= std::min(n1, n2); ++i) {
+        orderings = orderings * static_cast<double>(n1 + n2 - std::min(n1, n2) + i) / static_cast<double>(i);
+    }
+    return std::min(1.0, 2.0 / orderings);
+}
+
+double mann_whitney_p(const std::vector<double>& a, const std::vector<double>& b) {
+    const size_t n1 = a.size();
+    const size_t n2 = b.size();
+    if (n1 == 0 || n2 == 0) {
+        return 1.0;
+    }
+
+    // Mid-ranks of the pooled sample; `from_a` marks a's values
+    std::vector<std::pair<double, bool>> pooled;
+    pooled.reserve(n1 + n2);
+    for (double value : a) {
+        pooled.push_back({value, true});
+    }
+    for (double value : b) {
+        pooled.push_back({value, false});
+    }
+    std::sort(pooled.begin(), pooled.end());
+
+    const double n = static_cast<double>(n1 + n2);
+    double rank_sum = 0.0;
+    double tie_term = 0.0;
+    for (size_t i = 0; i < pooled.size();) {
+        size_t j = i;
+        while (j < pooled.size() && pooled[j].first == pooled[i].first) {
+            ++j;
+        }
+        double tied = static_cast<double>(j - i);
+        double rank = (static_cast<double>(i + 1) + static_cast<double>(j)) / 2.0;
+        for (size_t k = i; k < j; ++k) {
+            if (pooled[k].second) {
+                rank_sum += rank;
+            }
+        }
+        tie_term += tied * tied * tied - tied;
+        i = j;
+    }
+    const double u1 = rank_sum - static_cast<double>(n1) * static_cast<double>(n1 + 1) / 2.0;
+    const double pairs = static_cast<double>(n1) * static_cast<double>(n2);
+    const double u = std::min(u1, pairs - u1);
+
+    if (tie_term == 0.0 && n1 + n2 <= kMaxExactMannWhitney) {
+        // counts[j][v]: orderings of i values of a and j of b with U = v,
+        // built up one value of a at a time
+        const size_t max_u = n1 * n2;
+        std::vector<std::vector<double>> counts(n2 + 1, std::vector<double>(max_u + 1, 0.0));
+        for (size_t j = 0; j <= n2; ++j) {
+            counts[j][0] = 1.0;
+        }
+        for (size_t i = 1; i <= n1; ++i) {
+            std::vector<std::vector<double>> next(n2 + 1, std::vector<double>(max_u + 1, 0.0));
+            next[0][0] = 1.0;
+            for (size_t j = 1; j <= n2; ++j) {
+                for (size_t v = 0; v <= i * j; ++v) {
+                    // The largest value is from a (beats all j of b) or from b
+                    next[j][v] = (v >= j ? counts[j][v - j] : 0.0) + next[j - 1][v];
+                }
+            }
+            counts.swap(next);
+        }
+        double total = 0.0;
+        double tail = 0.0;
+        for (size_t v = 0; v <= max_u; ++v) {
+            total += counts[n2][v];
+            if (static_cast<double>(v) <= u) {
+                tail += counts[n2][v];
+            }
+        }
+        return std::min(1.0, 2.0 * tail / total);
+    }
+
+    const double variance = pairs / 12.0 * ((n + 1.0) - tie_term / (n * (n - 1.0)));
+    if (variance <= 0.0) {
+        return 1.0;
+    }
+    const double z = std::max(std::fabs(u1 - pairs / 2.0) - 0.5, 0.0) / std::sqrt(variance);
+    return std::min(1.0, std::erfc(z / std::sqrt(2.0)));
+}
+
+TrialTracker::TrialTracker(const TrialPolicy& policy)
+    : policy_(policy), start_(std::chrono::steady_clock::now()) {
+    policy_.max_trials = std::max(policy_.max_trials, 1);
+    policy_.min_trials = std::min(std::max(policy_.min_trials, 2), policy_.max_trials);
+}
+
+void TrialTracker::add(double throughput_mbps, double p99_rtt_ms) {
+    throughput_.push_back(throughput_mbps);
+    if (p99_rtt_ms >= 0.0) {
+        p99_rtt_.push_back(p99_rtt_ms);
+    }
+}
+
+bool TrialTracker::converged() const {
+    if (policy_.tolerance <= 0.0 || trials() < static_cast<size_t>(policy_.min_trials)) {
+        return false;
+    }
+    // Trials without RTT samples leave the RTT criterion to the others
+    return throughput().relative() <= policy_.tolerance &&
+           (p99_rtt_.empty() || (p99_rtt_.size() > 1 && p99_rtt().relative() <= policy_.tolerance));
+}
+
+bool TrialTracker::over_budget(double trial_seconds) const {
+    if (policy_.budget_seconds <= 0.0 || trials() == 0) {
+        return false;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    return elapsed + trial_seconds > policy_.budget_seconds;
+}
+
+bool TrialTracker::done(double trial_seconds) const {
+    return trials() >= static_cast<size_t>(policy_.max_trials) || converged() || over_budget(trial_seconds);
+}
+
+const char* TrialTracker::stop_reason(double trial_seconds) const {
+    if (converged()) {
+        return "converged";
+    }
+    if (over_budget(trial_seconds) && trials() < static_cast<size_t>(policy_.max_trials)) {
+        return "time budget";
+    }
+    return "max trials";
+}
+
+size_t mser_truncation(const std::vector<double>& batches) {
+    size_t n = batches.size();
+    if (n < 2) {
+        return 0;
+    }
+
+    // Suffix sums give the mean and spread of every tail in one pass
+    std::vector<double> sum(n + 1, 0.0);
+    std::vector<double> squares(n + 1, 0.0);
+    for (size_t i = n; i-- > 0;) {
+        sum[i] = sum[i + 1] + batches[i];
+        squares[i] = squares[i + 1] + batches[i] * batches[i];
+    }
+
+    size_t best = 0;
+    double best_score = std::numeric_limits<double>::infinity();
+    for (size_t d = 0; d <= n / 2; ++d) {
+        double count = static_cast<double>(n - d);
+        double mean = sum[d] / count;
+        double spread = std::max(squares[d] - count * mean * mean, 0.0);
+        double score = spread / (count * count);
+        if (score < best_score) {
+            best_score = score;
+            best = d;
+        }
+    }
+    return best;
+}
+
+size_t warmup_end(const TcpInfoSeries& series) {
+    size_t rows = series.rows();
+    if (rows < 2) {
+        return 0;
+    }
+
+    // Cut the series into fixed-time batches: delivered rate from
+    // bytes_acked and mean RTT
+    std::vector<size_t> starts;
+    std::vector<double> rate;
+    std::vector<double> rtt;
+    size_t first = 0;
+    double rtt_sum = 0.0;
+    for (size_t i = 0; i < rows; ++i) {
+        rtt_sum += series.rtt_us[i];
+        if (series.t_ns[i] - series.t_ns[first] >= kWarmupBatchNs || i + 1 == rows) {
+            if (i > first) {
+                double seconds = (series.t_ns[i] - series.t_ns[first]) / 1e9;
+                starts.push_back(first);
+                rate.push_back((series.bytes_acked[i] - series.bytes_acked[first]) / seconds);
+                rtt.push_back(rtt_sum / static_cast<double>(i - first + 1));
+            }
+            // Batches share their boundary sample
+            first = i;
+            rtt_sum = series.rtt_us[i];
+        }
+    }
+    if (starts.size() < kMinWarmupBatches) {
+        return 0;
+    }
+
+    size_t batch = std::max(mser_truncation(rate), mser_truncation(rtt));
+    return starts[batch];
+}
@@ -0,0 +1,540 @@
+#include "tcp_userspace_emulator.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+// Bytes one trace entry allows onto the link (Mahimahi's packet size)
+const size_t kTraceOpportunityBytes = 1500;
+
+// Largest single recv() into the ring, so one direction cannot starve the other
+const size_t kReadBatch = 256 * 1024;
+
+// Bounds for the preallocated ring of one direction
+const size_t kMinRingBytes = 1024 * 1024;
+const size_t kMaxRingBytes = 256 * 1024 * 1024;
+
+// Assumed ceiling when the forward direction has no rate limit
+const double kUnlimitedBytesPerSecond = 10e9 / 8.0;
+
+// Departure records held in the delay line at once
+const size_t kMaxDepartures = 64 * 1024;
+
+const uint64_t kNever = std::numeric_limits<uint64_t>::max();
+
+uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// One direction of the relay. Bytes live in a preallocated ring and move
+// through three regions, tracked as absolute stream offsets:
+//
+//   head_ .. released_   delay elapsed, waiting to be written out
+//   released_ .. departed_   left the bottleneck, in the delay line
+//   departed_ .. tail_   queued at the bottleneck
+class RelayPipe {
+public:
+    RelayPipe()
+        : capacity_(0), queue_limit_(0), delay_ns_(0), rate_bytes_per_ns_(0.0),
+          burst_bytes_(0.0), tokens_(0.0), last_refill_ns_(0),
+          trace_(nullptr), trace_index_(0), trace_base_ns_(0),
+          head_(0), released_(0), departed_(0), tail_(0),
+          departure_head_(0), departure_count_(0) {}
+
+    void init(size_t queue_limit, uint64_t delay_ns, double rate_bytes_per_second,
+              const DeliveryTrace* trace, double ring_rate_bytes_per_second, uint64_t start_ns) {
+        queue_limit_ = queue_limit;
+        delay_ns_ = delay_ns;
+        rate_bytes_per_ns_ = rate_bytes_per_second / 1e9;
+        trace_ = (trace != nullptr && !trace->empty()) ? trace : nullptr;
+
+        // Room for a full queue plus everything in the delay line
+        double in_flight = ring_rate_bytes_per_second * static_cast<double>(delay_ns) / 1e9;
+        capacity_ = std::min(kMaxRingBytes,
+                             std::max(kMinRingBytes, queue_limit + static_cast<size_t>(in_flight)));
+        ring_.assign(capacity_, 0);
+        departures_.assign(kMaxDepartures, Departure());
+
+        // A millisecond of tokens keeps the bucket smooth without stalling
+        // on large recv() batches
+        burst_bytes_ = std::max(2.0 * kTraceOpportunityBytes, rate_bytes_per_second / 1000.0);
+        tokens_ = burst_bytes_;
+        last_refill_ns_ = start_ns;
+        trace_base_ns_ = start_ns;
+    }
+
+    size_t queued() const { return static_cast<size_t>(tail_ - departed_); }
+    bool empty() const { return head_ == tail_; }
+    bool can_read() const { return read_space() > 0; }
+    bool has_deliverable() const { return released_ > head_; }
+
+    // Pull bytes from the sending socket into the queue.
+    // Returns bytes read, 0 on EOF, -1 when nothing is available.
+    ssize_t read_from(int fd) {
+        size_t space = std::min(read_space(), kReadBatch);
+        size_t offset = static_cast<size_t>(tail_ % capacity_);
+        space = std::min(space, capacity_ - offset);
+
+        ssize_t n = recv(fd, ring_.data() + offset, space, MSG_DONTWAIT);
+        if (n > 0) {
+            tail_ += static_cast<uint64_t>(n);
+        } else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            return 0;  // Treat a broken sender like EOF
+        }
+        return n;
+    }
+
+    // Let queued bytes leave the bottleneck and release delayed bytes
+    void advance(uint64_t now) {
+        if (trace_ != nullptr) {
+            drain_trace(now);
+        } else if (rate_bytes_per_ns_ > 0.0) {
+            drain_token_bucket(now);
+        } else if (queued() > 0) {
+            depart(queued(), now);
+        }
+
+        while (departure_count_ > 0) {
+            const Departure& front = departures_[departure_head_];
+            if (front.release_ns > now) {
+                break;
+            }
+            released_ = front.end;
+            departure_head_ = (departure_head_ + 1) % departures_.size();
+            --departure_count_;
+        }
+    }
+
+    // Write released bytes to the receiving socket.
+    // Returns bytes written, 0 if the socket is full, -1 on error.
+    ssize_t write_to(int fd) {
+        ssize_t total = 0;
+        while (head_ < released_) {
+            size_t offset = static_cast<size_t>(head_ % capacity_);
+            size_t len = std::min(static_cast<size_t>(released_ - head_), capacity_ - offset);
+            ssize_t n = send(fd, ring_.data() + offset, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                }
+                return -1;
+            }
+            head_ += static_cast<uint64_t>(n);
+            total += n;
+        }
+        return total;
+    }
+
+    // Earliest time at which advance() can make progress
+    uint64_t next_event(uint64_t now) const {
+        uint64_t next = kNever;
+        if (departure_count_ > 0) {
+            next = departures_[departure_head_].release_ns;
+        }
+        if (queued() > 0 && departure_count_ < departures_.size()) {
+            if (trace_ != nullptr) {
+                next = std::min(next, trace_next_ns());
+            } else if (rate_bytes_per_ns_ > 0.0) {
+                double wanted = std::min(static_cast<double>(queued()),
+                                         static_cast<double>(kTraceOpportunityBytes));
+                double missing = std::max(0.0, wanted - tokens_);
+                next = std::min(next, now + static_cast<uint64_t>(missing / rate_bytes_per_ns_) + 1);
+            } else {
+                next = now;
+            }
+        }
+        return next;
+    }
+
+private:
+    struct Departure {
+        uint64_t end = 0;         // Stream offset one past the departed bytes
+        uint64_t release_ns = 0;  // When they reach the far end
+    };
+
+    std::vector<char> ring_;
+    size_t capacity_;
+    size_t queue_limit_;
+    uint64_t delay_ns_;
+
+    // Token bucket
+    double rate_bytes_per_ns_;
+    double burst_bytes_;
+    double tokens_;
+    uint64_t last_refill_ns_;
+
+    // Trace replay
+    const DeliveryTrace* trace_;
+    size_t trace_index_;
+    uint64_t trace_base_ns_;
+
+    uint64_t head_;
+    uint64_t released_;
+    uint64_t departed_;
+    uint64_t tail_;
+
+    std::vector<Departure> departures_;
+    size_t departure_head_;
+    size_t departure_count_;
+
+    size_t read_space() const {
+        size_t ring_free = capacity_ - static_cast<size_t>(tail_ - head_);
+        size_t queue_free = queued() >= queue_limit_ ? 0 : queue_limit_ - queued();
+        return std::min(ring_free, queue_free);
+    }
+
+    uint64_t trace_next_ns() const {
+        return trace_base_ns_ + trace_->opportunities_ns[trace_index_];
+    }
+
+    // Move bytes from the queue into the delay line. Returns false when the
+    // delay line has no free record.
+    bool depart(size_t bytes, uint64_t when) {
+        uint64_t release = when + delay_ns_;
+        if (departure_count_ > 0) {
+            size_t last = (departure_head_ + departure_count_ - 1) % departures_.size();
+            if (departures_[last].release_ns == release) {
+                departed_ += bytes;
+                departures_[last].end = departed_;
+                return true;
+            }
+        }
+        if (departure_count_ == departures_.size()) {
+            return false;
+        }
+        departed_ += bytes;
+        size_t slot = (departure_head_ + departure_count_) % departures_.size();
+        departures_[slot].end = departed_;
+        departures_[slot].release_ns = release;
+        ++departure_count_;
+        return true;
+    }
+
+    void drain_token_bucket(uint64_t now) {
+        if (now > last_refill_ns_) {
+            tokens_ = std::min(burst_bytes_,
+                               tokens_ + static_cast<double>(now - last_refill_ns_) * rate_bytes_per_ns_);
+            last_refill_ns_ = now;
+        }
+        size_t bytes = std::min(queued(), static_cast<size_t>(tokens_));
+        if (bytes > 0 && depart(bytes, now)) {
+            tokens_ -= static_cast<double>(bytes);
+        }
+    }
+
+    // Each trace entry that has come due carries one packet. Entries that
+    // find the queue empty are lost, as in Mahimahi.
+    void drain_trace(uint64_t now) {
+        const std::vector<uint64_t>& opportunities = trace_->opportunities_ns;
+        while (trace_next_ns() <= now) {
+            size_t bytes = std::min(queued(), kTraceOpportunityBytes);
+            if (bytes > 0 && !depart(bytes, trace_next_ns())) {
+                return;  // Delay line full; retry this entry later
+            }
+            if (++trace_index_ == opportunities.size()) {
+                trace_index_ = 0;
+                trace_base_ns_ += trace_->period_ns;
+            }
+        }
+    }
+};
+
+// Relayed sockets are non-blocking; Nagle would only add delay on top of
+// the emulated one
+bool prepare_relay_socket(int fd) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+} // namespace
+
+bool DeliveryTrace::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open delivery trace " << path << std::endl;
+        return false;
+    }
+
+    opportunities_ns.clear();
+    uint64_t previous = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        uint64_t ms = 0;
+        try {
+            ms = std::stoull(line);
+        } catch (const std::exception&) {
+            std::cerr << "Invalid delivery trace line in " << path << ": " << line << std::endl;
+            return false;
+        }
+        if (ms < previous) {
+            std::cerr << "Delivery trace " << path << " is not sorted" << std::endl;
+            return false;
+        }
+        previous = ms;
+        opportunities_ns.push_back(ms * 1000000ULL);
+    }
+
+    if (opportunities_ns.empty() || previous == 0) {
+        std::cerr << "Delivery trace " << path << " has no usable entries" << std::endl;
+        opportunities_ns.clear();
+        return false;
+    }
+    period_ns = previous * 1000000ULL;
+    return true;
+}
+
+double DeliveryTrace::mean_rate_mbps() const {
+    if (period_ns == 0) {
+        return 0.0;
+    }
+    double bits = static_cast<double>(opportunities_ns.size() * kTraceOpportunityBytes) * 8.0;
+    return bits / (static_cast<double>(period_ns) / 1e9) / 1e6;
+}
+
+UserspaceLinkEmulator::UserspaceLinkEmulator(const UserspaceEmulatorConfig& config)
+    : config_(config), listen_fd_(-1), wake_fd_(-1), port_(0), forwarded_(0), max_queue_(0) {}
+
+UserspaceLinkEmulator::~UserspaceLinkEmulator() {
+    stop();
+}
+
+bool UserspaceLinkEmulator::start() {
+    if (!config_.trace_file.empty() && !trace_.load(config_.trace_file)) {
+        return false;
+    }
+
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        std::cerr << "Failed to create emulator socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t len = sizeof(addr);
+    if (bind(listen_fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        listen(listen_fd_, 1) < 0 ||
+        getsockname(listen_fd_, reinterpret_cast<struct sockaddr*>(&addr), &len) < 0) {
+        std::cerr << "Failed to set up emulator port: " << std::strerror(errno) << std::endl;
+        close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+    port_ = ntohs(addr.sin_port);
+
+    wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wake_fd_ < 0) {
+        std::cerr << "Failed to create eventfd: " << std::strerror(errno) << std::endl;
+        close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+
+    relay_ = std::thread(&UserspaceLinkEmulator::relay_loop, this);
+    return true;
+}
+
+void UserspaceLinkEmulator::stop() {
+    if (relay_.joinable()) {
+        uint64_t one = 1;
+        ssize_t ignored = write(wake_fd_, &one, sizeof(one));
+        (void)ignored;
+        relay_.join();
+    }
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        listen_fd_ = -1;
+    }
+    if (wake_fd_ >= 0) {
+        close(wake_fd_);
+        wake_fd_ = -1;
+    }
+}
+
+void UserspaceLinkEmulator::relay_loop() {
+    // Wait for the test client, unless stop() comes first
+    struct pollfd accept_fds[2] = {{listen_fd_, POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+    while (poll(accept_fds, 2, -1) < 0) {
+        if (errno != EINTR) {
+            return;
+        }
+    }
+    if (accept_fds[1].revents != 0) {
+        return;
+    }
+
+    int client = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client < 0) {
+        std::cerr << "Emulator failed to accept: " << std::strerror(errno) << std::endl;
+        return;
+    }
+
+    int server = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in target;
+    std::memset(&target, 0, sizeof(target));
+    target.sin_family = AF_INET;
+    target.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    target.sin_port = htons(config_.target_port);
+    if (server < 0 || connect(server, reinterpret_cast<struct sockaddr*>(&target), sizeof(target)) < 0) {
+        std::cerr << "Emulator failed to reach port " << config_.target_port << ": "
+                  << std::strerror(errno) << std::endl;
+        if (server >= 0) {
+            close(server);
+        }
+        close(client);
+        return;
+    }
+    prepare_relay_socket(client);
+    prepare_relay_socket(server);
+
+    double rate_bytes_per_second = config_.rate_mbps * 1e6 / 8.0;
+    double ring_rate = rate_bytes_per_second;
+    if (!trace_.empty()) {
+        // Traces are bursty; leave headroom above the mean
+        ring_rate = 4.0 * trace_.mean_rate_mbps() * 1e6 / 8.0;
+    } else if (ring_rate <= 0.0) {
+        ring_rate = kUnlimitedBytesPerSecond;
+    }
+
+    uint64_t one_way_ns = static_cast<uint64_t>(config_.delay_ms * 1e6 / 2.0);
+    size_t queue_bytes = config_.queue_bytes;
+    if (queue_bytes == 0) {
+        // One BDP over the full RTT, and never less than a few packets
+        queue_bytes = std::max<size_t>(256 * 1024,
+                                       static_cast<size_t>(ring_rate * config_.delay_ms / 1000.0));
+    }
+
+    uint64_t start = now_ns();
+    RelayPipe forward;
+    RelayPipe reverse;
+    forward.init(queue_bytes, one_way_ns, rate_bytes_per_second,
+                 trace_.empty() ? nullptr : &trace_, ring_rate, start);
+    reverse.init(kMinRingBytes, one_way_ns, 0.0, nullptr, kUnlimitedBytesPerSecond, start);
+
+    bool client_eof = false;
+    bool server_eof = false;
+    bool server_shut = false;
+    bool client_shut = false;
+    uint64_t max_queue = 0;
+
+    for (;;) {
+        bool progress = false;
+        uint64_t now = now_ns();
+
+        forward.advance(now);
+        reverse.advance(now);
+
+        ssize_t written = forward.write_to(server);
+        if (written < 0) {
+            break;
+        }
+        if (written > 0) {
+            forwarded_.fetch_add(static_cast<uint64_t>(written), std::memory_order_relaxed);
+            progress = true;
+        }
+        written = reverse.write_to(client);
+        if (written < 0) {
+            break;
+        }
+        progress = progress || written > 0;
+
+        if (!client_eof && forward.can_read()) {
+            ssize_t n = forward.read_from(client);
+            client_eof = n == 0;
+            progress = progress || n > 0;
+        }
+        if (!server_eof && reverse.can_read()) {
+            ssize_t n = reverse.read_from(server);
+            server_eof = n == 0;
+            progress = progress || n > 0;
+        }
+
+        if (forward.queued() > max_queue) {
+            max_queue = forward.queued();
+            max_queue_.store(max_queue, std::memory_order_relaxed);
+        }
+
+        // Pass half-closes on once everything before them has been delivered
+        if (client_eof && forward.empty() && !server_shut) {
+            shutdown(server, SHUT_WR);
+            server_shut = true;
+        }
+        if (server_eof && reverse.empty() && !client_shut) {
+            shutdown(client, SHUT_WR);
+            client_shut = true;
+        }
+        if (server_shut && client_shut) {
+            break;
+        }
+        if (progress) {
+            continue;
+        }
+
+        struct pollfd fds[3];
+        fds[0] = {client, 0, 0};
+        fds[1] = {server, 0, 0};
+        fds[2] = {wake_fd_, POLLIN, 0};
+        if (!client_eof && forward.can_read()) {
+            fds[0].events |= POLLIN;
+        }
+        if (reverse.has_deliverable()) {
+            fds[0].events |= POLLOUT;
+        }
+        if (!server_eof && reverse.can_read()) {
+            fds[1].events |= POLLIN;
+        }
+        if (forward.has_deliverable()) {
+            fds[1].events |= POLLOUT;
+        }
+
+        uint64_t next = std::min(forward.next_event(now), reverse.next_event(now));
+        struct timespec timeout;
+        struct timespec* timeout_ptr = nullptr;
+        if (next != kNever) {
+            uint64_t wait = next > now ? next - now : 0;
+            timeout.tv_sec = static_cast<time_t>(wait / 1000000000ULL);
+            timeout.tv_nsec = static_cast<long>(wait % 1000000000ULL);
+            timeout_ptr = &timeout;
+        }
+
+        if (ppoll(fds, 3, timeout_ptr, nullptr) < 0 && errno != EINTR) {
+            break;
+        }
+        if (fds[2].revents != 0) {
+            break;
+        }
+        if ((fds[0].revents | fds[1].revents) & (POLLERR | POLLNVAL)) {
+            break;
+        }
+    }
+
+    close(server);
+    close(client);
+}